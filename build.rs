@@ -7,9 +7,16 @@
 //! Build script for Rustux kernel
 //!
 //! This build script:
-//! 1. Compiles assembly files (context switch)
+//! 1. Compiles assembly files (context switch, AP startup trampoline)
 //! 2. Embeds files into the kernel as a ramdisk
 //! 3. Generates ramdisk.bin at build time
+//!
+//! Setting RUSTUX_AUTORUN to a ramdisk path (e.g. "/bin/bench") adds an
+//! /etc/autorun file naming it, which init spawns at boot.
+//!
+//! Setting RUSTUX_RAMDISK_COMPRESS=1 stores ramdisk files as LZ4 blocks
+//! wherever that saves at least an eighth of their size; the kernel
+//! decompresses each one the first time it is used.
 
 use std::env;
 use std::fs;
@@ -19,6 +26,7 @@ use std::io::Write;
 fn main() {
     // Tell cargo to rerun this script if source files change
     println!("cargo:rerun-if-changed=src/arch/amd64/switch.S");
+    println!("cargo:rerun-if-changed=src/arch/amd64/ap_trampoline.S");
     println!("cargo:rerun-if-changed=test-userspace/");
     println!("cargo:rerun-if-changed=test-userspace/shell/");
     println!("cargo:rerun-if-changed=files/");
@@ -26,18 +34,26 @@ fn main() {
     println!("cargo:rerun-if-changed=target/counter.elf");
     println!("cargo:rerun-if-changed=target/init.elf");
     println!("cargo:rerun-if-changed=target/shell.elf");
+    println!("cargo:rerun-if-changed=target/bench.elf");
+    println!("cargo:rerun-if-changed=target/bench-peer.elf");
+    println!("cargo:rerun-if-env-changed=RUSTUX_AUTORUN");
+    println!("cargo:rerun-if-env-changed=RUSTUX_RAMDISK_COMPRESS");
 
     // Get the output directory
     let out_dir = PathBuf::from(env::var("OUT_DIR").unwrap());
 
     // ============================================================================
-    // Part 1: Compile context switch assembly
+    // Part 1: Compile assembly (context switch, AP startup trampoline)
     // ============================================================================
 
-    let asm_file = PathBuf::from("src/arch/amd64/switch.S");
-    let obj_file = out_dir.join("switch.o");
+    for name in ["switch", "ap_trampoline"] {
+        let asm_file = PathBuf::from(format!("src/arch/amd64/{}.S", name));
+        let obj_file = out_dir.join(format!("{}.o", name));
+
+        if !asm_file.exists() {
+            continue;
+        }
 
-    if asm_file.exists() {
         let status = std::process::Command::new("cc")
             .arg("-c")
             .arg("-o")
@@ -63,16 +79,33 @@ fn main() {
         name_offset: u32,
         data_offset: u32,
         size: u32,
-        _pad: u32,
+        name_len: u32,
+        stored_size: u32,
+        compression: u32,     // 0 = stored, 1 = LZ4 block
     }
 
     #[repr(C)]
     struct RamdiskSuperblock {
-        magic: u32,           // 0x52555458 ("RUTX")
+        magic: u32,           // 0x52555833 ("RUX3")
         num_files: u32,
         files_offset: u32,
+        index_offset: u32,
+        index_buckets: u32,
+        _reserved: [u32; 3],
+    }
+
+    // Name index hash (32-bit FNV-1a, matching ramdisk::name_hash)
+    fn name_hash(name: &[u8]) -> u32 {
+        let mut hash: u32 = 0x811c_9dc5;
+        for &b in name {
+            hash ^= b as u32;
+            hash = hash.wrapping_mul(0x0100_0193);
+        }
+        hash
     }
 
+    let compress = env::var("RUSTUX_RAMDISK_COMPRESS").map_or(false, |v| !v.is_empty() && v != "0");
+
     let ramdisk_output = out_dir.join("ramdisk.bin");
     let mut ramdisk = fs::File::create(&ramdisk_output)
         .expect("Failed to create ramdisk.bin");
@@ -83,12 +116,24 @@ fn main() {
         ("files/test.txt", "test.txt"),
     ];
 
+    // Program for init to start at boot (used by scripts/perf-test.sh)
+    let autorun_path = out_dir.join("autorun");
+    let autorun_src = autorun_path.to_str().unwrap().to_string();
+    if let Ok(program) = env::var("RUSTUX_AUTORUN") {
+        fs::write(&autorun_path, format!("{}\n", program))
+            .expect("Failed to write autorun file");
+        files_to_embed.push((autorun_src.as_str(), "etc/autorun"));
+        println!("cargo:warning=Autorun at boot: {}", program);
+    }
+
     // Check for ELF binaries in target directory
     let potential_elf_files = vec![
         ("target/hello.elf", "bin/hello"),
         ("target/counter.elf", "bin/counter"),
         ("target/init.elf", "bin/init"),
         ("target/shell.elf", "bin/shell"),
+        ("target/bench.elf", "bin/bench"),
+        ("target/bench-peer.elf", "bin/bench-peer"),
     ];
 
     // Add ELF files if they exist
@@ -119,38 +164,84 @@ fn main() {
     let superblock_size = std::mem::size_of::<RamdiskSuperblock>() as u32;
     let file_entry_size = std::mem::size_of::<RamdiskFile>() as u32;
 
-    // Start offsets
-    let mut files_offset = superblock_size;
-    let mut names_offset = files_offset + file_entry_size * files_to_embed.len() as u32;
-    let mut data_offset = names_offset;
+    // File data is page-aligned so the kernel can map it in place
+    const PAGE_SIZE: u32 = 4096;
+    let page_align = |offset: u32| (offset + PAGE_SIZE - 1) & !(PAGE_SIZE - 1);
+
+    // Name index: open addressing with linear probing, at most half full
+    let index_buckets = (files_to_embed.len() as u32 * 2).next_power_of_two();
+    let mut index = vec![u32::MAX; index_buckets as usize];
+    for (i, (_src_path, name)) in files_to_embed.iter().enumerate() {
+        let mask = index_buckets - 1;
+        let mut slot = name_hash(name.as_bytes()) & mask;
+        while index[slot as usize] != u32::MAX {
+            let other = files_to_embed[index[slot as usize] as usize].1;
+            if other == *name {
+                panic!("Duplicate ramdisk file name: {}", name);
+            }
+            slot = (slot + 1) & mask;
+        }
+        index[slot as usize] = i as u32;
+    }
+
+    // Start offsets: headers, index, then all names, then page-aligned data
+    let files_offset = superblock_size;
+    let index_offset = files_offset + file_entry_size * files_to_embed.len() as u32;
+    let names_offset = index_offset + 4 * index_buckets;
     let mut file_entries = Vec::new();
+    let mut file_contents = Vec::new();
 
     // First pass: calculate all offsets
-    for (src_path, _name) in &files_to_embed {
+    let mut name_offset = names_offset;
+    for (src_path, name) in &files_to_embed {
         let contents = fs::read(src_path)
             .expect(&format!("Failed to read file: {}", src_path));
+        let size = contents.len() as u32;
 
-        let name_bytes = _name.as_bytes();
+        // Keep a compressed copy only if it is worth decompressing
+        let compressed = if compress { lz4_compress(&contents) } else { Vec::new() };
+        let (stored, compression) = if compress && compressed.len() < contents.len() - contents.len() / 8 {
+            (compressed, 1)
+        } else {
+            (contents, 0)
+        };
 
-        // Calculate offsets
-        let name_len = name_bytes.len() as u32;
         file_entries.push(RamdiskFile {
-            name_offset: data_offset,
-            data_offset: data_offset + name_len + 1, // +1 for null terminator
-            size: contents.len() as u32,
-            _pad: 0,
+            name_offset,
+            data_offset: 0, // Assigned below, once all names are placed
+            size,
+            name_len: name.len() as u32,
+            stored_size: stored.len() as u32,
+            compression,
         });
+        file_contents.push(stored);
+
+        name_offset += name.len() as u32 + 1; // +1 for null terminator
+    }
 
-        // Update data offset (after name + null terminator)
-        data_offset = data_offset + name_len + 1;
+    // Stored files start on a page boundary (to be mapped in place);
+    // compressed ones are packed, since they are decompressed elsewhere
+    let mut data_offset = name_offset;
+    for entry in &mut file_entries {
+        if entry.compression == 0 {
+            data_offset = page_align(data_offset);
+        }
+        entry.data_offset = data_offset;
+        data_offset += entry.stored_size;
     }
+    let data_offset = page_align(data_offset);
 
     // Second pass: write the ramdisk
+    let mut image = Vec::with_capacity(data_offset as usize);
+
     // Write superblock
     let superblock = RamdiskSuperblock {
-        magic: 0x52555458,
+        magic: 0x52555833,
         num_files: file_entries.len() as u32,
         files_offset: files_offset,
+        index_offset,
+        index_buckets,
+        _reserved: [0; 3],
     };
 
     unsafe {
@@ -158,40 +249,42 @@ fn main() {
             &superblock as *const _ as *const u8,
             std::mem::size_of::<RamdiskSuperblock>(),
         );
-        ramdisk.write_all(superblock_bytes).unwrap();
+        image.extend_from_slice(superblock_bytes);
     }
 
-    // Write file headers (at files_offset)
-    // First pad to files_offset
-    let mut current_size = superblock_size as usize;
-    while current_size < files_offset as usize {
-        ramdisk.write_all(&[0]).unwrap();
-        current_size += 1;
-    }
-
-    // Write file entries
+    // Write file entries (at files_offset)
+    image.resize(files_offset as usize, 0);
     for entry in &file_entries {
         unsafe {
             let entry_bytes = std::slice::from_raw_parts(
                 entry as *const _ as *const u8,
                 std::mem::size_of::<RamdiskFile>(),
             );
-            ramdisk.write_all(entry_bytes).unwrap();
+            image.extend_from_slice(entry_bytes);
         }
     }
 
-    // Write names and data
-    for (src_path, _name) in &files_to_embed {
-        // Write name (with null terminator)
-        ramdisk.write_all(_name.as_bytes()).unwrap();
-        ramdisk.write_all(&[0u8]).unwrap(); // null terminator
+    // Write the name index (at index_offset)
+    for slot in &index {
+        image.extend_from_slice(&slot.to_le_bytes());
+    }
 
-        // Write file contents
-        let contents = fs::read(src_path)
-            .expect(&format!("Failed to read file: {}", src_path));
-        ramdisk.write_all(&contents).unwrap();
+    // Write names (with null terminators)
+    for (_src_path, name) in &files_to_embed {
+        image.extend_from_slice(name.as_bytes());
+        image.push(0);
     }
 
+    // Write file contents, stored ones zero-padded to a page boundary so
+    // a mapping of the last page exposes nothing but zeros
+    for (entry, contents) in file_entries.iter().zip(&file_contents) {
+        image.resize(entry.data_offset as usize, 0);
+        image.extend_from_slice(contents);
+    }
+    image.resize(data_offset as usize, 0);
+
+    ramdisk.write_all(&image).unwrap();
+
     // Tell cargo where to find the ramdisk
     println!("cargo:rustc-env=RAMDISK_PATH={}", ramdisk_output.display());
     println!("cargo:rerun-if-changed={}", ramdisk_output.display());
@@ -201,6 +294,14 @@ fn main() {
         file_entries.len(),
         ramdisk.metadata().unwrap().len()
     );
+    if compress {
+        let compressed: Vec<_> = file_entries.iter().filter(|e| e.compression != 0).collect();
+        println!("cargo:warning=Ramdisk: {} files compressed, {} -> {} bytes",
+            compressed.len(),
+            compressed.iter().map(|e| e.size as u64).sum::<u64>(),
+            compressed.iter().map(|e| e.stored_size as u64).sum::<u64>()
+        );
+    }
 
     // ============================================================================
     // Part 3: Link search path
@@ -208,3 +309,72 @@ fn main() {
 
     println!("cargo:rustc-link-search={}", out_dir.display());
 }
+
+/// Compress `input` into one LZ4 block (decoded by src/fs/lz4.rs)
+///
+/// Greedy matching through a hash table of 4-byte sequences. Follows the
+/// format's end-of-block rules: the last match starts at least 12 bytes
+/// before the end, and the last 5 bytes are always literals.
+fn lz4_compress(input: &[u8]) -> Vec<u8> {
+    const MIN_MATCH: usize = 4;
+    const HASH_LOG: u32 = 16;
+    const MAX_OFFSET: usize = 65535;
+
+    // Lengths of 15 and more continue in bytes of up to 255
+    fn push_length(out: &mut Vec<u8>, mut len: usize) {
+        while len >= 255 {
+            out.push(255);
+            len -= 255;
+        }
+        out.push(len as u8);
+    }
+
+    fn push_sequence(out: &mut Vec<u8>, literals: &[u8], matched: Option<(usize, usize)>) {
+        let lit_len = literals.len();
+        let match_len = matched.map_or(0, |(_, len)| len - MIN_MATCH);
+        out.push(((lit_len.min(15) as u8) << 4) | match_len.min(15) as u8);
+        if lit_len >= 15 {
+            push_length(out, lit_len - 15);
+        }
+        out.extend_from_slice(literals);
+        if let Some((offset, _)) = matched {
+            out.extend_from_slice(&(offset as u16).to_le_bytes());
+            if match_len >= 15 {
+                push_length(out, match_len - 15);
+            }
+        }
+    }
+
+    let len = input.len();
+    let mut out = Vec::with_capacity(len / 2 + 16);
+    let mut table = vec![usize::MAX; 1 << HASH_LOG];
+    let match_limit = len.saturating_sub(12);
+    let extend_limit = len.saturating_sub(5);
+
+    let mut anchor = 0;
+    let mut pos = 0;
+    while pos < match_limit {
+        let seq = u32::from_le_bytes([input[pos], input[pos + 1], input[pos + 2], input[pos + 3]]);
+        let slot = (seq.wrapping_mul(2_654_435_761) >> (32 - HASH_LOG)) as usize;
+        let candidate = table[slot];
+        table[slot] = pos;
+
+        if candidate != usize::MAX
+            && pos - candidate <= MAX_OFFSET
+            && input[candidate..candidate + MIN_MATCH] == input[pos..pos + MIN_MATCH]
+        {
+            let mut match_len = MIN_MATCH;
+            while pos + match_len < extend_limit && input[candidate + match_len] == input[pos + match_len] {
+                match_len += 1;
+            }
+            push_sequence(&mut out, &input[anchor..pos], Some((pos - candidate, match_len)));
+            pos += match_len;
+            anchor = pos;
+        } else {
+            pos += 1;
+        }
+    }
+
+    push_sequence(&mut out, &input[anchor..], None);
+    out
+}
@@ -0,0 +1,204 @@
+#!/bin/bash
+# Performance regression harness for Rustux
+#
+# Builds the kernel with /bin/bench as the program init starts at boot,
+# boots it headlessly in QEMU, collects the "@BENCH <metric> <value>"
+# records the benchmark writes to the debug port (0xE9), and compares
+# them against scripts/perf-baseline.txt.
+#
+# Usage: scripts/perf-test.sh [--no-build] [--update-baseline] [--results FILE]
+#
+#   --no-build         Use the kernel and userspace already built
+#   --update-baseline  Record this run's values as the new baseline
+#   --results FILE     Where to keep the parsed results
+#                      (default /tmp/rustux-perf-results.txt)
+#
+# Environment:
+#   SMP           CPU count (default 2)
+#   PERF_TIMEOUT  Seconds to wait for the benchmarks (default 120)
+#   PERF_ACCEL    QEMU accelerator (default kvm if /dev/kvm is usable, else tcg)
+#
+# Cycle counts only compare between runs on the same host and
+# accelerator; record the baseline on the machine that runs the check.
+#
+# Exit status: 0 if nothing regressed, 1 on a regression, a missing
+# metric or a metric with no recorded baseline, 2 if the run did not
+# complete.
+
+set -e
+
+SCRIPT_DIR="$(cd "$(dirname "${BASH_SOURCE[0]}")" && pwd)"
+cd "$SCRIPT_DIR/.."
+
+BASELINE="scripts/perf-baseline.txt"
+RESULTS="/tmp/rustux-perf-results.txt"
+LOG="/tmp/rustux-perf-debug.log"
+IMG="/tmp/rustux-perf.img"
+EFI_DIR="/tmp/rustux-perf-efi"
+
+BUILD=1
+UPDATE=0
+while [ $# -gt 0 ]; do
+    case "$1" in
+        --no-build) BUILD=0 ;;
+        --update-baseline) UPDATE=1 ;;
+        --results) RESULTS="$2"; shift ;;
+        *)
+            echo "usage: $0 [--no-build] [--update-baseline] [--results FILE]"
+            exit 2
+            ;;
+    esac
+    shift
+done
+
+# ============================================================================
+# Prerequisites
+# ============================================================================
+
+if ! command -v qemu-system-x86_64 &> /dev/null; then
+    echo "QEMU not found! Install with: sudo apt install qemu-system-x86 ovmf"
+    exit 2
+fi
+
+OVMF_FD=""
+for path in "/usr/share/ovmf/OVMF.fd" "/usr/share/edk2-ovmf/x64/OVMF_CODE.fd"; do
+    if [ -f "$path" ]; then
+        OVMF_FD="$path"
+        break
+    fi
+done
+if [ -z "$OVMF_FD" ]; then
+    echo "ERROR: OVMF firmware not found! Install with: sudo apt install ovmf"
+    exit 2
+fi
+
+ACCEL="${PERF_ACCEL:-}"
+if [ -z "$ACCEL" ]; then
+    if [ -w /dev/kvm ]; then
+        ACCEL=kvm
+    else
+        ACCEL=tcg
+    fi
+fi
+
+# ============================================================================
+# Build
+# ============================================================================
+
+if [ "$BUILD" -eq 1 ]; then
+    echo "Building userspace..."
+    make -C userspace/c-progs copy > /dev/null
+
+    echo "Building kernel with /bin/bench as autorun..."
+    RUSTUX_AUTORUN=/bin/bench cargo build --release --bin rustux \
+        --features "uefi_kernel,userspace_test" --target x86_64-unknown-uefi
+fi
+
+rm -rf "$EFI_DIR"
+mkdir -p "$EFI_DIR/EFI/BOOT"
+cp target/x86_64-unknown-uefi/release/rustux.efi "$EFI_DIR/EFI/BOOT/BOOTX64.EFI"
+
+rm -f "$IMG"
+dd if=/dev/zero of="$IMG" bs=1M count=64 status=none
+mkfs.fat -F 32 "$IMG" > /dev/null 2>&1
+mcopy -i "$IMG" -s "$EFI_DIR/EFI" ::
+rm -rf "$EFI_DIR"
+
+# ============================================================================
+# Run
+# ============================================================================
+
+echo "Booting headless QEMU (accel=$ACCEL, smp=${SMP:-2})..."
+rm -f "$LOG"
+qemu-system-x86_64 \
+    -bios "$OVMF_FD" \
+    -drive format=raw,file="$IMG" \
+    -debugcon file:"$LOG" \
+    -display none \
+    -serial none \
+    -monitor none \
+    -m 512M \
+    -machine q35,accel="$ACCEL" \
+    -smp "${SMP:-2}" \
+    -no-reboot &
+QEMU_PID=$!
+trap 'kill $QEMU_PID 2> /dev/null || true; rm -f "$IMG"' EXIT
+
+TIMEOUT="${PERF_TIMEOUT:-120}"
+for _ in $(seq "$TIMEOUT"); do
+    if grep -q "@BENCH done" "$LOG" 2> /dev/null; then
+        break
+    fi
+    if ! kill -0 "$QEMU_PID" 2> /dev/null; then
+        break
+    fi
+    sleep 1
+done
+kill "$QEMU_PID" 2> /dev/null || true
+
+# Records may follow other debug output on the same line
+grep -ao "@BENCH [^ ]* [0-9][0-9]*" "$LOG" | awk '{ print $2, $3 }' > "$RESULTS"
+
+if ! grep -q "^done " "$RESULTS"; then
+    echo "ERROR: benchmarks did not complete within ${TIMEOUT}s"
+    echo "Debug log: $LOG"
+    exit 2
+fi
+
+# ============================================================================
+# Compare
+# ============================================================================
+
+if [ "$UPDATE" -eq 1 ]; then
+    awk 'NR == FNR { value[$1] = $2; next }
+         /^#/ || NF == 0 { print; next }
+         { v = ($1 in value) ? value[$1] : $2
+           printf "%-24s %-12s %-4s %s\n", $1, v, $3, $4 }' \
+        "$RESULTS" "$BASELINE" > "$BASELINE.new"
+    mv "$BASELINE.new" "$BASELINE"
+    echo "Baseline updated: $BASELINE"
+    exit 0
+fi
+
+echo ""
+printf "%-24s %12s %12s %9s  %s\n" "metric" "baseline" "result" "change" "status"
+set +e
+awk 'NR == FNR { value[$1] = $2; next }
+     /^#/ || NF == 0 { next }
+     {
+         metric = $1; base = $2; tol = $3; better = $4
+         if (!(metric in value)) {
+             printf "%-24s %12s %12s %9s  %s\n", metric, base, "-", "", "MISSING"
+             bad++
+             next
+         }
+         v = value[metric]
+         if (base == "-" || base == 0) {
+             printf "%-24s %12s %12s %9s  %s\n", metric, base, v, "", "UNRECORDED"
+             unrecorded++
+             next
+         }
+         change = (v - base) * 100 / base
+         status = "ok"
+         if (better == "lower" && change > tol) status = "REGRESSED"
+         if (better == "higher" && -change > tol) status = "REGRESSED"
+         if (status != "ok") bad++
+         printf "%-24s %12s %12s %+8.1f%%  %s\n", metric, base, v, change, status
+     }
+     END {
+         if (unrecorded > 0) {
+             printf "\n%d metric(s) have no baseline: record them with --update-baseline\n", unrecorded
+         }
+         exit bad + unrecorded > 0
+     }' "$RESULTS" "$BASELINE"
+STATUS=$?
+set -e
+
+echo ""
+echo "All results: $RESULTS"
+echo "Debug log:   $LOG"
+if [ "$STATUS" -ne 0 ]; then
+    echo "❌ Performance check failed (baselines and tolerances in $BASELINE)"
+    exit 1
+fi
+echo "✅ No performance regression"
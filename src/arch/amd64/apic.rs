@@ -9,6 +9,10 @@
 //! This module provides the actual APIC implementation for x86_64,
 //! including Local APIC and I/O APIC support.
 
+use core::sync::atomic::{AtomicBool, AtomicU64, Ordering};
+
+use super::{registers, tsc};
+
 /// Local APIC MMIO register offsets
 #[repr(C)]
 pub struct LocalApicRegisters {
@@ -119,6 +123,13 @@ pub fn apic_local_init() {
     // will intercept interrupts before they reach the IOAPIC
     pic_disable();
 
+    apic_local_enable();
+}
+
+/// Enable this CPU's Local APIC
+///
+/// Used directly by application processors, which have no PIC to disable.
+pub fn apic_local_enable() {
     unsafe {
         let apic_base = LOCAL_APIC_DEFAULT_BASE;
         let svr_offset = 0x70; // Spurious Interrupt Vector Register
@@ -135,7 +146,7 @@ pub fn apic_local_init() {
 /// The IRQ number is not used by the Local APIC EOI register,
 /// but we keep it for API compatibility.
 pub fn apic_send_eoi(_irq: u32) {
-    const LAPIC_EOI_OFFSET: u64 = 0x40;
+    const LAPIC_EOI_OFFSET: u64 = 0xB0;
 
     unsafe {
         let eoi_reg = (LOCAL_APIC_DEFAULT_BASE + LAPIC_EOI_OFFSET) as *mut u32;
@@ -148,6 +159,173 @@ pub fn apic_issue_eoi() {
     apic_send_eoi(0); // EOI number doesn't matter for LAPIC
 }
 
+/// Local APIC register offsets for IPIs and the timer
+const LAPIC_ID_OFFSET: u64 = 0x20;
+const LAPIC_ICR_LOW_OFFSET: u64 = 0x300;
+const LAPIC_ICR_HIGH_OFFSET: u64 = 0x310;
+const LAPIC_TIMER_LVT_OFFSET: u64 = 0x320;
+const LAPIC_TIMER_INITIAL_OFFSET: u64 = 0x380;
+const LAPIC_TIMER_CURRENT_OFFSET: u64 = 0x390;
+const LAPIC_TIMER_DIVIDE_OFFSET: u64 = 0x3E0;
+
+/// Timer LVT bits
+const LVT_MASKED: u32 = 1 << 16;
+const LVT_TIMER_PERIODIC: u32 = 1 << 17;
+const LVT_TIMER_TSC_DEADLINE: u32 = 2 << 17;
+
+/// CPUID.01H:ECX bit 24: the Local APIC timer supports TSC-deadline mode
+const CPUID_ECX_TSC_DEADLINE: u32 = 1 << 24;
+
+/// ICR delivery modes and flags
+const ICR_DELIVERY_FIXED: u32 = 0 << 8;
+const ICR_DELIVERY_INIT: u32 = 5 << 8;
+const ICR_DELIVERY_STARTUP: u32 = 6 << 8;
+const ICR_SEND_PENDING: u32 = 1 << 12;
+const ICR_LEVEL_ASSERT: u32 = 1 << 14;
+
+/// Read a Local APIC register
+#[inline]
+fn lapic_read(offset: u64) -> u32 {
+    unsafe { ((LOCAL_APIC_DEFAULT_BASE + offset) as *const u32).read_volatile() }
+}
+
+/// Write a Local APIC register
+#[inline]
+fn lapic_write(offset: u64, value: u32) {
+    unsafe { ((LOCAL_APIC_DEFAULT_BASE + offset) as *mut u32).write_volatile(value) }
+}
+
+/// Local APIC ID of the calling CPU
+pub fn apic_local_id() -> u32 {
+    lapic_read(LAPIC_ID_OFFSET) >> 24
+}
+
+/// Send an inter-processor interrupt
+///
+/// Waits for any previous IPI to be accepted first, so callers may send
+/// back to back.
+fn apic_send_icr(apic_id: u32, icr_low: u32) {
+    while lapic_read(LAPIC_ICR_LOW_OFFSET) & ICR_SEND_PENDING != 0 {
+        core::hint::spin_loop();
+    }
+    lapic_write(LAPIC_ICR_HIGH_OFFSET, apic_id << 24);
+    lapic_write(LAPIC_ICR_LOW_OFFSET, icr_low);
+}
+
+/// Send a fixed-vector IPI to one CPU
+pub fn apic_send_ipi(apic_id: u32, vector: u8) {
+    apic_send_icr(apic_id, ICR_DELIVERY_FIXED | ICR_LEVEL_ASSERT | vector as u32);
+}
+
+/// Send an INIT IPI (first step of application processor startup)
+pub fn apic_send_init(apic_id: u32) {
+    apic_send_icr(apic_id, ICR_DELIVERY_INIT | ICR_LEVEL_ASSERT);
+}
+
+/// Send a STARTUP IPI; the CPU starts in real mode at `page * 4096`
+pub fn apic_send_startup(apic_id: u32, page: u8) {
+    apic_send_icr(apic_id, ICR_DELIVERY_STARTUP | ICR_LEVEL_ASSERT | page as u32);
+}
+
+/// Start this CPU's Local APIC timer in periodic mode
+pub fn apic_timer_periodic(vector: u8, initial_count: u32) {
+    lapic_write(LAPIC_TIMER_DIVIDE_OFFSET, 0x03);                  // Divide by 16
+    lapic_write(LAPIC_TIMER_LVT_OFFSET, vector as u32 | LVT_TIMER_PERIODIC);
+    lapic_write(LAPIC_TIMER_INITIAL_OFFSET, initial_count);
+}
+
+/// ============================================================================
+/// One-Shot Timer
+/// ============================================================================
+
+// The timer is armed for one absolute TSC deadline at a time and never
+// ticks on its own. In TSC-deadline mode the deadline is written to
+// IA32_TSC_DEADLINE as is; otherwise it is converted to a one-shot count
+// with the LAPIC/TSC rate measured once at boot.
+
+/// True once the boot CPU found TSC-deadline mode
+static TSC_DEADLINE_MODE: AtomicBool = AtomicBool::new(false);
+
+/// LAPIC timer ticks (divide by 16) elapsed over `CALIBRATION_TSC` ticks
+static LAPIC_TICKS_PER_CALIBRATION: AtomicU64 = AtomicU64::new(0);
+static CALIBRATION_TSC: AtomicU64 = AtomicU64::new(0);
+
+/// Check for TSC-deadline mode (CPUID.01H:ECX[24])
+fn tsc_deadline_supported() -> bool {
+    let leaf1 = unsafe { core::arch::x86_64::__cpuid(1) };
+    leaf1.ecx & CPUID_ECX_TSC_DEADLINE != 0
+}
+
+/// Measure the LAPIC timer rate against the TSC (about 10 ms)
+fn apic_timer_calibrate() {
+    lapic_write(LAPIC_TIMER_DIVIDE_OFFSET, 0x03);    // Divide by 16
+    lapic_write(LAPIC_TIMER_LVT_OFFSET, LVT_MASKED); // One-shot, masked
+    lapic_write(LAPIC_TIMER_INITIAL_OFFSET, u32::MAX);
+
+    let start = tsc::tsc_ticks();
+    tsc::tsc_delay_ms(10);
+    let lapic_ticks = u32::MAX - lapic_read(LAPIC_TIMER_CURRENT_OFFSET);
+    let tsc_ticks = tsc::tsc_ticks().wrapping_sub(start);
+    lapic_write(LAPIC_TIMER_INITIAL_OFFSET, 0);
+
+    CALIBRATION_TSC.store(tsc_ticks.max(1), Ordering::Relaxed);
+    LAPIC_TICKS_PER_CALIBRATION.store(lapic_ticks as u64, Ordering::Relaxed);
+}
+
+/// Set up this CPU's Local APIC timer as a stopped one-shot timer
+///
+/// The boot CPU picks the mode (and calibrates the one-shot fallback);
+/// application processors reuse its choice. Interrupts are delivered on
+/// `vector` once [`apic_timer_set_deadline`] arms the timer.
+pub fn apic_timer_init(vector: u8, boot_cpu: bool) {
+    if boot_cpu {
+        let deadline_mode = tsc_deadline_supported();
+        TSC_DEADLINE_MODE.store(deadline_mode, Ordering::Relaxed);
+        if !deadline_mode {
+            apic_timer_calibrate();
+        }
+    }
+
+    if TSC_DEADLINE_MODE.load(Ordering::Relaxed) {
+        lapic_write(LAPIC_TIMER_LVT_OFFSET, vector as u32 | LVT_TIMER_TSC_DEADLINE);
+        unsafe { registers::write_msr(registers::msr::IA32_TSC_DEADLINE, 0) };
+    } else {
+        lapic_write(LAPIC_TIMER_DIVIDE_OFFSET, 0x03);
+        lapic_write(LAPIC_TIMER_LVT_OFFSET, vector as u32); // One-shot
+        lapic_write(LAPIC_TIMER_INITIAL_OFFSET, 0);
+    }
+}
+
+/// Check whether the timer runs in TSC-deadline mode
+pub fn apic_timer_tsc_deadline() -> bool {
+    TSC_DEADLINE_MODE.load(Ordering::Relaxed)
+}
+
+/// Arm this CPU's timer to fire once at TSC value `deadline`
+///
+/// Replaces any deadline already armed. A deadline in the past fires at
+/// once.
+pub fn apic_timer_set_deadline(deadline: u64) {
+    if TSC_DEADLINE_MODE.load(Ordering::Relaxed) {
+        unsafe { registers::write_msr(registers::msr::IA32_TSC_DEADLINE, deadline.max(1)) };
+        return;
+    }
+
+    let delta = deadline.saturating_sub(tsc::tsc_ticks()) as u128;
+    let lapic_ticks = delta * LAPIC_TICKS_PER_CALIBRATION.load(Ordering::Relaxed) as u128
+        / CALIBRATION_TSC.load(Ordering::Relaxed).max(1) as u128;
+    lapic_write(LAPIC_TIMER_INITIAL_OFFSET, lapic_ticks.clamp(1, u32::MAX as u128) as u32);
+}
+
+/// Disarm this CPU's timer
+pub fn apic_timer_stop() {
+    if TSC_DEADLINE_MODE.load(Ordering::Relaxed) {
+        unsafe { registers::write_msr(registers::msr::IA32_TSC_DEADLINE, 0) };
+    } else {
+        lapic_write(LAPIC_TIMER_INITIAL_OFFSET, 0);
+    }
+}
+
 /// Probe the I/O APIC to verify it's accessible
 ///
 /// Reads the IOAPIC ID and version registers to verify the IOAPIC
@@ -23,12 +23,19 @@
 //!
 //! # Assembly Interface
 //!
-//! The actual 16-bit code must be in assembly (start16.S).
+//! The actual 16-bit code is in assembly (ap_trampoline.S), which is
+//! copied to [`BOOTSTRAP_START`] and ends with a [`BootstrapInfo`] block.
 //! This Rust function is called after the switch to long mode.
 
+use core::sync::atomic::{AtomicU32, Ordering};
+
+use crate::arch::amd64::apic;
 use crate::arch::amd64::mm::page_tables::PAddr;
+use crate::arch::amd64::tsc;
 
 /// Bootstrap data passed from assembly to Rust
+///
+/// Field offsets are hard-coded in ap_trampoline.S.
 #[repr(C)]
 #[derive(Debug, Clone, Copy)]
 pub struct BootstrapInfo {
@@ -44,6 +51,24 @@ pub struct BootstrapInfo {
     pub entry_point: usize,
 }
 
+extern "C" {
+    /// First byte of the trampoline (ap_trampoline.S)
+    static ap_trampoline_start: u8;
+    /// Byte after the end of the trampoline
+    static ap_trampoline_end: u8;
+    /// BootstrapInfo block inside the trampoline
+    static ap_trampoline_info: u8;
+}
+
+/// CPU number of the last AP that copied its BootstrapInfo, plus one
+///
+/// The BSP waits for this before reusing the bootstrap area for the next
+/// AP.
+static AP_STARTED: AtomicU32 = AtomicU32::new(0);
+
+/// How long to wait for an AP to reach bootstrap16()
+const AP_START_TIMEOUT_MS: u64 = 100;
+
 /// Secondary CPU bootstrap entry (called from 16-bit assembly)
 ///
 /// This is called after the assembly code has switched to long mode.
@@ -57,22 +82,17 @@ pub struct BootstrapInfo {
 ///
 /// Must be called with valid bootstrap info
 #[no_mangle]
-pub unsafe extern "C" fn bootstrap16(info: BootstrapInfo) -> ! {
-    // TODO: Call the architecture-specific SMP initialization
-    // This function is defined in the architecture's mp module
-    // For now, halt since we don't have SMP support yet
+pub unsafe extern "C" fn bootstrap16(info: *const BootstrapInfo) -> ! {
+    // The block is reused for the next AP as soon as we acknowledge
+    let info = info.read_volatile();
+    AP_STARTED.store(info.cpu_num + 1, Ordering::Release);
 
-    let _ = info;
-
-    // Halt the CPU
-    loop {
-        core::arch::asm!("hlt", options(nomem, nostack));
-    }
+    crate::arch::amd64::smp::ap_main(info.cpu_num as usize, info.apic_id)
 }
 
 /// Initialize the bootstrap area in low memory
 ///
-/// This sets up the code and data that APs will execute when started.
+/// This copies the trampoline that APs will execute when started.
 ///
 /// # Arguments
 ///
@@ -81,32 +101,39 @@ pub unsafe extern "C" fn bootstrap16(info: BootstrapInfo) -> ! {
 ///
 /// # Returns
 ///
-/// Physical address of the bootstrap entry point
+/// Physical address of the trampoline's BootstrapInfo block, or 0 if the
+/// trampoline does not fit
 ///
 /// # Safety
 ///
-/// The bootstrap code area must be valid accessible memory
+/// The bootstrap code area must be valid, identity-mapped memory that
+/// nothing else uses
 pub unsafe fn init_bootstrap_area(bootstrap_code: PAddr, code_size: usize) -> PAddr {
-    // In a real implementation, this would:
-    // 1. Copy the 16-bit bootstrap code to the bootstrap area
-    // 2. Set up the bootstrap data structure
-    // 3. Configure the GDT for the bootstrap code
-    // 4. Return the entry point address
-
-    // For now, return the bootstrap code address as the entry point
-    let _ = code_size;
-    bootstrap_code
+    let start = &raw const ap_trampoline_start;
+    let end = &raw const ap_trampoline_end;
+    let info = &raw const ap_trampoline_info;
+
+    let size = end as usize - start as usize;
+    if size > code_size {
+        return 0;
+    }
+
+    core::ptr::copy_nonoverlapping(start, bootstrap_code as *mut u8, size);
+    bootstrap_code + (info as usize - start as usize) as PAddr
 }
 
 /// Start a secondary CPU
 ///
+/// Runs the INIT-SIPI-SIPI sequence and waits for the CPU to reach
+/// [`bootstrap16`], which then calls `entry_point` on `stack_top`.
+///
 /// # Arguments
 ///
-/// * `_cpu_num` - CPU number to start
-/// * `_apic_id` - APIC ID of the target CPU
-/// * `_entry_point` - 64-bit kernel entry point
-/// * `_stack_top` - Stack pointer for the new CPU
-/// * `_cr3` - Page table physical address
+/// * `cpu_num` - CPU number to start
+/// * `apic_id` - APIC ID of the target CPU
+/// * `entry_point` - 64-bit kernel entry point (normally [`bootstrap16`])
+/// * `stack_top` - Stack pointer for the new CPU (16-byte aligned)
+/// * `cr3` - Page table physical address (below 4GB)
 ///
 /// # Returns
 ///
@@ -117,27 +144,69 @@ pub unsafe fn init_bootstrap_area(bootstrap_code: PAddr, code_size: usize) -> PA
 /// This function manipulates APIC registers and should only be called
 /// by the BSP during initialization
 pub unsafe fn start_secondary_cpu(
-    _cpu_num: u32,
-    _apic_id: u32,
-    _entry_point: usize,
-    _stack_top: usize,
-    _cr3: PAddr,
+    cpu_num: u32,
+    apic_id: u32,
+    entry_point: usize,
+    stack_top: usize,
+    cr3: PAddr,
 ) -> bool {
-    // TODO: Implement IPI-based CPU startup
-    // 1. Write the bootstrap code to low memory (typically 0x7000)
-    // 2. Set up the bootstrap data with the provided parameters
-    // 3. Send INIT IPI to the target CPU
-    // 4. Wait 10ms
-    // 5. Send STARTUP IPI to the target CPU with the bootstrap address
-    // 6. Wait for the CPU to signal it's ready
-    // 7. Clean up the bootstrap area
-
-    // For now, return false as this is not yet implemented
+    // The trampoline loads CR3 from 32-bit code
+    if cr3 >> 32 != 0 {
+        return false;
+    }
+
+    let info = init_bootstrap_area(BOOTSTRAP_START, BOOTSTRAP_SIZE);
+    if info == 0 {
+        return false;
+    }
+
+    (info as *mut BootstrapInfo).write_volatile(BootstrapInfo {
+        cpu_num,
+        apic_id,
+        cr3,
+        // Entered by jmp: leave room for the return address slot
+        stack_top: stack_top - 8,
+        entry_point,
+    });
+    AP_STARTED.store(0, Ordering::Release);
+
+    // INIT, wait 10ms, then two STARTUP IPIs (Intel SDM 8.4.4.1)
+    let page = (BOOTSTRAP_START >> 12) as u8;
+    apic::apic_send_init(apic_id);
+    tsc::tsc_delay_ms(10);
+    apic::apic_send_startup(apic_id, page);
+    tsc::tsc_delay_us(200);
+    if AP_STARTED.load(Ordering::Acquire) == 0 {
+        apic::apic_send_startup(apic_id, page);
+    }
+
+    for _ in 0..AP_START_TIMEOUT_MS {
+        if AP_STARTED.load(Ordering::Acquire) == cpu_num + 1 {
+            return true;
+        }
+        tsc::tsc_delay_ms(1);
+    }
     false
 }
 
 /// Bootstrap area in low memory
 ///
 /// The bootstrap code is typically placed at 0x7000-0x8000 in physical memory.
+/// Must match AP_TRAMPOLINE_BASE in ap_trampoline.S.
 pub const BOOTSTRAP_START: PAddr = 0x7000;
 pub const BOOTSTRAP_SIZE: usize = 0x1000; // 4KB
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    #[test]
+    fn test_bootstrap_info_layout() {
+        // Offsets hard-coded in ap_trampoline.S
+        use core::mem::offset_of;
+        assert_eq!(offset_of!(BootstrapInfo, cr3), 8);
+        assert_eq!(offset_of!(BootstrapInfo, stack_top), 16);
+        assert_eq!(offset_of!(BootstrapInfo, entry_point), 24);
+        assert_eq!(core::mem::size_of::<BootstrapInfo>(), 32);
+    }
+}
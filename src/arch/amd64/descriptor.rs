@@ -8,6 +8,8 @@
 //!
 //! This module provides GDT and IDT setup functions.
 
+use super::percpu::MAX_CPUS;
+
 // ============================================================================
 // GDT (Global Descriptor Table) Structures
 // ============================================================================
@@ -59,9 +61,11 @@ pub const GDT_KERNEL_CODE: usize = 1;
 pub const GDT_KERNEL_DATA: usize = 2;
 pub const GDT_USER_CODE: usize = 3;
 pub const GDT_USER_DATA: usize = 4;
-pub const GDT_TSS_LOW: usize = 5;
-pub const GDT_TSS_HIGH: usize = 6;
-pub const GDT_ENTRIES: usize = 7;
+/// 64-bit user code used by SYSRET (STAR[63:48] + 16 must follow user data)
+pub const GDT_USER_CODE64: usize = 5;
+pub const GDT_TSS_LOW: usize = 6;
+pub const GDT_TSS_HIGH: usize = 7;
+pub const GDT_ENTRIES: usize = 8;
 
 // Access byte flags
 pub const ACC_PRESENT: u8 = 0x80;
@@ -76,10 +80,14 @@ pub const ACC_DPL3: u8 = 0x60;
 pub const FLAG_GRANULARITY_4K: u8 = 0x80;
 pub const FLAG_SIZE_64BIT: u8 = 0x20;
 
-// Global GDT storage
-static mut GDT: [GdtEntry; GDT_ENTRIES] = [GdtEntry::null(); GDT_ENTRIES];
-static mut GDT_POINTER: GdtPointer = GdtPointer { limit: 0, base: 0 };
-static mut TSS: TaskStateSegment = TaskStateSegment::null();
+// Per-CPU GDT storage
+//
+// Every CPU needs its own TSS (rsp0 is the running process's kernel
+// stack), and `ltr` marks the TSS descriptor busy, so each CPU also gets
+// its own copy of the GDT.
+static mut GDT: [[GdtEntry; GDT_ENTRIES]; MAX_CPUS] = [[GdtEntry::null(); GDT_ENTRIES]; MAX_CPUS];
+static mut GDT_POINTER: [GdtPointer; MAX_CPUS] = [GdtPointer { limit: 0, base: 0 }; MAX_CPUS];
+static mut TSS: [TaskStateSegment; MAX_CPUS] = [TaskStateSegment::null(); MAX_CPUS];
 
 impl GdtEntry {
     pub const fn null() -> Self {
@@ -149,14 +157,23 @@ impl TaskStateSegment {
     }
 }
 
-/// Setup the GDT (Global Descriptor Table)
+/// Setup the GDT (Global Descriptor Table) on the boot CPU
 pub fn gdt_setup() {
+    gdt_setup_cpu(0);
+}
+
+/// Setup and load the GDT and TSS of one CPU
+///
+/// Must run on the CPU it sets up.
+pub fn gdt_setup_cpu(cpu: usize) {
     unsafe {
+        let gdt = &mut GDT[cpu];
+
         // Null descriptor (required)
-        GDT[GDT_NULL] = GdtEntry::null();
+        gdt[GDT_NULL] = GdtEntry::null();
 
         // Kernel code segment (64-bit)
-        GDT[GDT_KERNEL_CODE] = GdtEntry::set_gate(
+        gdt[GDT_KERNEL_CODE] = GdtEntry::set_gate(
             0,                      // Base (ignored in long mode)
             0xFFFFF,                // Limit (ignored in long mode)
             ACC_PRESENT | ACC_CODE_DATA | ACC_CODE | ACC_DPL0, // Present, Code, DPL0
@@ -164,7 +181,7 @@ pub fn gdt_setup() {
         );
 
         // Kernel data segment
-        GDT[GDT_KERNEL_DATA] = GdtEntry::set_gate(
+        gdt[GDT_KERNEL_DATA] = GdtEntry::set_gate(
             0,                      // Base (ignored in long mode)
             0xFFFFF,                // Limit (ignored in long mode)
             ACC_PRESENT | ACC_CODE_DATA | ACC_DATA | ACC_DPL0, // Present, Data, DPL0
@@ -172,7 +189,7 @@ pub fn gdt_setup() {
         );
 
         // User code segment (64-bit)
-        GDT[GDT_USER_CODE] = GdtEntry::set_gate(
+        gdt[GDT_USER_CODE] = GdtEntry::set_gate(
             0,                      // Base (ignored in long mode)
             0xFFFFF,                // Limit (ignored in long mode)
             ACC_PRESENT | ACC_CODE_DATA | ACC_CODE | ACC_DPL3, // Present, Code, DPL3
@@ -180,27 +197,37 @@ pub fn gdt_setup() {
         );
 
         // User data segment
-        GDT[GDT_USER_DATA] = GdtEntry::set_gate(
+        gdt[GDT_USER_DATA] = GdtEntry::set_gate(
             0,                      // Base (ignored in long mode)
             0xFFFFF,                // Limit (ignored in long mode)
             ACC_PRESENT | ACC_CODE_DATA | ACC_DATA | ACC_DPL3, // Present, Data, DPL3
             FLAG_GRANULARITY_4K,                                      // 4KB pages
         );
 
+        // User code segment (64-bit) for SYSRET
+        // SYSRET derives CS as STAR[63:48] + 16, so this descriptor must sit
+        // directly after user data. It is identical to GDT_USER_CODE.
+        gdt[GDT_USER_CODE64] = GdtEntry::set_gate(
+            0,                      // Base (ignored in long mode)
+            0xFFFFF,                // Limit (ignored in long mode)
+            ACC_PRESENT | ACC_CODE_DATA | ACC_CODE | ACC_DPL3, // Present, Code, DPL3
+            FLAG_GRANULARITY_4K | FLAG_SIZE_64BIT,               // 4KB pages, 64-bit
+        );
+
         // TSS entry (needs two entries)
-        let tss_base = &TSS as *const TaskStateSegment as u64;
+        let tss_base = &TSS[cpu] as *const TaskStateSegment as u64;
         let tss_limit = core::mem::size_of::<TaskStateSegment>() as u32;
         let tss_access = ACC_PRESENT | 0x09; // Present, TSS, DPL0
 
-        GDT[GDT_TSS_LOW] = GdtEntry::set_tss_low(tss_base, tss_limit, tss_access);
-        GDT[GDT_TSS_HIGH] = GdtEntry::set_tss_high(tss_base);
+        gdt[GDT_TSS_LOW] = GdtEntry::set_tss_low(tss_base, tss_limit, tss_access);
+        gdt[GDT_TSS_HIGH] = GdtEntry::set_tss_high(tss_base);
 
         // Setup GDT pointer
-        GDT_POINTER.limit = ((core::mem::size_of::<GdtEntry>() * GDT_ENTRIES) - 1) as u16;
-        GDT_POINTER.base = &GDT as *const GdtEntry as u64;
+        GDT_POINTER[cpu].limit = ((core::mem::size_of::<GdtEntry>() * GDT_ENTRIES) - 1) as u16;
+        GDT_POINTER[cpu].base = gdt.as_ptr() as u64;
 
         // Load GDT
-        gdt_load(&GDT_POINTER);
+        gdt_load(&GDT_POINTER[cpu]);
 
         // Load TSS
         let tss_selector = (GDT_TSS_LOW * 8) as u16;
@@ -389,11 +416,11 @@ pub unsafe fn tss_load(selector: u16) {
     core::arch::asm!("ltr {0:x}", in(reg) selector, options(nostack));
 }
 
-/// Get TSS reference for modification
+/// Get this CPU's TSS for modification
 ///
 /// # Safety
 ///
 /// Caller must ensure TSS has been initialized
 pub unsafe fn get_tss() -> &'static mut TaskStateSegment {
-    &mut TSS
+    &mut TSS[super::percpu::this_cpu()]
 }
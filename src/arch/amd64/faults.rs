@@ -8,6 +8,13 @@
 //!
 //! This module handles all x86-64 exceptions including page faults,
 //! general protection faults, and debug exceptions.
+//!
+//! Not-present faults on user addresses populate demand-paged memory
+//! (see `AddressSpace::fault_in`), whether user code or a syscall
+//! touching user memory took them. A fault on a bad user address inside
+//! the user copy routine resumes at its recovery code (`usercopy`).
+
+use core::arch::naked_asm;
 
 use crate::arch::amd64::registers;
 use crate::arch::amd64::registers::X86_FLAGS_AC;
@@ -155,7 +162,19 @@ pub fn x86_pfe_handler(frame: &mut X86Iframe, error_code: u64) -> Result<(), ()>
         return Err(());
     }
 
-    // Convert PF error codes to page fault flags
+    // Call the high level page fault handler
+    if vmm_page_fault_handler(va, pf_flags_from_error(error_code)).is_ok() {
+        return Ok(());
+    }
+
+    // Unresolved faults are fatal on this path. Vector 14 is installed
+    // as x86_page_fault_entry, whose handle_page_fault terminates a
+    // faulting user process (exit_current) instead
+    Err(())
+}
+
+/// Convert a page fault error code to page fault flags
+fn pf_flags_from_error(error_code: u64) -> u32 {
     let mut flags = 0u32;
     if error_code & pf_error::W != 0 {
         flags |= pf_flags::WRITE;
@@ -169,23 +188,121 @@ pub fn x86_pfe_handler(frame: &mut X86Iframe, error_code: u64) -> Result<(), ()>
     if error_code & pf_error::P == 0 {
         flags |= pf_flags::NOT_PRESENT;
     }
+    flags
+}
 
-    // Call the high level page fault handler
-    // TODO: Implement vmm_page_fault_handler
-    // let pf_err = vmm_page_fault_handler(va, flags);
-    // if pf_err == ZX_OK {
-    //     return Ok(());
-    // }
+/// High level page fault handler
+///
+/// Handles faults on user addresses of the current address space:
+/// populates the page of a not-present fault from the demand-paged
+/// regions, and copies a copy-on-write page on a write to it (by user
+/// code, or by the kernel on its behalf).
+///
+/// # Returns
+///
+/// Ok(()) if the page is now mapped and the access can be retried
+pub fn vmm_page_fault_handler(va: usize, flags: u32) -> Result<(), ()> {
+    use crate::arch::amd64::init::x86_read_cr3;
+    use crate::process::address_space::AddressSpace;
 
-    // Let high level code deal with user space faults
-    if is_from_user(frame) {
-        // TODO: Dispatch user exception
-        // For now, return error to trigger signal to user process
+    if !is_user_address(va) {
         return Err(());
     }
 
-    // Fall through to fatal path
-    Err(())
+    let page_table = x86_read_cr3() & !0xFFF;
+    let space = AddressSpace::from_page_table(page_table);
+    let write = flags & pf_flags::WRITE != 0;
+    if flags & pf_flags::NOT_PRESENT != 0 {
+        space.fault_in(va as u64, write).map_err(|_| ())
+    } else if write {
+        space.break_cow(va as u64).map_err(|_| ())
+    } else {
+        Err(())
+    }
+}
+
+/// Page fault handler body, called by [`x86_page_fault_entry`]
+///
+/// A fault that is not demand paging terminates the process if user
+/// code took it. If the kernel did, it resumes at the recovery code of a
+/// user copy (by rewriting the saved `rip`), or halts the CPU.
+extern "C" fn handle_page_fault(error_code: u64, cs: u64, rip: &mut u64) {
+    let va = unsafe { registers::x86_get_cr2() } as usize;
+    if vmm_page_fault_handler(va, pf_flags_from_error(error_code)).is_ok() {
+        return;
+    }
+
+    let from_user = cs & 3 == 3;
+    if !from_user && is_user_address(va) {
+        if let Some(resume) = crate::arch::amd64::usercopy::fixup(*rip) {
+            *rip = resume;
+            return;
+        }
+    }
+    let msg: &[u8] = if from_user {
+        b"[PF] Unhandled user page fault, terminating process\n"
+    } else {
+        b"[PF] Unhandled kernel page fault, halting\n"
+    };
+    for &b in msg {
+        unsafe {
+            core::arch::asm!("out dx, al", in("dx") 0xE9u16, in("al") b, options(nomem, nostack));
+        }
+    }
+
+    if from_user {
+        crate::sched::round_robin::exit_current();
+    }
+    loop {
+        unsafe { registers::x86_hlt() };
+    }
+}
+
+/// #PF entry stub (IDT vector 14)
+///
+/// Saves the caller-saved general-purpose registers around the Rust
+/// handler, passing it the error code, the faulting CS and the saved RIP
+/// (which it may redirect), and drops the error code before returning
+/// to retry the access.
+///
+/// # Safety
+///
+/// Must only be installed as the vector 14 interrupt gate.
+#[unsafe(naked)]
+#[no_mangle]
+pub unsafe extern "C" fn x86_page_fault_entry() {
+    naked_asm!(
+        // Error code + interrupt frame (6 qwords) + 9 pushes + 8 bytes
+        // of padding leaves RSP 16-byte aligned
+        "push rax",
+        "push rcx",
+        "push rdx",
+        "push rsi",
+        "push rdi",
+        "push r8",
+        "push r9",
+        "push r10",
+        "push r11",
+        "sub rsp, 8",
+        "mov rdi, [rsp + 80]", // error code
+        "mov rsi, [rsp + 96]", // CS
+        "lea rdx, [rsp + 88]", // RIP
+        "cld",
+        "call {handler}",
+        "add rsp, 8",
+        "pop r11",
+        "pop r10",
+        "pop r9",
+        "pop r8",
+        "pop rdi",
+        "pop rsi",
+        "pop rdx",
+        "pop rcx",
+        "pop rax",
+        "add rsp, 8",
+        "iretq",
+        handler = sym handle_page_fault,
+    );
 }
 
 /// Debug exception handler
@@ -284,7 +401,8 @@ pub unsafe extern "C" fn x86_exception_handler(frame: *mut X86Iframe, vector: u6
             x86_invop_handler(frame);
         }
         exception_vector::DEVICE_NA => {
-            exception_die(frame, "device na fault\n");
+            // Lazy FPU restore (normally reached via fpu::x86_device_na_entry)
+            super::fpu::handle_device_not_available();
         }
         exception_vector::DOUBLE_FAULT => {
             x86_df_handler(frame);
@@ -0,0 +1,282 @@
+// Copyright 2025 The Rustux Authors
+//
+// Use of this source code is governed by a MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT
+
+//! Lazy FPU/SSE Context Switching
+//!
+//! x87/SSE state is not moved on every context switch. Instead:
+//!
+//! - The switch path records the next task's save area and sets CR0.TS
+//!   unless that task's state is already live in the registers.
+//! - The first FPU/SSE instruction the task executes raises #NM. The
+//!   handler clears TS, saves the previous owner's registers with
+//!   FXSAVE and loads the task's own state with FXRSTOR.
+//!
+//! A task that never touches the FPU between switches therefore costs
+//! one CR0 write per switch instead of a 512-byte save and restore.
+//!
+//! # Ownership
+//!
+//! `FPU_OWNER` is the save area whose contents are currently in the
+//! registers (the memory copy is stale). `FPU_CURRENT` is the save area
+//! of the running task. Whenever TS is clear the two are the same.
+//!
+//! Both are per CPU. A task whose state is live on one CPU must not run
+//! on another until that CPU has saved it: the scheduler calls [`flush`]
+//! before requeueing a task on another CPU and does not steal tasks for
+//! which [`live_cpu`] names the victim.
+
+use core::cell::UnsafeCell;
+use core::arch::naked_asm;
+use core::sync::atomic::{AtomicPtr, AtomicU64, Ordering};
+
+use crate::arch::amd64::percpu::{self, MAX_CPUS};
+use crate::arch::amd64::registers::{self, cr};
+
+/// Size of the FXSAVE/FXRSTOR area in bytes
+pub const FXSAVE_AREA_SIZE: usize = 512;
+
+/// x87 control word after FNINIT (all exceptions masked)
+const FCW_DEFAULT: u16 = 0x037F;
+
+/// MXCSR after reset (all SSE exceptions masked)
+const MXCSR_DEFAULT: u32 = 0x1F80;
+
+/// Per-task FPU/SSE save area (FXSAVE format)
+///
+/// Written by the #NM handler while only shared references to the owning
+/// process exist, hence the UnsafeCell.
+#[repr(C, align(16))]
+pub struct FpuState {
+    area: UnsafeCell<[u8; FXSAVE_AREA_SIZE]>,
+}
+
+impl FpuState {
+    /// Create a save area holding the power-on FPU/SSE state
+    pub const fn new() -> Self {
+        let mut area = [0u8; FXSAVE_AREA_SIZE];
+        let fcw = FCW_DEFAULT.to_le_bytes();
+        area[0] = fcw[0];
+        area[1] = fcw[1];
+        let mxcsr = MXCSR_DEFAULT.to_le_bytes();
+        area[24] = mxcsr[0];
+        area[25] = mxcsr[1];
+        area[26] = mxcsr[2];
+        area[27] = mxcsr[3];
+        Self { area: UnsafeCell::new(area) }
+    }
+
+    /// Raw pointer used for ownership tracking
+    pub fn as_ptr(&self) -> *mut FpuState {
+        self as *const FpuState as *mut FpuState
+    }
+}
+
+impl Default for FpuState {
+    fn default() -> Self {
+        Self::new()
+    }
+}
+
+/// Save area whose contents are live in each CPU's FPU registers
+static FPU_OWNER: [AtomicPtr<FpuState>; MAX_CPUS] = {
+    const NULL: AtomicPtr<FpuState> = AtomicPtr::new(core::ptr::null_mut());
+    [NULL; MAX_CPUS]
+};
+
+/// Save area of the task running on each CPU
+static FPU_CURRENT: [AtomicPtr<FpuState>; MAX_CPUS] = {
+    const NULL: AtomicPtr<FpuState> = AtomicPtr::new(core::ptr::null_mut());
+    [NULL; MAX_CPUS]
+};
+
+/// Number of #NM traps that had to move state (FXSAVE/FXRSTOR pairs)
+static FPU_RESTORES: AtomicU64 = AtomicU64::new(0);
+
+/// Prepare the FPU for a switch from `prev` to `next`
+///
+/// Called by the scheduler immediately before the register switch.
+///
+/// # Safety
+///
+/// Both pointers must be the save areas of live processes (or null for
+/// the idle context, or a `prev` that was just flushed), and interrupts
+/// must be disabled until the register switch completes.
+pub unsafe fn switch_fpu(prev: *mut FpuState, next: *mut FpuState) {
+    let cpu = percpu::this_cpu();
+    let cr0 = registers::x86_get_cr0();
+
+    // With TS clear the registers belong to whoever was running, even if
+    // that task has never been through a switch before
+    if cr0 & cr::CR0_TS == 0 {
+        FPU_OWNER[cpu].store(prev, Ordering::Relaxed);
+    }
+    FPU_CURRENT[cpu].store(next, Ordering::Relaxed);
+
+    if !next.is_null() && FPU_OWNER[cpu].load(Ordering::Relaxed) == next {
+        // Switching back to the owner: its state never left the registers
+        if cr0 & cr::CR0_TS != 0 {
+            core::arch::asm!("clts", options(nomem, nostack));
+        }
+    } else if cr0 & cr::CR0_TS == 0 {
+        registers::x86_set_cr0(cr0 | cr::CR0_TS);
+    }
+}
+
+/// Save a task's state from this CPU's registers to memory
+///
+/// Afterwards the task may be resumed on any CPU. Leaves TS set and this
+/// CPU with no owner, so pass null as `prev` to the following
+/// [`switch_fpu`].
+///
+/// # Safety
+///
+/// `state` must be a live save area; interrupts must be disabled.
+pub unsafe fn flush(state: *mut FpuState) {
+    let cpu = percpu::this_cpu();
+    let cr0 = registers::x86_get_cr0();
+
+    let owner = FPU_OWNER[cpu].load(Ordering::Relaxed);
+    let current = FPU_CURRENT[cpu].load(Ordering::Relaxed);
+    let live = owner == state || (cr0 & cr::CR0_TS == 0 && current == state);
+
+    if live {
+        if cr0 & cr::CR0_TS != 0 {
+            core::arch::asm!("clts", options(nomem, nostack));
+        }
+        core::arch::asm!("fxsave64 [{}]", in(reg) (*state).area.get(), options(nostack));
+        FPU_OWNER[cpu].store(core::ptr::null_mut(), Ordering::Relaxed);
+    }
+    if current == state {
+        FPU_CURRENT[cpu].store(core::ptr::null_mut(), Ordering::Relaxed);
+    }
+    registers::x86_set_cr0(registers::x86_get_cr0() | cr::CR0_TS);
+}
+
+/// CPU whose registers may hold a save area's live contents
+pub fn live_cpu(state: *mut FpuState) -> Option<usize> {
+    (0..MAX_CPUS).find(|&cpu| {
+        FPU_OWNER[cpu].load(Ordering::Relaxed) == state
+            || FPU_CURRENT[cpu].load(Ordering::Relaxed) == state
+    })
+}
+
+/// Forget a save area that is about to be freed
+///
+/// Its register contents are discarded rather than saved.
+pub fn release(state: *mut FpuState) {
+    for cpu in 0..MAX_CPUS {
+        let _ = FPU_OWNER[cpu].compare_exchange(state, core::ptr::null_mut(), Ordering::Relaxed, Ordering::Relaxed);
+        let _ = FPU_CURRENT[cpu].compare_exchange(state, core::ptr::null_mut(), Ordering::Relaxed, Ordering::Relaxed);
+    }
+}
+
+/// Number of lazy FPU restores performed since boot
+pub fn restore_count() -> u64 {
+    FPU_RESTORES.load(Ordering::Relaxed)
+}
+
+/// Handle #NM (device not available)
+///
+/// Must not use SSE itself until the owner's registers have been saved:
+/// keep this integer-only.
+pub extern "C" fn handle_device_not_available() {
+    unsafe {
+        core::arch::asm!("clts", options(nomem, nostack));
+    }
+
+    let cpu = percpu::this_cpu();
+    let current = FPU_CURRENT[cpu].load(Ordering::Relaxed);
+    let owner = FPU_OWNER[cpu].load(Ordering::Relaxed);
+
+    // State already live: nothing to move
+    if current == owner {
+        return;
+    }
+
+    unsafe {
+        if !owner.is_null() {
+            core::arch::asm!("fxsave64 [{}]", in(reg) (*owner).area.get(), options(nostack));
+        }
+        // No task context (early boot, idle loop): the registers are
+        // scratch once the owner is saved
+        if current.is_null() {
+            FPU_OWNER[cpu].store(core::ptr::null_mut(), Ordering::Relaxed);
+            return;
+        }
+        core::arch::asm!("fxrstor64 [{}]", in(reg) (*current).area.get(), options(nostack));
+    }
+
+    FPU_OWNER[cpu].store(current, Ordering::Relaxed);
+    FPU_RESTORES.fetch_add(1, Ordering::Relaxed);
+}
+
+/// #NM entry stub (IDT vector 7)
+///
+/// Saves the caller-saved general-purpose registers around the Rust
+/// handler. An `extern "x86-interrupt"` handler cannot be used here: its
+/// prologue may spill XMM registers, which would fault again with TS set.
+///
+/// # Safety
+///
+/// Must only be installed as the vector 7 interrupt gate.
+#[unsafe(naked)]
+#[no_mangle]
+pub unsafe extern "C" fn x86_device_na_entry() {
+    naked_asm!(
+        // Interrupt frame (5 qwords) + 9 pushes leaves RSP 16-byte aligned
+        "push rax",
+        "push rcx",
+        "push rdx",
+        "push rsi",
+        "push rdi",
+        "push r8",
+        "push r9",
+        "push r10",
+        "push r11",
+        "cld",
+        "call {handler}",
+        "pop r11",
+        "pop r10",
+        "pop r9",
+        "pop r8",
+        "pop rdi",
+        "pop rsi",
+        "pop rdx",
+        "pop rcx",
+        "pop rax",
+        "iretq",
+        handler = sym handle_device_not_available,
+    );
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    #[test]
+    fn test_fpu_state_layout() {
+        assert_eq!(core::mem::size_of::<FpuState>(), FXSAVE_AREA_SIZE);
+        assert_eq!(core::mem::align_of::<FpuState>(), 16);
+    }
+
+    #[test]
+    fn test_fpu_state_defaults() {
+        let state = FpuState::new();
+        let area = unsafe { &*state.area.get() };
+        assert_eq!(u16::from_le_bytes([area[0], area[1]]), FCW_DEFAULT);
+        assert_eq!(u32::from_le_bytes([area[24], area[25], area[26], area[27]]), MXCSR_DEFAULT);
+    }
+
+    #[test]
+    fn test_release_clears_ownership() {
+        let state = FpuState::new();
+        FPU_OWNER[1].store(state.as_ptr(), Ordering::Relaxed);
+        assert_eq!(live_cpu(state.as_ptr()), Some(1));
+        release(state.as_ptr());
+        assert!(FPU_OWNER[1].load(Ordering::Relaxed).is_null());
+        assert_eq!(live_cpu(state.as_ptr()), None);
+    }
+}
@@ -226,31 +226,17 @@ static mut KERNEL_STACK: Option<(u64, usize)> = None; // (physical_address, size
 pub unsafe fn init_kernel_stack(continuation: usize) -> ! {
     use crate::mm::pmm;
 
-    // Allocate 64 pages (256 KB) from kernel zone for the stack
+    // Allocate 64 contiguous pages (256 KB) from kernel zone for the stack
     // The UEFI-provided stack is typically only 4-8 KB
-    const STACK_PAGES: usize = 64; // 256 KB
-
-    // Allocate pages one at a time (since pmm_alloc_kernel_page only allocates 1 page)
-    let mut stack_pages: [u64; 64] = [0; 64];
-    let mut allocated_count = 0;
-
-    for i in 0..STACK_PAGES {
-        match pmm::pmm_alloc_kernel_page() {
-            Ok(paddr) => {
-                stack_pages[i] = paddr;
-                allocated_count += 1;
-            }
-            Err(_) => break,
-        }
-    }
+    const STACK_ORDER: u8 = 6; // 64 pages = 256 KB
 
-    if allocated_count == 0 {
-        panic!("Failed to allocate any pages for kernel stack!");
-    }
+    let stack_paddr = match pmm::pmm_alloc_pages(STACK_ORDER, pmm::PMM_ALLOC_FLAG_KERNEL) {
+        Ok(paddr) => paddr,
+        Err(_) => panic!("Failed to allocate pages for kernel stack!"),
+    };
 
-    let stack_paddr = stack_pages[0];
     let stack_vaddr = pmm::paddr_to_vaddr(stack_paddr) as usize;
-    let stack_size = allocated_count * 4096;
+    let stack_size = 4096 << STACK_ORDER;
 
     // Store the stack info for debugging
     KERNEL_STACK = Some((stack_paddr, stack_size));
@@ -151,6 +151,12 @@ pub enum RxStatus {
     ERR_INTERNAL = 8,
     /// Not supported
     ERR_NOT_SUPPORTED = 9,
+    /// Operation would block; retry later
+    ERR_SHOULD_WAIT = 10,
+    /// The other end of an IPC object is closed
+    ERR_PEER_CLOSED = 11,
+    /// The object is not in a state that allows the operation
+    ERR_BAD_STATE = 12,
 }
 
 /// Result type using RxStatus
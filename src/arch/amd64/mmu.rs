@@ -14,6 +14,11 @@ pub type PAddr = u64;
 /// Virtual address type
 pub type VAddr = usize;
 
+use core::sync::atomic::{AtomicU64, AtomicUsize, Ordering};
+
+use crate::arch::amd64::mm::page_tables::RxResult;
+use crate::mm::pmm;
+
 // Page size constants
 pub const PAGE_SIZE: usize = 4096;
 pub const PAGE_MASK: usize = PAGE_SIZE - 1;
@@ -24,11 +29,36 @@ pub const IA32_MTRR_CAP_MSR: u32 = 0xFE;
 pub const IA32_MTRR_DEF_TYPE_MSR: u32 = 0x2FF;
 
 // PAT register default values (write-back caching)
+//
+// PA0 WB, PA1 WC, PA2 UC-, PA3 UC (repeated for PA4-PA7): unlike the
+// power-on value, a PTE with only PWT set selects write-combining.
 pub const PAT_DEFAULT_VALUE: u64 = 0x0007010600070106;
 
+/// PTE bits selecting PAT entry 1 (write-combining) under PAT_DEFAULT_VALUE
+pub const PTE_CACHE_WC: u64 = 0x008; // PWT
+
 // Global page table state (simplified - in real kernel would be per-address space)
 static mut BOOT_PML4: Option<PAddr> = None;
 
+/// End of the physical range covered by the direct map (0 = not set up)
+static DIRECT_MAP_END: AtomicU64 = AtomicU64::new(0);
+
+/// The direct map's PDP table (0 = not set up)
+///
+/// Every address space shares it through its kernel PML4 entry, so
+/// entries added to it later are visible everywhere.
+static DIRECT_MAP_PDP: AtomicU64 = AtomicU64::new(0);
+
+/// First PDP slot used for device windows (1 GB each, above any RAM the
+/// direct map covers)
+const DEVICE_WINDOW_FIRST: usize = (MAX_PHYS_MEMORY >> 30) as usize;
+
+/// Number of device windows
+const DEVICE_WINDOW_COUNT: usize = 16;
+
+/// Device windows handed out so far
+static DEVICE_WINDOWS_USED: AtomicUsize = AtomicUsize::new(0);
+
 /// Kernel physical offset for direct-mapped physical memory
 ///
 /// Physical memory is mapped at this offset in kernel virtual address space.
@@ -37,7 +67,7 @@ static mut BOOT_PML4: Option<PAddr> = None;
 const KERNEL_PHYS_OFFSET: u64 = 0xffff_8000_0000_0000;
 
 /// Maximum physical memory to map (16GB for now)
-const MAX_PHYS_MEMORY: u64 = 0x4_0000_0000;
+pub const MAX_PHYS_MEMORY: u64 = 0x4_0000_0000;
 
 /// Early MMU initialization
 ///
@@ -56,7 +86,7 @@ pub fn x86_mmu_early_init() {
         // Set up direct mapping of physical memory
         // This maps [KERNEL_PHYS_OFFSET .. KERNEL_PHYS_OFFSET + MAX_PHYS_MEMORY]
         // to physical memory [0 .. MAX_PHYS_MEMORY]
-        x86_setup_direct_map();
+        let _ = x86_setup_direct_map(MAX_PHYS_MEMORY);
 
         // Enable write-protect (CR0.WP) to protect kernel code from modification
         x86_enable_write_protect();
@@ -68,40 +98,174 @@ pub fn x86_mmu_early_init() {
 
 /// Set up direct mapping of physical memory
 ///
-/// Maps physical memory at KERNEL_PHYS_OFFSET so the kernel can access
-/// any physical page by adding this offset.
-unsafe fn x86_setup_direct_map() {
+/// Builds the kernel page table, a copy of the firmware's PML4 (whose
+/// identity map the kernel runs from) plus physical memory [0, top)
+/// mapped at KERNEL_PHYS_OFFSET, and switches to it. Address spaces
+/// created afterwards copy its entries, the direct map included.
+///
+/// The direct map uses the largest pages the CPU has (1 GB, else 2 MB)
+/// and marks them global, so it costs a handful of TLB entries that no
+/// CR3 load flushes. `top` is rounded up to the page size; the MTRRs keep
+/// any MMIO hole inside it uncached whatever the page's memory type.
+///
+/// # Returns
+///
+/// Err if the page tables could not be allocated, in which case nothing
+/// changed and only the identity map is available.
+///
+/// # Safety
+///
+/// Must be called once on the boot CPU, after the PMM is set up and
+/// before any address space is created.
+pub unsafe fn x86_setup_direct_map(top: u64) -> RxResult<()> {
     // Page table entry flags
     const PTE_P: u64 = 0x001;  // Present
     const PTE_W: u64 = 0x002;  // Read/Write
+    const PTE_PS: u64 = 0x080; // Large page (1 GB in a PDP, 2 MB in a PD)
     const PTE_G: u64 = 0x100;  // Global
 
-    // Get the current PML4
-    let cr3 = read_cr3();
-    let pml4_virt = cr3 as *mut u64;
+    const SIZE_1G: u64 = 1 << 30;
+    const SIZE_2M: u64 = 1 << 21;
+
+    let top = top.min(MAX_PHYS_MEMORY);
+    let huge = x86_has_1gb_pages();
+    let top = if huge {
+        (top + SIZE_1G - 1) & !(SIZE_1G - 1)
+    } else {
+        (top + SIZE_2M - 1) & !(SIZE_2M - 1)
+    };
+
+    // Fresh page tables come from the identity-mapped kernel zone
+    let new_table = || -> RxResult<*mut u64> {
+        let paddr = pmm::pmm_alloc_kernel_page()?;
+        let table = pmm::paddr_to_vaddr(paddr) as *mut u64;
+        core::ptr::write_bytes(table, 0, 512);
+        Ok(table)
+    };
+
+    // PML4[256] -> PDP -> 1 GB pages, or -> PDs -> 2 MB pages
+    let pdp = new_table()?;
+    let mut paddr = 0u64;
+    while paddr < top {
+        let pdp_index = (paddr / SIZE_1G) as usize;
+        if huge {
+            *pdp.add(pdp_index) = paddr | PTE_P | PTE_W | PTE_PS | PTE_G;
+            paddr += SIZE_1G;
+            continue;
+        }
+
+        let pd = new_table()?;
+        for pd_index in 0..512 {
+            if paddr >= top {
+                break;
+            }
+            *pd.add(pd_index) = paddr | PTE_P | PTE_W | PTE_PS | PTE_G;
+            paddr += SIZE_2M;
+        }
+        *pdp.add(pdp_index) = pmm::vaddr_to_paddr(pd as VAddr).unwrap_or(0) | PTE_P | PTE_W;
+    }
+
+    // Copy the firmware PML4 rather than editing it: its pages may be
+    // read-only to us
+    let pml4 = new_table()?;
+    let boot_pml4 = pmm::paddr_to_vaddr(read_cr3() & !0xFFF) as *const u64;
+    core::ptr::copy_nonoverlapping(boot_pml4, pml4, 512);
 
-    // Calculate PML4 index for KERNEL_PHYS_OFFSET
-    // KERNEL_PHYS_OFFSET = 0xffff_8000_0000_0000
-    // Bits 47:39 = 0b100000000 = 256 (0x100)
     let pml4_index = ((KERNEL_PHYS_OFFSET >> 39) & 0x1FF) as usize;
+    *pml4.add(pml4_index) = pmm::vaddr_to_paddr(pdp as VAddr).unwrap_or(0) | PTE_P | PTE_W;
+
+    let pml4_paddr = pmm::vaddr_to_paddr(pml4 as VAddr).unwrap_or(0);
+    // Not write_cr3(): the table stores above must not sink past the load
+    core::arch::asm!("mov cr3, {}", in(reg) pml4_paddr, options(nostack));
+    BOOT_PML4 = Some(pml4_paddr);
+    DIRECT_MAP_PDP.store(pdp as u64, Ordering::Release);
+    DIRECT_MAP_END.store(top, Ordering::Release);
+    Ok(())
+}
+
+/// Map device memory write-combining
+///
+/// Maps physical [paddr, paddr + len) with 2 MB global pages in a device
+/// window, a 1 GB slot of the direct map's PDP past the end of RAM, with
+/// PAT type WC. PAT WC takes precedence over the UC the MTRRs give MMIO
+/// ranges, so writes through the mapping are buffered and burst to the
+/// device instead of going out one by one. Meant for framebuffers: reads
+/// through the mapping are still uncached.
+///
+/// # Returns
+///
+/// The virtual address of `paddr`. Fails with ERR_BAD_STATE before the
+/// direct map is set up, ERR_INVALID_ARGS if the range does not fit in a
+/// window, and ERR_NO_MEMORY if the windows or the page tables run out.
+///
+/// # Safety
+///
+/// The range must be device memory that stays in place; the mapping is
+/// never removed.
+pub unsafe fn x86_map_write_combining(paddr: PAddr, len: usize) -> RxResult<VAddr> {
+    use crate::arch::amd64::mm::RxStatus;
 
-    // Check if PML4 entry is already present
-    let pml4_entry = *pml4_virt.add(pml4_index);
+    const PTE_P: u64 = 0x001;  // Present
+    const PTE_W: u64 = 0x002;  // Read/Write
+    const PTE_PS: u64 = 0x080; // Large page
+    const PTE_G: u64 = 0x100;  // Global
 
-    // We need to create or verify the PML4 entry for the direct map
-    // For simplicity, we'll allocate page tables using a fixed address
-    // In a real kernel, this would use the PMM
+    const SIZE_1G: u64 = 1 << 30;
+    const SIZE_2M: u64 = 1 << 21;
 
-    // Map the first 1GB of physical memory using 2MB pages
-    // This should be sufficient for the current 128MB RAM setup
-    // PML4[256] -> PDP -> PD with 2MB pages
+    let pdp = DIRECT_MAP_PDP.load(Ordering::Acquire) as *mut u64;
+    if pdp.is_null() {
+        return Err(RxStatus::ERR_BAD_STATE);
+    }
 
-    // For now, use a simpler approach: identity mapping for low memory
-    // The UEFI bootloader should have already set this up
-    // We'll verify it exists
+    let start = paddr & !(SIZE_2M - 1);
+    let end = paddr.checked_add(len as u64).ok_or(RxStatus::ERR_INVALID_ARGS)?;
+    let end = (end + SIZE_2M - 1) & !(SIZE_2M - 1);
+    if len == 0 || end - start > SIZE_1G {
+        return Err(RxStatus::ERR_INVALID_ARGS);
+    }
 
-    // TODO: Implement full direct mapping setup with proper page table allocation
-    // For now, rely on UEFI bootloader's identity mapping of low memory
+    let window = DEVICE_WINDOWS_USED.fetch_add(1, Ordering::AcqRel);
+    if window >= DEVICE_WINDOW_COUNT {
+        return Err(RxStatus::ERR_NO_MEMORY);
+    }
+
+    let pd_paddr = pmm::pmm_alloc_kernel_page()?;
+    let pd = pmm::paddr_to_vaddr(pd_paddr) as *mut u64;
+    core::ptr::write_bytes(pd, 0, 512);
+    let mut page = start;
+    for pd_index in 0..((end - start) / SIZE_2M) as usize {
+        *pd.add(pd_index) = page | PTE_P | PTE_W | PTE_PS | PTE_G | PTE_CACHE_WC;
+        page += SIZE_2M;
+    }
+
+    // A slot that was never present cannot be in any TLB: no flush
+    let slot = DEVICE_WINDOW_FIRST + window;
+    core::ptr::write_volatile(pdp.add(slot), pd_paddr | PTE_P | PTE_W);
+
+    let window_base = KERNEL_PHYS_OFFSET + slot as u64 * SIZE_1G;
+    Ok((window_base + (paddr - start)) as VAddr)
+}
+
+/// Direct map address of a physical address, if the direct map covers it
+pub fn x86_phys_to_direct(paddr: PAddr) -> Option<VAddr> {
+    (paddr < DIRECT_MAP_END.load(Ordering::Acquire)).then(|| (KERNEL_PHYS_OFFSET + paddr) as VAddr)
+}
+
+/// Alias of identity-mapped kernel data (such as the embedded ramdisk)
+/// in the direct map
+///
+/// Accesses through the alias use the direct map's large global pages
+/// instead of the firmware's 4 KB mappings of the kernel image. Returns
+/// `data` itself if the direct map does not cover it.
+pub fn x86_direct_map_alias(data: &'static [u8]) -> &'static [u8] {
+    let start = data.as_ptr() as u64;
+    let end = start + data.len() as u64;
+    if start >= KERNEL_PHYS_OFFSET || end > DIRECT_MAP_END.load(Ordering::Acquire) {
+        return data;
+    }
+    // The identity map has vaddr == paddr
+    unsafe { core::slice::from_raw_parts((KERNEL_PHYS_OFFSET + start) as *const u8, data.len()) }
 }
 
 /// Main MMU initialization
@@ -116,14 +280,14 @@ pub fn x86_mmu_init() {
         // Synchronize PAT settings across all CPUs
         x86_pat_sync(0xFFFF_FFFF_FFFF_FFFF); // All CPUs
 
-        // Initialize large page support detection
-        x86_detect_huge_page_support();
     }
 }
 
 /// Per-CPU MMU initialization
 ///
-/// Initializes MMU settings specific to this CPU.
+/// Initializes MMU settings specific to this CPU. Every CPU must run it:
+/// the PAT has to be the same on all of them for a mapping's memory type
+/// (such as [`x86_map_write_combining`]'s) to mean the same everywhere.
 pub fn x86_mmu_percpu_init() {
     unsafe {
         // Initialize PAT (Page Attribute Table) for proper memory caching
@@ -358,8 +522,9 @@ pub unsafe fn x86_get_gs() -> u16 {
 
 /// Enable write-protect in CR0
 ///
-/// This protects kernel code from being modified.
-unsafe fn x86_enable_write_protect() {
+/// This protects kernel code from being modified, and makes kernel
+/// writes to read-only user pages fault, as copy-on-write needs.
+pub unsafe fn x86_enable_write_protect() {
     let mut cr0: u64;
     core::arch::asm!("mov {}, cr0", out(reg) cr0);
     cr0 |= 0x10000; // Set WP bit (bit 16)
@@ -379,10 +544,14 @@ unsafe fn x86_validate_page_tables() {
     }
 }
 
-/// Detect huge page support
-unsafe fn x86_detect_huge_page_support() {
-    // TODO: Use CPUID to detect support for 1GB pages
-    // For now, assume 2MB pages are supported (standard on x86-64)
+/// Whether the CPU supports 1 GB pages (CPUID.80000001H:EDX.Page1GB)
+///
+/// 2 MB pages are always available in long mode.
+pub fn x86_has_1gb_pages() -> bool {
+    unsafe {
+        core::arch::x86_64::__cpuid(0x8000_0000).eax >= 0x8000_0001
+            && core::arch::x86_64::__cpuid(0x8000_0001).edx & (1 << 26) != 0
+    }
 }
 
 /// Invalidate a TLB entry
@@ -20,6 +20,7 @@ pub mod descriptor;
 // Memory management
 pub mod mm;
 pub mod mmu;
+pub mod tlb;
 
 // Userspace transition
 pub mod uspace;
@@ -49,6 +50,16 @@ pub mod mexec;
 // Exception and fault handlers
 pub mod faults;
 
+// Fault-tolerant copies to and from user memory
+pub mod usercopy;
+
+// Lazy FPU/SSE context switching
+pub mod fpu;
+
+// Per-CPU data and SMP bring-up
+pub mod percpu;
+pub mod smp;
+
 // Bootstrap support for SMP
 pub mod bootstrap16;
 
@@ -0,0 +1,134 @@
+// Copyright 2025 The Rustux Authors
+//
+// Use of this source code is governed by a MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT
+
+//! Per-CPU Identification and Data
+//!
+//! Each CPU is numbered 0..cpu_count() in bring-up order; the BSP is
+//! CPU 0. [`this_cpu`] maps the Local APIC ID register to that number
+//! through a 256-entry table, so any context (interrupt, syscall,
+//! scheduler) can find it without depending on the GS base being the
+//! kernel's. (RDTSCP/TSC_AUX would be cheaper, but the default QEMU CPU
+//! model does not implement it.)
+//!
+//! The SYSCALL entry stub still needs a scratch slot and a stack before it
+//! can run any code, so each CPU's [`SyscallStack`] is reached through
+//! IA32_KERNEL_GS_BASE with a `swapgs` pair around the stack switch.
+
+use core::sync::atomic::{AtomicU8, AtomicU32, AtomicU64, Ordering};
+
+use crate::arch::amd64::registers;
+
+/// Maximum number of CPUs supported
+pub const MAX_CPUS: usize = 16;
+
+/// IA32_KERNEL_GS_BASE (swapped in by SWAPGS)
+const IA32_KERNEL_GS_BASE: u32 = 0xC000_0102;
+
+/// Per-CPU slots used by the SYSCALL entry stub
+///
+/// Field offsets are hard-coded in `syscall::x86_64_syscall_entry`.
+#[repr(C)]
+pub struct SyscallStack {
+    /// Kernel stack top for entries from user mode (offset 0)
+    pub kernel_rsp: u64,
+    /// Scratch slot for the user RSP during entry (offset 8)
+    pub user_rsp: u64,
+}
+
+/// SYSCALL entry slots, one per CPU
+static mut SYSCALL_STACKS: [SyscallStack; MAX_CPUS] = {
+    const EMPTY: SyscallStack = SyscallStack { kernel_rsp: 0, user_rsp: 0 };
+    [EMPTY; MAX_CPUS]
+};
+
+/// Bit N set once CPU N is running kernel code and can take work
+static CPU_ONLINE: AtomicU64 = AtomicU64::new(1);
+
+/// Local APIC ID of each CPU (for IPIs)
+static APIC_IDS: [AtomicU32; MAX_CPUS] = {
+    const ZERO: AtomicU32 = AtomicU32::new(0);
+    [ZERO; MAX_CPUS]
+};
+
+/// CPU number of each Local APIC ID (unregistered IDs read as CPU 0)
+static CPU_OF_APIC: [AtomicU8; 256] = {
+    const ZERO: AtomicU8 = AtomicU8::new(0);
+    [ZERO; 256]
+};
+
+/// Number of the CPU executing this code
+#[inline]
+pub fn this_cpu() -> usize {
+    #[cfg(not(test))]
+    {
+        let apic_id = crate::arch::amd64::apic::apic_local_id() as usize & 0xFF;
+        CPU_OF_APIC[apic_id].load(Ordering::Relaxed) as usize
+    }
+    #[cfg(test)]
+    {
+        0
+    }
+}
+
+/// Register the calling CPU under its number
+///
+/// # Safety
+///
+/// Must be called once on each CPU, with its own number, before that CPU
+/// takes a syscall. Until then [`this_cpu`] reports 0.
+pub unsafe fn init_cpu(cpu: usize, apic_id: u32) {
+    APIC_IDS[cpu].store(apic_id, Ordering::Relaxed);
+    CPU_OF_APIC[apic_id as usize & 0xFF].store(cpu as u8, Ordering::Relaxed);
+    registers::write_msr(IA32_KERNEL_GS_BASE, (&raw mut SYSCALL_STACKS[cpu]) as u64);
+}
+
+/// Set the SYSCALL entry stack of the calling CPU
+///
+/// # Safety
+///
+/// Interrupts must be disabled (the slot is read by the entry stub).
+pub unsafe fn set_syscall_stack(stack_top: u64) {
+    SYSCALL_STACKS[this_cpu()].kernel_rsp = stack_top;
+}
+
+/// Mark a CPU as online (ready to run processes)
+pub fn set_online(cpu: usize) {
+    CPU_ONLINE.fetch_or(1 << cpu, Ordering::Release);
+}
+
+/// Mask of online CPUs
+pub fn online_mask() -> u64 {
+    CPU_ONLINE.load(Ordering::Acquire)
+}
+
+/// Number of online CPUs
+pub fn cpu_count() -> usize {
+    online_mask().count_ones() as usize
+}
+
+/// Local APIC ID of a CPU
+pub fn apic_id(cpu: usize) -> u32 {
+    APIC_IDS[cpu].load(Ordering::Relaxed)
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    #[test]
+    fn test_syscall_stack_layout() {
+        // Offsets hard-coded in the SYSCALL entry stub
+        assert_eq!(core::mem::offset_of!(SyscallStack, kernel_rsp), 0);
+        assert_eq!(core::mem::offset_of!(SyscallStack, user_rsp), 8);
+    }
+
+    #[test]
+    fn test_bsp_online() {
+        assert_eq!(this_cpu(), 0);
+        assert!(online_mask() & 1 != 0);
+        assert!(cpu_count() >= 1);
+    }
+}
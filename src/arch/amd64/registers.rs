@@ -26,6 +26,9 @@ pub mod msr {
     /// IA32_APIC_BASE - Local APIC Base
     pub const IA32_APIC_BASE: u32 = 0x0000_001B;
 
+    /// IA32_TSC_DEADLINE - Local APIC timer deadline (TSC-deadline mode)
+    pub const IA32_TSC_DEADLINE: u32 = 0x0000_06E0;
+
     /// IA32_LSTAR - IA32-e Mode System Call Target Address (RIP)
     pub const IA32_LSTAR: u32 = 0xC000_0082;
 
@@ -45,6 +48,8 @@ pub mod cr {
     pub const CR0_AM: u64 = 1 << 18;  // Alignment Mask
     pub const CR0_WP: u64 = 1 << 16;  // Write Protect
     pub const CR0_NE: u64 = 1 << 5;   // Numeric Error
+    pub const CR0_TS: u64 = 1 << 3;   // Task Switched (lazy FPU)
+    pub const CR0_MP: u64 = 1 << 1;   // Monitor Coprocessor
     pub const CR0_PE: u64 = 1 << 0;   // Protected Mode Enable
 
     /// CR4 - Control Register 4
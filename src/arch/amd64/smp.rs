@@ -0,0 +1,189 @@
+// Copyright 2025 The Rustux Authors
+//
+// Use of this source code is governed by a MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT
+
+//! SMP Bring-up and Cross-CPU Signalling
+//!
+//! The BSP starts every enabled Local APIC listed in the MADT with the
+//! INIT-SIPI-SIPI sequence (see [`bootstrap16`]). Each application
+//! processor loads its own GDT/TSS and the shared IDT, programs its
+//! SYSCALL MSRs, enables its Local APIC and then enters the scheduler's
+//! idle loop, where it picks up or steals Ready processes.
+//!
+//! A CPU that queues work on another, idle CPU sends it a reschedule IPI
+//! ([`send_reschedule`]) so that the target leaves `hlt` and looks at its
+//! queue right away. A CPU that changes the page table of a process whose
+//! threads run elsewhere sends those CPUs a TLB shootdown IPI (see
+//! `tlb::shootdown`).
+
+use core::arch::naked_asm;
+
+use crate::acpi::ParsedMadt;
+use crate::arch::amd64::bootstrap16::{bootstrap16, start_secondary_cpu};
+use crate::arch::amd64::descriptor::{self, IDT_POINTER};
+use crate::arch::amd64::percpu::{self, MAX_CPUS};
+use crate::arch::amd64::{apic, idt, mmu, registers, syscall, tlb, tsc};
+
+/// IPI vector that makes an idle CPU re-check its run queue
+pub const RESCHEDULE_VECTOR: u8 = 0xF0;
+
+/// IPI vector that makes a CPU flush its loaded address space
+pub const TLB_SHOOTDOWN_VECTOR: u8 = 0xF1;
+
+/// Local APIC timer vector (the boot CPU installs its handler)
+pub const TIMER_VECTOR: u8 = 32;
+
+/// Kernel stack size of each application processor's idle context
+const AP_STACK_SIZE: usize = 16 * 1024;
+
+/// How long to wait for all started APs to come online
+const AP_ONLINE_TIMEOUT_MS: u64 = 100;
+
+/// Kernel stack of one application processor
+#[repr(C, align(16))]
+struct ApStack([u8; AP_STACK_SIZE]);
+
+/// AP stacks, indexed by CPU number (entry 0 is unused: the BSP has one)
+static mut AP_STACKS: [ApStack; MAX_CPUS] = {
+    const EMPTY: ApStack = ApStack([0; AP_STACK_SIZE]);
+    [EMPTY; MAX_CPUS]
+};
+
+/// Start all application processors
+///
+/// # Arguments
+///
+/// * `madt` - Parsed MADT listing the Local APICs
+///
+/// # Returns
+///
+/// Number of online CPUs, including the BSP
+///
+/// # Safety
+///
+/// Must be called once on the BSP after the GDT, IDT and Local APIC are
+/// set up, with the current page tables identity-mapping low memory.
+pub unsafe fn smp_init(madt: &ParsedMadt) -> usize {
+    idt::idt_set_gate(RESCHEDULE_VECTOR, x86_reschedule_entry as u64, 0x08, 0x8E);
+    idt::idt_set_gate(TLB_SHOOTDOWN_VECTOR, x86_tlb_shootdown_entry as u64, 0x08, 0x8E);
+
+    let bsp_apic_id = apic::apic_local_id();
+    let cr3 = registers::x86_get_cr3();
+
+    let mut cpu = 1usize;
+    let mut expected = 1u64;
+    for entry in &madt.local_apics[..madt.local_apic_count] {
+        let (apic_id, flags) = (entry.apic_id as u32, entry.flags);
+        if flags & 1 == 0 || apic_id == bsp_apic_id {
+            continue;
+        }
+        if cpu >= MAX_CPUS {
+            break;
+        }
+
+        let stack_top = (&raw mut AP_STACKS[cpu]) as usize + AP_STACK_SIZE;
+        if start_secondary_cpu(cpu as u32, apic_id, bootstrap16 as usize, stack_top, cr3) {
+            expected |= 1 << cpu;
+        }
+        // CPU numbers follow MADT order even if a core fails to start
+        cpu += 1;
+    }
+
+    for _ in 0..AP_ONLINE_TIMEOUT_MS {
+        if percpu::online_mask() & expected == expected {
+            break;
+        }
+        tsc::tsc_delay_ms(1);
+    }
+    percpu::cpu_count()
+}
+
+/// Per-CPU initialization of an application processor
+///
+/// Called by [`bootstrap16`] on the AP's own stack. Never returns: the
+/// CPU ends up in the scheduler's idle loop.
+pub fn ap_main(cpu: usize, apic_id: u32) -> ! {
+    unsafe {
+        percpu::init_cpu(cpu, apic_id);
+        descriptor::gdt_setup_cpu(cpu);
+        descriptor::idt_load(&*(&raw const IDT_POINTER));
+        syscall::x86_syscall_init();
+        tlb::init_cpu();
+        mmu::x86_mmu_percpu_init();
+        mmu::x86_enable_write_protect();
+    }
+    apic::apic_local_enable();
+    apic::apic_timer_init(TIMER_VECTOR, false);
+    percpu::set_online(cpu);
+
+    crate::sched::round_robin::idle_loop()
+}
+
+/// Ask another CPU to look at its run queue
+///
+/// Does nothing for the calling CPU or an offline one.
+pub fn send_reschedule(cpu: usize) {
+    if cpu == percpu::this_cpu() || percpu::online_mask() & (1 << cpu) == 0 {
+        return;
+    }
+    apic::apic_send_ipi(percpu::apic_id(cpu), RESCHEDULE_VECTOR);
+}
+
+/// Reschedule IPI entry stub
+///
+/// The IPI only has to end `hlt` in the idle loop, which re-checks its
+/// queue itself, so the handler just acknowledges the interrupt.
+///
+/// # Safety
+///
+/// Must only be installed as the [`RESCHEDULE_VECTOR`] interrupt gate.
+#[unsafe(naked)]
+#[no_mangle]
+pub unsafe extern "C" fn x86_reschedule_entry() {
+    naked_asm!(
+        "push rax",
+        "mov rax, 0xFEE000B0",  // Local APIC EOI register
+        "mov dword ptr [rax], 0",
+        "pop rax",
+        "iretq",
+    );
+}
+
+/// TLB shootdown IPI entry stub
+///
+/// Saves the caller-saved registers around `tlb::shootdown_interrupt`,
+/// which flushes and acknowledges the interrupt. The interrupt frame and
+/// nine pushes leave RSP 16-byte aligned.
+///
+/// # Safety
+///
+/// Must only be installed as the [`TLB_SHOOTDOWN_VECTOR`] interrupt gate.
+#[unsafe(naked)]
+#[no_mangle]
+pub unsafe extern "C" fn x86_tlb_shootdown_entry() {
+    naked_asm!(
+        "push rax",
+        "push rcx",
+        "push rdx",
+        "push rsi",
+        "push rdi",
+        "push r8",
+        "push r9",
+        "push r10",
+        "push r11",
+        "call {handler}",
+        "pop r11",
+        "pop r10",
+        "pop r9",
+        "pop r8",
+        "pop rdi",
+        "pop rsi",
+        "pop rdx",
+        "pop rcx",
+        "pop rax",
+        "iretq",
+        handler = sym tlb::shootdown_interrupt,
+    );
+}
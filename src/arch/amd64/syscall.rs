@@ -21,6 +21,8 @@
 //! 3. Loads kernel CS/RIP from IA32_LSTAR MSR
 //! 4. Loads kernel SS from IA32_STAR MSR
 
+use core::arch::naked_asm;
+
 use crate::arch::amd64::registers::{self, msr, rflags};
 use crate::syscall::{self as sys, SyscallArgs, SyscallRet};
 
@@ -31,6 +33,12 @@ pub use crate::syscall::{X86Iframe, X86SyscallGeneralRegs, SyscallStats};
 /// MSR Setup for Syscalls
 /// ============================================================================
 
+/// Selector base loaded into IA32_STAR[47:32] (kernel CS; SS = base + 8)
+const SYSCALL_CS_BASE: u64 = 0x08;
+
+/// Selector base loaded into IA32_STAR[63:48] (user SS = base + 8, CS = base + 16)
+const SYSRET_CS_BASE: u64 = 0x18;
+
 /// Initialize MSRs for syscall support
 ///
 /// This should be called during kernel initialization to set up
@@ -42,18 +50,16 @@ pub use crate::syscall::{X86Iframe, X86SyscallGeneralRegs, SyscallStats};
 /// during initialization.
 pub unsafe fn x86_syscall_init() {
     // IA32_STAR - System Call Target Address
-    // Bits [63:48] = Kernel CS (must be 0x08 for 64-bit kernel)
-    // Bits [47:32] = User CS (must be 0x1B for user mode)
-    // This MSR is used for compatibility mode (32-bit) syscalls
-    let star_value: u64 = (0x08u64 << 32) | (0x1Bu64 << 48);
+    // Bits [47:32] = SYSCALL base: CS = base (0x08), SS = base + 8 (0x10)
+    // Bits [63:48] = SYSRET base: SS = base + 8 (0x23), CS = base + 16 (0x2B)
+    // The SYSRET base points at the user code descriptor at index 3, so the
+    // 64-bit SYSRET selectors land on user data (index 4) and the dedicated
+    // 64-bit user code descriptor at index 5 (see descriptor.rs).
+    let star_value: u64 = (SYSCALL_CS_BASE << 32) | (SYSRET_CS_BASE << 48);
     registers::write_msr(msr::IA32_STAR, star_value);
 
     // IA32_LSTAR - IA32-e Mode System Call Target Address
     // This is the RIP where syscalls enter in 64-bit mode
-    // Set to the architecture-specific syscall entry point
-    extern "C" {
-        fn x86_64_syscall_entry();
-    }
     registers::write_msr(msr::IA32_LSTAR, x86_64_syscall_entry as u64);
 
     // IA32_FMASK - System Call Flag Mask
@@ -73,17 +79,163 @@ pub unsafe fn x86_syscall_init() {
 /// Architecture-Specific Syscall Entry Point
 /// ============================================================================
 
-/// AMD64 syscall entry point
+/// Set the kernel stack used on entry from user mode on this CPU
+///
+/// Updates both the SYSCALL entry stack (the per-CPU slot the entry stub
+/// reaches through SWAPGS, see `percpu`) and this CPU's TSS.rsp0 (used by
+/// interrupts and `int` gates taken from ring 3). The scheduler calls this
+/// every time a process is switched in.
+///
+/// # Safety
+///
+/// `stack_top` must be the top of a mapped kernel stack that is not in use
+/// by any other task.
+pub unsafe fn set_kernel_stack(stack_top: u64) {
+    super::percpu::set_syscall_stack(stack_top);
+    super::descriptor::get_tss().rsp0 = stack_top;
+}
+
+/// ============================================================================
+/// Architecture-Specific Syscall Entry Point
+/// ============================================================================
+
+/// AMD64 SYSCALL entry point (IA32_LSTAR target)
+///
+/// On entry the CPU has placed the user RIP in rcx and the user RFLAGS in
+/// r11, and is still running on the user stack. This stub:
+/// 1. Switches to this CPU's kernel stack (`percpu::SyscallStack`, reached
+///    via SWAPGS; GS is swapped back before any Rust code runs)
+/// 2. Saves the user RSP/RIP/RFLAGS and the argument registers
+/// 3. Calls [`x86_64_syscall_handler`] with rdi, rsi, rdx, r10, r8, r9, rax
+/// 4. Restores user state and returns with `sysretq`, result in rax
+///
+/// Only rax, rcx and r11 are clobbered from the caller's point of view.
+///
+/// # Safety
+///
+/// Must only be reached through the `syscall` instruction.
+#[unsafe(naked)]
+#[no_mangle]
+pub unsafe extern "C" fn x86_64_syscall_entry() {
+    naked_asm!(
+        // Switch to this CPU's kernel stack
+        "swapgs",
+        "mov gs:[8], rsp",
+        "mov rsp, gs:[0]",
+
+        // Save user return state
+        "push qword ptr gs:[8]",
+        "swapgs",
+        "push rcx",
+        "push r11",
+
+        // Save argument registers (preserved across syscalls)
+        "push rdi",
+        "push rsi",
+        "push rdx",
+        "push r10",
+        "push r8",
+        "push r9",
+
+        // 7th C argument (syscall number) goes on the stack; this also
+        // brings RSP back to 16-byte alignment for the call
+        "push rax",
+        "mov rcx, r10",
+        "call {handler}",
+        "add rsp, 8",
+
+        "pop r9",
+        "pop r8",
+        "pop r10",
+        "pop rdx",
+        "pop rsi",
+        "pop rdi",
+
+        // Refuse to SYSRET to a non-canonical RIP (would #GP in ring 0)
+        "mov rcx, [rsp + 8]",
+        "mov r11, rcx",
+        "shl r11, 16",
+        "sar r11, 16",
+        "cmp r11, rcx",
+        "jne 2f",
+
+        "pop r11",
+        "pop rcx",
+        "pop rsp",
+        "sysretq",
+
+        // Non-canonical return address: kill the process via the exit path
+        "2:",
+        "swapgs",
+        "mov rsp, gs:[0]",
+        "swapgs",
+        "xor edi, edi",
+        "xor esi, esi",
+        "xor edx, edx",
+        "xor ecx, ecx",
+        "xor r8d, r8d",
+        "xor r9d, r9d",
+        "push {exit_nr}",
+        "push {exit_nr}",
+        "call {handler}",
+        "ud2",
+
+        handler = sym x86_64_syscall_handler,
+        exit_nr = const sys::number::PROCESS_EXIT,
+    );
+}
+
+/// Legacy `int 0x80` syscall gate
 ///
-/// This function is called from the syscall instruction in user space.
-/// It properly saves/restores registers and calls the syscall dispatcher.
+/// Services the same register convention as [`x86_64_syscall_entry`]
+/// (number in rax, arguments in rdi, rsi, rdx, r10, r8, r9, result in
+/// rax), so old binaries and the fast path agree on the ABI. The CPU has
+/// already switched to TSS.rsp0 and pushed the interrupt frame.
 ///
 /// # Safety
 ///
-/// This function must preserve all registers except for the syscall
-/// arguments and return value.
+/// Must only be installed as a DPL 3 interrupt gate.
+#[unsafe(naked)]
+#[no_mangle]
+pub unsafe extern "C" fn x86_64_int80_entry() {
+    naked_asm!(
+        // Preserve everything except rax, as the SYSCALL path does
+        "push rdi",
+        "push rsi",
+        "push rdx",
+        "push r10",
+        "push r8",
+        "push r9",
+        "push rcx",
+        "push r11",
+
+        // 7th C argument; the 5-word interrupt frame plus 9 pushes keeps
+        // RSP 16-byte aligned for the call
+        "push rax",
+        "mov rcx, r10",
+        "call {handler}",
+        "add rsp, 8",
+
+        "pop r11",
+        "pop rcx",
+        "pop r9",
+        "pop r8",
+        "pop r10",
+        "pop rdx",
+        "pop rsi",
+        "pop rdi",
+        "iretq",
+
+        handler = sym x86_64_syscall_handler,
+    );
+}
+
+/// Rust side of the AMD64 syscall entry
+///
+/// Called from [`x86_64_syscall_entry`] and [`x86_64_int80_entry`] with
+/// the user argument registers in the order of the syscall ABI.
 #[no_mangle]
-pub unsafe extern "C" fn x86_64_syscall_entry(
+pub unsafe extern "C" fn x86_64_syscall_handler(
     rdi: usize,
     rsi: usize,
     rdx: usize,
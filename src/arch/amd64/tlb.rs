@@ -0,0 +1,413 @@
+// Copyright 2025 The Rustux Authors
+//
+// Use of this source code is governed by a MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT
+
+//! TLB Management
+//!
+//! # PCIDs
+//!
+//! With CR4.PCIDE set, the CPU tags TLB entries with the process-context
+//! ID held in the low 12 bits of CR3. Every address space gets its own
+//! PCID when it is created ([`assign_pcid`]), and the scheduler loads CR3
+//! with bit 63 set ([`switch_cr3`]): a process switch keeps the entries
+//! of every other address space, so a process switched back in finds its
+//! translations still cached instead of refilling them by page walks.
+//!
+//! PCID 0 is the kernel's own page table, and the fallback once the 4095
+//! others are handed out. A CR3 load of PCID 0 always flushes it, exactly
+//! as without PCIDs. Page tables are never freed, so PCIDs are never
+//! recycled.
+//!
+//! # Global Pages
+//!
+//! CR4.PGE is set as well: entries marked global (the kernel direct map,
+//! see `mmu::x86_setup_direct_map`) survive every CR3 load, whatever the
+//! PCID.
+//!
+//! # Shootdown
+//!
+//! A present translation that changes must be invalidated on every CPU
+//! that may cache it. The calling CPU invalidates at once: `invlpg` if
+//! the address space is loaded, INVPCID otherwise. Other CPUs are marked
+//! stale for the PCID and flush it the next time they load it, without
+//! an IPI.
+//!
+//! A CPU running the address space right now (another thread of the same
+//! process) cannot wait for that: it gets a shootdown IPI and reloads its
+//! CR3, and the caller spins until it has. Kernel code mostly runs with
+//! interrupts disabled, so CPUs also take their shootdown requests while
+//! they spin ([`poll_shootdown`], called by `SpinMutex::lock` and by a
+//! CPU waiting for its own shootdown): a target spinning on a lock the
+//! caller holds still answers.
+//!
+//! CPUs are assumed identical: the boot CPU's features decide for all.
+
+use alloc::collections::BTreeMap;
+use core::sync::atomic::{fence, AtomicBool, AtomicU16, AtomicU32, AtomicU64, Ordering};
+
+use crate::arch::amd64::apic;
+use crate::arch::amd64::mm::page_tables::PAddr;
+use crate::arch::amd64::percpu::{self, MAX_CPUS};
+use crate::arch::amd64::registers::{self, cr};
+use crate::arch::amd64::smp::TLB_SHOOTDOWN_VECTOR;
+use crate::sync::SpinMutex;
+
+/// CR3 bit 63: keep the TLB entries of the PCID being loaded
+pub const CR3_NOFLUSH: u64 = 1 << 63;
+
+/// Largest PCID (12 bits)
+pub const MAX_PCID: u16 = 0xFFF;
+
+/// Bits of CR3 holding the PML4 physical address
+const CR3_ADDR_MASK: u64 = 0x000F_FFFF_FFFF_F000;
+
+/// INVPCID types
+const INVPCID_ADDRESS: u64 = 0;
+const INVPCID_CONTEXT: u64 = 1;
+const INVPCID_ALL_GLOBAL: u64 = 2;
+
+/// CR4.PCIDE is set (CPUID.01H:ECX.PCID)
+static PCID_ENABLED: AtomicBool = AtomicBool::new(false);
+
+/// The CPU has INVPCID (CPUID.07H:EBX.INVPCID)
+static INVPCID_SUPPORTED: AtomicBool = AtomicBool::new(false);
+
+/// Next unassigned PCID
+static NEXT_PCID: AtomicU16 = AtomicU16::new(1);
+
+/// PCID of each page table (PML4 physical address)
+static PCIDS: SpinMutex<BTreeMap<PAddr, u16>> = SpinMutex::new(BTreeMap::new());
+
+/// CPUs that must flush a PCID the next time they load it (bit N = CPU N,
+/// MAX_CPUS fits)
+static STALE: [AtomicU32; MAX_PCID as usize + 1] = {
+    const NONE: AtomicU32 = AtomicU32::new(0);
+    [NONE; MAX_PCID as usize + 1]
+};
+
+/// Page table each CPU switched to last (see [`switch_cr3`])
+static ACTIVE: [AtomicU64; MAX_CPUS] = {
+    const NONE: AtomicU64 = AtomicU64::new(0);
+    [NONE; MAX_CPUS]
+};
+
+/// Shootdowns requested of each CPU, and how many it has handled
+static REQUESTED: [AtomicU64; MAX_CPUS] = {
+    const ZERO: AtomicU64 = AtomicU64::new(0);
+    [ZERO; MAX_CPUS]
+};
+static HANDLED: [AtomicU64; MAX_CPUS] = {
+    const ZERO: AtomicU64 = AtomicU64::new(0);
+    [ZERO; MAX_CPUS]
+};
+
+/// CPUs with shootdown requests they have not handled yet (bit N = CPU N)
+static PENDING: AtomicU32 = AtomicU32::new(0);
+
+/// ============================================================================
+/// Per-CPU Setup
+/// ============================================================================
+
+/// Enable global pages, and PCIDs where the CPU has them
+///
+/// # Safety
+///
+/// Must be called once on each CPU, the boot CPU first, with a CR3 that
+/// has PCID 0 (as any CR3 loaded without PCIDs does).
+pub unsafe fn init_cpu() {
+    let mut cr4 = registers::x86_get_cr4() | cr::CR4_PGE;
+
+    if percpu::online_mask() == 0 {
+        // Boot CPU: detect for everyone
+        let leaf1 = core::arch::x86_64::__cpuid(1);
+        let pcid = leaf1.ecx & (1 << 17) != 0;
+        let max_leaf = core::arch::x86_64::__cpuid(0).eax;
+        let invpcid = max_leaf >= 7
+            && core::arch::x86_64::__cpuid_count(7, 0).ebx & (1 << 10) != 0;
+        PCID_ENABLED.store(pcid, Ordering::Relaxed);
+        INVPCID_SUPPORTED.store(pcid && invpcid, Ordering::Relaxed);
+    }
+
+    if PCID_ENABLED.load(Ordering::Relaxed) {
+        cr4 |= cr::CR4_PCIDE;
+    }
+    registers::x86_set_cr4(cr4);
+}
+
+/// Whether address spaces are PCID-tagged
+pub fn pcid_enabled() -> bool {
+    PCID_ENABLED.load(Ordering::Relaxed)
+}
+
+/// ============================================================================
+/// PCID Assignment
+/// ============================================================================
+
+/// Give a new page table its PCID
+///
+/// # Returns
+///
+/// The PCID, or 0 once all are handed out
+pub fn assign_pcid(page_table: PAddr) -> u16 {
+    let pcid = NEXT_PCID
+        .fetch_update(Ordering::Relaxed, Ordering::Relaxed, |next| {
+            (next <= MAX_PCID).then_some(next + 1)
+        })
+        .unwrap_or(0);
+    if pcid != 0 {
+        PCIDS.lock().insert(page_table, pcid);
+    }
+    pcid
+}
+
+/// PCID of a page table (0 if it has none)
+pub fn pcid_of(page_table: PAddr) -> u16 {
+    PCIDS.lock().get(&page_table).copied().unwrap_or(0)
+}
+
+/// CR3 value that switches the calling CPU to a page table
+///
+/// Keeps the TLB entries of the PCID unless the CPU was marked stale for
+/// it since it last loaded it.
+///
+/// # Safety
+///
+/// Interrupts must be disabled until the CR3 is loaded.
+pub unsafe fn switch_cr3(page_table: PAddr, pcid: u16) -> u64 {
+    let cpu = percpu::this_cpu();
+    // Published before the stale check: a CPU changing the page table
+    // either sees us in `shootdown` or marked us stale before the check
+    ACTIVE[cpu].store(page_table, Ordering::SeqCst);
+
+    if pcid == 0 || !pcid_enabled() {
+        return page_table;
+    }
+
+    let bit = 1u32 << cpu;
+    let stale = &STALE[pcid as usize];
+    if stale.load(Ordering::SeqCst) & bit != 0 {
+        stale.fetch_and(!bit, Ordering::Relaxed);
+        return page_table | pcid as u64;
+    }
+    page_table | pcid as u64 | CR3_NOFLUSH
+}
+
+/// ============================================================================
+/// Invalidation
+/// ============================================================================
+
+/// Invalidate the calling CPU's entries for a page of the current PCID
+/// (and its global entry, if any)
+///
+/// # Safety
+///
+/// Privileged instruction; `vaddr` need not be mapped.
+#[inline]
+pub unsafe fn invlpg(vaddr: u64) {
+    core::arch::asm!("invlpg [{}]", in(reg) vaddr, options(nostack));
+}
+
+/// INVPCID of the given type
+///
+/// # Safety
+///
+/// The CPU must support INVPCID and have CR4.PCIDE set.
+#[inline]
+unsafe fn invpcid(kind: u64, pcid: u16, vaddr: u64) {
+    let descriptor: [u64; 2] = [pcid as u64, vaddr];
+    core::arch::asm!(
+        "invpcid {}, [{}]",
+        in(reg) kind,
+        in(reg) &descriptor,
+        options(nostack, readonly)
+    );
+}
+
+/// Mark CPUs stale for a PCID
+fn mark_stale(pcid: u16, cpus: u32) {
+    if cpus != 0 {
+        STALE[pcid as usize].fetch_or(cpus, Ordering::SeqCst);
+    }
+}
+
+/// Make the other CPUs running an address space flush it now
+///
+/// Sends each of them a shootdown IPI and waits until all have reloaded
+/// their CR3. CPUs that switch to the address space later flush it on
+/// the way in (they were marked stale, or load it without PCIDs).
+fn shootdown(page_table: PAddr) {
+    // The page table changes (and stale marks) come before the check
+    fence(Ordering::SeqCst);
+
+    let this = percpu::this_cpu();
+    let online = percpu::online_mask() as u32;
+    let mut targets = 0u32;
+    for cpu in 0..MAX_CPUS {
+        let bit = 1u32 << cpu;
+        if cpu != this && online & bit != 0 && ACTIVE[cpu].load(Ordering::SeqCst) == page_table {
+            targets |= bit;
+        }
+    }
+    if targets == 0 {
+        return;
+    }
+
+    let mut tickets = [0u64; MAX_CPUS];
+    for cpu in (0..MAX_CPUS).filter(|cpu| targets & (1 << cpu) != 0) {
+        tickets[cpu] = REQUESTED[cpu].fetch_add(1, Ordering::AcqRel) + 1;
+    }
+    PENDING.fetch_or(targets, Ordering::SeqCst);
+    for cpu in (0..MAX_CPUS).filter(|cpu| targets & (1 << cpu) != 0) {
+        apic::apic_send_ipi(percpu::apic_id(cpu), TLB_SHOOTDOWN_VECTOR);
+    }
+
+    for cpu in (0..MAX_CPUS).filter(|cpu| targets & (1 << cpu) != 0) {
+        while HANDLED[cpu].load(Ordering::Acquire) < tickets[cpu] {
+            // The target may be waiting for a shootdown of ours
+            poll_shootdown();
+            core::hint::spin_loop();
+        }
+    }
+}
+
+/// Handle shootdown requests made of the calling CPU, if there are any
+///
+/// Called by the shootdown IPI, and by code spinning with interrupts
+/// disabled so that two CPUs never wait on each other. Costs one load
+/// while no shootdown is in flight.
+#[inline]
+pub fn poll_shootdown() {
+    if PENDING.load(Ordering::Relaxed) != 0 {
+        handle_shootdown();
+    }
+}
+
+/// Flush the loaded address space if a shootdown was requested of us
+fn handle_shootdown() {
+    let cpu = percpu::this_cpu();
+    let bit = 1u32 << cpu;
+    if PENDING.load(Ordering::Acquire) & bit == 0 {
+        return;
+    }
+    PENDING.fetch_and(!bit, Ordering::AcqRel);
+    let requested = REQUESTED[cpu].load(Ordering::Acquire);
+
+    // A CR3 load without bit 63 flushes the loaded PCID
+    unsafe {
+        let cr3 = registers::x86_get_cr3();
+        core::arch::asm!("mov cr3, {}", in(reg) cr3, options(nostack));
+    }
+    HANDLED[cpu].store(requested, Ordering::Release);
+}
+
+/// Shootdown IPI handler (see `smp::x86_tlb_shootdown_entry`)
+pub extern "C" fn shootdown_interrupt() {
+    handle_shootdown();
+    apic::apic_issue_eoi();
+}
+
+/// Invalidate entries of a page table the calling CPU caches under its
+/// PCID, where the CPU has not just done it under the loaded one
+///
+/// `invalidate` runs INVPCID for the PCID; without INVPCID the CPU is
+/// marked stale instead, and flushes when it next loads the PCID. Also
+/// marks every other CPU stale.
+fn flush_pcid(pcid: u16, cr3: u64, invalidate: impl FnOnce()) {
+    // Without a PCID, each load of the page table flushes it anyway
+    if pcid == 0 || !pcid_enabled() {
+        return;
+    }
+
+    let this = 1u32 << percpu::this_cpu();
+    if cr3 & 0xFFF != pcid as u64 {
+        if INVPCID_SUPPORTED.load(Ordering::Relaxed) {
+            invalidate();
+        } else {
+            mark_stale(pcid, this);
+        }
+    }
+    mark_stale(pcid, percpu::online_mask() as u32 & !this);
+}
+
+/// Invalidate one page of an address space on every CPU
+///
+/// Call after changing or removing a present translation, with
+/// interrupts disabled. Adding a translation where there was none needs
+/// no invalidation. Returns once no CPU can use the old translation.
+///
+/// # Arguments
+///
+/// * `page_table` - PML4 physical address of the address space
+/// * `vaddr` - Address in the page
+pub fn flush_page(page_table: PAddr, vaddr: u64) {
+    let pcid = pcid_of(page_table);
+    let cr3 = unsafe { registers::x86_get_cr3() };
+
+    if cr3 & CR3_ADDR_MASK == page_table {
+        unsafe { invlpg(vaddr) };
+    }
+    flush_pcid(pcid, cr3, || unsafe { invpcid(INVPCID_ADDRESS, pcid, vaddr) });
+    shootdown(page_table);
+}
+
+/// Invalidate every non-global entry of an address space on every CPU
+///
+/// # Arguments
+///
+/// * `page_table` - PML4 physical address of the address space
+pub fn flush_address_space(page_table: PAddr) {
+    let pcid = pcid_of(page_table);
+    let cr3 = unsafe { registers::x86_get_cr3() };
+
+    if cr3 & CR3_ADDR_MASK == page_table {
+        // A CR3 load without bit 63 flushes the loaded PCID (CR3 never
+        // reads back with bit 63 set)
+        unsafe { core::arch::asm!("mov cr3, {}", in(reg) cr3, options(nostack)) };
+    }
+    flush_pcid(pcid, cr3, || unsafe { invpcid(INVPCID_CONTEXT, pcid, 0) });
+    shootdown(page_table);
+}
+
+/// Flush the calling CPU's entire TLB, global entries included
+///
+/// Needed after changing a global (kernel) translation, which no CR3
+/// load flushes.
+///
+/// # Safety
+///
+/// Interrupts must be disabled.
+pub unsafe fn flush_all_local() {
+    if INVPCID_SUPPORTED.load(Ordering::Relaxed) {
+        invpcid(INVPCID_ALL_GLOBAL, 0, 0);
+    } else {
+        // Toggling CR4.PGE flushes everything, every PCID included
+        let cr4 = registers::x86_get_cr4();
+        registers::x86_set_cr4(cr4 & !cr::CR4_PGE);
+        registers::x86_set_cr4(cr4);
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    #[test]
+    fn test_assign_pcid() {
+        let a = assign_pcid(0x7000_0000);
+        let b = assign_pcid(0x7000_1000);
+        assert_ne!(a, 0);
+        assert_ne!(a, b);
+        assert_eq!(pcid_of(0x7000_0000), a);
+        assert_eq!(pcid_of(0x7000_1000), b);
+        assert_eq!(pcid_of(0x7000_2000), 0);
+    }
+
+    #[test]
+    fn test_switch_cr3_without_pcids() {
+        // PCIDs stay disabled unless init_cpu finds them
+        assert_eq!(unsafe { switch_cr3(0x7000_3000, 5) }, 0x7000_3000);
+        assert_eq!(unsafe { switch_cr3(0x7000_3000, 0) }, 0x7000_3000);
+    }
+}
@@ -0,0 +1,108 @@
+// Copyright 2025 The Rustux Authors
+//
+// Use of this source code is governed by a MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT
+
+//! Fault-Tolerant User Memory Copies
+//!
+//! [`x86_user_copy`] moves bytes between kernel and user memory with
+//! string instructions. A page fault inside it that demand paging cannot
+//! resolve (an unmapped or read-only user address) does not halt the
+//! kernel: the #PF handler asks [`fixup`] for a recovery address and
+//! resumes there, and the copy reports the fault to its caller.
+//!
+//! The kernel is built without SSE (the vector registers hold user state,
+//! switched lazily by `fpu`), so the copy uses `rep movsb` where the CPU
+//! has ERMS (CPUID.07H:EBX.ERMS), whose microcode moves whole cache
+//! lines, and `rep movsq` with a `rep movsb` tail otherwise.
+
+use core::arch::naked_asm;
+use core::sync::atomic::{AtomicU8, Ordering};
+
+/// ERMS detection state
+const ERMS_UNKNOWN: u8 = 0;
+const ERMS_ABSENT: u8 = 1;
+const ERMS_PRESENT: u8 = 2;
+
+static ERMS: AtomicU8 = AtomicU8::new(ERMS_UNKNOWN);
+
+/// Whether `rep movsb` is the fast copy (Enhanced REP MOVSB/STOSB)
+pub fn has_erms() -> bool {
+    match ERMS.load(Ordering::Relaxed) {
+        ERMS_PRESENT => true,
+        ERMS_ABSENT => false,
+        _ => {
+            let present = unsafe {
+                core::arch::x86_64::__cpuid(0).eax >= 7
+                    && core::arch::x86_64::__cpuid_count(7, 0).ebx & (1 << 9) != 0
+            };
+            ERMS.store(if present { ERMS_PRESENT } else { ERMS_ABSENT }, Ordering::Relaxed);
+            present
+        }
+    }
+}
+
+extern "C" {
+    /// First instruction of [`x86_user_copy`] that touches memory
+    fn x86_user_copy_start();
+    /// End of the instructions that touch memory
+    fn x86_user_copy_end();
+    /// Recovery address of a fault between the two
+    fn x86_user_copy_fault();
+}
+
+/// Copy `len` bytes from `src` to `dst`, either of which may be user
+/// memory
+///
+/// `erms` selects a single `rep movsb` over `rep movsq` plus a tail.
+///
+/// # Returns
+///
+/// 0 on success, 1 if a page fault was taken that could not be resolved
+/// (the destination may be partly written)
+///
+/// # Safety
+///
+/// The kernel side must be valid for `len` bytes, and the user side must
+/// be a user range (see `syscall::usercopy`). No lock the page fault
+/// handler takes may be held.
+#[unsafe(naked)]
+pub unsafe extern "C" fn x86_user_copy(dst: *mut u8, src: *const u8, len: usize, erms: bool) -> u64 {
+    naked_asm!(
+        "mov r8, rdx",
+        "test cl, cl",
+        "jnz 2f",
+        "mov rcx, rdx",
+        "shr rcx, 3",
+        "and r8, 7",
+        ".global x86_user_copy_start",
+        "x86_user_copy_start:",
+        "rep movsq",
+        "2:",
+        "mov rcx, r8",
+        "rep movsb",
+        ".global x86_user_copy_end",
+        "x86_user_copy_end:",
+        "xor eax, eax",
+        "ret",
+        ".global x86_user_copy_fault",
+        "x86_user_copy_fault:",
+        "mov eax, 1",
+        "ret",
+    );
+}
+
+/// Recovery address for a kernel page fault at `rip`
+///
+/// Called by the #PF handler for a kernel-mode fault on a user address
+/// that demand paging could not resolve.
+///
+/// # Returns
+///
+/// Where to resume if the fault was taken by [`x86_user_copy`]
+pub fn fixup(rip: u64) -> Option<u64> {
+    let start = x86_user_copy_start as usize as u64;
+    let end = x86_user_copy_end as usize as u64;
+    (start..end).contains(&rip).then(|| x86_user_copy_fault as usize as u64)
+}
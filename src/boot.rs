@@ -0,0 +1,346 @@
+// Copyright 2025 The Rustux Authors
+//
+// Use of this source code is governed by a MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT
+
+//! Boot Phases and Deferred Initialization
+//!
+//! # Phase Markers
+//!
+//! [`mark`] records the TSC when a boot phase ends, in a fixed table (the
+//! first phases run before the heap exists). `SYS_STATS` copies the table
+//! out (`stats::kind::BOOT`), and it is dumped to the debug port once
+//! the deferred tasks are done. The TSC counts from reset, so each marker
+//! is also the time since power-on; `"user"`, taken just before the
+//! first switch to PID 1, is the time to the first userspace instruction.
+//!
+//! # Deferred Initialization
+//!
+//! Subsystems init can start without (the framebuffer console, the PS/2
+//! keyboard) are registered with [`defer`] instead of being initialized
+//! on the boot path. Each task names the tasks it depends on. Once PID 1
+//! is about to run, [`release`] hands them to whichever CPU gets there
+//! first: an application processor from its idle loop, in parallel with
+//! init, or the boot CPU from its next timer interrupt when it is alone.
+//! [`run_deferred`] runs them in dependency order, and marks each as a
+//! phase when it finishes.
+
+use core::sync::atomic::{AtomicU8, Ordering};
+
+use crate::arch::amd64::percpu;
+use crate::arch::amd64::tsc;
+use crate::sync::SpinMutex;
+
+/// Phase markers kept (later ones are dropped)
+pub const MAX_PHASES: usize = 32;
+
+/// Deferred tasks that can be registered
+pub const MAX_DEFERRED: usize = 16;
+
+/// ============================================================================
+/// Phase Markers
+/// ============================================================================
+
+/// The end of one boot phase
+#[derive(Debug, Clone, Copy)]
+pub struct Phase {
+    /// Phase name
+    pub name: &'static str,
+    /// TSC when the phase ended
+    pub tsc: u64,
+    /// CPU that ran it
+    pub cpu: u32,
+}
+
+impl Phase {
+    const EMPTY: Phase = Phase { name: "", tsc: 0, cpu: 0 };
+}
+
+/// Recorded markers, in recording order
+struct PhaseLog {
+    phases: [Phase; MAX_PHASES],
+    count: usize,
+}
+
+static PHASES: SpinMutex<PhaseLog> = SpinMutex::new(PhaseLog {
+    phases: [Phase::EMPTY; MAX_PHASES],
+    count: 0,
+});
+
+/// Record the end of a boot phase
+pub fn mark(name: &'static str) {
+    let tsc = tsc::tsc_ticks();
+    // The Local APIC says which CPU this is only once CPU 0 is set up
+    let cpu = if percpu::online_mask() != 0 { percpu::this_cpu() as u32 } else { 0 };
+
+    let mut log = PHASES.lock();
+    let count = log.count;
+    if count < MAX_PHASES {
+        log.phases[count] = Phase { name, tsc, cpu };
+        log.count = count + 1;
+    }
+}
+
+/// Copy out the recorded markers, in recording order
+///
+/// # Returns
+///
+/// The number of markers copied (at most `out.len()`)
+pub fn phases(out: &mut [Phase]) -> usize {
+    let log = PHASES.lock();
+    let count = log.count.min(out.len());
+    out[..count].copy_from_slice(&log.phases[..count]);
+    count
+}
+
+/// TSC of the first marker named `name`
+pub fn phase_tsc(name: &str) -> Option<u64> {
+    let log = PHASES.lock();
+    log.phases[..log.count].iter().find(|p| p.name == name).map(|p| p.tsc)
+}
+
+/// ============================================================================
+/// Deferred Tasks
+/// ============================================================================
+
+/// A subsystem initialized after PID 1 starts
+#[derive(Debug, Clone, Copy)]
+pub struct InitTask {
+    /// Task name, also the name of its phase marker
+    pub name: &'static str,
+    /// Tasks that must finish first
+    pub deps: &'static [&'static str],
+    /// Initialization function
+    pub run: fn(),
+}
+
+/// Registered tasks, in registration order
+struct TaskList {
+    tasks: [Option<InitTask>; MAX_DEFERRED],
+    count: usize,
+}
+
+static TASKS: SpinMutex<TaskList> = SpinMutex::new(TaskList {
+    tasks: [None; MAX_DEFERRED],
+    count: 0,
+});
+
+/// Deferred task states
+const REGISTERING: u8 = 0;
+const RELEASED: u8 = 1;
+const RUNNING: u8 = 2;
+const DONE: u8 = 3;
+
+static STATE: AtomicU8 = AtomicU8::new(REGISTERING);
+
+/// Register a task to run after PID 1 starts
+///
+/// # Errors
+///
+/// Fails if the table is full or the tasks were already released.
+pub fn defer(task: InitTask) -> Result<(), &'static str> {
+    if STATE.load(Ordering::Acquire) != REGISTERING {
+        return Err("deferred tasks already released");
+    }
+
+    let mut list = TASKS.lock();
+    let count = list.count;
+    if count == MAX_DEFERRED {
+        return Err("deferred task table full");
+    }
+    list.tasks[count] = Some(task);
+    list.count = count + 1;
+    Ok(())
+}
+
+/// Let the deferred tasks run
+///
+/// Called on the boot CPU once PID 1 is set up. Wakes the first other
+/// online CPU, which runs them from its idle loop.
+pub fn release() {
+    if STATE.compare_exchange(REGISTERING, RELEASED, Ordering::AcqRel, Ordering::Acquire).is_err() {
+        return;
+    }
+
+    let others = percpu::online_mask() & !(1 << percpu::this_cpu());
+    if others != 0 {
+        crate::arch::amd64::smp::send_reschedule(others.trailing_zeros() as usize);
+    }
+}
+
+/// Whether released tasks are waiting for a CPU to run them
+#[inline]
+pub fn pending() -> bool {
+    STATE.load(Ordering::Acquire) == RELEASED
+}
+
+/// Whether every deferred task has run
+pub fn deferred_done() -> bool {
+    STATE.load(Ordering::Acquire) == DONE
+}
+
+/// Order tasks so that each comes after its dependencies
+///
+/// Tasks keep their registration order where dependencies allow it.
+///
+/// # Returns
+///
+/// The number of tasks placed in `order` (indices into `tasks`). Tasks
+/// left out depend on a missing task or are part of a cycle.
+fn dependency_order(tasks: &[InitTask], order: &mut [usize; MAX_DEFERRED]) -> usize {
+    let mut placed = [false; MAX_DEFERRED];
+    let mut count = 0;
+
+    // Each pass places at least one task, or nothing more can be placed
+    loop {
+        let before = count;
+        for (i, task) in tasks.iter().enumerate() {
+            if placed[i] {
+                continue;
+            }
+            let ready = task.deps.iter().all(|dep| {
+                tasks.iter().enumerate().any(|(j, t)| placed[j] && t.name == *dep)
+            });
+            if ready {
+                placed[i] = true;
+                order[count] = i;
+                count += 1;
+            }
+        }
+        if count == before {
+            return count;
+        }
+    }
+}
+
+/// Run the released tasks, if no other CPU has taken them
+///
+/// Called from the idle loop and the timer interrupt, with interrupts
+/// disabled; a no-op unless the tasks are [`pending`].
+///
+/// # Returns
+///
+/// Whether this call ran them
+pub fn run_deferred() -> bool {
+    if STATE.compare_exchange(RELEASED, RUNNING, Ordering::AcqRel, Ordering::Acquire).is_err() {
+        return false;
+    }
+
+    // Registration is over: copy the list out so tasks run unlocked
+    let mut tasks = [InitTask { name: "", deps: &[], run: || {} }; MAX_DEFERRED];
+    let count = {
+        let list = TASKS.lock();
+        for (slot, task) in tasks.iter_mut().zip(list.tasks[..list.count].iter()) {
+            *slot = task.expect("registered task");
+        }
+        list.count
+    };
+    let tasks = &tasks[..count];
+
+    let mut order = [0usize; MAX_DEFERRED];
+    let runnable = dependency_order(tasks, &mut order);
+    for &i in &order[..runnable] {
+        (tasks[i].run)();
+        mark(tasks[i].name);
+    }
+    for (i, task) in tasks.iter().enumerate() {
+        if !order[..runnable].contains(&i) {
+            debug_write(b"[BOOT] deferred task skipped (unmet dependency): ");
+            debug_write(task.name.as_bytes());
+            debug_write(b"\n");
+        }
+    }
+
+    STATE.store(DONE, Ordering::Release);
+    dump_phases();
+    true
+}
+
+/// ============================================================================
+/// Debug Output
+/// ============================================================================
+
+fn debug_write(bytes: &[u8]) {
+    for &b in bytes {
+        unsafe {
+            core::arch::asm!("out dx, al", in("dx") 0xE9u16, in("al") b, options(nomem, nostack));
+        }
+    }
+}
+
+fn debug_dec(mut n: u64) {
+    let mut buf = [0u8; 20];
+    let mut i = buf.len();
+    loop {
+        i -= 1;
+        buf[i] = b'0' + (n % 10) as u8;
+        n /= 10;
+        if n == 0 {
+            break;
+        }
+    }
+    debug_write(&buf[i..]);
+}
+
+/// Print every marker as `[BOOT] <name> <us since reset> us (cpu N)`
+fn dump_phases() {
+    let mut phases = [Phase::EMPTY; MAX_PHASES];
+    let count = self::phases(&mut phases);
+    for phase in &phases[..count] {
+        debug_write(b"[BOOT] ");
+        debug_write(phase.name.as_bytes());
+        debug_write(b" ");
+        debug_dec(tsc::tsc_to_ns(phase.tsc) / 1000);
+        debug_write(b" us (cpu ");
+        debug_dec(phase.cpu as u64);
+        debug_write(b")\n");
+    }
+}
+
+/// ============================================================================
+/// Tests
+/// ============================================================================
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    fn task(name: &'static str, deps: &'static [&'static str]) -> InitTask {
+        InitTask { name, deps, run: || {} }
+    }
+
+    #[test]
+    fn test_dependency_order() {
+        let tasks = [
+            task("keyboard.irq", &["keyboard"]),
+            task("display", &[]),
+            task("keyboard", &[]),
+        ];
+        let mut order = [0; MAX_DEFERRED];
+        assert_eq!(dependency_order(&tasks, &mut order), 3);
+        assert_eq!(&order[..3], &[1, 2, 0]);
+    }
+
+    #[test]
+    fn test_unmet_dependencies() {
+        let tasks = [
+            task("a", &["b"]),
+            task("b", &["a"]),
+            task("c", &["missing"]),
+            task("d", &[]),
+        ];
+        let mut order = [0; MAX_DEFERRED];
+        assert_eq!(dependency_order(&tasks, &mut order), 1);
+        assert_eq!(order[0], 3);
+    }
+
+    #[test]
+    fn test_mark() {
+        mark("test.phase");
+        let tsc = phase_tsc("test.phase").expect("marked");
+        let mut phases = [Phase::EMPTY; MAX_PHASES];
+        let count = self::phases(&mut phases);
+        assert!(phases[..count].iter().any(|p| p.name == "test.phase" && p.tsc == tsc));
+    }
+}
@@ -8,15 +8,228 @@
 //!
 //! This module provides a text console implementation using the framebuffer
 //! and font rendering.
+//!
+//! `write_bytes` is the bulk path used by sys_write: it parses a whole
+//! buffer (including ANSI SGR/cursor/erase escapes), blits runs of glyphs
+//! from a pre-rendered glyph cache, and scrolls at most once per segment
+//! by the total number of lines the segment adds. A segment only ends
+//! early at an absolute cursor move or screen erase (CSI H/f/J), since
+//! line counts across those cannot be known up front.
+//!
+//! Drawing goes to the framebuffer's back buffer when it has one, and
+//! each `write_bytes` or `clear` ends with a single flush of the region
+//! it changed.
+//!
+//! The global console is shared by every CPU. Its accessors take its lock
+//! with interrupts disabled, so a CPU is never preempted mid-draw while
+//! another spins on the lock.
 
 use crate::drivers::display::framebuffer::{Color, Framebuffer};
-use crate::drivers::display::font::SimpleVgaFont;
+use crate::drivers::display::font::{GlyphCache, SimpleVgaFont};
+use crate::sync::SpinMutex;
 use core::sync::atomic::{AtomicBool, Ordering};
 
 /// Global text console instance
-static mut CONSOLE: Option<TextConsole> = None;
+static CONSOLE: SpinMutex<Option<TextConsole>> = SpinMutex::new(None);
 static CONSOLE_INITIALIZED: AtomicBool = AtomicBool::new(false);
 
+/// Width of a character cell in pixels
+const CELL_WIDTH: usize = SimpleVgaFont::width();
+
+/// Height of a character cell in pixels
+const CELL_HEIGHT: usize = SimpleVgaFont::height();
+
+/// Maximum number of numeric parameters kept for one CSI sequence
+const ANSI_MAX_PARAMS: usize = 4;
+
+/// ANSI palette for SGR 30-37/40-47 (Dracula theme, matching the shell)
+const ANSI_COLORS: [Color; 8] = [
+    Color::new(0x21, 0x22, 0x2C), // black
+    Color::new(0xFF, 0x55, 0x55), // red
+    Color::new(0x50, 0xFA, 0x7B), // green
+    Color::new(0xF1, 0xFA, 0x8C), // yellow
+    Color::new(0xBD, 0x93, 0xF9), // blue
+    Color::new(0xFF, 0x79, 0xC6), // magenta
+    Color::new(0x8B, 0xE9, 0xFD), // cyan
+    Color::new(0xF8, 0xF8, 0xF2), // white
+];
+
+/// Bright ANSI palette for SGR 90-97/100-107 and bold foregrounds
+const ANSI_BRIGHT_COLORS: [Color; 8] = [
+    Color::new(0x62, 0x72, 0xA4),
+    Color::new(0xFF, 0x6E, 0x6E),
+    Color::new(0x69, 0xFF, 0x94),
+    Color::new(0xFF, 0xFF, 0xA5),
+    Color::new(0xD6, 0xAC, 0xFF),
+    Color::new(0xFF, 0x92, 0xDF),
+    Color::new(0xA4, 0xFF, 0xFF),
+    Color::new(0xFF, 0xFF, 0xFF),
+];
+
+/// ANSI escape parser state
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+enum AnsiState {
+    /// Plain text
+    Ground,
+    /// After ESC
+    Escape,
+    /// After ESC [
+    Csi,
+}
+
+/// What a byte fed to the ANSI parser turned out to be
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+enum AnsiAction {
+    /// A text or control byte to render
+    Byte(u8),
+    /// A complete CSI sequence with the given final byte
+    Csi(u8),
+    /// Consumed as part of an escape sequence
+    None,
+}
+
+/// Incremental ANSI escape parser
+///
+/// Keeps its state across calls so a sequence split between two writes
+/// is still recognized.
+#[derive(Debug, Clone, Copy)]
+struct AnsiParser {
+    state: AnsiState,
+    params: [u16; ANSI_MAX_PARAMS],
+    nparams: usize,
+}
+
+impl AnsiParser {
+    const fn new() -> Self {
+        Self {
+            state: AnsiState::Ground,
+            params: [0; ANSI_MAX_PARAMS],
+            nparams: 0,
+        }
+    }
+
+    /// Check if the parser is outside any escape sequence
+    #[inline]
+    fn is_ground(&self) -> bool {
+        self.state == AnsiState::Ground
+    }
+
+    /// Get the parameters of the last CSI sequence (missing ones are 0)
+    fn params(&self) -> &[u16] {
+        &self.params[..self.nparams]
+    }
+
+    /// Get parameter `i` of the last CSI sequence, or `default` if absent
+    fn param(&self, i: usize, default: u16) -> u16 {
+        match self.params().get(i) {
+            Some(&0) | None => default,
+            Some(&v) => v,
+        }
+    }
+
+    /// Feed one byte
+    fn feed(&mut self, b: u8) -> AnsiAction {
+        match self.state {
+            AnsiState::Ground => {
+                if b == 0x1B {
+                    self.state = AnsiState::Escape;
+                    AnsiAction::None
+                } else {
+                    AnsiAction::Byte(b)
+                }
+            }
+            AnsiState::Escape => {
+                if b == b'[' {
+                    self.state = AnsiState::Csi;
+                    self.params = [0; ANSI_MAX_PARAMS];
+                    self.nparams = 0;
+                } else {
+                    // Unsupported two-byte escape - drop it
+                    self.state = AnsiState::Ground;
+                }
+                AnsiAction::None
+            }
+            AnsiState::Csi => match b {
+                b'0'..=b'9' => {
+                    if self.nparams == 0 {
+                        self.nparams = 1;
+                    }
+                    if let Some(p) = self.params.get_mut(self.nparams - 1) {
+                        *p = p.saturating_mul(10).saturating_add((b - b'0') as u16);
+                    }
+                    AnsiAction::None
+                }
+                b';' => {
+                    if self.nparams == 0 {
+                        self.nparams = 1;
+                    }
+                    if self.nparams < ANSI_MAX_PARAMS {
+                        self.nparams += 1;
+                    }
+                    AnsiAction::None
+                }
+                0x40..=0x7E => {
+                    self.state = AnsiState::Ground;
+                    AnsiAction::Csi(b)
+                }
+                _ => {
+                    // Private markers ('?') and intermediates - ignored
+                    AnsiAction::None
+                }
+            },
+        }
+    }
+}
+
+/// Check if a byte is rendered as a glyph
+#[inline]
+fn is_printable(b: u8) -> bool {
+    (0x20..=0x7E).contains(&b)
+}
+
+/// Apply the cursor movement of a text or control byte
+///
+/// Shared by the measuring and rendering passes of `write_bytes` so both
+/// agree on how many lines a buffer adds. `y` may be negative while
+/// rendering lines that will already have scrolled off; `top` is the
+/// row backspace may not move above.
+fn advance_cursor(cols: usize, top: isize, x: &mut usize, y: &mut isize, b: u8) {
+    match b {
+        b'\n' => {
+            *y += 1;
+            *x = 0;
+        }
+        b'\r' => {
+            *x = 0;
+        }
+        b'\t' => {
+            *x = (*x + 8) & !7;
+            if *x >= cols {
+                *x = 0;
+                *y += 1;
+            }
+        }
+        b'\x08' => {
+            if *x > 0 {
+                *x -= 1;
+            } else if *y > top {
+                *y -= 1;
+                *x = cols - 1;
+            }
+        }
+        _ if is_printable(b) => {
+            *x += 1;
+            if *x >= cols {
+                *x = 0;
+                *y += 1;
+            }
+        }
+        _ => {
+            // Other control characters - ignored
+        }
+    }
+}
+
 /// Text console with framebuffer backing
 pub struct TextConsole {
     framebuffer: Framebuffer,
@@ -24,8 +237,13 @@ pub struct TextConsole {
     cursor_y: usize,
     fg_color: Color,
     bg_color: Color,
+    default_fg: Color,
+    default_bg: Color,
+    bold: bool,
     cols: usize,
     rows: usize,
+    ansi: AnsiParser,
+    glyphs: GlyphCache,
 }
 
 impl TextConsole {
@@ -43,8 +261,13 @@ impl TextConsole {
             cursor_y: 0,
             fg_color: Color::WHITE,
             bg_color: Color::BLACK,
+            default_fg: Color::WHITE,
+            default_bg: Color::BLACK,
+            bold: false,
             cols,
             rows,
+            ansi: AnsiParser::new(),
+            glyphs: GlyphCache::new(),
         }
     }
 
@@ -59,9 +282,13 @@ impl TextConsole {
     }
 
     /// Set the foreground and background colors
+    ///
+    /// These also become the colors SGR 0/39/49 reset to.
     pub fn set_color(&mut self, fg: Color, bg: Color) {
         self.fg_color = fg;
         self.bg_color = bg;
+        self.default_fg = fg;
+        self.default_bg = bg;
     }
 
     /// Get the cursor position (column, row)
@@ -81,6 +308,7 @@ impl TextConsole {
     pub fn clear(&mut self) {
         unsafe {
             self.framebuffer.clear(self.bg_color);
+            self.framebuffer.flush();
         }
         self.cursor_x = 0;
         self.cursor_y = 0;
@@ -88,90 +316,247 @@ impl TextConsole {
 
     /// Put a single character at the current cursor position
     pub fn put_char(&mut self, ch: u8) {
-        match ch {
-            b'\n' => {
-                // Newline - move to next line
-                self.cursor_y += 1;
-                self.cursor_x = 0;
+        self.write_bytes(core::slice::from_ref(&ch));
+    }
+
+    /// Write a string to the console
+    pub fn write_str(&mut self, s: &str) {
+        self.write_bytes(s.as_bytes());
+    }
+
+    /// Write a buffer of bytes to the console
+    ///
+    /// Each segment is measured first, the screen is scrolled once by the
+    /// number of lines it overflows, and the text is then rendered
+    /// directly at its final rows (lines that would have scrolled off the
+    /// top are skipped rather than drawn). The changes reach the screen in
+    /// one flush at the end.
+    pub fn write_bytes(&mut self, bytes: &[u8]) {
+        let mut rest = bytes;
+
+        while !rest.is_empty() {
+            let (overflow, end) = self.measure(rest);
+            if overflow > 0 {
+                self.scroll_lines(overflow);
             }
-            b'\r' => {
-                // Carriage return - move to start of line
-                self.cursor_x = 0;
+            self.render(&rest[..end], overflow as isize);
+            rest = &rest[end..];
+        }
+
+        unsafe {
+            self.framebuffer.flush();
+        }
+    }
+
+    /// Dry-run a buffer from the current state
+    ///
+    /// Returns the number of lines the segment overflows the screen by and
+    /// the length of the segment, which ends after the first absolute
+    /// cursor move or erase (CSI H/f/J) or at the end of the buffer.
+    fn measure(&self, bytes: &[u8]) -> (usize, usize) {
+        let mut parser = self.ansi;
+        let mut x = self.cursor_x;
+        let mut y = self.cursor_y as isize;
+        let mut max_y = y;
+        let mut end = bytes.len();
+
+        for (i, &b) in bytes.iter().enumerate() {
+            match parser.feed(b) {
+                AnsiAction::Byte(ch) => {
+                    advance_cursor(self.cols, 0, &mut x, &mut y, ch);
+                    max_y = core::cmp::max(max_y, y);
+                }
+                AnsiAction::Csi(b'H' | b'f' | b'J') => {
+                    end = i + 1;
+                    break;
+                }
+                _ => {}
             }
-            b'\t' => {
-                // Tab - move to next tab stop (every 8 columns)
-                self.cursor_x = (self.cursor_x + 8) & !7;
-                if self.cursor_x >= self.cols {
-                    self.cursor_x = 0;
-                    self.cursor_y += 1;
+        }
+
+        let overflow = (max_y - (self.rows as isize - 1)).max(0) as usize;
+        (overflow, end)
+    }
+
+    /// Render a measured segment after the screen was scrolled by `overflow`
+    fn render(&mut self, bytes: &[u8], overflow: isize) {
+        let top = -overflow;
+        let mut x = self.cursor_x;
+        let mut y = self.cursor_y as isize - overflow;
+        let mut i = 0;
+
+        while i < bytes.len() {
+            // Fast path: a run of printable glyphs up to the end of the line
+            if self.ansi.is_ground() && is_printable(bytes[i]) {
+                let limit = core::cmp::min(bytes.len(), i + (self.cols - x));
+                let mut j = i + 1;
+                while j < limit && is_printable(bytes[j]) {
+                    j += 1;
+                }
+
+                if y >= 0 {
+                    self.blit_run(&bytes[i..j], x, y as usize);
+                }
+
+                x += j - i;
+                if x >= self.cols {
+                    x = 0;
+                    y += 1;
                 }
+                i = j;
+                continue;
             }
-            b'\x08' => {
-                // Backspace - move cursor back and clear character
-                if self.cursor_x > 0 {
-                    self.cursor_x -= 1;
-                    self.clear_char_at(self.cursor_x, self.cursor_y);
-                } else if self.cursor_y > 0 {
-                    self.cursor_y -= 1;
-                    self.cursor_x = self.cols - 1;
-                    self.clear_char_at(self.cursor_x, self.cursor_y);
+
+            match self.ansi.feed(bytes[i]) {
+                AnsiAction::Byte(ch) => {
+                    let (old_x, old_y) = (x, y);
+                    advance_cursor(self.cols, top, &mut x, &mut y, ch);
+
+                    // Backspace erases the cell it moved onto
+                    if ch == b'\x08' && (x, y) != (old_x, old_y) && y >= 0 {
+                        self.clear_char_at(x, y as usize);
+                    }
                 }
+                AnsiAction::Csi(final_byte) => {
+                    self.apply_csi(final_byte, &mut x, &mut y);
+                }
+                AnsiAction::None => {}
+            }
+            i += 1;
+        }
+
+        self.cursor_x = x;
+        self.cursor_y = y.clamp(0, self.rows as isize - 1) as usize;
+    }
+
+    /// Execute a complete CSI sequence
+    fn apply_csi(&mut self, final_byte: u8, x: &mut usize, y: &mut isize) {
+        match final_byte {
+            b'm' => self.apply_sgr(),
+            b'H' | b'f' => {
+                // Cursor position (1-based row;col)
+                let row = self.ansi.param(0, 1) as usize;
+                let col = self.ansi.param(1, 1) as usize;
+                *y = (core::cmp::min(row, self.rows) - 1) as isize;
+                *x = core::cmp::min(col, self.cols) - 1;
             }
-            0x20..=0x7E => {
-                // Printable ASCII character
-                self.render_char(ch, self.cursor_x, self.cursor_y);
-                self.cursor_x += 1;
-
-                // Check for line wrap
-                if self.cursor_x >= self.cols {
-                    self.cursor_x = 0;
-                    self.cursor_y += 1;
+            b'J' => {
+                let row = (*y).max(0) as usize;
+                match self.ansi.param(0, 0) {
+                    0 => {
+                        // Cursor to end of screen
+                        self.clear_cells(*x, self.cols, row);
+                        self.clear_rows(row + 1, self.rows);
+                    }
+                    2 | 3 => {
+                        // Whole screen (cursor stays put)
+                        self.clear_rows(0, self.rows);
+                    }
+                    _ => {}
+                }
+            }
+            b'K' => {
+                if *y >= 0 {
+                    let row = *y as usize;
+                    match self.ansi.param(0, 0) {
+                        0 => self.clear_cells(*x, self.cols, row),
+                        1 => self.clear_cells(0, *x + 1, row),
+                        2 => self.clear_cells(0, self.cols, row),
+                        _ => {}
+                    }
                 }
             }
             _ => {
-                // Other control characters - ignore for now
+                // Unsupported CSI sequence - ignored
             }
         }
+    }
 
-        // Check for scroll
-        if self.cursor_y >= self.rows {
-            self.scroll();
-            self.cursor_y = self.rows - 1;
+    /// Apply an SGR (select graphic rendition) sequence
+    fn apply_sgr(&mut self) {
+        let parser = self.ansi;
+        let params = parser.params();
+
+        // "ESC [ m" is the same as "ESC [ 0 m"
+        if params.is_empty() {
+            self.reset_attributes();
+            return;
         }
-    }
 
-    /// Write a string to the console
-    pub fn write_str(&mut self, s: &str) {
-        for &b in s.as_bytes() {
-            self.put_char(b);
+        for &p in params {
+            match p {
+                0 => self.reset_attributes(),
+                1 => self.bold = true,
+                22 => self.bold = false,
+                30..=37 => {
+                    let i = (p - 30) as usize;
+                    self.fg_color = if self.bold { ANSI_BRIGHT_COLORS[i] } else { ANSI_COLORS[i] };
+                }
+                39 => self.fg_color = self.default_fg,
+                40..=47 => self.bg_color = ANSI_COLORS[(p - 40) as usize],
+                49 => self.bg_color = self.default_bg,
+                90..=97 => self.fg_color = ANSI_BRIGHT_COLORS[(p - 90) as usize],
+                100..=107 => self.bg_color = ANSI_BRIGHT_COLORS[(p - 100) as usize],
+                _ => {
+                    // Unsupported attribute - ignored
+                }
+            }
         }
     }
 
-    /// Render a single character at the given position
-    fn render_char(&mut self, ch: u8, col: usize, row: usize) {
-        let char_width = SimpleVgaFont::width();
-        let char_height = SimpleVgaFont::height();
-
-        let x = col * char_width;
-        let y = row * char_height;
+    /// Reset colors and attributes to the console defaults
+    fn reset_attributes(&mut self) {
+        self.fg_color = self.default_fg;
+        self.bg_color = self.default_bg;
+        self.bold = false;
+    }
 
-        // Clear the character cell with background color
-        unsafe {
-            self.framebuffer.fill_rect(
-                x,
-                y,
-                char_width,
-                char_height,
-                self.bg_color,
-            );
+    /// Blit a run of printable glyphs starting at the given cell
+    ///
+    /// The run must fit on the row. Glyph rows come from the cache; on
+    /// 32-bpp framebuffers each scanline of the run is written as whole
+    /// pixels, left to right across all glyphs.
+    fn blit_run(&mut self, run: &[u8], col: usize, row: usize) {
+        let x = col * CELL_WIDTH;
+        let y = row * CELL_HEIGHT;
+        let fb = &mut self.framebuffer;
+        fb.mark_dirty(x, y, run.len() * CELL_WIDTH, CELL_HEIGHT);
+
+        if fb.bpp == 32 {
+            let fg = fb.pixel_value(self.fg_color);
+            let bg = fb.pixel_value(self.bg_color);
+            let diff = fg ^ bg;
+
+            for py in 0..core::cmp::min(CELL_HEIGHT, fb.height - y) {
+                unsafe {
+                    let line = fb.pixel_ptr32(x, y + py);
+                    for (i, &ch) in run.iter().enumerate() {
+                        let bits = self.glyphs.glyph(ch)[py];
+                        let dst = line.add(i * CELL_WIDTH);
+                        for px in 0..CELL_WIDTH {
+                            // Branch-free select: all ones where the bit is set
+                            let mask = 0u32.wrapping_sub(((bits >> (7 - px)) & 1) as u32);
+                            dst.add(px).write(bg ^ (diff & mask));
+                        }
+                    }
+                }
+            }
+            return;
         }
 
-        // Render the character pixels
-        for py in 0..char_height {
-            for px in 0..char_width {
-                if SimpleVgaFont::glyph_pixel(ch, px, py) {
+        // Other depths: per-pixel stores, still from the cached rows
+        for (i, &ch) in run.iter().enumerate() {
+            let glyph = self.glyphs.glyph(ch);
+            let gx = x + i * CELL_WIDTH;
+            for py in 0..CELL_HEIGHT {
+                for px in 0..CELL_WIDTH {
+                    let color = if (glyph[py] >> (7 - px)) & 1 != 0 {
+                        self.fg_color
+                    } else {
+                        self.bg_color
+                    };
                     unsafe {
-                        self.framebuffer.put_pixel(x + px, y + py, self.fg_color);
+                        fb.store_pixel(gx + px, y + py, color);
                     }
                 }
             }
@@ -180,33 +565,54 @@ impl TextConsole {
 
     /// Clear the character at the given position
     fn clear_char_at(&mut self, col: usize, row: usize) {
-        let char_width = SimpleVgaFont::width();
-        let char_height = SimpleVgaFont::height();
-
-        let x = col * char_width;
-        let y = row * char_height;
+        self.clear_cells(col, col + 1, row);
+    }
 
+    /// Clear cells [start, end) of a row with the background color
+    fn clear_cells(&mut self, start: usize, end: usize, row: usize) {
+        if start >= end || row >= self.rows {
+            return;
+        }
         unsafe {
             self.framebuffer.fill_rect(
-                x,
-                y,
-                char_width,
-                char_height,
+                start * CELL_WIDTH,
+                row * CELL_HEIGHT,
+                (end - start) * CELL_WIDTH,
+                CELL_HEIGHT,
                 self.bg_color,
             );
         }
     }
 
-    /// Scroll the console up by one line
-    fn scroll(&mut self) {
+    /// Clear rows [start, end) with the background color
+    fn clear_rows(&mut self, start: usize, end: usize) {
+        if start >= end {
+            return;
+        }
         unsafe {
-            self.framebuffer.scroll(1, SimpleVgaFont::height());
+            self.framebuffer.fill_rect(
+                0,
+                start * CELL_HEIGHT,
+                self.framebuffer.width,
+                (end - start) * CELL_HEIGHT,
+                self.bg_color,
+            );
+        }
+    }
+
+    /// Scroll the console up by `lines` text rows in one framebuffer move
+    fn scroll_lines(&mut self, lines: usize) {
+        if lines >= self.rows {
+            self.clear_rows(0, self.rows);
+            return;
         }
 
-        // Clear the bottom line
-        for col in 0..self.cols {
-            self.clear_char_at(col, self.rows - 1);
+        unsafe {
+            self.framebuffer.scroll(lines, CELL_HEIGHT);
         }
+
+        // Clear the exposed rows
+        self.clear_rows(self.rows - lines, self.rows);
     }
 
     /// Get the number of columns
@@ -234,9 +640,15 @@ impl TextConsole {
 ///
 /// # Safety
 /// This function must be called only once during kernel initialization.
-/// It must be called after the framebuffer has been initialized.
+/// It must be called after the framebuffer has been initialized, and the
+/// framebuffer's addresses must stay mapped for the kernel's lifetime.
+///
+/// It runs as a deferred boot task, possibly on another CPU than the
+/// console's users: they must check [`is_initialized`] first.
 pub unsafe fn init(framebuffer: Framebuffer) {
-    CONSOLE = Some(TextConsole::new(framebuffer));
+    // Built outside the lock: rendering the glyph cache is slow
+    let console = TextConsole::new(framebuffer);
+    *CONSOLE.lock_irqsave() = Some(console);
     CONSOLE_INITIALIZED.store(true, Ordering::Release);
 }
 
@@ -245,51 +657,39 @@ pub fn is_initialized() -> bool {
     CONSOLE_INITIALIZED.load(Ordering::Acquire)
 }
 
+/// Run `f` on the console, if it has been initialized
+fn with_console<R>(f: impl FnOnce(&mut TextConsole) -> R) -> Option<R> {
+    CONSOLE.lock_irqsave().as_mut().map(f)
+}
+
 /// Write a string to the console
 pub fn write_str(s: &str) {
-    unsafe {
-        if let Some(ref mut console) = CONSOLE {
-            console.write_str(s);
-        }
-    }
+    with_console(|console| console.write_str(s));
+}
+
+/// Write a buffer of bytes to the console (bulk path for sys_write)
+pub fn write_bytes(bytes: &[u8]) {
+    with_console(|console| console.write_bytes(bytes));
 }
 
 /// Write a single character to the console
 pub fn put_char(ch: u8) {
-    unsafe {
-        if let Some(ref mut console) = CONSOLE {
-            console.put_char(ch);
-        }
-    }
+    with_console(|console| console.put_char(ch));
 }
 
 /// Clear the console
 pub fn clear() {
-    unsafe {
-        if let Some(ref mut console) = CONSOLE {
-            console.clear();
-        }
-    }
+    with_console(|console| console.clear());
 }
 
 /// Set the console colors
 pub fn set_color(fg: Color, bg: Color) {
-    unsafe {
-        if let Some(ref mut console) = CONSOLE {
-            console.set_color(fg, bg);
-        }
-    }
+    with_console(|console| console.set_color(fg, bg));
 }
 
 /// Get the console colors
 pub fn get_color() -> (Color, Color) {
-    unsafe {
-        if let Some(ref console) = CONSOLE {
-            (console.fg_color(), console.bg_color())
-        } else {
-            (Color::WHITE, Color::BLACK)
-        }
-    }
+    with_console(|console| (console.fg_color(), console.bg_color())).unwrap_or((Color::WHITE, Color::BLACK))
 }
 
 #[cfg(test)]
@@ -300,4 +700,37 @@ mod tests {
     fn test_initialized_flag() {
         assert!(!is_initialized());
     }
+
+    #[test]
+    fn test_ansi_parser_sgr() {
+        let mut p = AnsiParser::new();
+        let mut actions = [AnsiAction::None; 7];
+        for (a, &b) in actions.iter_mut().zip(b"\x1b[1;31mA") {
+            *a = p.feed(b);
+        }
+        assert_eq!(actions[6], AnsiAction::Csi(b'm'));
+        assert_eq!(p.params(), &[1, 31]);
+        assert_eq!(p.feed(b'A'), AnsiAction::Byte(b'A'));
+    }
+
+    #[test]
+    fn test_ansi_parser_split_sequence() {
+        // A sequence split across two writes is still recognized
+        let mut p = AnsiParser::new();
+        for &b in b"\x1b[2" {
+            assert_eq!(p.feed(b), AnsiAction::None);
+        }
+        assert_eq!(p.feed(b'J'), AnsiAction::Csi(b'J'));
+        assert_eq!(p.param(0, 0), 2);
+        assert!(p.is_ground());
+    }
+
+    #[test]
+    fn test_advance_cursor_wraps() {
+        let (mut x, mut y) = (79usize, 0isize);
+        advance_cursor(80, 0, &mut x, &mut y, b'a');
+        assert_eq!((x, y), (0, 1));
+        advance_cursor(80, 0, &mut x, &mut y, b'\x08');
+        assert_eq!((x, y), (79, 0));
+    }
 }
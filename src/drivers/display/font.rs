@@ -174,6 +174,12 @@ impl SimpleVgaFont {
         (font_data[y] & bit_mask) != 0
     }
 
+    /// Get the glyph bitmap for a character (one byte per row, MSB is the
+    /// leftmost pixel)
+    pub fn glyph_rows(ch: u8) -> [u8; 16] {
+        Self::get_glyph_data(ch)
+    }
+
     /// Get the glyph data for a character
     fn get_glyph_data(ch: u8) -> [u8; 16] {
         // Very simple 8x16 bitmap font for a few characters
@@ -257,6 +263,35 @@ impl SimpleVgaFont {
     }
 }
 
+/// Pre-rendered glyph bitmaps for SimpleVgaFont
+///
+/// `SimpleVgaFont::glyph_pixel` resolves the glyph on every pixel; the
+/// console instead looks each glyph up once here and blits whole rows.
+/// Covers the 7-bit range only; the console renders printable ASCII.
+pub struct GlyphCache {
+    glyphs: [[u8; 16]; GlyphCache::GLYPHS],
+}
+
+impl GlyphCache {
+    /// Number of cached glyphs
+    pub const GLYPHS: usize = 128;
+
+    /// Render every glyph of SimpleVgaFont into the cache
+    pub fn new() -> Self {
+        let mut glyphs = [[0u8; 16]; Self::GLYPHS];
+        for (ch, rows) in glyphs.iter_mut().enumerate() {
+            *rows = SimpleVgaFont::glyph_rows(ch as u8);
+        }
+        Self { glyphs }
+    }
+
+    /// Get the row bitmaps for a character
+    #[inline]
+    pub fn glyph(&self, ch: u8) -> &[u8; 16] {
+        &self.glyphs[(ch as usize) & (Self::GLYPHS - 1)]
+    }
+}
+
 #[cfg(test)]
 mod tests {
     use super::*;
@@ -290,6 +325,19 @@ mod tests {
         }
     }
 
+    #[test]
+    fn test_glyph_cache_matches_font() {
+        let cache = GlyphCache::new();
+        for ch in [b'A', b'C', b' ', b'z'] {
+            for y in 0..16 {
+                for x in 0..8 {
+                    let bit = (cache.glyph(ch)[y] >> (7 - x)) & 1 != 0;
+                    assert_eq!(bit, SimpleVgaFont::glyph_pixel(ch, x, y));
+                }
+            }
+        }
+    }
+
     #[test]
     fn test_simple_vga_font_bounds() {
         // Out of bounds pixels should always be false
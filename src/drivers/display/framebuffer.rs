@@ -8,6 +8,16 @@
 //!
 //! This module provides framebuffer management for text console output.
 //! The framebuffer is typically obtained from UEFI Graphics Output Protocol (GOP).
+//!
+//! # Back Buffer
+//!
+//! Framebuffer memory is uncached (or at best write-combining), so reads
+//! from it are very slow, and a scroll that moves the screen contents in
+//! place reads every pixel. With [`Framebuffer::attach_back_buffer`] all
+//! drawing, scrolling included, goes to a copy in ordinary cached RAM
+//! instead. Drawing calls record the bounding rectangle they touched,
+//! and [`Framebuffer::flush`] copies just that rectangle to the screen:
+//! the framebuffer itself is then only ever written, in whole rows.
 
 /// Pixel format supported by the framebuffer
 #[derive(Debug, Clone, Copy, PartialEq, Eq)]
@@ -68,10 +78,43 @@ impl Color {
     }
 }
 
+/// A rectangle of pixels, [x0, x1) x [y0, y1)
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+pub struct DirtyRect {
+    pub x0: usize,
+    pub y0: usize,
+    pub x1: usize,
+    pub y1: usize,
+}
+
+impl DirtyRect {
+    /// The empty rectangle
+    pub const EMPTY: DirtyRect = DirtyRect { x0: usize::MAX, y0: usize::MAX, x1: 0, y1: 0 };
+
+    /// Check if the rectangle covers no pixels
+    pub const fn is_empty(&self) -> bool {
+        self.x0 >= self.x1 || self.y0 >= self.y1
+    }
+
+    /// Grow the rectangle to cover [x0, x1) x [y0, y1) as well
+    pub fn add(&mut self, x0: usize, y0: usize, x1: usize, y1: usize) {
+        if x0 >= x1 || y0 >= y1 {
+            return;
+        }
+        self.x0 = self.x0.min(x0);
+        self.y0 = self.y0.min(y0);
+        self.x1 = self.x1.max(x1);
+        self.y1 = self.y1.max(y1);
+    }
+}
+
 /// Framebuffer information and management
 pub struct Framebuffer {
-    /// Base physical address of framebuffer
+    /// Base address drawing goes to: the back buffer if one is attached,
+    /// else the framebuffer itself
     pub base_addr: u64,
+    /// Address of the visible framebuffer
+    pub front_addr: u64,
     /// Width in pixels
     pub width: usize,
     /// Height in pixels
@@ -82,6 +125,8 @@ pub struct Framebuffer {
     pub bpp: usize,
     /// Pixel format
     pub format: PixelFormat,
+    /// Pixels drawn to the back buffer since the last flush
+    dirty: DirtyRect,
 }
 
 impl Framebuffer {
@@ -96,11 +141,77 @@ impl Framebuffer {
     ) -> Self {
         Self {
             base_addr,
+            front_addr: base_addr,
             width,
             height,
             pitch,
             bpp,
             format,
+            dirty: DirtyRect::EMPTY,
+        }
+    }
+
+    /// Draw to a back buffer instead of the framebuffer
+    ///
+    /// The back buffer starts as a copy of the screen (the only time the
+    /// framebuffer is read), and must be at least [`size`](Self::size)
+    /// bytes. Until [`flush`](Self::flush), drawing is not visible.
+    ///
+    /// # Safety
+    /// `back` must be valid, writable kernel memory of at least `size()`
+    /// bytes that nothing else uses, for as long as the framebuffer lives.
+    pub unsafe fn attach_back_buffer(&mut self, back: u64) {
+        core::ptr::copy_nonoverlapping(self.front_addr as *const u8, back as *mut u8, self.size());
+        self.base_addr = back;
+        self.dirty = DirtyRect::EMPTY;
+    }
+
+    /// Check if drawing goes to a back buffer
+    pub fn has_back_buffer(&self) -> bool {
+        self.base_addr != self.front_addr
+    }
+
+    /// Record that drawing touched [x, x + w) x [y, y + h)
+    ///
+    /// The drawing calls of this type record what they touch themselves;
+    /// callers that store through [`pixel_ptr32`](Self::pixel_ptr32) or
+    /// [`store_pixel`](Self::store_pixel) must call this.
+    #[inline]
+    pub fn mark_dirty(&mut self, x: usize, y: usize, w: usize, h: usize) {
+        let x1 = core::cmp::min(x.saturating_add(w), self.width);
+        let y1 = core::cmp::min(y.saturating_add(h), self.height);
+        self.dirty.add(x, y, x1, y1);
+    }
+
+    /// Get the pixels drawn since the last flush
+    pub fn dirty(&self) -> DirtyRect {
+        self.dirty
+    }
+
+    /// Copy the pixels drawn since the last flush to the screen
+    ///
+    /// Each dirty row span is one forward copy, which write-combining
+    /// turns into full-line bursts. A no-op without a back buffer.
+    ///
+    /// # Safety
+    /// The caller must ensure that the framebuffer memory is valid and accessible.
+    pub unsafe fn flush(&mut self) {
+        let dirty = self.dirty;
+        self.dirty = DirtyRect::EMPTY;
+        if dirty.is_empty() || !self.has_back_buffer() {
+            return;
+        }
+
+        let bytes_pp = self.bpp / 8;
+        let start = dirty.x0 * bytes_pp;
+        let len = (dirty.x1 - dirty.x0) * bytes_pp;
+        for y in dirty.y0..dirty.y1 {
+            let offset = y * self.pitch + start;
+            core::ptr::copy_nonoverlapping(
+                (self.base_addr as *const u8).add(offset),
+                (self.front_addr as *mut u8).add(offset),
+                len,
+            );
         }
     }
 
@@ -117,11 +228,48 @@ impl Framebuffer {
         Some(y * self.pitch + x * (self.bpp / 8))
     }
 
+    /// Pack a color into the native 32-bit pixel value
+    ///
+    /// Matches the byte layout `put_pixel` writes for 32-bpp modes, so
+    /// bulk paths can store whole pixels at once.
+    pub const fn pixel_value(&self, color: Color) -> u32 {
+        match self.format {
+            PixelFormat::RGB => {
+                0xFF000000 | ((color.r as u32) << 16) | ((color.g as u32) << 8) | (color.b as u32)
+            }
+            PixelFormat::BGR => {
+                0xFF000000 | ((color.b as u32) << 16) | ((color.g as u32) << 8) | (color.r as u32)
+            }
+        }
+    }
+
+    /// Get a pointer to the 32-bit pixel at (x, y)
+    ///
+    /// Stores through it are not recorded: see [`mark_dirty`](Self::mark_dirty).
+    ///
+    /// # Safety
+    /// The framebuffer must be 32 bpp and (x, y) must be on screen.
+    #[inline]
+    pub unsafe fn pixel_ptr32(&self, x: usize, y: usize) -> *mut u32 {
+        (self.base_addr as *mut u8).add(y * self.pitch + x * 4) as *mut u32
+    }
+
     /// Put a single pixel at the given position
     ///
     /// # Safety
     /// The caller must ensure that the framebuffer memory is valid and accessible.
     pub unsafe fn put_pixel(&mut self, x: usize, y: usize, color: Color) {
+        self.store_pixel(x, y, color);
+        self.mark_dirty(x, y, 1, 1);
+    }
+
+    /// Put a single pixel without recording it as dirty
+    ///
+    /// For loops that draw a known rectangle and mark it once.
+    ///
+    /// # Safety
+    /// The caller must ensure that the framebuffer memory is valid and accessible.
+    pub unsafe fn store_pixel(&mut self, x: usize, y: usize, color: Color) {
         if let Some(offset) = self.pixel_offset(x, y) {
             let fb_ptr = self.base_addr as *mut u8;
 
@@ -175,9 +323,28 @@ impl Framebuffer {
         h: usize,
         color: Color,
     ) {
-        for py in y..core::cmp::min(y + h, self.height) {
-            for px in x..core::cmp::min(x + w, self.width) {
-                self.put_pixel(px, py, color);
+        let x_end = core::cmp::min(x + w, self.width);
+        let y_end = core::cmp::min(y + h, self.height);
+        if x >= x_end || y >= y_end {
+            return;
+        }
+        self.mark_dirty(x, y, x_end - x, y_end - y);
+
+        if self.bpp == 32 {
+            // Whole-pixel stores instead of per-byte put_pixel
+            let value = self.pixel_value(color);
+            for py in y..y_end {
+                let row = self.pixel_ptr32(x, py);
+                for i in 0..x_end - x {
+                    row.add(i).write(value);
+                }
+            }
+            return;
+        }
+
+        for py in y..y_end {
+            for px in x..x_end {
+                self.store_pixel(px, py, color);
             }
         }
     }
@@ -192,6 +359,9 @@ impl Framebuffer {
 
     /// Scroll the framebuffer up by the specified number of lines
     ///
+    /// With a back buffer the move is a memmove in cached RAM (and the
+    /// whole screen becomes dirty); without one it reads the framebuffer.
+    ///
     /// # Arguments
     /// * `lines` - Number of lines to scroll
     /// * `char_height` - Height of a character cell in pixels (for line height)
@@ -207,18 +377,16 @@ impl Framebuffer {
             return;
         }
 
-        // Move pixels up
+        // Move pixels up (one overlapping copy of the retained rows)
         let fb_ptr = self.base_addr as *mut u8;
         let row_size = self.pitch;
 
-        for y in scroll_pixels..self.height {
-            let src_offset = y * row_size;
-            let dst_offset = (y - scroll_pixels) * row_size;
-
-            for x in 0..row_size {
-                *fb_ptr.add(dst_offset + x) = *fb_ptr.add(src_offset + x);
-            }
-        }
+        core::ptr::copy(
+            fb_ptr.add(scroll_pixels * row_size),
+            fb_ptr,
+            (self.height - scroll_pixels) * row_size,
+        );
+        self.mark_dirty(0, 0, self.width, self.height - scroll_pixels);
 
         // Clear the bottom area
         let clear_start = self.height - scroll_pixels;
@@ -320,6 +488,45 @@ mod tests {
         assert_eq!(fb.size(), 768 * 4096);
     }
 
+    #[test]
+    fn test_pixel_value_matches_byte_order() {
+        let c = Color::new(0x11, 0x22, 0x33);
+        let rgb = Framebuffer::new(0, 1, 1, 4, 32, PixelFormat::RGB);
+        let bgr = Framebuffer::new(0, 1, 1, 4, 32, PixelFormat::BGR);
+
+        // put_pixel stores b, g, r (RGB) or r, g, b (BGR), then alpha
+        assert_eq!(rgb.pixel_value(c).to_le_bytes(), [0x33, 0x22, 0x11, 0xFF]);
+        assert_eq!(bgr.pixel_value(c).to_le_bytes(), [0x11, 0x22, 0x33, 0xFF]);
+    }
+
+    #[test]
+    fn test_back_buffer_flush() {
+        let mut front = alloc::vec![0u32; 16 * 4];
+        let mut back = alloc::vec![0u32; 16 * 4];
+        let mut fb = Framebuffer::new(front.as_mut_ptr() as u64, 16, 4, 64, 32, PixelFormat::RGB);
+        unsafe {
+            fb.attach_back_buffer(back.as_mut_ptr() as u64);
+            fb.fill_rect(2, 1, 3, 2, Color::WHITE);
+        }
+        assert_eq!(fb.dirty(), DirtyRect { x0: 2, y0: 1, x1: 5, y1: 3 });
+        // Nothing reaches the screen before the flush
+        assert!(front.iter().all(|&p| p == 0));
+
+        unsafe { fb.flush() };
+        assert!(fb.dirty().is_empty());
+        assert_eq!(front, back);
+        assert_eq!(front.iter().filter(|&&p| p != 0).count(), 6);
+    }
+
+    #[test]
+    fn test_scroll_marks_retained_rows() {
+        let mut back = alloc::vec![0u32; 16 * 4];
+        let mut fb = Framebuffer::new(back.as_mut_ptr() as u64, 16, 4, 64, 32, PixelFormat::RGB);
+        unsafe { fb.scroll(1, 1) };
+        // Rows 0-2 were moved, row 3 was cleared
+        assert_eq!(fb.dirty(), DirtyRect { x0: 0, y0: 0, x1: 16, y1: 4 });
+    }
+
     #[test]
     fn test_pixel_offset_valid() {
         let fb = Framebuffer::new(0xE0000000, 1024, 768, 4096, 32, PixelFormat::RGB);
@@ -14,6 +14,6 @@ pub mod font;
 pub mod console;
 
 // Re-exports
-pub use framebuffer::{Framebuffer, Color, PixelFormat};
-pub use font::{Psf2Font, SimpleVgaFont};
-pub use console::{TextConsole, init, write_str, put_char, clear, set_color, get_color, is_initialized};
+pub use framebuffer::{Framebuffer, Color, DirtyRect, PixelFormat};
+pub use font::{GlyphCache, Psf2Font, SimpleVgaFont};
+pub use console::{TextConsole, init, write_str, write_bytes, put_char, clear, set_color, get_color, is_initialized};
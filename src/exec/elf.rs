@@ -9,6 +9,10 @@
 //! This module provides ELF (Executable and Linkable Format) binary loading
 //! for x86_64 executables. It parses ELF files and maps them into process
 //! address spaces using Virtual Memory Objects (VMOs).
+//!
+//! [`load_elf`] copies every segment in up front. [`load_elf_demand`]
+//! only records where each segment's bytes are, for files that stay in
+//! memory (the ramdisk): pages are filled on first touch.
 
 #![allow(dead_code)]
 
@@ -48,6 +52,12 @@ pub const PF_X: u32 = 0x1; // Execute
 pub const PF_W: u32 = 0x2; // Write
 pub const PF_R: u32 = 0x4; // Read
 
+/// User stack top address
+pub const USER_STACK_TOP: u64 = 0x7fff_ffff_f000;
+
+/// User stack size (4KB stack for testing, was 8MB)
+pub const USER_STACK_SIZE: u64 = 4 * 1024;
+
 // ============================================================================
 // ELF File Structures
 // ============================================================================
@@ -105,6 +115,8 @@ pub struct LoadedSegment {
     pub size: u64,             // Size in memory
     pub vmo: Box<Vmo>,         // VMO containing the segment data (boxed for stable address)
     pub flags: u32,            // PF_R | PF_W | PF_X
+    pub data: &'static [u8],   // File bytes (demand-loaded images only)
+    pub data_offset: u64,      // Offset of `data` from vaddr
 }
 
 /// Loaded ELF binary information
@@ -113,6 +125,7 @@ pub struct LoadedElf {
     pub segments: Vec<LoadedSegment>, // Loaded segments
     pub stack_addr: u64,        // Stack top address
     pub stack_size: u64,        // Stack size
+    pub demand: bool,           // Segment VMOs are filled on first touch
 }
 
 // ============================================================================
@@ -515,6 +528,8 @@ pub fn load_elf(elf_data: &[u8]) -> Result<Box<LoadedElf>, &'static str> {
             size: mem_size,
             vmo: boxed_vmo,
             flags: p_flags,
+            data: &[],
+            data_offset: 0,
         });
 
         unsafe {
@@ -548,8 +563,8 @@ pub fn load_elf(elf_data: &[u8]) -> Result<Box<LoadedElf>, &'static str> {
     }
 
     // Set up user stack
-    let stack_addr = 0x7fff_ffff_f000u64;
-    let stack_size = 4 * 1024; // 4KB stack for testing (was 8MB)
+    let stack_addr = USER_STACK_TOP;
+    let stack_size = USER_STACK_SIZE;
 
     unsafe {
         let msg = b"[ELF] About to Box LoadedElf\n";
@@ -615,6 +630,7 @@ pub fn load_elf(elf_data: &[u8]) -> Result<Box<LoadedElf>, &'static str> {
         segments,
         stack_addr,
         stack_size,
+        demand: false,
     });
 
     unsafe {
@@ -649,6 +665,68 @@ pub fn load_elf(elf_data: &[u8]) -> Result<Box<LoadedElf>, &'static str> {
     Ok(boxed)
 }
 
+/// Load an ELF binary for demand paging
+///
+/// Parses and validates the file like [`load_elf`], but reads and
+/// allocates nothing: each LOAD segment gets an empty VMO and a reference
+/// to its bytes in `elf_data`. Segments are widened to whole pages, so
+/// `vaddr` is page-aligned and the bytes start `data_offset` into it.
+///
+/// # Arguments
+///
+/// * `elf_data` - Raw ELF file contents, which must stay in memory
+///
+/// # Returns
+///
+/// * `Ok(Box<LoadedElf>)` - ELF with `demand` set (see `instantiate_image`)
+/// * `Err(&str)` - Error loading ELF
+pub fn load_elf_demand(elf_data: &'static [u8]) -> Result<Box<LoadedElf>, &'static str> {
+    let header = parse_elf_header(elf_data)?;
+    validate_elf_header(&header)?;
+
+    let prog_headers = parse_program_headers(elf_data, header.e_phoff, header.e_phentsize, header.e_phnum);
+
+    let mut segments = Vec::new();
+    for ph in prog_headers.iter().filter(|ph| ph.p_type == PT_LOAD) {
+        // Skip zero-size segments (alignment segments, etc.)
+        let mem_size = ph.p_memsz.max(ph.p_filesz);
+        if mem_size == 0 {
+            continue;
+        }
+
+        let data: &'static [u8] = if ph.p_filesz > 0 {
+            let file_end = ph.p_offset.checked_add(ph.p_filesz)
+                .filter(|&end| end <= elf_data.len() as u64)
+                .ok_or("Segment extends beyond file size")?;
+            &elf_data[ph.p_offset as usize..file_end as usize]
+        } else {
+            &[]
+        };
+
+        let data_offset = ph.p_vaddr & 0xFFF;
+        let size = (data_offset + mem_size + 0xFFF) & !0xFFF;
+        let vmo = Vmo::create(size as usize, elf_flags_to_vmo_flags(ph.p_flags))
+            .map_err(|_| "Failed to create VMO")?;
+
+        segments.push(LoadedSegment {
+            vaddr: ph.p_vaddr - data_offset,
+            size,
+            vmo: Box::new(vmo),
+            flags: ph.p_flags,
+            data,
+            data_offset,
+        });
+    }
+
+    Ok(Box::new(LoadedElf {
+        entry: header.e_entry,
+        segments,
+        stack_addr: USER_STACK_TOP,
+        stack_size: USER_STACK_SIZE,
+        demand: true,
+    }))
+}
+
 /// Check if data looks like an ELF file
 ///
 /// # Arguments
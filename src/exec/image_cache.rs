@@ -0,0 +1,66 @@
+// Copyright 2025 The Rustux Authors
+//
+// Use of this source code is governed by a MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT
+
+//! Program Image Cache
+//!
+//! The first spawn of a ramdisk program parses its ELF file once (see
+//! [`load_elf_demand`]). The result is kept, keyed by ramdisk inode, and
+//! every spawn of the program builds its address space from it with
+//! [`instantiate_image`]. Pages are only populated when touched:
+//!
+//! - Read-only segments (text, rodata) are shared: all instances run from
+//!   the same physical pages, filled by whichever touches a page first
+//! - Writable segments (data, bss) get private pages, filled from the
+//!   file or zeroed, so the ELF is never re-parsed
+//!
+//! Ramdisk files are immutable, so cached images never go stale and are
+//! never evicted.
+
+use alloc::boxed::Box;
+use alloc::collections::BTreeMap;
+
+use crate::exec::elf::{load_elf_demand, LoadedElf};
+use crate::exec::process_loader::{instantiate_image, ProcessImage};
+use crate::sync::SpinMutex;
+
+/// Loaded program images, by ramdisk inode
+static IMAGES: SpinMutex<BTreeMap<u32, Box<LoadedElf>>> = SpinMutex::new(BTreeMap::new());
+
+/// Get the cached image of a ramdisk program, loading it on first use
+///
+/// # Arguments
+///
+/// * `inode` - Ramdisk inode (file index) of the program
+/// * `elf_data` - Contents of that file
+fn cached_image(inode: u32, elf_data: &'static [u8]) -> Result<&'static LoadedElf, &'static str> {
+    // Held across the first load, so concurrent spawns of a new program
+    // load it once
+    let mut images = IMAGES.lock();
+
+    if !images.contains_key(&inode) {
+        let image = load_elf_demand(elf_data)?;
+        images.insert(inode, image);
+    }
+
+    let image: *const LoadedElf = &**images.get(&inode).ok_or("image cache insert failed")?;
+    // Entries are boxed and never removed, so they outlive the lock
+    Ok(unsafe { &*image })
+}
+
+/// Load a ramdisk program into a new process
+///
+/// Same result as [`load_elf_process`](crate::exec::load_elf_process),
+/// but the ELF is only parsed the first time a given inode is spawned,
+/// and segments are demand-paged.
+pub fn load_cached_process(inode: u32, elf_data: &'static [u8]) -> Result<ProcessImage, &'static str> {
+    let image = cached_image(inode, elf_data)?;
+    instantiate_image(image)
+}
+
+/// Number of cached program images
+pub fn cached_image_count() -> usize {
+    IMAGES.lock().len()
+}
@@ -10,6 +10,7 @@
 //! ELF binaries in userspace.
 
 pub mod elf;
+pub mod image_cache;
 pub mod process_loader;
 pub mod userspace_exec_test;
 
@@ -24,11 +25,13 @@ pub use elf::{
     parse_program_headers,
     validate_elf_header,
     load_elf,
+    load_elf_demand,
     is_elf_file,
 };
 
 // Re-export process loader types
-pub use process_loader::{ProcessImage, load_elf_process};
+pub use process_loader::{ProcessImage, load_elf_process, instantiate_image};
+pub use image_cache::{load_cached_process, cached_image_count};
 
 // Re-export userspace test
 pub use userspace_exec_test::test_userspace_execution;
@@ -11,8 +11,9 @@
 
 #![allow(dead_code)]
 
-use crate::exec::elf::{load_elf, LoadedElf};
+use crate::exec::elf::{load_elf, LoadedElf, PF_W};
 use crate::process::AddressSpace;
+use crate::process::address_space::{PageSource, Region};
 use crate::object::{Vmo, VmoFlags};
 use crate::mm::pmm;
 
@@ -91,6 +92,77 @@ pub fn load_elf_process(elf_data: &[u8]) -> Result<ProcessImage, &'static str> {
         )?;
     }
 
+    map_user_stack(&address_space, &loaded_elf)?;
+
+    Ok(ProcessImage {
+        entry: loaded_elf.entry,
+        address_space,
+        stack_top: loaded_elf.stack_addr,
+        stack_size: loaded_elf.stack_size,
+    })
+}
+
+/// Build a new process from an already loaded ELF image
+///
+/// Read-only segments are mapped straight from the image's VMOs, so every
+/// process built from one image shares those pages. Writable segments are
+/// mapped from a copy-on-write clone, so a process only copies the pages
+/// it writes. The image itself is left untouched and can be instantiated
+/// again.
+///
+/// The segments of a demand-loaded image (`load_elf_demand`) are
+/// registered as regions instead, and nothing is copied: read-only ones
+/// fill the shared VMO on first touch, writable ones get private pages
+/// filled from the file.
+///
+/// # Arguments
+///
+/// * `image` - Loaded ELF, normally from the program image cache
+///
+/// # Returns
+///
+/// * `Ok(ProcessImage)` - Loaded process ready to execute
+/// * `Err(&str)` - Loading failed
+pub fn instantiate_image(image: &'static LoadedElf) -> Result<ProcessImage, &'static str> {
+    let address_space = AddressSpace::new()
+        .map_err(|_| "Failed to create address space")?;
+
+    for segment in image.segments.iter() {
+        if image.demand {
+            let source = if segment.flags & PF_W == 0 {
+                PageSource::Shared(&segment.vmo)
+            } else {
+                PageSource::Private
+            };
+            address_space.add_region(Region {
+                vaddr: segment.vaddr,
+                size: segment.size,
+                flags: segment.flags,
+                data: segment.data,
+                data_offset: segment.data_offset,
+                source,
+            })?;
+        } else if segment.flags & PF_W == 0 {
+            address_space.map_vmo(&segment.vmo, segment.vaddr, segment.size, segment.flags)?;
+        } else {
+            let private = segment.vmo.clone()
+                .map_err(|_| "Failed to clone writable segment")?;
+            address_space.map_vmo(&private, segment.vaddr, segment.size, segment.flags)?;
+        }
+    }
+
+    map_user_stack(&address_space, image)?;
+
+    Ok(ProcessImage {
+        entry: image.entry,
+        address_space,
+        stack_top: image.stack_addr,
+        stack_size: image.stack_size,
+    })
+}
+
+/// Create, populate and map the user stack described by a loaded ELF
+fn map_user_stack(address_space: &AddressSpace, loaded_elf: &LoadedElf) -> Result<(), &'static str> {
     // Create and map the stack
     let stack_vmo = Vmo::create(loaded_elf.stack_size as usize, VmoFlags::empty)
         .map_err(|_| "Failed to create stack VMO")?;
@@ -123,12 +195,5 @@ pub fn load_elf_process(elf_data: &[u8]) -> Result<ProcessImage, &'static str> {
         stack_bottom,
         loaded_elf.stack_size,
         0x6, // PF_R | PF_W (readable + writable)
-    ).map_err(|_| "Failed to map stack")?;
-
-    Ok(ProcessImage {
-        entry: loaded_elf.entry,
-        address_space,
-        stack_top: loaded_elf.stack_addr,
-        stack_size: loaded_elf.stack_size,
-    })
+    ).map_err(|_| "Failed to map stack")
 }
@@ -0,0 +1,160 @@
+// Copyright 2025 The Rustux Authors
+//
+// Use of this source code is governed by a MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT
+
+//! LZ4 Block Decompression
+//!
+//! Decoder for the LZ4 block format, used for compressed ramdisk files
+//! (build.rs has the matching compressor). A block is a series of
+//! sequences, each a token byte, literal bytes and a back-reference:
+//!
+//! ```text
+//! token: literal length (high nibble) | match length - 4 (low nibble)
+//! [literal length continuation: 255, 255, ..., < 255]
+//! literals
+//! match offset (u16, little-endian, 1..=65535 bytes back)
+//! [match length continuation]
+//! ```
+//!
+//! The last sequence ends after its literals. Every read and write is
+//! bounds-checked, so a corrupt block fails instead of overrunning.
+
+/// Shortest match the format encodes
+const MIN_MATCH: usize = 4;
+
+/// Read a length continuation (bytes added while they are 255)
+fn read_length(src: &[u8], pos: &mut usize, mut len: usize) -> Result<usize, &'static str> {
+    loop {
+        let byte = *src.get(*pos).ok_or("truncated length")?;
+        *pos += 1;
+        len += byte as usize;
+        if byte != 255 {
+            return Ok(len);
+        }
+    }
+}
+
+/// Decompress an LZ4 block
+///
+/// # Arguments
+///
+/// * `src` - Compressed block
+/// * `dst` - Output buffer, exactly the uncompressed size
+///
+/// # Returns
+///
+/// The number of bytes produced (always `dst.len()`), or an error if the
+/// block is corrupt or decodes to a different size
+pub fn decompress(src: &[u8], dst: &mut [u8]) -> Result<usize, &'static str> {
+    let mut ip = 0;
+    let mut op = 0;
+
+    loop {
+        let token = *src.get(ip).ok_or("truncated block")?;
+        ip += 1;
+
+        // Literals
+        let mut literals = (token >> 4) as usize;
+        if literals == 15 {
+            literals = read_length(src, &mut ip, literals)?;
+        }
+        let lit_src = src.get(ip..ip + literals).ok_or("literals past end of block")?;
+        let lit_dst = dst.get_mut(op..op + literals).ok_or("output overflow")?;
+        lit_dst.copy_from_slice(lit_src);
+        ip += literals;
+        op += literals;
+
+        // The last sequence has no match
+        if ip == src.len() {
+            break;
+        }
+
+        // Match
+        let offset = match src.get(ip..ip + 2) {
+            Some(bytes) => u16::from_le_bytes([bytes[0], bytes[1]]) as usize,
+            None => return Err("truncated match offset"),
+        };
+        ip += 2;
+        if offset == 0 || offset > op {
+            return Err("match offset out of range");
+        }
+
+        let mut len = (token & 0xF) as usize;
+        if len == 15 {
+            len = read_length(src, &mut ip, len)?;
+        }
+        len += MIN_MATCH;
+        if op + len > dst.len() {
+            return Err("output overflow");
+        }
+
+        let from = op - offset;
+        if offset >= len {
+            dst.copy_within(from..from + len, op);
+        } else {
+            // Overlapping: the match repeats bytes it is producing
+            for i in 0..len {
+                dst[op + i] = dst[from + i];
+            }
+        }
+        op += len;
+    }
+
+    if op != dst.len() {
+        return Err("block shorter than its size");
+    }
+    Ok(op)
+}
+
+/// ============================================================================
+/// Tests
+/// ============================================================================
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    #[test]
+    fn test_literals_only() {
+        let block = [0x50, b'h', b'e', b'l', b'l', b'o'];
+        let mut out = [0u8; 5];
+        assert_eq!(decompress(&block, &mut out), Ok(5));
+        assert_eq!(&out, b"hello");
+    }
+
+    #[test]
+    fn test_overlapping_match() {
+        // "ab", then a 10-byte match 2 back, then literal "!"
+        let block = [0x26, b'a', b'b', 0x02, 0x00, 0x10, b'!'];
+        let mut out = [0u8; 13];
+        assert_eq!(decompress(&block, &mut out), Ok(13));
+        assert_eq!(&out, b"abababababab!");
+    }
+
+    #[test]
+    fn test_long_lengths() {
+        // 20 literals (15 + 5), then a 4 + 15 + 255 + 1 byte run of 'z'
+        let mut block = alloc::vec![0xFF, 5];
+        block.extend_from_slice(&[b'z'; 20]);
+        block.extend_from_slice(&[0x01, 0x00, 255, 1]);
+        block.push(0x00);
+        let mut out = alloc::vec![0u8; 20 + 275];
+        assert_eq!(decompress(&block, &mut out), Ok(295));
+        assert!(out.iter().all(|&b| b == b'z'));
+    }
+
+    #[test]
+    fn test_corrupt_blocks() {
+        let mut out = [0u8; 8];
+        // Offset reaching before the start of the output
+        assert!(decompress(&[0x10, b'a', 0x02, 0x00, 0x00], &mut out).is_err());
+        // Literals running past the block
+        assert!(decompress(&[0x50, b'a'], &mut out).is_err());
+        // Output larger than the buffer
+        assert!(decompress(&[0x90, 0, 0, 0, 0, 0, 0, 0, 0, 0], &mut out).is_err());
+        // Output smaller than the buffer
+        assert!(decompress(&[0x10, b'a'], &mut out).is_err());
+    }
+}
@@ -8,11 +8,14 @@
 //!
 //! This module provides filesystem functionality for the Rustux kernel.
 //! It includes:
-//! - Ramdisk (embedded read-only filesystem)
+//! - Ramdisk (embedded read-only filesystem, optionally LZ4-compressed)
+//! - Tmpfs (writable in-memory filesystem mounted at /tmp)
 //! - VFS (Virtual File System) abstraction
 //! - File operations for reading/writing files
 
+pub mod lz4;
 pub mod ramdisk;
+pub mod tmpfs;
 pub mod vfs;
 
 // Re-export commonly used types
@@ -21,12 +21,36 @@
 //! # Layout
 //!
 //! ```text
-//! Offset 0x00: Superblock (16 bytes)
-//! Offset 0x10: File headers (16 bytes each, num_files entries)
-//! Offset 0x10 + (num_files * 16): File names (null-terminated)
-//! After names: File data (contiguous)
+//! Offset 0x00: Superblock (32 bytes)
+//! Offset 0x20: File headers (24 bytes each, num_files entries)
+//! index_offset: Name index (index_buckets u32 slots)
+//! After index: File names (null-terminated)
+//! After names: File data (each stored file starts on a page boundary)
 //! ```
 //!
+//! The name index is an open-addressed hash table built by build.rs:
+//! slot `name_hash(name) & (index_buckets - 1)` onwards (linear probing)
+//! holds file indexes, terminated by `RAMDISK_INDEX_EMPTY`. Lookups cost
+//! one hash plus, in the common case, a single length-checked compare.
+//! Version 2 images (16-byte file headers, no compression) and version 1
+//! images (12-byte superblock, no index, searched linearly) are still
+//! accepted.
+//!
+//! File data stored as-is is page-aligned and zero-padded to a page
+//! boundary, so a file can be mapped into a process in place (see
+//! `file_mappable`).
+//!
+//! # Compression
+//!
+//! build.rs can store files as LZ4 blocks (`RUSTUX_RAMDISK_COMPRESS=1`),
+//! packed without alignment; a file header records both sizes. Such a
+//! file is decompressed the first time it is opened or spawned, into
+//! page-aligned, zero-padded pages that are kept for the life of the
+//! kernel, and from then on it behaves exactly like a stored file:
+//! `file_data` returns the decompressed pages, programs demand-page from
+//! them and `sys_map_file` maps them in place. Files nobody touches
+//! cost neither decompression time nor memory.
+//!
 //! # Usage
 //!
 //! ```ignore
@@ -45,6 +69,7 @@
 //! ```
 
 use crate::sync::SpinMutex;
+use alloc::collections::BTreeMap;
 use alloc::vec::Vec;
 
 /// ============================================================================
@@ -107,7 +132,46 @@ pub const ENOSYS: Errno = Errno::EPERM; // Temporary: use EPERM for "not support
 /// Ramdisk Structures
 /// ============================================================================
 
+/// Granularity of file data in the image (one x86-64 page)
+pub const RAMDISK_PAGE_SIZE: usize = 4096;
+
+/// Version 1 superblock magic: "RUTX" (no name index)
+pub const RAMDISK_MAGIC_V1: u32 = 0x52555458;
+
+/// Version 2 superblock magic: "RUX2" (hashed name index)
+pub const RAMDISK_MAGIC_V2: u32 = 0x52555832;
+
+/// Version 3 superblock magic: "RUX3" (24-byte file headers, compression)
+pub const RAMDISK_MAGIC_V3: u32 = 0x52555833;
+
+/// File data stored as-is
+pub const RAMDISK_COMPRESSION_NONE: u32 = 0;
+
+/// File data stored as one LZ4 block (see `fs::lz4`)
+pub const RAMDISK_COMPRESSION_LZ4: u32 = 1;
+
+/// Empty slot in the name index
+pub const RAMDISK_INDEX_EMPTY: u32 = u32::MAX;
+
+/// Longest file name a lookup will consider
+const MAX_NAME_LEN: usize = 256;
+
+/// Hash a file name for the name index (32-bit FNV-1a)
+///
+/// Must match the copy in build.rs.
+pub fn name_hash(name: &[u8]) -> u32 {
+    let mut hash: u32 = 0x811c_9dc5;
+    for &b in name {
+        hash ^= b as u32;
+        hash = hash.wrapping_mul(0x0100_0193);
+    }
+    hash
+}
+
 /// Ramdisk file header (embedded at compile time)
+///
+/// This is the version 3 layout. Headers of older images are read into
+/// it with `stored_size == size` and no compression.
 #[repr(C)]
 #[derive(Debug, Clone, Copy)]
 pub struct RamdiskFile {
@@ -115,28 +179,73 @@ pub struct RamdiskFile {
     pub name_offset: u32,
     /// Offset to file data (from start of ramdisk)
     pub data_offset: u32,
-    /// File size in bytes
+    /// File size in bytes (uncompressed)
     pub size: u32,
-    /// Reserved (for alignment)
-    pub _pad: u32,
+    /// Name length in bytes, excluding the null terminator
+    /// (0 in version 1 images, which only have the terminator)
+    pub name_len: u32,
+    /// Bytes of file data in the image (compressed size)
+    pub stored_size: u32,
+    /// How the data is stored (RAMDISK_COMPRESSION_*)
+    pub compression: u32,
+}
+
+impl RamdiskFile {
+    /// Whether the data must be decompressed before use
+    pub fn is_compressed(&self) -> bool {
+        self.compression != RAMDISK_COMPRESSION_NONE
+    }
+}
+
+/// Version 1 and 2 file header
+#[repr(C)]
+#[derive(Clone, Copy)]
+struct RamdiskFileV2 {
+    name_offset: u32,
+    data_offset: u32,
+    size: u32,
+    name_len: u32,
 }
 
 /// Ramdisk superblock (at offset 0)
+///
+/// Version 1 images end the superblock after `files_offset`; the index
+/// fields are only meaningful when `magic == RAMDISK_MAGIC_V2`.
 #[repr(C)]
 #[derive(Debug, Clone, Copy)]
 pub struct RamdiskSuperblock {
-    /// Magic number: 0x52555458 ("RUTX")
+    /// Magic number: RAMDISK_MAGIC_V1 or RAMDISK_MAGIC_V2
     pub magic: u32,
     /// Number of files in the ramdisk
     pub num_files: u32,
     /// Offset to file headers array (from start of ramdisk)
     pub files_offset: u32,
+    /// Offset to the name index (from start of ramdisk)
+    pub index_offset: u32,
+    /// Number of index slots (power of two, larger than num_files)
+    pub index_buckets: u32,
+    /// Reserved (pads the superblock to 32 bytes)
+    pub _reserved: [u32; 3],
 }
 
 impl RamdiskSuperblock {
     /// Check if the superblock magic is valid
     pub fn is_valid(&self) -> bool {
-        self.magic == 0x52555458
+        matches!(self.magic, RAMDISK_MAGIC_V1 | RAMDISK_MAGIC_V2 | RAMDISK_MAGIC_V3)
+    }
+
+    /// Check whether the image carries a name index
+    pub fn has_index(&self) -> bool {
+        matches!(self.magic, RAMDISK_MAGIC_V2 | RAMDISK_MAGIC_V3)
+    }
+
+    /// Size of one file header in the image
+    pub fn file_header_size(&self) -> usize {
+        if self.magic == RAMDISK_MAGIC_V3 {
+            core::mem::size_of::<RamdiskFile>()
+        } else {
+            core::mem::size_of::<RamdiskFileV2>()
+        }
     }
 }
 
@@ -187,7 +296,83 @@ impl Ramdisk {
         }
     }
 
-    /// Find a file by name
+    /// Number of file headers that lie inside the image
+    fn header_count(&self) -> usize {
+        if !self.superblock.is_valid() {
+            return 0;
+        }
+
+        let offset = self.superblock.files_offset as usize;
+        let count = self.superblock.num_files as usize;
+        let entry_size = self.superblock.file_header_size();
+        match count.checked_mul(entry_size).and_then(|n| n.checked_add(offset)) {
+            Some(end) if end <= self.data.len() => count,
+            _ => 0,
+        }
+    }
+
+    /// Get a file header by index (the inode number used by file descriptors)
+    pub fn file(&self, index: usize) -> Option<RamdiskFile> {
+        if index >= self.header_count() {
+            return None;
+        }
+
+        let entry_size = self.superblock.file_header_size();
+        let offset = self.superblock.files_offset as usize + index * entry_size;
+        let ptr = unsafe { self.data.as_ptr().add(offset) };
+
+        if self.superblock.magic == RAMDISK_MAGIC_V3 {
+            return Some(unsafe { (ptr as *const RamdiskFile).read_unaligned() });
+        }
+
+        let old = unsafe { (ptr as *const RamdiskFileV2).read_unaligned() };
+        Some(RamdiskFile {
+            name_offset: old.name_offset,
+            data_offset: old.data_offset,
+            size: old.size,
+            name_len: old.name_len,
+            stored_size: old.size,
+            compression: RAMDISK_COMPRESSION_NONE,
+        })
+    }
+
+    /// Get the name index slots, if the image has a usable index
+    fn index(&self) -> Option<&'static [u32]> {
+        if !self.superblock.has_index() {
+            return None;
+        }
+
+        let offset = self.superblock.index_offset as usize;
+        let buckets = self.superblock.index_buckets as usize;
+        if !buckets.is_power_of_two() || offset % 4 != 0 {
+            return None;
+        }
+        match buckets.checked_mul(4).and_then(|n| n.checked_add(offset)) {
+            Some(end) if end <= self.data.len() => unsafe {
+                let base = self.data.as_ptr().add(offset);
+                Some(core::slice::from_raw_parts(base as *const u32, buckets))
+            },
+            _ => None,
+        }
+    }
+
+    /// Get a file's name (without the null terminator)
+    pub fn file_name(&self, file: &RamdiskFile) -> &'static [u8] {
+        let start = core::cmp::min(file.name_offset as usize, self.data.len());
+        let rest = &self.data[start..];
+
+        if file.name_len != 0 {
+            // Version 2: stored length
+            return &rest[..core::cmp::min(file.name_len as usize, rest.len())];
+        }
+
+        // Version 1: scan for the terminator
+        let limit = core::cmp::min(rest.len(), MAX_NAME_LEN);
+        let len = rest[..limit].iter().position(|&b| b == 0).unwrap_or(limit);
+        &rest[..len]
+    }
+
+    /// Find a file's index by name
     ///
     /// # Arguments
     ///
@@ -195,45 +380,51 @@ impl Ramdisk {
     ///
     /// # Returns
     ///
-    /// The RamdiskFile if found, or None if not found
-    pub fn find_file(&self, name: &str) -> Option<RamdiskFile> {
+    /// The file index if found, or None if not found
+    pub fn find_index(&self, name: &str) -> Option<usize> {
         // Strip leading slash if present
-        let name = if name.starts_with('/') {
-            &name[1..]
-        } else {
-            name
-        };
-
-        // Get file headers array
-        let files = unsafe {
-            let base = self.data.as_ptr().add(self.superblock.files_offset as usize);
-            let count = self.superblock.num_files as usize;
-            core::slice::from_raw_parts(base as *const RamdiskFile, count)
+        let name = name.strip_prefix('/').unwrap_or(name).as_bytes();
+
+        let index = match self.index() {
+            Some(index) => index,
+            // Version 1 image: linear scan
+            None => {
+                return (0..self.header_count())
+                    .find(|&i| self.file(i).is_some_and(|f| self.file_name(&f) == name))
+            }
         };
 
-        // Search for file by name
-        for &file in files {
-            let file_name = unsafe {
-                let base = self.data.as_ptr();
-                let name_ptr = base.add(file.name_offset as usize);
-                // Find null terminator
-                let mut len = 0;
-                while *name_ptr.add(len) != 0 && len < 256 {
-                    len += 1;
+        let mask = index.len() - 1;
+        let mut slot = name_hash(name) as usize & mask;
+        for _ in 0..index.len() {
+            let entry = index[slot];
+            if entry == RAMDISK_INDEX_EMPTY {
+                return None;
+            }
+            if let Some(file) = self.file(entry as usize) {
+                if self.file_name(&file) == name {
+                    return Some(entry as usize);
                 }
-                core::str::from_utf8_unchecked(
-                    core::slice::from_raw_parts(name_ptr, len)
-                )
-            };
-
-            if file_name == name {
-                return Some(file);
             }
+            slot = (slot + 1) & mask;
         }
 
         None
     }
 
+    /// Find a file by name
+    ///
+    /// # Arguments
+    ///
+    /// * `name` - File name (e.g., "/test.txt" or "test.txt")
+    ///
+    /// # Returns
+    ///
+    /// The RamdiskFile if found, or None if not found
+    pub fn find_file(&self, name: &str) -> Option<RamdiskFile> {
+        self.find_index(name).and_then(|index| self.file(index))
+    }
+
     /// Read file data into a buffer
     ///
     /// # Arguments
@@ -243,23 +434,12 @@ impl Ramdisk {
     ///
     /// # Returns
     ///
-    /// Number of bytes read
-    pub fn read_file(&self, file: &RamdiskFile, buf: &mut [u8]) -> usize {
-        let data_ptr = unsafe {
-            self.data.as_ptr().add(file.data_offset as usize)
-        };
-
-        let to_copy = core::cmp::min(buf.len(), file.size as usize);
-
-        if to_copy == 0 {
-            return 0;
-        }
-
-        unsafe {
-            core::ptr::copy_nonoverlapping(data_ptr, buf.as_mut_ptr(), to_copy);
-        }
-
-        to_copy
+    /// Number of bytes read, or the error of `file_data`
+    pub fn read_file(&self, file: &RamdiskFile, buf: &mut [u8]) -> Result<usize, Errno> {
+        let data = self.file_data(file)?;
+        let to_copy = core::cmp::min(buf.len(), data.len());
+        buf[..to_copy].copy_from_slice(&data[..to_copy]);
+        Ok(to_copy)
     }
 
     /// Get file size
@@ -275,36 +455,61 @@ impl Ramdisk {
         file.size as usize
     }
 
-    /// List all files in the ramdisk
+    /// Get a file's contents
+    ///
+    /// # Arguments
+    ///
+    /// * `file` - The file (from find_file)
     ///
     /// # Returns
     ///
-    /// Vector of file names
-    pub fn list_files(&self) -> alloc::vec::Vec<alloc::string::String> {
-        let mut names = alloc::vec::Vec::new();
+    /// The file data, borrowed straight from the embedded image, or for
+    /// a compressed file its decompressed pages (decompressing it on the
+    /// first call). Fails with ENOMEM if there is no memory to
+    /// decompress into, or EIO if the compressed data is corrupt.
+    pub fn file_data(&self, file: &RamdiskFile) -> Result<&'static [u8], Errno> {
+        if file.is_compressed() {
+            return decompressed_data(self.stored_data(file), file);
+        }
+        Ok(self.stored_data(file))
+    }
 
-        let files = unsafe {
-            let base = self.data.as_ptr().add(self.superblock.files_offset as usize);
-            let count = self.superblock.num_files as usize;
-            core::slice::from_raw_parts(base as *const RamdiskFile, count)
-        };
+    /// A file's data as stored in the image
+    fn stored_data(&self, file: &RamdiskFile) -> &'static [u8] {
+        let start = core::cmp::min(file.data_offset as usize, self.data.len());
+        let end = core::cmp::min(start + file.stored_size as usize, self.data.len());
+        &self.data[start..end]
+    }
 
-        for &file in files {
-            let file_name = unsafe {
-                let base = self.data.as_ptr();
-                let name_ptr = base.add(file.name_offset as usize);
-                let mut len = 0;
-                while *name_ptr.add(len) != 0 && len < 256 {
-                    len += 1;
-                }
-                alloc::string::String::from_utf8_unchecked(
-                    core::slice::from_raw_parts(name_ptr, len).to_vec()
-                )
-            };
-            names.push(file_name);
+    /// Check whether a file can be mapped in place
+    ///
+    /// True when the file data starts on a page boundary and its last
+    /// page lies entirely inside the image, so mapping whole pages never
+    /// exposes memory beyond the ramdisk. Images built by build.rs always
+    /// satisfy this; an image embedded without page alignment does not.
+    /// Compressed files always do once decompressed (see `file_data`).
+    pub fn file_mappable(&self, file: &RamdiskFile) -> bool {
+        if file.is_compressed() {
+            return file.size != 0;
         }
 
-        names
+        let start = self.data.as_ptr() as usize + file.data_offset as usize;
+        let pages = (file.size as usize + RAMDISK_PAGE_SIZE - 1) / RAMDISK_PAGE_SIZE;
+        let end = file.data_offset as usize + pages * RAMDISK_PAGE_SIZE;
+
+        file.size != 0 && start % RAMDISK_PAGE_SIZE == 0 && end <= self.data.len()
+    }
+
+    /// List all files in the ramdisk
+    ///
+    /// # Returns
+    ///
+    /// Vector of file names
+    pub fn list_files(&self) -> alloc::vec::Vec<alloc::string::String> {
+        (0..self.header_count())
+            .filter_map(|i| self.file(i))
+            .map(|file| alloc::string::String::from_utf8_lossy(self.file_name(&file)).into_owned())
+            .collect()
     }
 
     /// Get the number of files
@@ -318,6 +523,64 @@ impl Ramdisk {
     }
 }
 
+/// ============================================================================
+/// Decompressed Files
+/// ============================================================================
+
+/// Decompressed contents of compressed files, by data offset
+static DECOMPRESSED: SpinMutex<BTreeMap<u32, &'static [u8]>> = SpinMutex::new(BTreeMap::new());
+
+/// Get the decompressed contents of a compressed file, decompressing it
+/// on first use
+///
+/// The contents go into physically contiguous pages, zero-padded to a
+/// page boundary, so they can be mapped in place like stored file data.
+/// They are never freed: the file never changes.
+fn decompressed_data(stored: &[u8], file: &RamdiskFile) -> Result<&'static [u8], Errno> {
+    use crate::mm::pmm;
+
+    // Held across the decompression, so concurrent first opens of a file
+    // decompress it once
+    let mut cache = DECOMPRESSED.lock();
+    if let Some(&data) = cache.get(&file.data_offset) {
+        return Ok(data);
+    }
+
+    let size = file.size as usize;
+    let pages = (size + RAMDISK_PAGE_SIZE - 1) / RAMDISK_PAGE_SIZE;
+    let data: &'static [u8] = if pages == 0 {
+        &[]
+    } else {
+        let paddr = pmm::pmm_alloc_contiguous(pages, pmm::PMM_ALLOC_FLAG_ANY, 12)
+            .map_err(|_| Errno::ENOMEM)?;
+        let buf = unsafe {
+            core::slice::from_raw_parts_mut(pmm::paddr_to_vaddr(paddr) as *mut u8, pages * RAMDISK_PAGE_SIZE)
+        };
+
+        let decoded = match file.compression {
+            RAMDISK_COMPRESSION_LZ4 => crate::fs::lz4::decompress(stored, &mut buf[..size]),
+            _ => Err("unknown compression"),
+        };
+        if decoded.is_err() {
+            for i in 0..pages {
+                pmm::pmm_free_page(paddr + (i * RAMDISK_PAGE_SIZE) as u64);
+            }
+            return Err(Errno::EIO);
+        }
+
+        buf[size..].fill(0);
+        &buf[..size]
+    };
+
+    cache.insert(file.data_offset, data);
+    Ok(data)
+}
+
+/// Bytes of RAM holding decompressed files
+pub fn decompressed_bytes() -> usize {
+    DECOMPRESSED.lock().values().map(|data| data.len()).sum()
+}
+
 /// ============================================================================
 /// Global Ramdisk Instance
 /// ============================================================================
@@ -424,17 +687,169 @@ mod tests {
 
     #[test]
     fn test_ramdisk_file_size() {
-        assert_eq!(core::mem::size_of::<RamdiskFile>(), 16);
-        assert_eq!(core::mem::size_of::<RamdiskSuperblock>(), 12);
+        assert_eq!(core::mem::size_of::<RamdiskFile>(), 24);
+        assert_eq!(core::mem::size_of::<RamdiskFileV2>(), 16);
+        assert_eq!(core::mem::size_of::<RamdiskSuperblock>(), 32);
     }
 
     #[test]
     fn test_superblock_magic() {
-        let sb = RamdiskSuperblock {
-            magic: 0x52555458,
+        let mut sb = RamdiskSuperblock {
+            magic: RAMDISK_MAGIC_V1,
             num_files: 3,
-            files_offset: 16,
+            files_offset: 12,
+            index_offset: 0,
+            index_buckets: 0,
+            _reserved: [0; 3],
         };
         assert!(sb.is_valid());
+        assert!(!sb.has_index());
+
+        sb.magic = RAMDISK_MAGIC_V2;
+        assert!(sb.is_valid() && sb.has_index());
+        assert_eq!(sb.file_header_size(), 16);
+
+        sb.magic = RAMDISK_MAGIC_V3;
+        assert!(sb.is_valid() && sb.has_index());
+        assert_eq!(sb.file_header_size(), 24);
+
+        sb.magic = 0;
+        assert!(!sb.is_valid());
+    }
+
+    #[test]
+    fn test_name_hash() {
+        // FNV-1a reference values
+        assert_eq!(name_hash(b""), 0x811c_9dc5);
+        assert_eq!(name_hash(b"a"), 0xe40c_292c);
+    }
+
+    /// Build an image the way build.rs does (names only, no file data)
+    fn build_image(names: &[&str], indexed: bool) -> Ramdisk {
+        let num_files = names.len() as u32;
+        let buckets = if indexed { (num_files * 2).next_power_of_two() } else { 0 };
+        let files_offset = if indexed { 32 } else { 12 };
+        let index_offset = files_offset + 16 * num_files;
+        let mut name_offset = index_offset + 4 * buckets;
+
+        let mut words: Vec<u32> = alloc::vec![
+            if indexed { RAMDISK_MAGIC_V2 } else { RAMDISK_MAGIC_V1 },
+            num_files,
+            files_offset,
+        ];
+        if indexed {
+            words.extend_from_slice(&[index_offset, buckets, 0, 0, 0]);
+        }
+
+        let mut index = alloc::vec![RAMDISK_INDEX_EMPTY; buckets as usize];
+        for (i, name) in names.iter().enumerate() {
+            let name_len = if indexed { name.len() as u32 } else { 0 };
+            words.extend_from_slice(&[name_offset, 0, 0, name_len]);
+            name_offset += name.len() as u32 + 1;
+
+            if indexed {
+                let mut slot = name_hash(name.as_bytes()) & (buckets - 1);
+                while index[slot as usize] != RAMDISK_INDEX_EMPTY {
+                    slot = (slot + 1) & (buckets - 1);
+                }
+                index[slot as usize] = i as u32;
+            }
+        }
+        words.extend_from_slice(&index);
+
+        let mut bytes: Vec<u8> = words.iter().flat_map(|w| w.to_le_bytes()).collect();
+        for name in names {
+            bytes.extend_from_slice(name.as_bytes());
+            bytes.push(0);
+        }
+
+        // Copy into u32 storage so the superblock is aligned
+        let mut storage = alloc::vec![0u32; (bytes.len() + 3) / 4];
+        unsafe {
+            core::ptr::copy_nonoverlapping(bytes.as_ptr(), storage.as_mut_ptr() as *mut u8, bytes.len());
+        }
+        let storage: &'static [u32] = alloc::boxed::Box::leak(storage.into_boxed_slice());
+        let data = unsafe { core::slice::from_raw_parts(storage.as_ptr() as *const u8, bytes.len()) };
+        unsafe { Ramdisk::from_embedded_data(data) }
+    }
+
+    #[test]
+    fn test_find_index() {
+        let names = ["test.txt", "bin/init", "bin/shell", "bin/hello", "bin/counter"];
+
+        for &indexed in &[true, false] {
+            let ramdisk = build_image(&names, indexed);
+
+            for (i, name) in names.iter().enumerate() {
+                assert_eq!(ramdisk.find_index(name), Some(i));
+                assert_eq!(ramdisk.file_name(&ramdisk.file(i).unwrap()), name.as_bytes());
+            }
+            assert_eq!(ramdisk.find_index("/bin/shell"), Some(2));
+            assert_eq!(ramdisk.find_index("bin/she"), None);
+            assert_eq!(ramdisk.find_index("bin/shells"), None);
+            assert_eq!(ramdisk.find_index(""), None);
+        }
+    }
+
+    #[test]
+    fn test_v3_headers() {
+        // Superblock, one 24-byte header, a one-slot index, then the name
+        let words: [u32; 15] = [
+            RAMDISK_MAGIC_V3, 1, 32, 56, 1, 0, 0, 0,
+            60, 64, 5000, 1, 300, RAMDISK_COMPRESSION_LZ4,
+            0,
+        ];
+        let mut storage = alloc::vec![0u32; 16];
+        storage[..15].copy_from_slice(&words);
+        storage[15] = u32::from_le_bytes(*b"a\0\0\0");
+        let storage: &'static [u32] = alloc::boxed::Box::leak(storage.into_boxed_slice());
+        let data = unsafe { core::slice::from_raw_parts(storage.as_ptr() as *const u8, 64) };
+        let ramdisk = unsafe { Ramdisk::from_embedded_data(data) };
+
+        assert_eq!(ramdisk.find_index("a"), Some(0));
+        let file = ramdisk.file(0).unwrap();
+        assert_eq!((file.size, file.stored_size), (5000, 300));
+        assert!(file.is_compressed());
+        assert_eq!(ramdisk.file_name(&file), b"a");
+        assert!(ramdisk.file(1).is_none());
+    }
+
+    #[repr(C, align(4096))]
+    struct Image([u8; 3 * RAMDISK_PAGE_SIZE]);
+
+    fn test_ramdisk(image: &'static Image) -> Ramdisk {
+        unsafe { Ramdisk::from_embedded_data(&image.0) }
+    }
+
+    fn file_at(data_offset: u32, size: u32) -> RamdiskFile {
+        RamdiskFile {
+            name_offset: 0,
+            data_offset,
+            size,
+            name_len: 0,
+            stored_size: size,
+            compression: RAMDISK_COMPRESSION_NONE,
+        }
+    }
+
+    #[test]
+    fn test_file_mappable() {
+        static IMAGE: Image = Image([0; 3 * RAMDISK_PAGE_SIZE]);
+        let ramdisk = test_ramdisk(&IMAGE);
+
+        // Page-aligned, tail page inside the image
+        assert!(ramdisk.file_mappable(&file_at(4096, 100)));
+        assert!(ramdisk.file_mappable(&file_at(4096, 8192)));
+        // Tail page would run past the image
+        assert!(!ramdisk.file_mappable(&file_at(8192, 4097)));
+        // Unaligned data or an empty file
+        assert!(!ramdisk.file_mappable(&file_at(4100, 100)));
+        assert!(!ramdisk.file_mappable(&file_at(4096, 0)));
+
+        assert_eq!(ramdisk.file_data(&file_at(4096, 100)).unwrap().len(), 100);
+
+        // Compressed data is mappable wherever it is stored
+        let compressed = RamdiskFile { stored_size: 10, compression: RAMDISK_COMPRESSION_LZ4, ..file_at(4100, 100) };
+        assert!(ramdisk.file_mappable(&compressed));
     }
 }
@@ -0,0 +1,466 @@
+// Copyright 2025 The Rustux Authors
+//
+// Use of this source code is governed by a MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT
+
+//! Temporary Filesystem (tmpfs)
+//!
+//! A writable in-memory filesystem mounted at `/tmp`, next to the
+//! read-only ramdisk: `sys_open("/tmp/log", O_WRONLY | O_CREAT)` creates
+//! a file here, and every other path still resolves in the ramdisk. The
+//! directory is flat (`/tmp/<name>`), and files are never removed, so an
+//! inode number stays valid for as long as any descriptor holds it.
+//!
+//! # Page Cache
+//!
+//! A file's data lives in whole physical pages, indexed by page number
+//! (page N holds bytes `N * 4096..`). The pages are the file: reads and
+//! writes copy straight between them and the caller's buffer, and
+//! `sys_map_file` maps the same pages, so a mapping sees later writes in
+//! place. Pages are allocated as writes reach them and zeroed only where
+//! the write does not cover them; the page index grows by doubling, so
+//! a stream of small appends allocates nothing but the occasional page.
+//!
+//! Pages are reference counted (`pmm_page_ref`): the file holds one
+//! reference and each mapping another, so truncating a file releases
+//! pages that are still mapped without freeing them under the mapping.
+//!
+//! # Directory
+//!
+//! Names are hashed with the ramdisk's `name_hash` into a fixed table of
+//! chained buckets. A lookup costs one hash and, in the common case, one
+//! length-checked compare. The directory has its own lock, taken only by
+//! open; each file has another, so I/O on different files never contends.
+//! No two of these locks are ever held together.
+
+use alloc::vec::Vec;
+
+use crate::arch::amd64::mm::page_tables::PAddr;
+use crate::fs::ramdisk::{name_hash, Errno};
+use crate::mm::pmm;
+use crate::sync::SpinMutex;
+
+/// Directory the filesystem is mounted at (without slashes)
+pub const MOUNT_POINT: &str = "tmp";
+
+/// Maximum number of files
+pub const MAX_FILES: usize = 256;
+
+/// Maximum file name length in bytes
+pub const NAME_MAX: usize = 63;
+
+/// Maximum file size (4 GiB)
+pub const MAX_FILE_SIZE: u64 = 1 << 32;
+
+/// Page size of the page cache
+const PAGE_SIZE: usize = 4096;
+
+/// Number of directory hash buckets (a power of two)
+const BUCKETS: usize = 64;
+
+/// End of a bucket chain
+const NO_ENTRY: u16 = u16::MAX;
+
+/// Page containing byte `offset`
+#[inline]
+fn page_of(offset: u64) -> usize {
+    (offset / PAGE_SIZE as u64) as usize
+}
+
+/// Kernel address of byte `offset` within a cached page
+#[inline]
+fn page_ptr(paddr: PAddr, offset: usize) -> *mut u8 {
+    (pmm::paddr_to_vaddr_user_zone(paddr) + offset) as *mut u8
+}
+
+/// File name of a tmpfs path, or None for a path outside the mount
+///
+/// Accepts `/tmp/<name>` and `tmp/<name>`, where `<name>` has no further
+/// slashes.
+pub fn tmpfs_name(path: &str) -> Option<&str> {
+    let path = path.strip_prefix('/').unwrap_or(path);
+    let name = path.strip_prefix(MOUNT_POINT)?.strip_prefix('/')?;
+    (!name.is_empty() && !name.contains('/')).then_some(name)
+}
+
+/// ============================================================================
+/// Directory
+/// ============================================================================
+
+/// One directory entry (its index is the file's inode number)
+#[derive(Clone, Copy)]
+struct DirEntry {
+    /// `name_hash` of the name
+    hash: u32,
+    /// Next entry in the same bucket
+    next: u16,
+    /// Name length
+    len: u8,
+    /// Name bytes
+    name: [u8; NAME_MAX],
+}
+
+impl DirEntry {
+    const EMPTY: Self = Self {
+        hash: 0,
+        next: NO_ENTRY,
+        len: 0,
+        name: [0; NAME_MAX],
+    };
+
+    fn name(&self) -> &[u8] {
+        &self.name[..self.len as usize]
+    }
+}
+
+/// Hashed flat directory
+struct Directory {
+    /// First entry of each bucket
+    buckets: [u16; BUCKETS],
+    /// Entries, by inode number
+    entries: [DirEntry; MAX_FILES],
+    /// Entries in use
+    count: usize,
+}
+
+impl Directory {
+    const fn new() -> Self {
+        Self {
+            buckets: [NO_ENTRY; BUCKETS],
+            entries: [DirEntry::EMPTY; MAX_FILES],
+            count: 0,
+        }
+    }
+
+    /// Inode number of a name
+    fn lookup(&self, name: &[u8]) -> Option<u32> {
+        let hash = name_hash(name);
+        let mut index = self.buckets[hash as usize & (BUCKETS - 1)];
+        while index != NO_ENTRY {
+            let entry = &self.entries[index as usize];
+            if entry.hash == hash && entry.name() == name {
+                return Some(index as u32);
+            }
+            index = entry.next;
+        }
+        None
+    }
+
+    /// Add a name that is not in the directory yet
+    ///
+    /// # Returns
+    ///
+    /// The new inode number, EINVAL for an empty or over-long name, or
+    /// ENFILE if the directory is full
+    fn insert(&mut self, name: &[u8]) -> Result<u32, Errno> {
+        if name.is_empty() || name.len() > NAME_MAX {
+            return Err(Errno::EINVAL);
+        }
+        if self.count == MAX_FILES {
+            return Err(Errno::ENFILE);
+        }
+
+        let index = self.count;
+        let hash = name_hash(name);
+        let bucket = &mut self.buckets[hash as usize & (BUCKETS - 1)];
+
+        let entry = &mut self.entries[index];
+        entry.hash = hash;
+        entry.next = *bucket;
+        entry.len = name.len() as u8;
+        entry.name[..name.len()].copy_from_slice(name);
+
+        *bucket = index as u16;
+        self.count += 1;
+        Ok(index as u32)
+    }
+}
+
+static DIRECTORY: SpinMutex<Directory> = SpinMutex::new(Directory::new());
+
+/// ============================================================================
+/// File Data
+/// ============================================================================
+
+/// Contents of one file
+struct FileData {
+    /// Size in bytes
+    size: u64,
+    /// Cached pages, by page number (always `size` rounded up to pages)
+    pages: Vec<PAddr>,
+}
+
+impl FileData {
+    const fn new() -> Self {
+        Self { size: 0, pages: Vec::new() }
+    }
+
+    /// Allocate the pages backing bytes up to `end`
+    ///
+    /// Bytes of `[start, end)` are about to be written, so pages entirely
+    /// inside that range are not zeroed. Stops early if memory runs out.
+    ///
+    /// # Returns
+    ///
+    /// The end of the bytes now backed (`end`, or less on exhaustion)
+    fn grow(&mut self, start: u64, end: u64) -> u64 {
+        let needed = page_of(end + PAGE_SIZE as u64 - 1);
+        if needed > self.pages.len() && self.pages.try_reserve(needed - self.pages.len()).is_err() {
+            return self.backed();
+        }
+
+        while self.pages.len() < needed {
+            let Ok(paddr) = pmm::pmm_alloc_user_page() else {
+                break;
+            };
+            let page_start = (self.pages.len() * PAGE_SIZE) as u64;
+            if page_start < start || page_start + PAGE_SIZE as u64 > end {
+                unsafe { core::ptr::write_bytes(page_ptr(paddr, 0), 0, PAGE_SIZE) };
+            }
+            self.pages.push(paddr);
+        }
+
+        end.min(self.backed())
+    }
+
+    /// Bytes the allocated pages can hold
+    fn backed(&self) -> u64 {
+        (self.pages.len() * PAGE_SIZE) as u64
+    }
+
+    /// Copy `buf` in at `offset`, which must be backed
+    fn copy_in(&mut self, mut offset: u64, mut buf: &[u8]) {
+        while !buf.is_empty() {
+            let in_page = offset as usize % PAGE_SIZE;
+            let chunk = buf.len().min(PAGE_SIZE - in_page);
+            let dst = page_ptr(self.pages[page_of(offset)], in_page);
+            unsafe { core::ptr::copy_nonoverlapping(buf.as_ptr(), dst, chunk) };
+            buf = &buf[chunk..];
+            offset += chunk as u64;
+        }
+    }
+
+    /// Copy out to `buf` from `offset`, which must be below the size
+    fn copy_out(&self, mut offset: u64, mut buf: &mut [u8]) {
+        while !buf.is_empty() {
+            let in_page = offset as usize % PAGE_SIZE;
+            let chunk = buf.len().min(PAGE_SIZE - in_page);
+            let src = page_ptr(self.pages[page_of(offset)], in_page);
+            unsafe { core::ptr::copy_nonoverlapping(src, buf.as_mut_ptr(), chunk) };
+            buf = &mut buf[chunk..];
+            offset += chunk as u64;
+        }
+    }
+
+    /// Shrink to `size` bytes, releasing the pages past it
+    fn shrink(&mut self, size: u64) {
+        let keep = page_of(size + PAGE_SIZE as u64 - 1);
+        for paddr in self.pages.drain(keep..) {
+            pmm::pmm_page_unref(paddr);
+        }
+
+        // Bytes past the end read as zero, in mappings too, and when the
+        // file grows again
+        let tail = size as usize % PAGE_SIZE;
+        if tail != 0 {
+            let last = self.pages[keep - 1];
+            unsafe { core::ptr::write_bytes(page_ptr(last, tail), 0, PAGE_SIZE - tail) };
+        }
+        self.size = size;
+    }
+}
+
+static FILES: [SpinMutex<FileData>; MAX_FILES] = {
+    const EMPTY: SpinMutex<FileData> = SpinMutex::new(FileData::new());
+    [EMPTY; MAX_FILES]
+};
+
+/// Data of an inode
+fn file(inode: u32) -> Result<&'static SpinMutex<FileData>, Errno> {
+    FILES.get(inode as usize).ok_or(Errno::EBADF)
+}
+
+/// ============================================================================
+/// File Operations
+/// ============================================================================
+
+/// Open a file by name (see [`tmpfs_name`])
+///
+/// # Arguments
+///
+/// * `name` - File name within the mount
+/// * `create` - Create the file if it does not exist (O_CREAT)
+/// * `exclusive` - Fail if it does exist (O_EXCL, with `create`)
+///
+/// # Returns
+///
+/// The file's inode number, or ENOENT, EEXIST, EINVAL (bad name) or
+/// ENFILE (directory full)
+pub fn open(name: &str, create: bool, exclusive: bool) -> Result<u32, Errno> {
+    let mut directory = DIRECTORY.lock();
+    match directory.lookup(name.as_bytes()) {
+        Some(_) if create && exclusive => Err(Errno::EEXIST),
+        Some(inode) => Ok(inode),
+        None if create => directory.insert(name.as_bytes()),
+        None => Err(Errno::ENOENT),
+    }
+}
+
+/// Read from a file at `offset`
+///
+/// # Returns
+///
+/// Bytes read (0 at or past the end of the file)
+pub fn read(inode: u32, offset: u64, buf: &mut [u8]) -> Result<usize, Errno> {
+    let file = file(inode)?.lock();
+    if offset >= file.size {
+        return Ok(0);
+    }
+
+    let len = buf.len().min((file.size - offset) as usize);
+    file.copy_out(offset, &mut buf[..len]);
+    Ok(len)
+}
+
+/// Write to a file at `offset`, or at its end if `append`
+///
+/// A write past the end of the file (possible when another descriptor
+/// truncated it) leaves zeros in the gap.
+///
+/// # Returns
+///
+/// Bytes written and the offset just past them. A write cut short by
+/// memory exhaustion returns what was written; one that wrote nothing
+/// fails with ENOMEM.
+pub fn write(inode: u32, offset: u64, append: bool, buf: &[u8]) -> Result<(usize, u64), Errno> {
+    let mut file = file(inode)?.lock();
+    let start = if append { file.size } else { offset };
+    if buf.is_empty() {
+        return Ok((0, start));
+    }
+
+    let end = start.checked_add(buf.len() as u64).ok_or(Errno::EINVAL)?;
+    if end > MAX_FILE_SIZE {
+        return Err(Errno::EINVAL);
+    }
+
+    let end = file.grow(start, end);
+    if end <= start {
+        return Err(Errno::ENOMEM);
+    }
+
+    let len = (end - start) as usize;
+    file.copy_in(start, &buf[..len]);
+    file.size = file.size.max(end);
+    Ok((len, end))
+}
+
+/// Set a file's size
+///
+/// Shrinking releases the pages past the new end; growing fills with
+/// zeros.
+pub fn truncate(inode: u32, size: u64) -> Result<(), Errno> {
+    if size > MAX_FILE_SIZE {
+        return Err(Errno::EINVAL);
+    }
+
+    let mut file = file(inode)?.lock();
+    if size <= file.size {
+        file.shrink(size);
+        return Ok(());
+    }
+
+    // Bytes past the old end are already zero (see `shrink`)
+    if file.grow(size, size) < size {
+        return Err(Errno::ENOMEM);
+    }
+    file.size = size;
+    Ok(())
+}
+
+/// Size of a file in bytes
+pub fn size(inode: u32) -> Result<u64, Errno> {
+    Ok(file(inode)?.lock().size)
+}
+
+/// Pages of a file, for mapping
+///
+/// Takes a reference on each page for the caller's mapping, and returns
+/// the pages with the file size. A mapping covers the file as it is now:
+/// pages added by later writes are not part of it.
+pub fn map_pages(inode: u32) -> Result<(Vec<PAddr>, u64), Errno> {
+    let file = file(inode)?.lock();
+
+    let mut pages = Vec::new();
+    pages.try_reserve_exact(file.pages.len()).map_err(|_| Errno::ENOMEM)?;
+    for &paddr in file.pages.iter() {
+        pmm::pmm_page_ref(paddr);
+        pages.push(paddr);
+    }
+    Ok((pages, file.size))
+}
+
+/// Number of files
+pub fn file_count() -> usize {
+    DIRECTORY.lock().count
+}
+
+/// ============================================================================
+/// Tests
+/// ============================================================================
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    #[test]
+    fn test_tmpfs_name() {
+        assert_eq!(tmpfs_name("/tmp/log"), Some("log"));
+        assert_eq!(tmpfs_name("tmp/out.txt"), Some("out.txt"));
+        assert_eq!(tmpfs_name("/tmp/"), None);
+        assert_eq!(tmpfs_name("/tmp"), None);
+        assert_eq!(tmpfs_name("/tmpfoo/x"), None);
+        assert_eq!(tmpfs_name("/tmp/a/b"), None);
+        assert_eq!(tmpfs_name("/hello.txt"), None);
+    }
+
+    #[test]
+    fn test_directory_lookup() {
+        let mut directory = Directory::new();
+        let a = directory.insert(b"a").unwrap();
+        let b = directory.insert(b"b").unwrap();
+        assert_ne!(a, b);
+        assert_eq!(directory.lookup(b"a"), Some(a));
+        assert_eq!(directory.lookup(b"b"), Some(b));
+        assert_eq!(directory.lookup(b"c"), None);
+    }
+
+    #[test]
+    fn test_directory_collisions() {
+        // Far more names than buckets, so every bucket chains
+        let mut directory = Directory::new();
+        let mut name = [0u8; 8];
+        for i in 0..200u32 {
+            name[..4].copy_from_slice(&i.to_le_bytes());
+            assert_eq!(directory.insert(&name).unwrap(), i);
+        }
+        for i in 0..200u32 {
+            name[..4].copy_from_slice(&i.to_le_bytes());
+            assert_eq!(directory.lookup(&name), Some(i));
+        }
+    }
+
+    #[test]
+    fn test_directory_limits() {
+        let mut directory = Directory::new();
+        assert_eq!(directory.insert(b""), Err(Errno::EINVAL));
+        assert_eq!(directory.insert(&[b'x'; NAME_MAX + 1]), Err(Errno::EINVAL));
+        assert!(directory.insert(&[b'x'; NAME_MAX]).is_ok());
+
+        for i in 1..MAX_FILES as u32 {
+            directory.insert(&i.to_le_bytes()).unwrap();
+        }
+        assert_eq!(directory.insert(b"full"), Err(Errno::ENFILE));
+    }
+}
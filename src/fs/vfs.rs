@@ -125,14 +125,9 @@ impl FileOps for RamdiskFileOps {
         let to_read = core::cmp::min(buf.len(), remaining);
 
         // Read from the file at current offset
-        let data_offset = self.file.data_offset as usize + self.offset as usize;
-        let data_ptr = unsafe {
-            ramdisk.data.as_ptr().add(data_offset)
-        };
-
-        unsafe {
-            core::ptr::copy_nonoverlapping(data_ptr, buf.as_mut_ptr(), to_read);
-        }
+        let data = ramdisk.file_data(&self.file)?;
+        let start = self.offset as usize;
+        buf[..to_read].copy_from_slice(&data[start..start + to_read]);
 
         // Update offset
         self.offset += to_read as u64;
@@ -229,7 +224,9 @@ mod tests {
             name_offset: 0,
             data_offset: 32,
             size: 100,
-            _pad: 0,
+            name_len: 0,
+            stored_size: 100,
+            compression: 0,
         };
 
         let mut ops = RamdiskFileOps::new(file);
@@ -222,6 +222,7 @@ pub fn pmm_init() {
         INIT_STATE = InitState::Early;
     }
     init_early();
+    crate::boot::mark("pmm");
 }
 
 /// Complete kernel initialization (after stack switch)
@@ -234,7 +235,9 @@ pub fn pmm_init() {
 /// Must be called after pmm_init() and stack switch.
 pub fn kernel_init_rest() {
     init_arch();
+    crate::boot::mark("arch");
     init_memory();
+    crate::boot::mark("memory");
     init_threads();
     init_late();
 
@@ -411,7 +414,26 @@ fn init_memory() {
             const HEAP_PADDR: u64 = 0x0100_0000;  // 16MB physical address (AFTER kernel zone)
             const HEAP_SIZE: usize = 16 * 1024 * 1024; // 16MB heap (reduced to avoid consuming too much memory)
 
-            let heap_start_vaddr = pmm::paddr_to_vaddr(HEAP_PADDR);
+            // Global pages and PCIDs, then the kernel page table with the
+            // direct map (global 1 GB / 2 MB pages). The heap is used
+            // through the direct map, so its accesses never miss in the
+            // TLB after a process switch; without it, the identity map.
+            //
+            // 4 GB covers every arena and the kernel image UEFI loaded.
+            const DIRECT_MAP_SIZE: u64 = 0x1_0000_0000;
+            crate::arch::amd64::tlb::init_cpu();
+            // Kernel writes to user pages must fault on copy-on-write ones
+            crate::arch::amd64::mmu::x86_enable_write_protect();
+            let direct_map = crate::arch::amd64::mmu::x86_setup_direct_map(DIRECT_MAP_SIZE);
+            if direct_map.is_err() {
+                let msg = b"[INIT] Direct map setup failed, heap stays identity-mapped\n";
+                for &byte in msg {
+                    core::arch::asm!("out dx, al", in("dx") 0xE9u16, in("al") byte, options(nomem, nostack));
+                }
+            }
+
+            let heap_start_vaddr = crate::arch::amd64::mmu::x86_phys_to_direct(HEAP_PADDR)
+                .unwrap_or_else(|| pmm::paddr_to_vaddr(HEAP_PADDR));
 
             let msg = b"[INIT] Using hardcoded heap at 0x";
             for &byte in msg {
@@ -431,6 +453,9 @@ fn init_memory() {
             const HEAP_PAGES: usize = 4096;
             let _ = pmm::pmm_reserve_pages(HEAP_PADDR, HEAP_PAGES);
 
+            // Small allocations come from the size-class slabs from here on
+            crate::mm::slab::enable();
+
             let msg = b"[INIT] Heap initialized successfully (16MB)\n";
             for &byte in msg {
                 core::arch::asm!("out dx, al", in("dx") 0xE9u16, in("al") byte, options(nomem, nostack));
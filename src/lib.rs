@@ -92,6 +92,9 @@ pub mod sched;
 // Kernel initialization
 pub mod init;
 
+// Boot phase markers and deferred initialization
+pub mod boot;
+
 // System call interface
 pub mod syscall;
 
@@ -178,7 +181,9 @@ pub use mm::{
     pmm_alloc_kernel_page,
     pmm_alloc_user_page,
     pmm_alloc_contiguous,
+    pmm_alloc_pages,
     pmm_free_page,
+    pmm_free_pages,
     pmm_free_contiguous,
     pmm_count_free_pages,
     pmm_count_total_pages,
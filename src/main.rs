@@ -9,17 +9,28 @@ extern crate rustux;
 
 use uefi::prelude::*;
 use core::arch::asm;
-use core::ptr::write_volatile;
 
 use rustux::arch::amd64::{descriptor, idt, apic};
+use rustux::boot::{self, InitTask};
 use rustux::drivers::keyboard;
 
-// Note: Global allocator is now in src/mm/allocator.rs (LinkedListAllocator)
+// Note: Global allocator is now in src/mm/allocator.rs (KernelHeap: slabs + LinkedListAllocator)
 // The UEFI allocator is no longer used as the global allocator after exit_boot_services()
 
 // Simple keyboard scancode counter (legacy, for compatibility)
 static mut KEYBOARD_COUNT: u32 = 0;
 
+// ACPI RSDP address from the UEFI configuration table (0 = none)
+static mut ACPI_RSDP: u64 = 0;
+
+/// Page-aligned wrapper for embedded data
+#[repr(C, align(4096))]
+struct PageAligned<T: ?Sized>(T);
+
+/// Embedded ramdisk image (page-aligned so files can be mapped in place)
+static RAMDISK_IMAGE: &PageAligned<[u8]> =
+    &PageAligned(*include_bytes!(concat!(env!("OUT_DIR"), "/ramdisk.bin")));
+
 /// Initialize the 8042 Keyboard Controller
 ///
 /// This is now a wrapper around the new keyboard::init() function.
@@ -35,11 +46,40 @@ fn keyboard_controller_init() {
     }
 }
 
+/// Subsystems init does not wait for: they run after PID 1 starts, on
+/// whichever CPU picks them up first (see `rustux::boot`)
+///
+/// IRQ1 is routed only once the controller is set up, so the interrupt
+/// handler (on the boot CPU, by then running init) cannot take the
+/// controller's replies to the setup commands.
+const DEFERRED_TASKS: [InitTask; 3] = [
+    InitTask { name: "display", deps: &[], run: deferred_display_init },
+    InitTask { name: "keyboard", deps: &[], run: keyboard_controller_init },
+    InitTask { name: "keyboard.irq", deps: &["keyboard"], run: deferred_keyboard_irq },
+];
+
+fn deferred_display_init() {
+    unsafe { init_display_console(); }
+}
+
+fn deferred_keyboard_irq() {
+    apic::apic_io_init(1, 33);
+    // IRQ1 is edge-triggered: a scancode that arrived before the route
+    // would hold the line high and block every later interrupt
+    unsafe {
+        if keyboard::controller_status() & keyboard::ps2::STATUS_OBF != 0 {
+            let _ = keyboard::read_data_port();
+        }
+    }
+}
+
 #[entry]
 fn main() -> Status {
     use uefi::system;
     use uefi::cstr16;
 
+    boot::mark("efi.entry");
+
     // Simple single message - NO special characters, NO reset
     system::with_stdout(|stdout| {
         let msg = cstr16!("EFI OK");
@@ -49,8 +89,9 @@ fn main() -> Status {
     // PROGRESS MARKER: Entry point reached (RED framebuffer)
     fb_red();
 
-    let _acpi_rsdp = find_acpi_rsdp();
+    unsafe { ACPI_RSDP = find_acpi_rsdp().unwrap_or(0); }
     let _memory_map = unsafe { uefi::boot::exit_boot_services(None) };
+    boot::mark("efi.exit");
 
     // PROGRESS MARKER: ExitBootServices succeeded
     // This confirms kernel is fully in control of hardware
@@ -94,9 +135,12 @@ fn kernel_main_on_new_stack() -> ! {
     rustux::init::kernel_init_rest();
     debug_print("[INIT] kernel_init_rest() returned!\n");
 
-    // Setup GDT
+    // Setup GDT (the boot CPU is CPU 0)
     debug_print("[1/5] Setting up GDT...\n");
-    unsafe { descriptor::gdt_setup(); }
+    unsafe {
+        rustux::arch::amd64::percpu::init_cpu(0, apic::apic_local_id());
+        descriptor::gdt_setup();
+    }
     debug_print("      ✓ GDT configured\n");
 
     // Setup IDT
@@ -114,53 +158,95 @@ fn kernel_main_on_new_stack() -> ! {
     unsafe { idt::idt_set_gate(33, keyboard_handler as u64, 0x08, 0x8E); }
     debug_print("      ✓ Keyboard handler at vector 33\n");
 
-    // Install syscall handler (int 0x80)
+    // Install #NM handler (lazy FPU/SSE state switching)
+    unsafe {
+        idt::idt_set_gate(7, rustux::arch::amd64::fpu::x86_device_na_entry as u64, 0x08, 0x8E);
+    }
+    debug_print("      ✓ Lazy FPU handler at vector 7\n");
+
+    // Install #PF handler (demand paging of user memory)
+    unsafe {
+        idt::idt_set_gate(14, rustux::arch::amd64::faults::x86_page_fault_entry as u64, 0x08, 0x8E);
+    }
+    debug_print("      ✓ Page fault handler at vector 14\n");
+
+    // Program the SYSCALL/SYSRET MSRs (fast-path syscall entry)
+    debug_print("[3.55/5] Enabling SYSCALL/SYSRET...\n");
+    unsafe { rustux::arch::amd64::syscall::x86_syscall_init(); }
+    debug_print("      ✓ SYSCALL entry via IA32_LSTAR\n");
+
+    // Install legacy syscall gate (int 0x80, same ABI as SYSCALL)
+    // 0xEE = present, DPL 3, 64-bit interrupt gate (callable from ring 3)
     debug_print("[3.6/5] Installing syscall handler...\n");
-    unsafe { idt::idt_set_gate(0x80, syscall_handler as u64, 0x08, 0x8E); }
+    unsafe {
+        idt::idt_set_gate(
+            0x80,
+            rustux::arch::amd64::syscall::x86_64_int80_entry as u64,
+            0x08,
+            0xEE,
+        );
+    }
     debug_print("      ✓ Syscall handler at vector 0x80\n");
+    boot::mark("cpu");
 
     // Initialize APIC
     debug_print("[4/5] Initializing APIC...\n");
     unsafe { apic::apic_local_init(); }
     debug_print("      ✓ APIC initialized\n");
 
-    // Configure keyboard IRQ
-    debug_print("[4.5/5] Configuring keyboard IRQ...\n");
-    unsafe { apic::apic_io_init(1, 33); }
-    debug_print("      ✓ IRQ1 → Vector 33\n");
+    boot::mark("apic");
 
-    // Initialize keyboard controller
-    debug_print("[4.6/5] Initializing keyboard controller...\n");
-    keyboard_controller_init();
-    debug_print("      ✓ Keyboard controller initialized\n");
+    // The keyboard (and its IRQ1 route) and the display console come up
+    // after init starts
+    for task in DEFERRED_TASKS {
+        if boot::defer(task).is_err() {
+            (task.run)();
+        }
+    }
 
-    // Configure timer
+    // Configure timer (one-shot: armed per time slice and timer deadline)
     debug_print("[5/5] Configuring timer...\n");
-    unsafe {
-        let lapic = 0xFEE00000usize;
-        write_volatile((lapic + 0x3E0) as *mut u32, 0x03);
-        write_volatile((lapic + 0x320) as *mut u32, 32 | (1 << 17));
-        write_volatile((lapic + 0x380) as *mut u32, 10_000_000);
+    apic::apic_timer_init(rustux::arch::amd64::smp::TIMER_VECTOR, true);
+    if apic::apic_timer_tsc_deadline() {
+        debug_print("      ✓ Timer configured (TSC-deadline, tickless)\n\n");
+    } else {
+        debug_print("      ✓ Timer configured (one-shot, tickless)\n\n");
     }
-    debug_print("      ✓ Timer configured\n\n");
+    boot::mark("timer");
 
-    // Initialize display console (Phase 6B)
-    debug_print("╔══════════════════════════════════════════════════════════╗\n");
-    debug_print("║  PHASE 6B: Initializing Display Console                   ║\n");
-    debug_print("╚══════════════════════════════════════════════════════════╝\n\n");
+    // Start the application processors listed in the MADT
+    debug_print("[5.5/5] Starting secondary CPUs...\n");
     unsafe {
-        init_display_console();
+        let rsdp = ACPI_RSDP;
+        let madt = if rsdp != 0 {
+            rustux::acpi::find_and_parse_madt(&*(rsdp as *const rustux::acpi::Rsdp))
+        } else {
+            None
+        };
+        match madt {
+            Some(madt) => {
+                let cpus = rustux::arch::amd64::smp::smp_init(&madt);
+                debug_print("      ✓ CPUs online: ");
+                print_hex(cpus as u64);
+                debug_print("\n\n");
+            }
+            None => debug_print("      ✗ No MADT, running on the boot CPU only\n\n"),
+        }
     }
-    debug_print("      ✓ Display console initialized\n\n");
+    boot::mark("smp");
 
     // Initialize ramdisk (Phase 5C)
     debug_print("╔══════════════════════════════════════════════════════════╗\n");
     debug_print("║  PHASE 5C: Initializing Ramdisk                          ║\n");
     debug_print("╚══════════════════════════════════════════════════════════╝\n\n");
     unsafe {
-        rustux::fs::ramdisk::init_ramdisk(include_bytes!(concat!(env!("OUT_DIR"), "/ramdisk.bin")));
+        // Read through the direct map's large pages, not the firmware's
+        // 4 KB mappings of the kernel image
+        let image = rustux::arch::amd64::mmu::x86_direct_map_alias(&RAMDISK_IMAGE.0);
+        rustux::fs::ramdisk::init_ramdisk(image);
     }
     debug_print("      ✓ Ramdisk initialized\n\n");
+    boot::mark("ramdisk");
 
     // Try to load and execute init.elf from ramdisk (Phase 5D)
     debug_print("╔══════════════════════════════════════════════════════════╗\n");
@@ -195,9 +281,14 @@ fn kernel_main_on_new_stack() -> ! {
         print_hex(init_file.size as u64);
         debug_print(" bytes\n");
 
-        // Read the ELF data from ramdisk
-        let elf_data_ptr = ramdisk.data.as_ptr().add(init_file.data_offset as usize);
-        let elf_data = core::slice::from_raw_parts(elf_data_ptr, init_file.size as usize);
+        // Read the ELF data from ramdisk (decompressing it if needed)
+        let elf_data = match ramdisk.file_data(&init_file) {
+            Ok(data) => data,
+            Err(_) => {
+                debug_print("[INIT] Failed to read init.elf\n\n");
+                false
+            }
+        };
 
         debug_print("[INIT] Loading ELF binary...\n");
 
@@ -215,58 +306,28 @@ fn kernel_main_on_new_stack() -> ! {
         };
 
         debug_print("[INIT] ELF loaded successfully\n");
+        boot::mark("init.load");
         debug_print("[INIT] Entry point: 0x");
         print_hex(process_image.entry);
         debug_print("\n");
 
-        // Allocate kernel stack (4 pages)
-        let kernel_stack_paddrs = [
-            match rustux::mm::pmm::pmm_alloc_kernel_page() {
-                Ok(p) => p,
-                Err(_) => {
-                    debug_print("[INIT] Failed to allocate kernel stack\n");
-                    false
-                }
-            },
-            match rustux::mm::pmm::pmm_alloc_kernel_page() {
-                Ok(p) => p,
-                Err(_) => {
-                    debug_print("[INIT] Failed to allocate kernel stack\n");
-                    false
-                }
-            },
-            match rustux::mm::pmm::pmm_alloc_kernel_page() {
-                Ok(p) => p,
-                Err(_) => {
-                    debug_print("[INIT] Failed to allocate kernel stack\n");
-                    false
-                }
-            },
-            match rustux::mm::pmm::pmm_alloc_kernel_page() {
-                Ok(p) => p,
-                Err(_) => {
-                    debug_print("[INIT] Failed to allocate kernel stack\n");
-                    false
-                }
-            },
-        ];
-
-        // Get the kernel stack virtual addresses
-        let kernel_stack_vaddrs = [
-            rustux::mm::pmm::paddr_to_vaddr(kernel_stack_paddrs[0]),
-            rustux::mm::pmm::paddr_to_vaddr(kernel_stack_paddrs[1]),
-            rustux::mm::pmm::paddr_to_vaddr(kernel_stack_paddrs[2]),
-            rustux::mm::pmm::paddr_to_vaddr(kernel_stack_paddrs[3]),
-        ];
+        // Allocate kernel stack (4 contiguous pages)
+        let kernel_stack_paddr = match rustux::mm::pmm::pmm_alloc_pages(2, rustux::mm::pmm::PMM_ALLOC_FLAG_KERNEL) {
+            Ok(p) => p,
+            Err(_) => {
+                debug_print("[INIT] Failed to allocate kernel stack\n");
+                false
+            }
+        };
 
         // Stack grows down, so top is at the highest address
-        let kernel_stack_top = (kernel_stack_vaddrs[3] + 4096) as u64;
+        let kernel_stack_top = (rustux::mm::pmm::paddr_to_vaddr(kernel_stack_paddr) + 4 * 4096) as u64;
 
         // Get page table physical address
         let page_table_phys = process_image.address_space.page_table.phys;
 
         // Create process with PID 1
-        let process = Process::new(
+        let mut process = Process::new(
             1,  // PID 1 (init)
             0,  // PPID 0 (kernel)
             page_table_phys,
@@ -279,9 +340,19 @@ fn kernel_main_on_new_stack() -> ! {
         let mut name_owned = alloc::string::String::from("init");
         process.set_name(name_owned);
 
-        // Add to process table
+        // Add to process table; init is running from here on
+        let now = rustux::arch::amd64::tsc::tsc_ticks();
+        if let Some(task) = process.task.as_mut() {
+            task.state = rustux::process::table::ProcessState::Running;
+        }
         PROCESS_TABLE.lock().insert(process);
-        PROCESS_TABLE.lock().set_current(1);
+        {
+            let mut queue = rustux::sched::runqueue::RUN_QUEUES.lock(rustux::arch::amd64::percpu::this_cpu());
+            queue.set_current(Some(1));
+            queue.account_switch(None, Some(1), now);
+        }
+        rustux::sched::round_robin::this_scheduler().lock().set_current(1);
+        rustux::sched::tickless::start_slice(now, true, rustux::sched::round_robin::DEFAULT_TIME_SLICE_MS);
 
         debug_print("[INIT] Process created with PID 1\n");
         debug_print("[INIT] Kernel stack: 0x");
@@ -298,18 +369,24 @@ fn kernel_main_on_new_stack() -> ! {
         debug_print("║  Jumping to Init Process (Userspace)                   ║\n");
         debug_print("╚══════════════════════════════════════════════════════════╝\n\n");
 
-        // Execute the init process - never returns
-        rustux::arch::amd64::uspace::execute_process(
-            process_image.entry,
-            process_image.stack_top,
-            page_table_phys,
-        );
+        // Last kernel instruction before init's first: the deferred
+        // subsystems start from here, alongside it
+        boot::mark("user");
+        boot::release();
+
+        // Switch to init (on its own kernel stack, so its kernel entries
+        // land there) - never returns. This boot context becomes the
+        // CPU's idle loop
+        rustux::sched::round_robin::enter_first_process(1);
 
         // Unreachable
         false
     };
 
     if !init_loaded {
+        // Bring up the console and keyboard anyway, for whoever looks
+        boot::release();
+        boot::run_deferred();
         debug_print("[INIT] Failed to load init process, halting...\n");
         loop { unsafe { asm!("hlt"); } }
     }
@@ -345,64 +422,21 @@ pub extern "x86-interrupt" fn keyboard_handler(_sf: idt::X86Iframe) {
 
         // Debug: show we received an interrupt
         // debug_print("[K]\n");
-
-        // Send EOI to LAPIC (write 0 to EOI register at offset 0x40)
-        let lapic = 0xFEE00000usize;
-        write_volatile((lapic + 0x40) as *mut u32, 0);
     }
-}
 
-// Timer handler (Vector 32)
-#[no_mangle]
-pub extern "x86-interrupt" fn timer_handler(_sf: idt::X86Iframe) {
-    unsafe {
-        let msg = b"[TICK]\n";
-        for &b in msg {
-            asm!("out dx, al", in("dx") 0xE9u16, in("al") b, options(nomem, nostack, preserves_flags));
-        }
-        let lapic = 0xFEE00000usize;
-        write_volatile((lapic + 0xB0) as *mut u32, 0);
-    }
+    // An unacknowledged IRQ1 would also hold off the timer (same
+    // priority class)
+    apic::apic_issue_eoi();
 }
 
-// Syscall handler (int 0x80 = Vector 0x80)
+// Timer handler (Vector 32)
 //
-// This handler is invoked when userspace executes `int 0x80`.
-// It extracts the syscall number and arguments from the interrupt frame
-// and dispatches to the appropriate syscall implementation.
+// The timer is one-shot: acknowledge it first, since the slice check may
+// switch to another process before this returns
 #[no_mangle]
-pub extern "x86-interrupt" fn syscall_handler(sf: idt::X86Iframe) {
-    use rustux::syscall::{SyscallArgs, syscall_dispatch};
-
-    // PROOF: Syscall reached - fill top half CYAN to verify
-    unsafe {
-        if FRAMEBUFFER_ADDR != 0 {
-            let fb_ptr = FRAMEBUFFER_ADDR as *mut u16;
-            let pixel_count = FRAMEBUFFER_SIZE as usize / 2;
-            // Fill top half with CYAN (RGB565: 0x07FF)
-            for i in 0..(pixel_count / 2) {
-                *(fb_ptr.add(i)) = 0x07FF;
-            }
-        }
-    }
-
-    let syscall_num = sf.rax as u32;
-
-    // Note: The int 0x80 ABI uses ebx/ecx/edx for args 0/1/2
-    let syscall_args = SyscallArgs::new(
-        syscall_num,
-        [
-            sf.rbx as usize,  // arg0 (ebx)
-            sf.rcx as usize,  // arg1 (ecx)
-            sf.rdx as usize,  // arg2 (edx)
-            sf.r10 as usize,  // arg3 (not used by int 0x80, but we have it in the frame)
-            sf.r8  as usize,  // arg4 (not used by int 0x80)
-            sf.r9  as usize,  // arg5 (not used by int 0x80)
-        ],
-    );
-
-    // Call the syscall dispatcher
-    let _ret = syscall_dispatch(syscall_args);
+pub extern "x86-interrupt" fn timer_handler(_sf: idt::X86Iframe) {
+    apic::apic_issue_eoi();
+    unsafe { rustux::sched::tickless::timer_interrupt(); }
 }
 
 fn find_acpi_rsdp() -> Option<u64> {
@@ -579,8 +613,14 @@ pub fn get_framebuffer_height() -> usize {
 ///
 /// This function should be called after fb_green() to initialize
 /// the text console using the framebuffer information.
+///
+/// The console writes the framebuffer through a write-combining mapping
+/// and draws into a back buffer in RAM; without either it falls back to
+/// the firmware's mapping or to drawing on screen.
 pub unsafe fn init_display_console() {
+    use rustux::arch::amd64::mmu;
     use rustux::drivers::display::{Framebuffer, PixelFormat, init as display_init};
+    use rustux::mm::pmm;
 
     if FRAMEBUFFER_ADDR == 0 {
         debug_print("[DISPLAY] No framebuffer available, skipping console init\n");
@@ -590,9 +630,19 @@ pub unsafe fn init_display_console() {
     // Calculate pitch (stride) from width and bytes per pixel
     let bpp = 16; // RGB565
     let pitch = FRAMEBUFFER_WIDTH * (bpp / 8);
+    let size = pitch * FRAMEBUFFER_HEIGHT;
+
+    // The firmware identity-maps the framebuffer, so its address is physical
+    let front = match mmu::x86_map_write_combining(FRAMEBUFFER_ADDR, size) {
+        Ok(vaddr) => vaddr as u64,
+        Err(_) => {
+            debug_print("[DISPLAY] No write-combining mapping, using the firmware's\n");
+            FRAMEBUFFER_ADDR
+        }
+    };
 
-    let framebuffer = Framebuffer::new(
-        FRAMEBUFFER_ADDR,
+    let mut framebuffer = Framebuffer::new(
+        front,
         FRAMEBUFFER_WIDTH,
         FRAMEBUFFER_HEIGHT,
         pitch,
@@ -600,6 +650,12 @@ pub unsafe fn init_display_console() {
         PixelFormat::RGB,
     );
 
+    let pages = (size + 4095) / 4096;
+    match pmm::pmm_alloc_contiguous(pages, pmm::PMM_ALLOC_FLAG_ANY, 12) {
+        Ok(paddr) => framebuffer.attach_back_buffer(pmm::paddr_to_vaddr(paddr) as u64),
+        Err(_) => debug_print("[DISPLAY] No memory for a back buffer, drawing on screen\n"),
+    }
+
     display_init(framebuffer);
 
     debug_print("[DISPLAY] Text console initialized\n");
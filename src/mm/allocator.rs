@@ -9,6 +9,10 @@
 //! This module provides a linked list allocator for the kernel heap.
 //! It supports allocation, deallocation, and memory reuse.
 //!
+//! The global allocator ([`KernelHeap`]) sends requests of up to 4 KB to
+//! the size-class slabs in [`crate::mm::slab`] once they are enabled, and
+//! only large or over-aligned ones to the linked list.
+//!
 //! # Design
 //!
 //! The allocator uses a simple linked list approach where free blocks
@@ -30,8 +34,19 @@
 //! // Free memory
 //! deallocate(ptr, size, align);
 //! ```
+//!
+//! # Diagnostics
+//!
+//! The debug-port telemetry (heap init, the first allocations, the heap
+//! summary) is only built with the `heap_debug` feature: every byte is a
+//! port write, which costs a VM exit, and boot does hundreds of them.
 
 use crate::arch::amd64::mm::page_tables::PAGE_SIZE;
+use crate::mm::slab;
+use crate::sync::SpinMutex;
+
+/// Whether to print heap telemetry to the debug port
+const HEAP_DEBUG: bool = cfg!(feature = "heap_debug");
 
 // Align helper function (local to this module)
 fn align_page_up(addr: usize) -> usize {
@@ -152,45 +167,47 @@ impl LinkedListAllocator {
         self.initialized = true;
 
         // Print heap init telemetry once
-        let msg = b"[HEAP] init base=0x";
-        for &byte in msg {
-            core::arch::asm!("out dx, al", in("dx") 0xE9u16, in("al") byte, options(nomem, nostack));
-        }
-        let mut n = heap_start;
-        let mut buf = [0u8; 16];
-        let mut i = 0;
-        loop {
-            buf[i] = if (n & 0xF) < 10 { b'0' + (n & 0xF) as u8 } else { b'a' + (n & 0xF) as u8 - 10 };
-            n >>= 4;
-            i += 1;
-            if n == 0 { break; }
-        }
-        while i > 0 {
-            i -= 1;
-            core::arch::asm!("out dx, al", in("dx") 0xE9u16, in("al") buf[i], options(nomem, nostack));
-        }
+        if HEAP_DEBUG {
+            let msg = b"[HEAP] init base=0x";
+            for &byte in msg {
+                core::arch::asm!("out dx, al", in("dx") 0xE9u16, in("al") byte, options(nomem, nostack));
+            }
+            let mut n = heap_start;
+            let mut buf = [0u8; 16];
+            let mut i = 0;
+            loop {
+                buf[i] = if (n & 0xF) < 10 { b'0' + (n & 0xF) as u8 } else { b'a' + (n & 0xF) as u8 - 10 };
+                n >>= 4;
+                i += 1;
+                if n == 0 { break; }
+            }
+            while i > 0 {
+                i -= 1;
+                core::arch::asm!("out dx, al", in("dx") 0xE9u16, in("al") buf[i], options(nomem, nostack));
+            }
 
-        let msg = b" size=";
-        for &byte in msg {
-            core::arch::asm!("out dx, al", in("dx") 0xE9u16, in("al") byte, options(nomem, nostack));
-        }
-        let size_mb = heap_size / (1024 * 1024);
-        let mut n = size_mb;
-        let mut buf = [0u8; 16];
-        let mut i = 0;
-        loop {
-            buf[i] = b'0' + (n % 10) as u8;
-            n /= 10;
-            i += 1;
-            if n == 0 { break; }
-        }
-        while i > 0 {
-            i -= 1;
-            core::arch::asm!("out dx, al", in("dx") 0xE9u16, in("al") buf[i], options(nomem, nostack));
-        }
-        let msg = b"MB\n";
-        for &byte in msg {
-            core::arch::asm!("out dx, al", in("dx") 0xE9u16, in("al") byte, options(nomem, nostack));
+            let msg = b" size=";
+            for &byte in msg {
+                core::arch::asm!("out dx, al", in("dx") 0xE9u16, in("al") byte, options(nomem, nostack));
+            }
+            let size_mb = heap_size / (1024 * 1024);
+            let mut n = size_mb;
+            let mut buf = [0u8; 16];
+            let mut i = 0;
+            loop {
+                buf[i] = b'0' + (n % 10) as u8;
+                n /= 10;
+                i += 1;
+                if n == 0 { break; }
+            }
+            while i > 0 {
+                i -= 1;
+                core::arch::asm!("out dx, al", in("dx") 0xE9u16, in("al") buf[i], options(nomem, nostack));
+            }
+            let msg = b"MB\n";
+            for &byte in msg {
+                core::arch::asm!("out dx, al", in("dx") 0xE9u16, in("al") byte, options(nomem, nostack));
+            }
         }
 
         // Initialize the heap as a single free block
@@ -224,7 +241,7 @@ impl LinkedListAllocator {
         // Log allocation request for first 30 allocations
         static mut ALLOC_COUNT: u32 = 0;
         ALLOC_COUNT += 1;
-        if ALLOC_COUNT <= 30 {
+        if HEAP_DEBUG && ALLOC_COUNT <= 30 {
             let msg = b"[HEAP] alloc request size=";
             for &byte in msg {
                 core::arch::asm!("out dx, al", in("dx") 0xE9u16, in("al") byte, options(nomem, nostack));
@@ -278,8 +295,8 @@ impl LinkedListAllocator {
 
         // Debug: entering while loop
         static mut LOOP_COUNT: u32 = 0;
-        let my_loop = LOOP_COUNT;
-        LOOP_COUNT += 1;
+        let my_loop = if HEAP_DEBUG { LOOP_COUNT } else { u32::MAX };
+        LOOP_COUNT = LOOP_COUNT.saturating_add(1);
 
         if my_loop < 20 {
             let msg = b"[HEAP] entering while loop\n";
@@ -942,9 +959,9 @@ impl LinkedListAllocator {
         count
     }
 
-    /// Print heap summary
+    /// Print heap summary (a no-op without the `heap_debug` feature)
     pub unsafe fn print_summary(&self) {
-        if !self.initialized {
+        if !HEAP_DEBUG || !self.initialized {
             return;
         }
 
@@ -1058,6 +1075,12 @@ impl LinkedListAllocator {
 /// Global allocator instance
 static mut ALLOCATOR: LinkedListAllocator = LinkedListAllocator::new();
 
+/// Serializes [`ALLOCATOR`] between CPUs for the global allocator
+///
+/// Taken with interrupts disabled: an interrupt handler that allocates
+/// must not find its own CPU holding it.
+static HEAP_LOCK: SpinMutex<()> = SpinMutex::new(());
+
 /// Initialize the heap allocator
 ///
 /// # Arguments
@@ -1162,32 +1185,58 @@ pub fn heap_available() -> usize {
     unsafe { ALLOCATOR.available() }
 }
 
-/// Print heap summary for debugging
+/// Print heap summary for debugging (needs the `heap_debug` feature)
 pub fn heap_print_summary() {
     unsafe { ALLOCATOR.print_summary() }
 }
 
+/// Check whether a pointer lies inside the linked-list heap region
+fn in_linked_heap(ptr: *mut u8) -> bool {
+    unsafe {
+        let start = ALLOCATOR.heap_start;
+        (ptr as usize) >= start && (ptr as usize) < start + ALLOCATOR.heap_size
+    }
+}
+
 // ============================================================================
 // GlobalAlloc Implementation
 // ============================================================================
 
 use alloc::alloc::{GlobalAlloc, Layout};
 
-// SAFETY: The allocator is only used in a single-threaded early kernel environment
-// The raw pointers inside are protected by the fact that there's no concurrent access
-unsafe impl Sync for LinkedListAllocator {}
+/// Kernel global allocator: slabs for small objects, linked list for the rest
+///
+/// Frees are routed by address: anything inside the linked-list heap
+/// region goes back there (including small objects allocated before the
+/// slabs were enabled), everything else to its slab class.
+pub struct KernelHeap;
 
-unsafe impl GlobalAlloc for LinkedListAllocator {
+unsafe impl GlobalAlloc for KernelHeap {
     unsafe fn alloc(&self, layout: Layout) -> *mut u8 {
-        // Use a mutable reference to self for the allocation
-        // Note: This is a workaround - GlobalAlloc takes &self but we need &mut self
-        // In a single-threaded early kernel environment, this is safe
-        let allocator = &ALLOCATOR as *const LinkedListAllocator as *mut LinkedListAllocator;
+        if slab::is_enabled() {
+            if let Some(class) = slab::class_index(layout.size(), layout.align()) {
+                let ptr = slab::KERNEL_SLAB.alloc(class);
+                if !ptr.is_null() {
+                    return ptr;
+                }
+            }
+        }
+
+        let _guard = HEAP_LOCK.lock_irqsave();
+        let allocator = &raw mut ALLOCATOR;
         (*allocator).allocate(layout.size(), layout.align())
     }
 
     unsafe fn dealloc(&self, ptr: *mut u8, layout: Layout) {
-        let allocator = &ALLOCATOR as *const LinkedListAllocator as *mut LinkedListAllocator;
+        if !in_linked_heap(ptr) {
+            if let Some(class) = slab::class_index(layout.size(), layout.align()) {
+                slab::KERNEL_SLAB.free(ptr, class);
+                return;
+            }
+        }
+
+        let _guard = HEAP_LOCK.lock_irqsave();
+        let allocator = &raw mut ALLOCATOR;
         (*allocator).deallocate(ptr, layout.size(), layout.align());
     }
 }
@@ -1196,7 +1245,7 @@ unsafe impl GlobalAlloc for LinkedListAllocator {
 ///
 /// This is exported as the global allocator for the Rust standard library.
 #[global_allocator]
-static HEAP_ALLOCATOR: LinkedListAllocator = LinkedListAllocator::new();
+static HEAP_ALLOCATOR: KernelHeap = KernelHeap;
 
 #[cfg(test)]
 mod tests {
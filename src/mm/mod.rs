@@ -13,6 +13,7 @@
 //!
 //! - [`pmm`] - Physical Memory Manager for allocating physical pages
 //! - [`allocator`] - Heap allocator for dynamic memory allocation
+//! - [`slab`] - Size-class slabs with per-CPU caches for small allocations
 //!
 //! # Usage
 //!
@@ -54,6 +55,7 @@
 
 pub mod pmm;
 pub mod allocator;
+pub mod slab;
 
 // Re-export PAGE_SIZE explicitly from page_tables to avoid ambiguity
 pub use crate::arch::amd64::mm::page_tables::PAGE_SIZE;
@@ -81,6 +83,10 @@ pub use pmm::{
     PMM_ALLOC_FLAG_LOW_MEM,
     PMM_ALLOC_FLAG_KERNEL,
     PMM_ALLOC_FLAG_USER,
+    // Buddy orders
+    PMM_MAX_ORDER,
+    PMM_HUGE_PAGE_ORDER,
+    order_for_pages,
     // Zone constants
     KERNEL_ZONE_START,
     KERNEL_ZONE_END,
@@ -93,9 +99,12 @@ pub use pmm::{
     pmm_alloc_kernel_page,
     pmm_alloc_user_page,
     pmm_alloc_contiguous,
+    pmm_alloc_pages,
+    pmm_free_pages,
     pmm_free_page,
     pmm_free_contiguous,
     pmm_count_free_pages,
+    pmm_arena_free_blocks,
     pmm_count_total_pages,
     pmm_count_total_bytes,
     paddr_to_page,
@@ -4,33 +4,33 @@
 // license that can be found in the LICENSE file or at
 // https://opensource.org/licenses/MIT
 
-//! Physical Memory Manager (PMM) - Vec-Based Implementation
+//! Physical Memory Manager (PMM) - Buddy Allocator
 //!
-//! This is a simplified PMM using a Vec-based page array with linear scan allocation.
-//! This replaces the bitmap-based PMM which had a bug in the atomic bitmap handling.
-//!
-//! # Architecture Note
-//!
-//! This represents the "Early Kernel PMM" stage - simple, reliable, proven to work.
+//! Each arena keeps its free pages in naturally aligned power-of-two
+//! blocks, one free list per order up to [`PMM_MAX_ORDER`]. Allocating
+//! 2^N pages splits the smallest large-enough block; freeing merges a
+//! block with its buddy for as long as the buddy is free too. Both are
+//! O(PMM_MAX_ORDER), and multi-page runs (kernel stacks, DMA buffers,
+//! 2 MB huge pages) come out physically contiguous and aligned.
 //!
 //! # Design
 //!
-//! - Uses a Vec of Page structures with state tracking
-//! - Linear scan allocation (O(N) where N = total pages)
-//! - No atomic operations (single-threaded initially)
+//! - A Vec of Page structures per arena, with state tracking
+//! - Free blocks linked through their first page's Page structure
+//! - One spinlock per arena
+//! - Per-CPU hot caches of single pages in front of each arena, so the
+//!   common 4 KB allocate/free does not take the arena lock
 //! - Simple state enum: Free | Allocated | Reserved
 //!
-//! # Migration Path
-//!
-//! Phase A (NOW): Use this Vec-based PMM to unblock userspace
-//! Phase B (LATER): Reintroduce bitmap PMM with proper testing as optimization
-//!
 //! # Usage
 //!
 //! ```rust
 //! // Allocate a single page
 //! let page = pmm::pmm_alloc_page(0)?;
 //!
+//! // Allocate a 2 MB-aligned 2 MB block
+//! let huge = pmm::pmm_alloc_pages(pmm::PMM_HUGE_PAGE_ORDER, pmm::PMM_ALLOC_FLAG_USER)?;
+//!
 //! // Free a page
 //! pmm::pmm_free_page(page);
 //!
@@ -45,9 +45,11 @@ use crate::arch::amd64::mm::{
     RxResult,
     page_tables::PAGE_SIZE
 };
-use core::sync::atomic::{AtomicU64, AtomicUsize, Ordering};
+use crate::arch::amd64::percpu::{self, MAX_CPUS};
+use crate::sync::SpinMutex;
+use core::sync::atomic::{AtomicU32, AtomicUsize, Ordering};
 
-/// Global PMM allocation call counter
+/// Global PMM allocation failure counter
 static ALLOC_CALL_COUNT: AtomicUsize = AtomicUsize::new(0);
 
 /// Helper: Print decimal number to debug console
@@ -232,8 +234,15 @@ pub struct Page {
     /// Arena index this page belongs to
     pub arena_index: u8,
 
+    /// Buddy order of the free block this page heads ([`NOT_HEAD`] otherwise)
+    pub order: u8,
+
     /// Page index within arena
     pub page_index: u32,
+
+    /// Next and previous free block of the same order (page indices)
+    next: u32,
+    prev: u32,
 }
 
 impl Page {
@@ -244,7 +253,10 @@ impl Page {
             state: PageState::Free,
             ref_count: 0,
             arena_index,
+            order: NOT_HEAD,
             page_index,
+            next: NO_PAGE,
+            prev: NO_PAGE,
         }
     }
 
@@ -254,7 +266,37 @@ impl Page {
     }
 }
 
+/// ============================================================================
+/// Buddy Allocator
+/// ============================================================================
+
+/// Largest buddy order (2^10 pages = 4 MB blocks)
+pub const PMM_MAX_ORDER: u8 = 10;
+
+/// Order of a 2 MB (huge page) block
+pub const PMM_HUGE_PAGE_ORDER: u8 = 9;
+
+/// [`Page::order`] of a page that does not head a free block
+pub const NOT_HEAD: u8 = 0xFF;
+
+/// End-of-list marker for the free block links
+const NO_PAGE: u32 = u32::MAX;
+
+/// Number of free lists per arena
+const NUM_ORDERS: usize = PMM_MAX_ORDER as usize + 1;
+
+/// Smallest order whose block holds `count` pages
+pub fn order_for_pages(count: usize) -> u8 {
+    count.max(1).next_power_of_two().trailing_zeros() as u8
+}
+
 /// Memory arena structure
+///
+/// Free pages are kept in power-of-two blocks on per-order free lists.
+/// Blocks are aligned to their size in physical frame numbers, so an
+/// order-9 block is a 2 MB-aligned 2 MB region. Every page of a free
+/// block is `Free`; only the first page (the head) carries the block's
+/// order and list links.
 struct Arena {
     /// Arena information
     info: ArenaInfo,
@@ -265,8 +307,14 @@ struct Arena {
     /// Total number of pages
     total_count: u64,
 
-    /// Lock for arena operations (spinlock for now)
-    locked: core::sync::atomic::AtomicBool,
+    /// Physical frame number of the first page
+    base_pfn: u64,
+
+    /// First free block of each order (page index)
+    free_heads: [u32; NUM_ORDERS],
+
+    /// Pages on the free lists
+    free_pages: u64,
 }
 
 impl Arena {
@@ -276,54 +324,248 @@ impl Arena {
             info,
             pages: alloc::vec::Vec::new(),
             total_count: 0,
-            locked: core::sync::atomic::AtomicBool::new(false),
+            base_pfn: 0,
+            free_heads: [NO_PAGE; NUM_ORDERS],
+            free_pages: 0,
         }
     }
 
-    /// Initialize the arena with page structures
+    /// Initialize the arena with page structures (all free)
     fn init(&mut self, pages: alloc::vec::Vec<Page>) {
         self.total_count = pages.len() as u64;
         self.pages = pages;
+        self.base_pfn = self.info.base >> PAGE_SIZE_SHIFT;
+        self.free_heads = [NO_PAGE; NUM_ORDERS];
+        self.free_pages = 0;
+
+        let count = self.pages.len();
+        let mut index = 0;
+        while index < count {
+            let order = self.largest_order_at(index, count);
+            self.push_free(index, order);
+            self.free_pages += 1 << order;
+            index += 1 << order;
+        }
     }
 
-    /// Allocate a single page from this arena
-    fn alloc_page(&mut self) -> Option<PAddr> {
-        // Simple linear scan for free page
-        for page in &mut self.pages {
-            if page.is_free() {
-                page.state = PageState::Allocated;
-                page.ref_count = 1;
-                return Some(page.paddr);
+    /// Largest block order that starts at `index` and ends by `end`
+    fn largest_order_at(&self, index: usize, end: usize) -> u8 {
+        let pfn = self.base_pfn + index as u64;
+        let mut order = 0u8;
+        while order < PMM_MAX_ORDER
+            && pfn & ((2u64 << order) - 1) == 0
+            && index + (2usize << order) <= end
+        {
+            order += 1;
+        }
+        order
+    }
+
+    /// Put a block at the head of its free list
+    fn push_free(&mut self, index: usize, order: u8) {
+        let head = self.free_heads[order as usize];
+        let page = &mut self.pages[index];
+        page.order = order;
+        page.prev = NO_PAGE;
+        page.next = head;
+        if head != NO_PAGE {
+            self.pages[head as usize].prev = index as u32;
+        }
+        self.free_heads[order as usize] = index as u32;
+    }
+
+    /// Take a block off its free list
+    fn remove_free(&mut self, index: usize) {
+        let (order, prev, next) = {
+            let page = &self.pages[index];
+            (page.order, page.prev, page.next)
+        };
+        if prev == NO_PAGE {
+            self.free_heads[order as usize] = next;
+        } else {
+            self.pages[prev as usize].next = next;
+        }
+        if next != NO_PAGE {
+            self.pages[next as usize].prev = prev;
+        }
+        let page = &mut self.pages[index];
+        page.order = NOT_HEAD;
+        page.next = NO_PAGE;
+        page.prev = NO_PAGE;
+    }
+
+    /// Allocate a naturally aligned block of 2^order pages
+    ///
+    /// Returns the index of its first page.
+    fn alloc_block(&mut self, order: u8) -> Option<usize> {
+        let mut found = order;
+        while found <= PMM_MAX_ORDER && self.free_heads[found as usize] == NO_PAGE {
+            found += 1;
+        }
+        if found > PMM_MAX_ORDER {
+            return None;
+        }
+
+        let index = self.free_heads[found as usize] as usize;
+        self.remove_free(index);
+
+        // Split down, returning the upper halves
+        while found > order {
+            found -= 1;
+            self.push_free(index + (1 << found), found);
+        }
+
+        for page in &mut self.pages[index..index + (1 << order)] {
+            page.state = PageState::Allocated;
+            page.ref_count = 1;
+        }
+        self.free_pages -= 1 << order;
+        Some(index)
+    }
+
+    /// Free a naturally aligned block of allocated pages, coalescing
+    /// it with free buddies
+    fn free_block(&mut self, index: usize, order: u8) {
+        for page in &mut self.pages[index..index + (1 << order)] {
+            page.state = PageState::Free;
+            page.ref_count = 0;
+        }
+        self.free_pages += 1 << order;
+
+        let count = self.pages.len();
+        let (mut index, mut order) = (index, order);
+        while order < PMM_MAX_ORDER {
+            let pfn = self.base_pfn + index as u64;
+            let buddy_pfn = pfn ^ (1u64 << order);
+            if buddy_pfn < self.base_pfn {
+                break;
+            }
+            let buddy = (buddy_pfn - self.base_pfn) as usize;
+            if buddy + (1 << order) > count {
+                break;
+            }
+            let page = &self.pages[buddy];
+            if page.state != PageState::Free || page.order != order {
+                break;
             }
+
+            self.remove_free(buddy);
+            index = index.min(buddy);
+            order += 1;
         }
-        None
+        self.push_free(index, order);
     }
 
-    /// Free a page back to this arena
-    fn free_page(&mut self, paddr: PAddr) -> RxStatus {
-        let offset = paddr - self.info.base;
-        if offset % PAGE_SIZE as PAddr != 0 {
+    /// Free an arbitrary run of allocated pages
+    ///
+    /// Fails without freeing anything if a page in the run is already free.
+    fn free_range(&mut self, index: usize, count: usize) -> RxStatus {
+        let end = index + count;
+        if end > self.pages.len() {
             return RxStatus::ERR_INVALID_ARGS;
         }
-
-        let index = (offset / PAGE_SIZE as PAddr) as usize;
-        if index >= self.total_count as usize {
+        if self.pages[index..end].iter().any(|p| p.is_free()) {
             return RxStatus::ERR_INVALID_ARGS;
         }
 
-        self.pages[index].state = PageState::Free;
-        self.pages[index].ref_count = 0;
+        let mut index = index;
+        while index < end {
+            let order = self.largest_order_at(index, end);
+            self.free_block(index, order);
+            index += 1 << order;
+        }
         RxStatus::OK
     }
 
-    /// Check if a physical address is within this arena
-    fn address_in_arena(&self, addr: PAddr) -> bool {
-        addr >= self.info.base && addr < (self.info.base + self.info.size as PAddr)
+    /// Take one specific free page out of the buddy lists
+    ///
+    /// Splits the free block containing it. Returns false if the page is
+    /// not free.
+    fn claim_page(&mut self, index: usize, state: PageState) -> bool {
+        if !self.pages[index].is_free() {
+            return false;
+        }
+
+        // Find the head of the free block containing the page
+        let pfn = self.base_pfn + index as u64;
+        let mut found = None;
+        for order in 0..=PMM_MAX_ORDER {
+            let head_pfn = pfn & !((1u64 << order) - 1);
+            if head_pfn < self.base_pfn {
+                break;
+            }
+            let head = (head_pfn - self.base_pfn) as usize;
+            let page = &self.pages[head];
+            if page.is_free() && page.order == order {
+                found = Some((head, order));
+                break;
+            }
+        }
+        let Some((mut head, mut order)) = found else {
+            return false;
+        };
+
+        self.remove_free(head);
+        while order > 0 {
+            order -= 1;
+            let half = 1 << order;
+            if index >= head + half {
+                self.push_free(head, order);
+                head += half;
+            } else {
+                self.push_free(head + half, order);
+            }
+        }
+
+        let page = &mut self.pages[index];
+        page.state = state;
+        page.ref_count = if state == PageState::Allocated { 1 } else { 0 };
+        self.free_pages -= 1;
+        true
+    }
+
+    /// Allocate `count` contiguous pages aligned to 2^align_order pages
+    fn alloc_contiguous(&mut self, count: usize, align_order: u8) -> Option<usize> {
+        let order = order_for_pages(count).max(align_order);
+        if order <= PMM_MAX_ORDER {
+            let index = self.alloc_block(order)?;
+            // Give back the tail the request does not need
+            let block = 1usize << order;
+            if count < block {
+                let _ = self.free_range(index + count, block - count);
+            }
+            return Some(index);
+        }
+
+        // Larger than any block: find a run of free pages
+        let align = 1usize << align_order;
+        let total = self.pages.len();
+        let mut start = (align - (self.base_pfn as usize % align)) % align;
+        while start + count <= total {
+            match self.pages[start..start + count].iter().position(|p| !p.is_free()) {
+                Some(busy) => {
+                    start += busy + 1;
+                    start = (start + align - 1) / align * align;
+                }
+                None => {
+                    for index in start..start + count {
+                        self.claim_page(index, PageState::Allocated);
+                    }
+                    return Some(start);
+                }
+            }
+        }
+        None
+    }
+
+    /// Physical address of a page index
+    fn page_paddr(&self, index: usize) -> PAddr {
+        self.info.base + (index as PAddr) * PAGE_SIZE as PAddr
     }
 
-    /// Count free pages in this arena
+    /// Count free pages in this arena (not counting per-CPU caches)
     fn count_free_pages(&self) -> u64 {
-        self.pages.iter().filter(|p| p.is_free()).count() as u64
+        self.free_pages
     }
 
     /// Count total pages in this arena
@@ -333,43 +575,190 @@ impl Arena {
 }
 
 /// Global arena array
-static mut ARENAS: [Arena; MAX_ARENAS] = [
-    Arena::new(ArenaInfo::new(
-        b"empty\0\0\0\0\0\0\0\0\0\0\0\0\0\0",
-        0, 0, 0, 0
-    )),
-    Arena::new(ArenaInfo::new(
-        b"empty\0\0\0\0\0\0\0\0\0\0\0\0\0\0",
-        0, 0, 0, 0
-    )),
-    Arena::new(ArenaInfo::new(
-        b"empty\0\0\0\0\0\0\0\0\0\0\0\0\0\0",
-        0, 0, 0, 0
-    )),
-    Arena::new(ArenaInfo::new(
-        b"empty\0\0\0\0\0\0\0\0\0\0\0\0\0\0",
-        0, 0, 0, 0
-    )),
-    Arena::new(ArenaInfo::new(
-        b"empty\0\0\0\0\0\0\0\0\0\0\0\0\0\0",
-        0, 0, 0, 0
-    )),
-    Arena::new(ArenaInfo::new(
-        b"empty\0\0\0\0\0\0\0\0\0\0\0\0\0\0",
-        0, 0, 0, 0
-    )),
-    Arena::new(ArenaInfo::new(
+static ARENAS: [SpinMutex<Arena>; MAX_ARENAS] = {
+    const EMPTY: SpinMutex<Arena> = SpinMutex::new(Arena::new(ArenaInfo::new(
         b"empty\0\0\0\0\0\0\0\0\0\0\0\0\0\0",
         0, 0, 0, 0
-    )),
-    Arena::new(ArenaInfo::new(
-        b"empty\0\0\0\0\0\0\0\0\0\0\0\0\0\0",
-        0, 0, 0, 0
-    )),
-];
+    )));
+    [EMPTY; MAX_ARENAS]
+};
+
+/// Arena information and page arrays, readable without the arena locks
+///
+/// Written once per arena by pmm_add_arena() before the arena is counted
+/// in NUM_ARENAS; the page arrays never move afterwards.
+static mut ARENA_INFO: [ArenaInfo; MAX_ARENAS] = [ArenaInfo::new(b"empty", 0, 0, 0, 0); MAX_ARENAS];
+static mut ARENA_PAGES: [usize; MAX_ARENAS] = [0; MAX_ARENAS];
 
 /// Number of arenas currently in use
-static mut NUM_ARENAS: usize = 0;
+static NUM_ARENAS: AtomicUsize = AtomicUsize::new(0);
+
+/// Information of the arenas in use
+fn arena_infos() -> &'static [ArenaInfo] {
+    let count = NUM_ARENAS.load(Ordering::Acquire);
+    unsafe { &(&*(&raw const ARENA_INFO))[..count] }
+}
+
+/// Check if an arena may serve an allocation with `flags`
+fn arena_matches(info: &ArenaInfo, flags: u32) -> bool {
+    match flags {
+        PMM_ALLOC_FLAG_LOW_MEM => info.flags & ARENA_FLAG_LOW_MEM != 0,
+        PMM_ALLOC_FLAG_KERNEL => info.flags & ARENA_FLAG_KERNEL != 0,
+        PMM_ALLOC_FLAG_USER => info.flags & ARENA_FLAG_USER != 0,
+        _ => true,
+    }
+}
+
+/// Arena and page index of a page-aligned physical address
+fn locate_page(paddr: PAddr) -> Option<(usize, usize)> {
+    if paddr % PAGE_SIZE as PAddr != 0 {
+        return None;
+    }
+    let arena_index = arena_infos()
+        .iter()
+        .position(|info| paddr >= info.base && paddr < info.end())?;
+    let index = ((paddr - arena_infos()[arena_index].base) >> PAGE_SIZE_SHIFT) as usize;
+    Some((arena_index, index))
+}
+
+/// Page structure of a located page, without taking the arena lock
+///
+/// # Safety
+///
+/// `(arena_index, index)` must come from [`locate_page`], and the caller
+/// must own the page (allocated to it, or held in its hot cache).
+unsafe fn page_entry(arena_index: usize, index: usize) -> &'static mut Page {
+    &mut *((*(&raw const ARENA_PAGES))[arena_index] as *mut Page).add(index)
+}
+
+/// ============================================================================
+/// Per-CPU Hot Page Caches
+/// ============================================================================
+
+/// Order-0 pages a per-CPU cache holds per arena
+const HOT_CACHE_SIZE: usize = 32;
+
+/// Pages moved between a cache and its arena at a time
+const HOT_CACHE_BATCH: usize = HOT_CACHE_SIZE / 2;
+
+/// Recently freed single pages of one arena, kept by one CPU
+///
+/// Cached pages stay `Allocated` (with a zero reference count) in the
+/// page array, so the buddy lists never coalesce them. Single-page
+/// allocation and free on a CPU normally touch only its cache; the arena
+/// lock is taken once per batch.
+///
+/// A busy cache (an interrupt handler allocating on top of the code it
+/// interrupted) is bypassed for the arena. Arenas are only ever locked
+/// with interrupts disabled, so that fallback cannot spin on an arena
+/// lock its own CPU holds.
+struct HotCache {
+    pages: [u32; HOT_CACHE_SIZE],
+    count: usize,
+}
+
+impl HotCache {
+    const fn new() -> Self {
+        Self { pages: [0; HOT_CACHE_SIZE], count: 0 }
+    }
+
+    /// Move pages out of the arena until the cache is half full
+    fn refill(&mut self, arena: &mut Arena) {
+        while self.count < HOT_CACHE_BATCH {
+            let Some(index) = arena.alloc_block(0) else { break };
+            arena.pages[index].ref_count = 0;
+            self.pages[self.count] = index as u32;
+            self.count += 1;
+        }
+    }
+
+    /// Give `count` cached pages back to the arena
+    fn flush(&mut self, arena: &mut Arena, count: usize) {
+        for _ in 0..count.min(self.count) {
+            self.count -= 1;
+            arena.free_block(self.pages[self.count] as usize, 0);
+        }
+    }
+}
+
+/// Hot page caches, by CPU and arena
+static HOT_CACHES: [[SpinMutex<HotCache>; MAX_ARENAS]; MAX_CPUS] = {
+    const EMPTY: SpinMutex<HotCache> = SpinMutex::new(HotCache::new());
+    const CPU: [SpinMutex<HotCache>; MAX_ARENAS] = [EMPTY; MAX_ARENAS];
+    [CPU; MAX_CPUS]
+};
+
+/// Allocate one page from an arena, through this CPU's cache
+fn alloc_hot_page(arena_index: usize) -> Option<PAddr> {
+    let info = arena_infos()[arena_index];
+    let Some(mut cache) = HOT_CACHES[percpu::this_cpu()][arena_index].try_lock() else {
+        // Interrupted a cache operation on this CPU: go to the arena
+        let mut arena = ARENAS[arena_index].lock_irqsave();
+        let index = arena.alloc_block(0)?;
+        return Some(arena.page_paddr(index));
+    };
+
+    if cache.count == 0 {
+        cache.refill(&mut ARENAS[arena_index].lock_irqsave());
+        if cache.count == 0 {
+            return None;
+        }
+    }
+
+    cache.count -= 1;
+    let index = cache.pages[cache.count] as usize;
+    unsafe { page_entry(arena_index, index) }.ref_count = 1;
+    Some(info.base + (index as PAddr) * PAGE_SIZE as PAddr)
+}
+
+/// Free one page of an arena into this CPU's cache
+fn free_hot_page(arena_index: usize, index: usize) -> RxStatus {
+    let (state, ref_count) = {
+        let page = unsafe { page_entry(arena_index, index) };
+        (page.state, page.ref_count)
+    };
+    if state != PageState::Allocated {
+        // Reserved, or a double free (which the buddy lists reject)
+        return ARENAS[arena_index].lock_irqsave().free_range(index, 1);
+    }
+    if ref_count == 0 {
+        // Already sitting in a hot cache
+        return RxStatus::ERR_INVALID_ARGS;
+    }
+
+    let Some(mut cache) = HOT_CACHES[percpu::this_cpu()][arena_index].try_lock() else {
+        ARENAS[arena_index].lock_irqsave().free_block(index, 0);
+        return RxStatus::OK;
+    };
+
+    if cache.count == HOT_CACHE_SIZE {
+        cache.flush(&mut ARENAS[arena_index].lock_irqsave(), HOT_CACHE_BATCH);
+    }
+    unsafe { page_entry(arena_index, index) }.ref_count = 0;
+    let count = cache.count;
+    cache.pages[count] = index as u32;
+    cache.count += 1;
+    RxStatus::OK
+}
+
+/// Return every CPU's cached pages of an arena to its buddy lists
+///
+/// Caches in use at the moment are skipped.
+fn drain_hot_caches(arena_index: usize) {
+    for cpu in 0..MAX_CPUS {
+        let Some(mut cache) = HOT_CACHES[cpu][arena_index].try_lock() else { continue };
+        if cache.count > 0 {
+            cache.flush(&mut ARENAS[arena_index].lock_irqsave(), HOT_CACHE_SIZE);
+        }
+    }
+}
+
+/// Number of pages held in per-CPU caches for an arena
+fn hot_cached_pages(arena_index: usize) -> u64 {
+    (0..MAX_CPUS)
+        .map(|cpu| HOT_CACHES[cpu][arena_index].lock().count as u64)
+        .sum()
+}
 
 /// Early PMM initialization
 ///
@@ -416,8 +805,13 @@ pub unsafe fn pmm_init_early(
 /// # Returns
 ///
 /// `RxStatus::OK` on success, or an error code
+///
+/// # Safety
+///
+/// Must not run concurrently with another pmm_add_arena() call.
 pub unsafe fn pmm_add_arena(info: ArenaInfo) -> RxStatus {
-    if NUM_ARENAS >= MAX_ARENAS {
+    let arena_index = NUM_ARENAS.load(Ordering::Acquire);
+    if arena_index >= MAX_ARENAS {
         return RxStatus::ERR_NO_MEMORY;
     }
 
@@ -445,18 +839,13 @@ pub unsafe fn pmm_add_arena(info: ArenaInfo) -> RxStatus {
         heap_ptr
     };
 
-    let pages = core::ptr::slice_from_raw_parts_mut(
-        pages_ptr as *mut Page,
-        page_count,
-    );
-
     // Initialize page structures using pointer arithmetic
     let pages_slice = unsafe {
         core::slice::from_raw_parts_mut(pages_ptr as *mut Page, page_count)
     };
 
     for i in 0..page_count {
-        pages_slice[i] = Page::new(info.base + (i as PAddr) * PAGE_SIZE as PAddr, NUM_ARENAS as u8, i as u32);
+        pages_slice[i] = Page::new(info.base + (i as PAddr) * PAGE_SIZE as PAddr, arena_index as u8, i as u32);
     }
 
     // Create Vec from the initialized memory using from_raw_parts
@@ -465,12 +854,16 @@ pub unsafe fn pmm_add_arena(info: ArenaInfo) -> RxStatus {
         alloc::vec::Vec::from_raw_parts(pages_ptr as *mut Page, page_count, page_count)
     };
 
-    // Initialize arena
-    let arena = &mut ARENAS[NUM_ARENAS];
-    arena.info = info;
-    arena.init(pages_vec);
+    // Initialize arena (builds the buddy free lists)
+    {
+        let mut arena = ARENAS[arena_index].lock_irqsave();
+        arena.info = info;
+        arena.init(pages_vec);
+    }
+    (*(&raw mut ARENA_INFO))[arena_index] = info;
+    (*(&raw mut ARENA_PAGES))[arena_index] = pages_ptr as usize;
 
-    NUM_ARENAS += 1;
+    NUM_ARENAS.store(arena_index + 1, Ordering::Release);
     RxStatus::OK
 }
 
@@ -492,6 +885,29 @@ pub unsafe fn set_boot_allocator(alloc: BootAllocFn) {
     BOOT_ALLOC = Some(alloc);
 }
 
+/// Report that no arena could satisfy an allocation
+fn report_exhausted(flags: u32, order: u8) {
+    let call_num = ALLOC_CALL_COUNT.fetch_add(1, Ordering::Relaxed);
+    unsafe {
+        let msg = b"[PMM] EXHAUSTED: failure #";
+        for &byte in msg {
+            core::arch::asm!("out dx, al", in("dx") 0xE9u16, in("al") byte, options(nomem, nostack));
+        }
+        print_decimal(call_num + 1);
+        let msg = b" flags=";
+        for &byte in msg {
+            core::arch::asm!("out dx, al", in("dx") 0xE9u16, in("al") byte, options(nomem, nostack));
+        }
+        print_decimal(flags as usize);
+        let msg = b" order=";
+        for &byte in msg {
+            core::arch::asm!("out dx, al", in("dx") 0xE9u16, in("al") byte, options(nomem, nostack));
+        }
+        print_decimal(order as usize);
+        core::arch::asm!("out dx, al", in("dx") 0xE9u16, in("al") b'\n', options(nomem, nostack));
+    }
+}
+
 /// Allocate a single physical page
 ///
 /// # Arguments
@@ -501,107 +917,31 @@ pub unsafe fn set_boot_allocator(alloc: BootAllocFn) {
 /// # Returns
 ///
 /// Physical address of the allocated page, or an error
+///
+/// Single pages come from the calling CPU's hot page cache when it has
+/// one, and from the buddy lists otherwise.
 pub fn pmm_alloc_page(flags: u32) -> RxResult<PAddr> {
-    // Increment and get call number
-    let call_num = ALLOC_CALL_COUNT.fetch_add(1, Ordering::Relaxed);
-
-    let arenas = unsafe { &mut ARENAS[..NUM_ARENAS] };
-
-    // Debug: Log which allocator is being called WITH CALL NUMBER
-    unsafe {
-        let msg = b"[PMM] Call #";
-        for &byte in msg {
-            core::arch::asm!("out dx, al", in("dx") 0xE9u16, in("al") byte, options(nomem, nostack));
-        }
-        print_decimal(call_num);
-
-        // Print allocation type separately
-        if flags == PMM_ALLOC_FLAG_KERNEL {
-            let msg = b" alloc_kernel_page\n";
-            for &byte in msg {
-                core::arch::asm!("out dx, al", in("dx") 0xE9u16, in("al") byte, options(nomem, nostack));
-            }
-        } else if flags == PMM_ALLOC_FLAG_USER {
-            let msg = b" alloc_user_page\n";
-            for &byte in msg {
-                core::arch::asm!("out dx, al", in("dx") 0xE9u16, in("al") byte, options(nomem, nostack));
-            }
-        } else {
-            let msg = b" alloc_page(GENERIC)\n";
-            for &byte in msg {
-                core::arch::asm!("out dx, al", in("dx") 0xE9u16, in("al") byte, options(nomem, nostack));
-            }
-        }
-    }
-
-    // Try to allocate from matching arenas
-    for arena in arenas {
-        // Filter arenas based on requested flags
-        if flags == PMM_ALLOC_FLAG_LOW_MEM && (arena.info.flags & ARENA_FLAG_LOW_MEM) == 0 {
-            continue;
-        }
-        if flags == PMM_ALLOC_FLAG_KERNEL && (arena.info.flags & ARENA_FLAG_KERNEL) == 0 {
-            continue;
-        }
-        if flags == PMM_ALLOC_FLAG_USER && (arena.info.flags & ARENA_FLAG_USER) == 0 {
+    for (arena_index, info) in arena_infos().iter().enumerate() {
+        if !arena_matches(info, flags) {
             continue;
         }
-
-        if let Some(paddr) = arena.alloc_page() {
-            // Debug: Log SUCCESS with call number
-            unsafe {
-                let msg = b"[PMM] Call #";
-                for &byte in msg {
-                    core::arch::asm!("out dx, al", in("dx") 0xE9u16, in("al") byte, options(nomem, nostack));
-                }
-                print_decimal(call_num);
-                let msg = b" SUCCESS -> 0x";
-                for &byte in msg {
-                    core::arch::asm!("out dx, al", in("dx") 0xE9u16, in("al") byte, options(nomem, nostack));
-                }
-                // Print address in hex
-                let mut n = paddr;
-                let mut buf = [0u8; 16];
-                let mut i = 0;
-                loop {
-                    let digit = (n & 0xF) as u8;
-                    buf[i] = if digit < 10 { b'0' + digit } else { b'a' + digit - 10 };
-                    n >>= 4;
-                    i += 1;
-                    if n == 0 { break; }
-                }
-                while i > 0 {
-                    i -= 1;
-                    core::arch::asm!("out dx, al", in("dx") 0xE9u16, in("al") buf[i], options(nomem, nostack));
-                }
-                let msg = b"\n";
-                for &byte in msg {
-                    core::arch::asm!("out dx, al", in("dx") 0xE9u16, in("al") byte, options(nomem, nostack));
-                }
-            }
+        if let Some(paddr) = alloc_hot_page(arena_index) {
             return Ok(paddr);
         }
     }
 
-    // Debug: Log exhaustion
-    unsafe {
-        let msg = b"[PMM] Call #";
-        for &byte in msg {
-            core::arch::asm!("out dx, al", in("dx") 0xE9u16, in("al") byte, options(nomem, nostack));
-        }
-        print_decimal(call_num);
-        let msg = b" FAILED - PMM EXHAUSTED\n";
-        for &byte in msg {
-            core::arch::asm!("out dx, al", in("dx") 0xE9u16, in("al") byte, options(nomem, nostack));
+    // Pages may be parked in other CPUs' caches
+    for (arena_index, info) in arena_infos().iter().enumerate() {
+        if !arena_matches(info, flags) {
+            continue;
         }
-        // Halt with distinctive pattern
-        let msg = b"[PMM] EXHAUSTED - HALTING\n";
-        for &byte in msg {
-            core::arch::asm!("out dx, al", in("dx") 0xE9u16, in("al") byte, options(nomem, nostack));
+        drain_hot_caches(arena_index);
+        if let Some(paddr) = alloc_hot_page(arena_index) {
+            return Ok(paddr);
         }
-        loop {}
     }
 
+    report_exhausted(flags, 0);
     Err(RxStatus::ERR_NO_MEMORY)
 }
 
@@ -633,65 +973,85 @@ pub fn pmm_alloc_user_page() -> RxResult<PAddr> {
     pmm_alloc_page(PMM_ALLOC_FLAG_USER)
 }
 
+/// Allocate a naturally aligned block of 2^order physical pages
+///
+/// # Arguments
+///
+/// * `order` - Block order (0 = 4 KB, [`PMM_HUGE_PAGE_ORDER`] = 2 MB)
+/// * `flags` - Allocation flags
+///
+/// # Returns
+///
+/// Physical address of the block (aligned to its size), or an error.
+/// Free it with [`pmm_free_pages`] or page by page.
+pub fn pmm_alloc_pages(order: u8, flags: u32) -> RxResult<PAddr> {
+    if order > PMM_MAX_ORDER {
+        return Err(RxStatus::ERR_INVALID_ARGS);
+    }
+    if order == 0 {
+        return pmm_alloc_page(flags);
+    }
+
+    for (arena_index, info) in arena_infos().iter().enumerate() {
+        if !arena_matches(info, flags) {
+            continue;
+        }
+        let mut arena = ARENAS[arena_index].lock_irqsave();
+        if let Some(index) = arena.alloc_block(order) {
+            return Ok(arena.page_paddr(index));
+        }
+    }
+
+    report_exhausted(flags, order);
+    Err(RxStatus::ERR_NO_MEMORY)
+}
+
+/// Free a block allocated with [`pmm_alloc_pages`]
+pub fn pmm_free_pages(paddr: PAddr, order: u8) -> RxStatus {
+    if order > PMM_MAX_ORDER {
+        return RxStatus::ERR_INVALID_ARGS;
+    }
+    pmm_free_contiguous(paddr, 1 << order)
+}
+
 /// Allocate multiple contiguous physical pages
 ///
 /// # Arguments
 ///
 /// * `count` - Number of pages to allocate
 /// * `flags` - Allocation flags
-/// * `align_log2` - Alignment as log2 (0 = page aligned, 12 = 4KB, etc.)
+/// * `align_log2` - Alignment as log2 of bytes (0 or 12 = page aligned,
+///   21 = 2 MB, etc.)
 ///
 /// # Returns
 ///
 /// Physical address of the allocated region, or an error
 ///
-/// Note: For the Vec-based PMM, contiguous allocation is implemented
-/// by finding sequential free pages. This is simpler than the bitmap version
-/// but may be slower for large allocations.
-pub fn pmm_alloc_contiguous(count: usize, flags: u32, _align_log2: u8) -> RxResult<PAddr> {
+/// The region is cut from a buddy block of the next power of two; the
+/// unused tail goes straight back to the free lists. Runs larger than
+/// the biggest block fall back to a scan for free pages.
+pub fn pmm_alloc_contiguous(count: usize, flags: u32, align_log2: u8) -> RxResult<PAddr> {
     if count == 0 {
         return Err(RxStatus::ERR_INVALID_ARGS);
     }
 
     // For single pages, use the regular allocator
-    if count == 1 {
+    let align_order = align_log2.saturating_sub(PAGE_SIZE_SHIFT);
+    if count == 1 && align_order == 0 {
         return pmm_alloc_page(flags);
     }
 
-    // For multiple pages, try to find contiguous free pages
-    let arenas = unsafe { &mut ARENAS[..NUM_ARENAS] };
-
-    for arena in arenas {
-        if flags == PMM_ALLOC_FLAG_LOW_MEM && (arena.info.flags & ARENA_FLAG_LOW_MEM) == 0 {
+    for (arena_index, info) in arena_infos().iter().enumerate() {
+        if !arena_matches(info, flags) {
             continue;
         }
-
-        // Try to find contiguous free pages
-        let mut start_index = 0;
-        let total_count = arena.total_count as usize;
-
-        while start_index + count <= total_count {
-            // Check if all pages in this range are free
-            let mut all_free = true;
-            for page_idx in start_index..(start_index + count) {
-                if !arena.pages[page_idx].is_free() {
-                    all_free = false;
-                    start_index = page_idx + 1; // Start from next page
-                    break;
-                }
-            }
-
-            if all_free {
-                // Mark all pages as allocated
-                for page_idx in start_index..(start_index + count) {
-                    arena.pages[page_idx].state = PageState::Allocated;
-                    arena.pages[page_idx].ref_count = 1;
-                }
-                return Ok(arena.info.base + (start_index as PAddr) * PAGE_SIZE as PAddr);
-            }
+        let mut arena = ARENAS[arena_index].lock_irqsave();
+        if let Some(index) = arena.alloc_contiguous(count, align_order) {
+            return Ok(arena.page_paddr(index));
         }
     }
 
+    report_exhausted(flags, order_for_pages(count));
     Err(RxStatus::ERR_NO_MEMORY)
 }
 
@@ -705,16 +1065,10 @@ pub fn pmm_alloc_contiguous(count: usize, flags: u32, _align_log2: u8) -> RxResu
 ///
 /// `RxStatus::OK` on success, or an error code
 pub fn pmm_free_page(paddr: PAddr) -> RxStatus {
-    let arenas = unsafe { &mut ARENAS[..NUM_ARENAS] };
-
-    // Find the arena containing this page
-    for arena in arenas {
-        if arena.address_in_arena(paddr) {
-            return arena.free_page(paddr);
-        }
+    match locate_page(paddr) {
+        Some((arena_index, index)) => free_hot_page(arena_index, index),
+        None => RxStatus::ERR_INVALID_ARGS,
     }
-
-    RxStatus::ERR_INVALID_ARGS
 }
 
 /// Free multiple contiguous physical pages
@@ -727,40 +1081,105 @@ pub fn pmm_free_page(paddr: PAddr) -> RxStatus {
 /// # Returns
 ///
 /// `RxStatus::OK` on success, or an error code
+///
+/// Any run of allocated pages may be freed this way, whether it came from
+/// one allocation or several; the pages coalesce with their buddies.
 pub fn pmm_free_contiguous(paddr: PAddr, count: usize) -> RxStatus {
     if count == 0 {
         return RxStatus::ERR_INVALID_ARGS;
     }
 
-    let arenas = unsafe { &mut ARENAS[..NUM_ARENAS] };
+    match locate_page(paddr) {
+        Some((arena_index, index)) => ARENAS[arena_index].lock_irqsave().free_range(index, count),
+        None => RxStatus::ERR_INVALID_ARGS,
+    }
+}
 
-    // Find the arena containing this page range
-    for arena in arenas {
-        let end_addr = paddr + (count as PAddr) * PAGE_SIZE as PAddr;
+/// ============================================================================
+/// Page Reference Counts
+/// ============================================================================
+//
+// An allocated page starts with one reference, its allocator's. Pages
+// shared copy-on-write (VMO clones) take one more per sharer, and the
+// last release frees the page. References change without the arena
+// lock, so they are updated atomically in place.
+
+/// Reference count of an allocated page
+fn page_refs(paddr: PAddr) -> Option<&'static AtomicU32> {
+    let (arena_index, index) = locate_page(paddr)?;
+    let page = unsafe { page_entry(arena_index, index) };
+    if page.state != PageState::Allocated {
+        return None;
+    }
+    // SAFETY: ref_count is an aligned u32 inside the arena's page array,
+    // which is never freed
+    Some(unsafe { AtomicU32::from_ptr(&raw mut page.ref_count) })
+}
 
-        if arena.address_in_arena(paddr) && arena.address_in_arena(end_addr - 1) {
-            // Free each page
-            for i in 0..count {
-                let page_paddr = paddr + (i as PAddr) * PAGE_SIZE as PAddr;
-                let _ = arena.free_page(page_paddr);
-            }
-            return RxStatus::OK;
+/// Take another reference to an allocated page
+///
+/// # Returns
+///
+/// `RxStatus::OK`, or `ERR_INVALID_ARGS` if the PMM does not own an
+/// allocated page at `paddr` (such as kernel image memory)
+pub fn pmm_page_ref(paddr: PAddr) -> RxStatus {
+    match page_refs(paddr) {
+        Some(refs) => {
+            refs.fetch_add(1, Ordering::Relaxed);
+            RxStatus::OK
+        }
+        None => RxStatus::ERR_INVALID_ARGS,
+    }
+}
+
+/// Drop a reference to an allocated page, freeing it with the last one
+pub fn pmm_page_unref(paddr: PAddr) -> RxStatus {
+    let Some(refs) = page_refs(paddr) else {
+        return RxStatus::ERR_INVALID_ARGS;
+    };
+
+    let mut count = refs.load(Ordering::Acquire);
+    loop {
+        if count <= 1 {
+            // Ours was the last: freeing resets the count
+            return pmm_free_page(paddr);
+        }
+        match refs.compare_exchange_weak(count, count - 1, Ordering::AcqRel, Ordering::Acquire) {
+            Ok(_) => return RxStatus::OK,
+            Err(current) => count = current,
         }
     }
+}
 
-    RxStatus::ERR_INVALID_ARGS
+/// References held on a page (0 if the PMM does not own it)
+pub fn pmm_page_ref_count(paddr: PAddr) -> u32 {
+    page_refs(paddr).map_or(0, |refs| refs.load(Ordering::Acquire))
 }
 
 /// Get the number of free pages across all arenas
 pub fn pmm_count_free_pages() -> u64 {
-    let arenas = unsafe { &ARENAS[..NUM_ARENAS] };
-    let mut count = 0u64;
+    (0..arena_infos().len())
+        .map(|arena_index| {
+            ARENAS[arena_index].lock_irqsave().count_free_pages() + hot_cached_pages(arena_index)
+        })
+        .sum()
+}
 
-    for arena in arenas {
-        count += arena.count_free_pages();
+/// Number of free blocks of each order in an arena (None if no such arena)
+pub fn pmm_arena_free_blocks(arena_index: usize) -> Option<[u32; NUM_ORDERS]> {
+    if arena_index >= arena_infos().len() {
+        return None;
     }
-
-    count
+    let arena = ARENAS[arena_index].lock_irqsave();
+    let mut blocks = [0u32; NUM_ORDERS];
+    for (order, count) in blocks.iter_mut().enumerate() {
+        let mut index = arena.free_heads[order];
+        while index != NO_PAGE {
+            *count += 1;
+            index = arena.pages[index as usize].next;
+        }
+    }
+    Some(blocks)
 }
 
 /// Reserve a range of physical pages
@@ -778,40 +1197,29 @@ pub fn pmm_reserve_pages(paddr: PAddr, count: usize) -> RxStatus {
         return RxStatus::ERR_INVALID_ARGS;
     }
 
-    let arenas = unsafe { &mut ARENAS[..NUM_ARENAS] };
-
-    // Find the arena containing this page range
-    for arena in arenas {
-        let end_addr = paddr + (count as PAddr) * PAGE_SIZE as PAddr;
+    let Some((arena_index, first)) = locate_page(align_page_down(paddr as usize) as PAddr) else {
+        return RxStatus::ERR_INVALID_ARGS;
+    };
 
-        if arena.address_in_arena(paddr) && arena.address_in_arena(end_addr - 1) {
-            // Mark each page as reserved
-            for i in 0..count {
-                let page_paddr = paddr + (i as PAddr) * PAGE_SIZE as PAddr;
-                let offset = page_paddr - arena.info.base;
-                let index = (offset / PAGE_SIZE as PAddr) as usize;
+    // Cached pages look allocated: put them back on the free lists first
+    drain_hot_caches(arena_index);
 
-                if index < arena.total_count as usize {
-                    arena.pages[index].state = PageState::Reserved;
-                }
-            }
-            return RxStatus::OK;
+    let mut arena = ARENAS[arena_index].lock_irqsave();
+    let end = (first + count).min(arena.pages.len());
+    for index in first..end {
+        if !arena.claim_page(index, PageState::Reserved) {
+            // Already allocated: keep it from ever being freed for reuse
+            arena.pages[index].state = PageState::Reserved;
         }
     }
-
-    RxStatus::ERR_INVALID_ARGS
+    RxStatus::OK
 }
 
 /// Get the total number of pages across all arenas
 pub fn pmm_count_total_pages() -> u64 {
-    let arenas = unsafe { &ARENAS[..NUM_ARENAS] };
-    let mut count = 0u64;
-
-    for arena in arenas {
-        count += arena.count_total_pages();
-    }
-
-    count
+    (0..arena_infos().len())
+        .map(|arena_index| ARENAS[arena_index].lock_irqsave().count_total_pages())
+        .sum()
 }
 
 /// Get the total amount of physical memory in bytes
@@ -829,23 +1237,10 @@ pub fn pmm_count_total_bytes() -> u64 {
 ///
 /// Pointer to the page structure, or null if not found
 pub fn paddr_to_page(paddr: PAddr) -> *mut Page {
-    let num_arenas = unsafe { NUM_ARENAS };
-    let arenas = unsafe { &ARENAS[..num_arenas] };
-
-    for arena_idx in 0..num_arenas {
-        let arena = &arenas[arena_idx];
-        if arena.address_in_arena(paddr) {
-            let offset = paddr - arena.info.base;
-            let index = (offset / PAGE_SIZE as PAddr) as usize;
-            if index < arena.total_count as usize {
-                // Get raw pointer to the page
-                let pages_ptr = arena.pages.as_ptr() as *mut Page;
-                return unsafe { pages_ptr.add(index) };
-            }
-        }
+    match locate_page(align_page_down(paddr as usize) as PAddr) {
+        Some((arena_index, index)) => unsafe { page_entry(arena_index, index) },
+        None => core::ptr::null_mut(),
     }
-
-    core::ptr::null_mut()
 }
 
 /// Kernel physical offset for direct-mapped physical memory
@@ -910,6 +1305,22 @@ pub fn paddr_to_vaddr_user_zone(paddr: PAddr) -> VAddr {
     }
 }
 
+/// Convert a kernel virtual address back to its physical address
+///
+/// Inverse of paddr_to_vaddr(): works for the identity-mapped low region
+/// (which holds the kernel image) and the direct map. Returns None for
+/// any other address.
+pub fn vaddr_to_paddr(vaddr: VAddr) -> Option<PAddr> {
+    let vaddr = vaddr as u64;
+    if vaddr < IDENTITY_MAP_LIMIT {
+        Some(vaddr as PAddr)
+    } else if vaddr >= KERNEL_PHYS_OFFSET {
+        Some((vaddr - KERNEL_PHYS_OFFSET) as PAddr)
+    } else {
+        None
+    }
+}
+
 /// Allocate a single page (convenience wrapper)
 pub fn alloc_page() -> RxResult<PAddr> {
     pmm_alloc_page(0)
@@ -919,3 +1330,87 @@ pub fn alloc_page() -> RxResult<PAddr> {
 pub fn free_page(paddr: PAddr) {
     let _ = pmm_free_page(paddr);
 }
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    fn test_arena(base: PAddr, count: usize) -> Arena {
+        let info = ArenaInfo::new(b"test", 0, 0, base, count * PAGE_SIZE);
+        let pages = (0..count)
+            .map(|i| Page::new(base + (i * PAGE_SIZE) as PAddr, 0, i as u32))
+            .collect();
+        let mut arena = Arena::new(info);
+        arena.init(pages);
+        arena
+    }
+
+    fn free_blocks(arena: &Arena, order: u8) -> usize {
+        let mut count = 0;
+        let mut index = arena.free_heads[order as usize];
+        while index != NO_PAGE {
+            count += 1;
+            index = arena.pages[index as usize].next;
+        }
+        count
+    }
+
+    #[test]
+    fn test_buddy_split_and_coalesce() {
+        let mut arena = test_arena(0x20_0000, 16);
+        assert_eq!(free_blocks(&arena, 4), 1);
+
+        assert_eq!(arena.alloc_block(0), Some(0));
+        assert_eq!(arena.free_pages, 15);
+        for order in 0..4 {
+            assert_eq!(free_blocks(&arena, order), 1);
+        }
+        assert_eq!(arena.alloc_block(2), Some(4));
+
+        arena.free_block(0, 0);
+        arena.free_block(4, 2);
+        assert_eq!(arena.free_pages, 16);
+        assert_eq!(free_blocks(&arena, 4), 1);
+        assert!(arena.pages.iter().all(|p| p.is_free()));
+    }
+
+    #[test]
+    fn test_buddy_blocks_are_naturally_aligned() {
+        // PFNs 1..8: blocks of 1 (PFN 1), 2 (PFN 2) and 4 (PFN 4) pages
+        let mut arena = test_arena(0x1000, 7);
+        assert_eq!(free_blocks(&arena, 0), 1);
+        assert_eq!(free_blocks(&arena, 1), 1);
+        assert_eq!(free_blocks(&arena, 2), 1);
+
+        assert_eq!(arena.alloc_block(2), Some(3));
+        assert_eq!(arena.alloc_block(2), None);
+
+        // The PFN 4 block's buddy (PFN 0) is outside the arena
+        arena.free_block(3, 2);
+        assert_eq!(free_blocks(&arena, 2), 1);
+        assert_eq!(free_blocks(&arena, 3), 0);
+    }
+
+    #[test]
+    fn test_contiguous_claim_and_free_range() {
+        let mut arena = test_arena(0x20_0000, 16);
+
+        // Three pages from a four-page block; the fourth goes back
+        assert_eq!(arena.alloc_contiguous(3, 0), Some(0));
+        assert_eq!(arena.free_pages, 13);
+        assert!(arena.pages[3].is_free());
+
+        assert!(arena.claim_page(9, PageState::Reserved));
+        assert!(!arena.claim_page(9, PageState::Reserved));
+        assert_eq!(arena.free_pages, 12);
+
+        assert_eq!(arena.free_range(0, 3), RxStatus::OK);
+        assert_eq!(arena.free_range(0, 1), RxStatus::ERR_INVALID_ARGS);
+        assert_eq!(arena.free_pages, 15);
+        assert_eq!(arena.pages[9].state, PageState::Reserved);
+        assert_eq!(free_blocks(&arena, 3), 1);
+
+        // 8-page alignment skips over the reserved page's block
+        assert_eq!(arena.alloc_contiguous(2, 3), Some(0));
+    }
+}
@@ -0,0 +1,462 @@
+// Copyright 2025 The Rustux Authors
+//
+// Use of this source code is governed by a MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT
+
+//! Size-Class Slab Allocator
+//!
+//! Small kernel allocations (channel message buffers, boxed ELF images,
+//! handles, process names) are served from power-of-two size classes of
+//! 16 bytes to 4 KB. Each class carves whole pages from the PMM into
+//! equal objects and keeps the free ones on an intrusive list, so an
+//! allocation or free is a list pop or push instead of a first-fit heap
+//! walk, and objects of one size never fragment memory for another.
+//!
+//! # Design
+//!
+//! - Objects are aligned to their class size (pages are page-aligned), so
+//!   any layout with `align <= size` fits the class of `max(size, align)`.
+//! - Each CPU has a magazine (a small stack of free objects) per class in
+//!   front of the shared class depot. The fast path touches only the
+//!   calling CPU's magazine; the depot lock is taken once per
+//!   [`MAGAZINE_BATCH`] objects when a magazine runs dry or overflows.
+//! - No header is stored with an object: the caller's layout selects the
+//!   class again on free (as `GlobalAlloc::dealloc` guarantees).
+//! - Pages stay with their class once carved (they are reused, not
+//!   returned to the PMM).
+//!
+//! Magazines are taken with `try_lock`: if one is busy (an interrupt
+//! handler allocating on top of the code it interrupted) the request goes
+//! straight to the depot instead of deadlocking. Depots are only ever
+//! locked with interrupts disabled, so the interrupted code cannot be
+//! holding the depot the handler falls back to.
+
+use core::sync::atomic::{AtomicBool, AtomicU64, Ordering};
+
+use crate::arch::amd64::mm::page_tables::PAGE_SIZE;
+use crate::arch::amd64::percpu::{self, MAX_CPUS};
+use crate::mm::pmm;
+use crate::sync::SpinMutex;
+
+/// Smallest size class (bytes)
+pub const MIN_CLASS_SIZE: usize = 16;
+
+/// Largest size class (bytes); larger requests go to the linked-list heap
+pub const MAX_CLASS_SIZE: usize = 4096;
+
+/// Number of size classes (16, 32, ..., 4096)
+pub const NUM_CLASSES: usize = 9;
+
+/// Objects a per-CPU magazine holds
+const MAGAZINE_SIZE: usize = 32;
+
+/// Objects moved between a magazine and its depot at a time
+const MAGAZINE_BATCH: usize = MAGAZINE_SIZE / 2;
+
+/// Free object link (stored in the free object itself)
+struct FreeObject {
+    next: *mut FreeObject,
+}
+
+/// ============================================================================
+/// Size Classes
+/// ============================================================================
+
+/// Size class index for an allocation, or None if it is too large
+pub fn class_index(size: usize, align: usize) -> Option<usize> {
+    let size = size.max(align).max(MIN_CLASS_SIZE);
+    if size > MAX_CLASS_SIZE {
+        return None;
+    }
+    let shift = size.next_power_of_two().trailing_zeros() as usize;
+    Some(shift - MIN_CLASS_SIZE.trailing_zeros() as usize)
+}
+
+/// Object size of a size class
+pub const fn class_size(index: usize) -> usize {
+    MIN_CLASS_SIZE << index
+}
+
+/// ============================================================================
+/// Class Depot
+/// ============================================================================
+
+/// Shared free list and page count of one size class
+struct SlabDepot {
+    /// Free objects not held by any magazine
+    free: *mut FreeObject,
+
+    /// Number of objects on `free`
+    free_count: usize,
+
+    /// Pages carved for this class
+    pages: usize,
+}
+
+// Safety: the free objects are only reached through the depot lock
+unsafe impl Send for SlabDepot {}
+
+impl SlabDepot {
+    const fn new() -> Self {
+        Self { free: core::ptr::null_mut(), free_count: 0, pages: 0 }
+    }
+
+    unsafe fn push(&mut self, object: *mut u8) {
+        let object = object as *mut FreeObject;
+        (*object).next = self.free;
+        self.free = object;
+        self.free_count += 1;
+    }
+
+    unsafe fn pop(&mut self) -> *mut u8 {
+        let object = self.free;
+        if !object.is_null() {
+            self.free = (*object).next;
+            self.free_count -= 1;
+        }
+        object as *mut u8
+    }
+
+    /// Split a fresh page into objects of `size` bytes
+    unsafe fn carve(&mut self, page: *mut u8, size: usize) {
+        // Push in reverse so the page is handed out in address order
+        for i in (0..PAGE_SIZE / size).rev() {
+            self.push(page.add(i * size));
+        }
+        self.pages += 1;
+    }
+}
+
+/// ============================================================================
+/// Per-CPU Magazines
+/// ============================================================================
+
+/// Per-CPU stack of free objects of one class
+struct Magazine {
+    objects: [*mut u8; MAGAZINE_SIZE],
+    count: usize,
+
+    /// Allocations and frees made through this magazine
+    allocs: u64,
+    frees: u64,
+}
+
+// Safety: a magazine's objects are only reached through its lock
+unsafe impl Send for Magazine {}
+
+impl Magazine {
+    const fn new() -> Self {
+        Self {
+            objects: [core::ptr::null_mut(); MAGAZINE_SIZE],
+            count: 0,
+            allocs: 0,
+            frees: 0,
+        }
+    }
+}
+
+/// Statistics of one size class
+#[derive(Debug, Clone, Copy, Default, PartialEq, Eq)]
+pub struct SlabStats {
+    /// Object size (bytes)
+    pub size: usize,
+    /// Pages carved for the class
+    pub pages: usize,
+    /// Objects currently allocated
+    pub in_use: u64,
+    /// Free objects (depot and magazines)
+    pub free: usize,
+    /// Allocations served since boot
+    pub allocs: u64,
+    /// Frees since boot
+    pub frees: u64,
+    /// Depot refills and flushes (magazine misses)
+    pub depot_transfers: u64,
+}
+
+/// ============================================================================
+/// Slab Allocator
+/// ============================================================================
+
+/// Source of whole, page-aligned pages (null when out of memory)
+pub type PageSource = fn() -> *mut u8;
+
+/// Size-class allocator with per-CPU magazines
+pub struct SlabAllocator {
+    depots: [SpinMutex<SlabDepot>; NUM_CLASSES],
+    magazines: [[SpinMutex<Magazine>; NUM_CLASSES]; MAX_CPUS],
+    depot_transfers: [AtomicU64; NUM_CLASSES],
+    /// Allocations and frees that bypassed a busy magazine
+    bypass_allocs: [AtomicU64; NUM_CLASSES],
+    bypass_frees: [AtomicU64; NUM_CLASSES],
+    page_source: PageSource,
+}
+
+impl SlabAllocator {
+    /// Create an empty allocator that takes pages from `page_source`
+    pub const fn new(page_source: PageSource) -> Self {
+        const DEPOT: SpinMutex<SlabDepot> = SpinMutex::new(SlabDepot::new());
+        const MAGAZINE: SpinMutex<Magazine> = SpinMutex::new(Magazine::new());
+        const CPU_MAGAZINES: [SpinMutex<Magazine>; NUM_CLASSES] = [MAGAZINE; NUM_CLASSES];
+        const ZERO: AtomicU64 = AtomicU64::new(0);
+        Self {
+            depots: [DEPOT; NUM_CLASSES],
+            magazines: [CPU_MAGAZINES; MAX_CPUS],
+            depot_transfers: [ZERO; NUM_CLASSES],
+            bypass_allocs: [ZERO; NUM_CLASSES],
+            bypass_frees: [ZERO; NUM_CLASSES],
+            page_source,
+        }
+    }
+
+    /// Allocate one object of a size class
+    ///
+    /// Returns null if the class needs a new page and none is available.
+    pub fn alloc(&self, class: usize) -> *mut u8 {
+        let cpu = percpu::this_cpu();
+        let Some(mut magazine) = self.magazines[cpu][class].try_lock() else {
+            let object = self.depot_alloc(class);
+            if !object.is_null() {
+                self.bypass_allocs[class].fetch_add(1, Ordering::Relaxed);
+            }
+            return object;
+        };
+
+        if magazine.count == 0 {
+            self.refill(class, &mut magazine);
+            if magazine.count == 0 {
+                return core::ptr::null_mut();
+            }
+        }
+
+        magazine.count -= 1;
+        magazine.allocs += 1;
+        magazine.objects[magazine.count]
+    }
+
+    /// Free an object of a size class
+    ///
+    /// # Safety
+    ///
+    /// `object` must have come from `alloc(class)` on this allocator and
+    /// must not be used afterwards.
+    pub unsafe fn free(&self, object: *mut u8, class: usize) {
+        let cpu = percpu::this_cpu();
+        let Some(mut magazine) = self.magazines[cpu][class].try_lock() else {
+            self.depots[class].lock_irqsave().push(object);
+            self.bypass_frees[class].fetch_add(1, Ordering::Relaxed);
+            return;
+        };
+
+        if magazine.count == MAGAZINE_SIZE {
+            self.flush(class, &mut magazine);
+        }
+
+        let count = magazine.count;
+        magazine.objects[count] = object;
+        magazine.count += 1;
+        magazine.frees += 1;
+    }
+
+    /// Take one object directly from the depot
+    fn depot_alloc(&self, class: usize) -> *mut u8 {
+        let mut depot = self.depots[class].lock_irqsave();
+        unsafe {
+            if depot.free.is_null() && !self.grow(class, &mut depot) {
+                return core::ptr::null_mut();
+            }
+            depot.pop()
+        }
+    }
+
+    /// Move up to a batch of objects from the depot into a magazine
+    fn refill(&self, class: usize, magazine: &mut Magazine) {
+        self.depot_transfers[class].fetch_add(1, Ordering::Relaxed);
+        let mut depot = self.depots[class].lock_irqsave();
+        unsafe {
+            if depot.free_count < MAGAZINE_BATCH {
+                self.grow(class, &mut depot);
+            }
+            while magazine.count < MAGAZINE_BATCH {
+                let object = depot.pop();
+                if object.is_null() {
+                    break;
+                }
+                magazine.objects[magazine.count] = object;
+                magazine.count += 1;
+            }
+        }
+    }
+
+    /// Move a batch of objects from a full magazine to the depot
+    fn flush(&self, class: usize, magazine: &mut Magazine) {
+        self.depot_transfers[class].fetch_add(1, Ordering::Relaxed);
+        let mut depot = self.depots[class].lock_irqsave();
+        for _ in 0..MAGAZINE_BATCH {
+            magazine.count -= 1;
+            unsafe { depot.push(magazine.objects[magazine.count]); }
+        }
+    }
+
+    /// Add enough fresh pages to the depot for at least one batch
+    ///
+    /// Returns false if no page could be had.
+    unsafe fn grow(&self, class: usize, depot: &mut SlabDepot) -> bool {
+        let size = class_size(class);
+        let pages = (MAGAZINE_BATCH * size).div_ceil(PAGE_SIZE).max(1);
+        let mut grown = false;
+        for _ in 0..pages {
+            let page = (self.page_source)();
+            if page.is_null() {
+                break;
+            }
+            depot.carve(page, size);
+            grown = true;
+        }
+        grown
+    }
+
+    /// Statistics of one size class
+    pub fn stats(&self, class: usize) -> SlabStats {
+        let (pages, mut free) = {
+            let depot = self.depots[class].lock_irqsave();
+            (depot.pages, depot.free_count)
+        };
+
+        let mut allocs = self.bypass_allocs[class].load(Ordering::Relaxed);
+        let mut frees = self.bypass_frees[class].load(Ordering::Relaxed);
+        for cpu in 0..MAX_CPUS {
+            let magazine = self.magazines[cpu][class].lock();
+            allocs += magazine.allocs;
+            frees += magazine.frees;
+            free += magazine.count;
+        }
+
+        SlabStats {
+            size: class_size(class),
+            pages,
+            in_use: allocs.saturating_sub(frees),
+            free,
+            allocs,
+            frees,
+            depot_transfers: self.depot_transfers[class].load(Ordering::Relaxed),
+        }
+    }
+}
+
+/// ============================================================================
+/// Kernel Slab Instance
+/// ============================================================================
+
+/// Take a page for the kernel slabs from the PMM
+///
+/// Slab pages come from the user zone, like the heap itself, so that the
+/// kernel zone stays available for page tables.
+fn pmm_page_source() -> *mut u8 {
+    match pmm::pmm_alloc_page(pmm::PMM_ALLOC_FLAG_USER) {
+        Ok(paddr) => pmm::paddr_to_vaddr_user_zone(paddr) as *mut u8,
+        Err(_) => core::ptr::null_mut(),
+    }
+}
+
+/// Kernel slab allocator (used by the global allocator once enabled)
+pub static KERNEL_SLAB: SlabAllocator = SlabAllocator::new(pmm_page_source);
+
+/// Whether the global allocator routes small requests to [`KERNEL_SLAB`]
+static SLAB_ENABLED: AtomicBool = AtomicBool::new(false);
+
+/// Start serving small allocations from the slabs
+///
+/// Must be called once the PMM has its arenas. Earlier allocations stay
+/// in the linked-list heap and are freed there (by address).
+pub fn enable() {
+    SLAB_ENABLED.store(true, Ordering::Release);
+}
+
+/// Check if the slabs serve small allocations
+#[inline]
+pub fn is_enabled() -> bool {
+    SLAB_ENABLED.load(Ordering::Acquire)
+}
+
+/// Statistics of a kernel slab size class (None past the last class)
+pub fn slab_stats(class: usize) -> Option<SlabStats> {
+    if class < NUM_CLASSES {
+        Some(KERNEL_SLAB.stats(class))
+    } else {
+        None
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use core::sync::atomic::AtomicUsize;
+
+    const TEST_PAGES: usize = 64;
+
+    #[repr(C, align(4096))]
+    struct TestPages([u8; TEST_PAGES * PAGE_SIZE]);
+
+    static mut TEST_MEMORY: TestPages = TestPages([0; TEST_PAGES * PAGE_SIZE]);
+    static TEST_NEXT_PAGE: AtomicUsize = AtomicUsize::new(0);
+
+    fn test_page_source() -> *mut u8 {
+        let page = TEST_NEXT_PAGE.fetch_add(1, Ordering::Relaxed);
+        if page >= TEST_PAGES {
+            return core::ptr::null_mut();
+        }
+        unsafe { (&raw mut TEST_MEMORY.0).cast::<u8>().add(page * PAGE_SIZE) }
+    }
+
+    #[test]
+    fn test_class_index() {
+        assert_eq!(class_index(1, 1), Some(0));
+        assert_eq!(class_index(16, 8), Some(0));
+        assert_eq!(class_index(17, 8), Some(1));
+        assert_eq!(class_index(24, 64), Some(2));
+        assert_eq!(class_index(4096, 8), Some(NUM_CLASSES - 1));
+        assert_eq!(class_index(4097, 8), None);
+        assert_eq!(class_size(NUM_CLASSES - 1), MAX_CLASS_SIZE);
+    }
+
+    #[test]
+    fn test_slab_alloc_free() {
+        let slab = SlabAllocator::new(test_page_source);
+        let class = class_index(48, 8).unwrap();
+
+        let a = slab.alloc(class);
+        let b = slab.alloc(class);
+        assert!(!a.is_null() && !b.is_null() && a != b);
+        assert_eq!(a as usize % class_size(class), 0);
+
+        // LIFO magazine: a freed object is handed out next
+        unsafe { slab.free(a, class); }
+        assert_eq!(slab.alloc(class), a);
+
+        let stats = slab.stats(class);
+        assert_eq!(stats.size, 64);
+        assert_eq!(stats.allocs, 3);
+        assert_eq!(stats.frees, 1);
+        assert_eq!(stats.in_use, 2);
+    }
+
+    #[test]
+    fn test_slab_magazine_overflow() {
+        let slab = SlabAllocator::new(test_page_source);
+        let class = class_index(256, 8).unwrap();
+
+        let objects: [*mut u8; MAGAZINE_SIZE + 8] = core::array::from_fn(|_| slab.alloc(class));
+        assert!(objects.iter().all(|o| !o.is_null()));
+        for &object in &objects {
+            unsafe { slab.free(object, class); }
+        }
+
+        // Overflowing frees went back to the depot; nothing was lost
+        let stats = slab.stats(class);
+        assert_eq!(stats.in_use, 0);
+        assert_eq!(stats.free, stats.pages * PAGE_SIZE / 256);
+        assert!(stats.depot_transfers >= 2);
+    }
+}
@@ -16,6 +16,28 @@
 //! - **Bounded queue**: Backpressure when full
 //! - **Handle passing**: Handles can be transferred with rights reduction
 //! - **Peer closure**: One end closed → PEER_CLOSED signal to other
+//! - **Page transfer**: Large payloads travel as physical pages, not bytes
+//!
+//! # Large Messages
+//!
+//! Small messages are copied into the kernel and out again. A payload of
+//! more than [`LARGE_MSG_THRESHOLD`] bytes can instead be queued as the
+//! list of physical pages that back it ([`Message::with_pages`]): the
+//! sender's pages, or the pages of a VMO. The receiver gets the same
+//! pages mapped into its address space, so bulk data is never copied.
+//! The message holds a reference to each of its pages, released when it
+//! is dropped: once read, or with the channel if it is never read.
+//!
+//! # Endpoint Registry
+//!
+//! Endpoints used from userspace live in a kernel-wide registry keyed by
+//! channel ID ([`create_endpoints`], [`endpoint_write`], [`endpoint_read`],
+//! [`close_endpoint`]); a write on one endpoint queues the message on
+//! its peer. An endpoint's reference count counts the descriptors that
+//! name it ([`retain_endpoint`]), and the last close closes it.
+//!
+//! Ports can watch an endpoint for [`SIGNAL_READABLE`] and
+//! [`SIGNAL_PEER_CLOSED`] ([`watch_endpoint`]).
 //!
 //! # Usage
 //!
@@ -29,8 +51,12 @@ use core::sync::atomic::{AtomicU64, AtomicUsize, Ordering};
 use crate::sync::SpinMutex;
 use crate::object::handle::{KernelObjectBase, ObjectType, Handle};
 use crate::object::event::Event;
+use crate::object::port::{ObserverList, Port, Signals, SIGNAL_PEER_CLOSED, SIGNAL_READABLE};
+use crate::arch::amd64::mm::{PAddr, RxStatus};
+use alloc::boxed::Box;
+use alloc::sync::Arc;
 use alloc::vec::Vec;
-use alloc::collections::VecDeque;
+use alloc::collections::{BTreeMap, VecDeque};
 
 /// ============================================================================
 /// Channel ID
@@ -57,24 +83,107 @@ pub const MAX_MSG_SIZE: usize = 64 * 1024;
 /// Maximum handles per message
 pub const MAX_MSG_HANDLES: usize = 64;
 
+/// Payloads larger than this may be sent as pages instead of bytes
+pub const LARGE_MSG_THRESHOLD: usize = 4096;
+
+/// Maximum size of a page-transfer message in bytes
+pub const MAX_LARGE_MSG_SIZE: usize = 16 * 1024 * 1024;
+
+/// Maximum number of queued messages per endpoint
+pub const MAX_QUEUED_MSGS: usize = 256;
+
 /// Message data
 pub struct Message {
-    /// Message bytes
+    /// Message bytes (empty for a page-transfer message)
     pub data: Vec<u8>,
 
     /// Handles being transferred
     pub handles: Vec<Handle>,
+
+    /// Physical pages holding the payload of a page-transfer message
+    pub pages: Vec<PAddr>,
+
+    /// Payload length of a page-transfer message
+    pub page_len: usize,
 }
 
 impl Message {
     /// Create a new message
     pub fn new(data: Vec<u8>, handles: Vec<Handle>) -> Self {
-        Self { data, handles }
+        Self { data, handles, pages: Vec::new(), page_len: 0 }
+    }
+
+    /// Create a page-transfer message
+    ///
+    /// The payload is the first `len` bytes of `pages`, which must hold
+    /// at least that much. The pages are shared, not copied: the message
+    /// takes over one reference to each, which the caller must hold, and
+    /// releases them when dropped. The sender must not write the pages
+    /// in place afterwards (map them copy-on-write instead).
+    pub fn with_pages(pages: Vec<PAddr>, len: usize, handles: Vec<Handle>) -> Self {
+        Self { data: Vec::new(), handles, pages, page_len: len }
+    }
+
+    /// Take the pages of a page-transfer message, with their references
+    ///
+    /// The message is left with no payload.
+    pub fn take_pages(&mut self) -> Vec<PAddr> {
+        self.page_len = 0;
+        core::mem::take(&mut self.pages)
+    }
+
+    /// Check if the payload travels as pages
+    pub fn is_page_transfer(&self) -> bool {
+        !self.pages.is_empty()
     }
 
     /// Get message data size
     pub fn data_size(&self) -> usize {
-        self.data.len()
+        if self.is_page_transfer() {
+            self.page_len
+        } else {
+            self.data.len()
+        }
+    }
+
+    /// Copy the payload out, whether it is inline or in pages
+    ///
+    /// Returns the number of bytes copied (at most `buf.len()`).
+    pub fn copy_payload(&self, buf: &mut [u8]) -> usize {
+        let copied: Result<usize, ()> = self.copy_payload_with(buf.len(), |at, chunk| {
+            buf[at..at + chunk.len()].copy_from_slice(chunk);
+            Ok(())
+        });
+        copied.unwrap_or(0)
+    }
+
+    /// Hand the first `max` bytes of the payload to `copy` in contiguous
+    /// pieces (the inline data, or a page at a time), with each piece's
+    /// offset
+    ///
+    /// Returns the number of bytes handed over, or the first error.
+    pub fn copy_payload_with<E>(
+        &self,
+        max: usize,
+        mut copy: impl FnMut(usize, &[u8]) -> Result<(), E>,
+    ) -> Result<usize, E> {
+        let len = core::cmp::min(max, self.data_size());
+        if !self.is_page_transfer() {
+            copy(0, &self.data[..len])?;
+            return Ok(len);
+        }
+
+        let mut copied = 0;
+        for &paddr in &self.pages {
+            if copied == len {
+                break;
+            }
+            let chunk = core::cmp::min(len - copied, 4096);
+            let src = crate::mm::pmm::paddr_to_vaddr_user_zone(paddr) as *const u8;
+            copy(copied, unsafe { core::slice::from_raw_parts(src, chunk) })?;
+            copied += chunk;
+        }
+        Ok(copied)
     }
 
     /// Get handle count
@@ -84,7 +193,15 @@ impl Message {
 
     /// Check if message is empty
     pub fn is_empty(&self) -> bool {
-        self.data.is_empty() && self.handles.is_empty()
+        self.data_size() == 0 && self.handles.is_empty()
+    }
+}
+
+impl Drop for Message {
+    fn drop(&mut self) {
+        for &paddr in &self.pages {
+            let _ = crate::mm::pmm::pmm_page_unref(paddr);
+        }
     }
 }
 
@@ -166,6 +283,9 @@ pub struct Channel {
 
     /// Channel state
     pub state: SpinMutex<ChannelState>,
+
+    /// Ports watching this endpoint
+    pub observers: ObserverList,
 }
 
 impl Channel {
@@ -187,6 +307,7 @@ impl Channel {
                 crate::object::event::EventFlags::empty,
             )),
             state: SpinMutex::new(ChannelState::Active),
+            observers: ObserverList::new(),
         }
     }
 
@@ -226,6 +347,18 @@ impl Channel {
         *self.state.lock()
     }
 
+    /// Signals this endpoint asserts now
+    pub fn signals(&self) -> Signals {
+        let mut signals = 0;
+        if self.queue_len() > 0 {
+            signals |= SIGNAL_READABLE;
+        }
+        if self.state() == ChannelState::PeerClosed {
+            signals |= SIGNAL_PEER_CLOSED;
+        }
+        signals
+    }
+
     /// Write data and handles to the channel
     ///
     /// # Arguments
@@ -233,36 +366,53 @@ impl Channel {
     /// * `data` - Data bytes to write
     /// * `handles` - Handles to transfer
     pub fn write(&self, data: &[u8], handles: &[Handle]) -> Result<usize, &'static str> {
+        // Check message size limits
+        if data.len() > MAX_MSG_SIZE {
+            return Err("message too large");
+        }
+
+        // Copy data and handles
+        self.enqueue(Message::new(Vec::from(data), handles.to_vec()))?;
+        Ok(data.len())
+    }
+
+    /// Queue a message on this endpoint
+    ///
+    /// Inline bytes count against the queue's byte budget; the pages of a
+    /// page-transfer message do not, as they are not kernel heap memory.
+    pub fn enqueue(&self, msg: Message) -> Result<(), &'static str> {
         let state = *self.state.lock();
         if state != ChannelState::Active {
             return Err("channel not active");
         }
 
-        // Check message size limits
-        if data.len() > MAX_MSG_SIZE {
-            return Err("message too large");
+        if msg.handles.len() > MAX_MSG_HANDLES {
+            return Err("too many handles");
         }
 
-        if handles.len() > MAX_MSG_HANDLES {
-            return Err("too many handles");
+        if msg.is_page_transfer() {
+            if msg.page_len > MAX_LARGE_MSG_SIZE || msg.page_len > msg.pages.len() * 4096 {
+                return Err("message too large");
+            }
+        } else if msg.data.len() > MAX_MSG_SIZE {
+            return Err("message too large");
         }
 
         // Check queue space
-        let msg_size = data.len();
+        let msg_size = msg.data.len();
         let current_size = self.queue_size.load(Ordering::Acquire);
 
         if current_size + msg_size > self.max_queue_bytes {
             return Err("channel full");
         }
 
-        // Copy data and handles
-        let msg_data = Vec::from(data);
-        let msg_handles = handles.to_vec();
-
         // Add to queue
         {
             let mut queue = self.queue.lock();
-            queue.push_back(Message::new(msg_data, msg_handles));
+            if queue.len() >= MAX_QUEUED_MSGS {
+                return Err("channel full");
+            }
+            queue.push_back(msg);
         }
 
         // Update queue size
@@ -270,8 +420,35 @@ impl Channel {
 
         // Signal read event
         self.read_event.lock().signal();
+        self.observers.notify(SIGNAL_READABLE);
 
-        Ok(data.len())
+        Ok(())
+    }
+
+    /// Take the next message off this endpoint's queue
+    pub fn dequeue(&self) -> Result<Message, &'static str> {
+        let msg = {
+            let mut queue = self.queue.lock();
+            match queue.pop_front() {
+                Some(msg) => msg,
+                None => {
+                    // Check if peer closed
+                    if *self.state.lock() == ChannelState::PeerClosed {
+                        // Return peer closed status
+                        return Err("peer closed");
+                    }
+                    return Err("no messages");
+                }
+            }
+        };
+
+        // Update queue size
+        self.queue_size.fetch_sub(msg.data.len(), Ordering::Release);
+
+        // Signal write event (space available)
+        self.write_event.lock().signal();
+
+        Ok(msg)
     }
 
     /// Read data and handles from the channel
@@ -289,39 +466,17 @@ impl Channel {
         buf: &mut [u8],
         handle_buf: &mut [Handle],
     ) -> Result<ReadResult, &'static str> {
-        // Try to get a message from queue
-        let (data, handles) = {
-            let mut queue = self.queue.lock();
-            match queue.pop_front() {
-                Some(msg) => (msg.data, msg.handles),
-                None => {
-                    // Check if peer closed
-                    if *self.state.lock() == ChannelState::PeerClosed {
-                        // Return peer closed status
-                        return Err("peer closed");
-                    }
-                    return Err("no messages");
-                }
-            }
-        };
-
-        // Update queue size
-        let msg_size = data.len();
-        self.queue_size.fetch_sub(msg_size, Ordering::Release);
+        let msg = self.dequeue()?;
 
         // Copy data to buffer
-        let bytes_to_copy = core::cmp::min(buf.len(), data.len());
-        buf[..bytes_to_copy].copy_from_slice(&data[..bytes_to_copy]);
+        let bytes_to_copy = msg.copy_payload(buf);
 
         // Copy handles to buffer
-        let handles_to_copy = core::cmp::min(handle_buf.len(), handles.len());
-        for (i, handle) in handles.iter().take(handles_to_copy).enumerate() {
+        let handles_to_copy = core::cmp::min(handle_buf.len(), msg.handles.len());
+        for (i, handle) in msg.handles.iter().take(handles_to_copy).enumerate() {
             handle_buf[i] = handle.clone();
         }
 
-        // Signal write event (space available)
-        self.write_event.lock().signal();
-
         Ok(ReadResult {
             bytes_read: bytes_to_copy,
             handles_read: handles_to_copy,
@@ -377,6 +532,111 @@ impl Channel {
     }
 }
 
+/// ============================================================================
+/// Endpoint Registry
+/// ============================================================================
+
+/// Live endpoints, by channel ID
+static ENDPOINTS: SpinMutex<BTreeMap<ChannelId, Box<Channel>>> = SpinMutex::new(BTreeMap::new());
+
+/// Create a channel pair in the registry
+///
+/// # Returns
+///
+/// IDs of the two endpoints
+pub fn create_endpoints() -> Result<(ChannelId, ChannelId), RxStatus> {
+    let (channel_a, channel_b) = Channel::create().map_err(|_| RxStatus::ERR_NO_MEMORY)?;
+    let ids = (channel_a.id(), channel_b.id());
+
+    let mut endpoints = ENDPOINTS.lock();
+    endpoints.insert(ids.0, Box::new(channel_a));
+    endpoints.insert(ids.1, Box::new(channel_b));
+    Ok(ids)
+}
+
+/// Send a message from an endpoint to its peer
+///
+/// Fails with `ERR_PEER_CLOSED` once the peer is gone and with
+/// `ERR_SHOULD_WAIT` while the peer's queue is full.
+pub fn endpoint_write(id: ChannelId, msg: Message) -> Result<(), RxStatus> {
+    let endpoints = ENDPOINTS.lock();
+    let endpoint = endpoints.get(&id).ok_or(RxStatus::ERR_NOT_FOUND)?;
+    let peer = endpoint
+        .peer_id()
+        .and_then(|peer| endpoints.get(&peer))
+        .ok_or(RxStatus::ERR_PEER_CLOSED)?;
+
+    peer.enqueue(msg).map_err(|e| match e {
+        "channel full" => RxStatus::ERR_SHOULD_WAIT,
+        "channel not active" => RxStatus::ERR_PEER_CLOSED,
+        _ => RxStatus::ERR_INVALID_ARGS,
+    })
+}
+
+/// Take the next message queued on an endpoint
+///
+/// Fails with `ERR_SHOULD_WAIT` if the queue is empty, or
+/// `ERR_PEER_CLOSED` if it is empty and the peer is gone.
+pub fn endpoint_read(id: ChannelId) -> Result<Message, RxStatus> {
+    let endpoints = ENDPOINTS.lock();
+    let endpoint = endpoints.get(&id).ok_or(RxStatus::ERR_NOT_FOUND)?;
+
+    endpoint.dequeue().map_err(|e| match e {
+        "peer closed" => RxStatus::ERR_PEER_CLOSED,
+        _ => RxStatus::ERR_SHOULD_WAIT,
+    })
+}
+
+/// Count another descriptor naming an endpoint (a duplicate)
+pub fn retain_endpoint(id: ChannelId) -> Result<(), RxStatus> {
+    ENDPOINTS.lock().get(&id).map(|endpoint| endpoint.ref_inc()).ok_or(RxStatus::ERR_NOT_FOUND)
+}
+
+/// Drop a descriptor's reference to an endpoint
+///
+/// The last one closes the endpoint: drops its queued messages and
+/// moves the peer to `PeerClosed`, waking its readers.
+pub fn close_endpoint(id: ChannelId) {
+    let mut endpoints = ENDPOINTS.lock();
+    if !endpoints.get(&id).is_some_and(|endpoint| endpoint.ref_dec()) {
+        return;
+    }
+    let Some(endpoint) = endpoints.remove(&id) else {
+        return;
+    };
+
+    if let Some(peer) = endpoint.peer_id().and_then(|peer| endpoints.get(&peer)) {
+        *peer.peer.lock() = None;
+        *peer.state.lock() = ChannelState::PeerClosed;
+        peer.read_event.lock().signal();
+        peer.observers.notify(SIGNAL_PEER_CLOSED);
+    }
+}
+
+/// Register a port to watch an endpoint
+///
+/// Signals the endpoint already asserts are posted right away.
+pub fn watch_endpoint(
+    id: ChannelId,
+    port: &Arc<Port>,
+    key: u64,
+    trigger: Signals,
+    once: bool,
+) -> Result<(), RxStatus> {
+    let endpoints = ENDPOINTS.lock();
+    let endpoint = endpoints.get(&id).ok_or(RxStatus::ERR_NOT_FOUND)?;
+
+    let trigger = trigger & (SIGNAL_READABLE | SIGNAL_PEER_CLOSED);
+    endpoint
+        .observers
+        .add(port, key, trigger, once, endpoint.signals())
+        .map_err(|e| match e {
+            "port full" => RxStatus::ERR_SHOULD_WAIT,
+            "too many observers" => RxStatus::ERR_NO_MEMORY,
+            _ => RxStatus::ERR_INVALID_ARGS,
+        })
+}
+
 // ============================================================================
 // Tests
 // ============================================================================
@@ -436,4 +696,58 @@ mod tests {
         // For now, just test that size tracking works
         assert_eq!(ch_a.queue_size(), 0);
     }
+
+    #[test]
+    fn test_page_transfer_message() {
+        let paddr: PAddr = 0x200_0000;
+        let msg = Message::with_pages(alloc::vec![paddr, paddr], 6000, alloc::vec![]);
+
+        assert!(msg.is_page_transfer());
+        assert_eq!(msg.data_size(), 6000);
+
+        let (ch_a, _) = Channel::create().unwrap();
+        ch_a.enqueue(msg).unwrap();
+        // Pages do not count against the byte budget
+        assert_eq!(ch_a.queue_size(), 0);
+
+        let mut msg = ch_a.dequeue().unwrap();
+        assert_eq!(msg.pages, [paddr, paddr]);
+        // Taking the pages (and their references) empties the message
+        assert_eq!(msg.take_pages(), [paddr, paddr]);
+        assert!(!msg.is_page_transfer());
+
+        // The payload must fit in the pages it names
+        let short = Message::with_pages(alloc::vec![paddr], 4097, alloc::vec![]);
+        assert!(ch_a.enqueue(short).is_err());
+    }
+
+    #[test]
+    fn test_endpoint_registry() {
+        let (a, b) = create_endpoints().unwrap();
+
+        endpoint_write(a, Message::new(alloc::vec![7; 3], alloc::vec![])).unwrap();
+        assert_eq!(endpoint_read(b).unwrap().data, [7, 7, 7]);
+        assert_eq!(endpoint_read(b).err(), Some(RxStatus::ERR_SHOULD_WAIT));
+
+        close_endpoint(a);
+        assert_eq!(endpoint_read(b).err(), Some(RxStatus::ERR_PEER_CLOSED));
+        let msg = Message::new(alloc::vec![1], alloc::vec![]);
+        assert_eq!(endpoint_write(b, msg).err(), Some(RxStatus::ERR_PEER_CLOSED));
+        close_endpoint(b);
+    }
+
+    #[test]
+    fn test_endpoint_retain() {
+        let (a, b) = create_endpoints().unwrap();
+
+        // Two descriptors name `a`: the first close leaves it open
+        retain_endpoint(a).unwrap();
+        close_endpoint(a);
+        endpoint_write(a, Message::new(alloc::vec![1], alloc::vec![])).unwrap();
+        close_endpoint(a);
+        assert_eq!(retain_endpoint(a).err(), Some(RxStatus::ERR_NOT_FOUND));
+        assert_eq!(endpoint_read(b).unwrap().data, [1]);
+        assert_eq!(endpoint_read(b).err(), Some(RxStatus::ERR_PEER_CLOSED));
+        close_endpoint(b);
+    }
 }
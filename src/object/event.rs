@@ -29,6 +29,7 @@ use core::sync::atomic::{AtomicBool, AtomicU64, Ordering};
 use crate::sync::SpinMutex;
 use crate::sync::WaitQueue;
 use crate::object::handle::{KernelObjectBase, ObjectType};
+use crate::object::port::{ObserverList, Signals, SIGNAL_SIGNALED};
 
 /// ============================================================================
 /// Event ID
@@ -99,6 +100,9 @@ pub struct Event {
 
     /// Wait queue for blocked waiters
     pub waiters: SpinMutex<WaitQueue>,
+
+    /// Ports watching this event
+    pub observers: ObserverList,
 }
 
 impl Event {
@@ -115,6 +119,7 @@ impl Event {
             signaled: AtomicBool::new(signaled),
             flags,
             waiters: SpinMutex::new(WaitQueue::new()),
+            observers: ObserverList::new(),
         }
     }
 
@@ -128,15 +133,27 @@ impl Event {
         self.signaled.load(Ordering::Acquire)
     }
 
+    /// Signals this event asserts now
+    pub fn signals(&self) -> Signals {
+        if self.is_signaled() {
+            SIGNAL_SIGNALED
+        } else {
+            0
+        }
+    }
+
     /// Signal the event
     ///
-    /// Wakes up all waiting threads.
+    /// Wakes up all waiting threads and posts to watching ports.
     pub fn signal(&self) {
         self.signaled.store(true, Ordering::Release);
 
         // Wake all waiters (interior mutability through Mutex)
         let waiters = self.waiters.lock();
         waiters.wake_all();
+        drop(waiters);
+
+        self.observers.notify(SIGNAL_SIGNALED);
     }
 
     /// Unsignal the event
@@ -25,6 +25,7 @@
 //! - [`event`] - Event objects
 //! - [`timer`] - Timer objects
 //! - [`job`] - Job objects (resource containers)
+//! - [`port`] - Port objects (waitsets)
 
 pub mod handle;
 pub mod vmo;
@@ -32,6 +33,7 @@ pub mod channel;
 pub mod event;
 pub mod timer;
 pub mod job;
+pub mod port;
 
 // Re-exports
 pub use handle::{
@@ -41,5 +43,12 @@ pub use handle::{
 pub use job::{Job, JobId, JobPolicy, ResourceLimits, JobStats, JOB_ID_ROOT, JOB_ID_INVALID};
 pub use event::{Event, EventId, EventFlags};
 pub use timer::{Timer, TimerId, TimerState, SlackPolicy};
-pub use channel::{Channel, ChannelId, ChannelState, Message, ReadResult, MAX_MSG_SIZE, MAX_MSG_HANDLES};
+pub use channel::{
+    Channel, ChannelId, ChannelState, Message, ReadResult, MAX_MSG_SIZE, MAX_MSG_HANDLES,
+    LARGE_MSG_THRESHOLD, MAX_LARGE_MSG_SIZE,
+};
+pub use port::{
+    Port, PortId, PortPacket, ObserverList, Signals, SIGNAL_READABLE, SIGNAL_PEER_CLOSED,
+    SIGNAL_SIGNALED, MAX_PORT_PACKETS,
+};
 pub use vmo::{Vmo, VmoId, VmoFlags, CachePolicy};
@@ -0,0 +1,474 @@
+// Copyright 2025 The Rustux Authors
+//
+// Use of this source code is governed by a MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT
+
+//! Port Objects
+//!
+//! A port is a waitset: objects are registered with it and post a packet
+//! to it when one of the watched signals is asserted. A waiter blocks on
+//! the port alone and dequeues only the packets that are ready, so one
+//! event loop can serve hundreds of handles without rescanning them.
+//!
+//! # Design
+//!
+//! - **Observers**: Each watchable object keeps an [`ObserverList`] and
+//!   calls [`ObserverList::notify`] when its signals change
+//! - **Packets**: Keyed by the registration's `key`; a key that is posted
+//!   again before it is read is coalesced into one packet (signals ORed,
+//!   `count` incremented), so the queue is bounded by the number of keys
+//! - **Wakeups**: Blocked waiters sit on the port's [`WaitQueue`] and are
+//!   woken one per newly queued packet
+//! - **One-shot or persistent**: A one-shot registration is dropped after
+//!   its first packet; a persistent one posts on every notification
+//!
+//! Waiting costs O(ready packets); posting costs O(observers of the one
+//! object whose signals changed).
+//!
+//! # Port Registry
+//!
+//! Ports used from userspace live in a kernel-wide registry keyed by port
+//! ID ([`create_port`], [`get_port`], [`close_port`]). Ports are reference
+//! counted so that a waiter can sleep on one without holding the registry
+//! lock; observers only hold weak references, so closing a port drops
+//! its registrations lazily. Separately, the port's object reference
+//! count counts the descriptors that name it ([`retain_port`]), and the
+//! last close closes it.
+//!
+//! # Usage
+//!
+//! ```rust
+//! let port = get_port(create_port()?)?;
+//! channel.observers.add(&port, key, SIGNAL_READABLE, false, current)?;
+//! let count = port.wait(&mut packets)?;
+//! ```
+
+use core::sync::atomic::{AtomicBool, AtomicU64, Ordering};
+use crate::sync::{SpinMutex, WaitQueue};
+use crate::object::handle::{KernelObjectBase, ObjectType};
+use crate::arch::amd64::mm::RxStatus;
+use alloc::collections::{BTreeMap, VecDeque};
+use alloc::sync::{Arc, Weak};
+use alloc::vec::Vec;
+
+/// ============================================================================
+/// Port ID & Signals
+/// ============================================================================
+
+/// Port identifier
+pub type PortId = u64;
+
+/// Object signal mask
+pub type Signals = u32;
+
+/// Channel has a message queued
+pub const SIGNAL_READABLE: Signals = 1 << 0;
+
+/// Channel's other endpoint was closed
+pub const SIGNAL_PEER_CLOSED: Signals = 1 << 1;
+
+/// Event (or the event of a timer) is signaled
+pub const SIGNAL_SIGNALED: Signals = 1 << 2;
+
+/// Maximum number of distinct keys queued on one port
+pub const MAX_PORT_PACKETS: usize = 1024;
+
+/// Maximum number of registrations on one object
+pub const MAX_OBSERVERS: usize = 64;
+
+/// Next port ID counter
+static NEXT_PORT_ID: AtomicU64 = AtomicU64::new(1);
+
+/// Allocate a new port ID
+fn alloc_port_id() -> PortId {
+    NEXT_PORT_ID.fetch_add(1, Ordering::Relaxed)
+}
+
+/// ============================================================================
+/// Port Packet
+/// ============================================================================
+
+/// Packet delivered by a port
+///
+/// Layout is shared with userspace (`struct rx_port_packet`).
+#[repr(C)]
+#[derive(Debug, Clone, Copy, PartialEq, Eq, Default)]
+pub struct PortPacket {
+    /// Key given when the object was registered
+    pub key: u64,
+
+    /// Signals asserted since the packet was last read
+    pub signals: Signals,
+
+    /// Number of notifications coalesced into this packet
+    pub count: u32,
+}
+
+/// Queued packets, one per key, in the order their keys first became ready
+struct PacketQueue {
+    /// Keys with a pending packet, oldest first
+    order: VecDeque<u64>,
+
+    /// Pending packet of each key in `order`
+    pending: BTreeMap<u64, PortPacket>,
+}
+
+/// ============================================================================
+/// Port
+/// ============================================================================
+
+/// Port object
+///
+/// Collects ready packets from the objects registered with it.
+pub struct Port {
+    /// Kernel object base
+    pub base: KernelObjectBase,
+
+    /// Port ID
+    pub id: PortId,
+
+    /// Pending packets
+    packets: SpinMutex<PacketQueue>,
+
+    /// Processes blocked in [`Port::wait`]
+    waiters: WaitQueue,
+
+    /// Set once the port is closed
+    closed: AtomicBool,
+}
+
+impl Port {
+    /// Create a new port
+    pub fn new() -> Self {
+        Self {
+            base: KernelObjectBase::new(ObjectType::Port),
+            id: alloc_port_id(),
+            packets: SpinMutex::new(PacketQueue {
+                order: VecDeque::new(),
+                pending: BTreeMap::new(),
+            }),
+            waiters: WaitQueue::new(),
+            closed: AtomicBool::new(false),
+        }
+    }
+
+    /// Get port ID
+    pub const fn id(&self) -> PortId {
+        self.id
+    }
+
+    /// Check if the port has been closed
+    pub fn is_closed(&self) -> bool {
+        self.closed.load(Ordering::Acquire)
+    }
+
+    /// Number of pending packets
+    pub fn pending(&self) -> usize {
+        self.packets.lock().order.len()
+    }
+
+    /// Post a packet
+    ///
+    /// A packet already pending for `key` absorbs the new signals.
+    /// Otherwise a new packet is queued and one waiter is woken.
+    pub fn queue(&self, key: u64, signals: Signals) -> Result<(), &'static str> {
+        if self.is_closed() {
+            return Err("port closed");
+        }
+
+        {
+            let mut packets = self.packets.lock();
+            if let Some(packet) = packets.pending.get_mut(&key) {
+                packet.signals |= signals;
+                packet.count = packet.count.saturating_add(1);
+                return Ok(());
+            }
+            if packets.order.len() >= MAX_PORT_PACKETS {
+                return Err("port full");
+            }
+            packets.pending.insert(key, PortPacket { key, signals, count: 1 });
+            packets.order.push_back(key);
+        }
+
+        crate::sched::round_robin::wake_waiter(&self.waiters);
+        Ok(())
+    }
+
+    /// Dequeue pending packets without blocking
+    ///
+    /// # Returns
+    ///
+    /// Number of packets stored in `out`, oldest first
+    pub fn try_dequeue(&self, out: &mut [PortPacket]) -> usize {
+        let mut packets = self.packets.lock();
+        let mut count = 0;
+        while count < out.len() {
+            let Some(key) = packets.order.pop_front() else {
+                break;
+            };
+            if let Some(packet) = packets.pending.remove(&key) {
+                out[count] = packet;
+                count += 1;
+            }
+        }
+        count
+    }
+
+    /// Dequeue pending packets, blocking until there is at least one
+    ///
+    /// Fails with "port closed" if the port is closed while waiting.
+    pub fn wait(&self, out: &mut [PortPacket]) -> Result<usize, &'static str> {
+        if out.is_empty() {
+            return Err("empty packet buffer");
+        }
+
+        loop {
+            let count = self.try_dequeue(out);
+            if count > 0 {
+                return Ok(count);
+            }
+            if self.is_closed() {
+                return Err("port closed");
+            }
+            crate::sched::round_robin::wait_on(&self.waiters, || {
+                self.pending() > 0 || self.is_closed()
+            });
+        }
+    }
+
+    /// Close the port
+    ///
+    /// Drops pending packets and wakes every waiter.
+    pub fn close(&self) {
+        self.closed.store(true, Ordering::Release);
+        {
+            let mut packets = self.packets.lock();
+            packets.order.clear();
+            packets.pending.clear();
+        }
+        while crate::sched::round_robin::wake_waiter(&self.waiters) {}
+    }
+
+    /// Get the kernel object base
+    pub fn base(&self) -> &KernelObjectBase {
+        &self.base
+    }
+}
+
+impl Default for Port {
+    fn default() -> Self {
+        Self::new()
+    }
+}
+
+/// ============================================================================
+/// Observer List
+/// ============================================================================
+
+/// One registration of an object with a port
+struct Observer {
+    /// Port to post to
+    port: Weak<Port>,
+
+    /// Key of the posted packets
+    key: u64,
+
+    /// Signals that trigger a packet
+    trigger: Signals,
+
+    /// Drop the registration after its first packet
+    once: bool,
+}
+
+/// Ports watching one object
+pub struct ObserverList {
+    /// Registrations, in the order they were made
+    observers: SpinMutex<Vec<Observer>>,
+}
+
+impl ObserverList {
+    /// Create an empty observer list
+    pub const fn new() -> Self {
+        Self {
+            observers: SpinMutex::new(Vec::new()),
+        }
+    }
+
+    /// Register a port
+    ///
+    /// # Arguments
+    ///
+    /// * `port` - Port to post packets to
+    /// * `key` - Key of the posted packets
+    /// * `trigger` - Signals to watch
+    /// * `once` - Drop the registration after its first packet
+    /// * `current` - Signals the object asserts now
+    ///
+    /// Signals that are already asserted post a packet right away, so a
+    /// registration never misses a state that predates it.
+    pub fn add(
+        &self,
+        port: &Arc<Port>,
+        key: u64,
+        trigger: Signals,
+        once: bool,
+        current: Signals,
+    ) -> Result<(), &'static str> {
+        if trigger == 0 {
+            return Err("no signals to watch");
+        }
+
+        let mut observers = self.observers.lock();
+        if current & trigger != 0 {
+            port.queue(key, current & trigger)?;
+            if once {
+                return Ok(());
+            }
+        }
+
+        observers.retain(|o| o.port.strong_count() > 0);
+        if observers.len() >= MAX_OBSERVERS {
+            return Err("too many observers");
+        }
+        observers.push(Observer {
+            port: Arc::downgrade(port),
+            key,
+            trigger,
+            once,
+        });
+        Ok(())
+    }
+
+    /// Post to every port watching one of `signals`
+    ///
+    /// Registrations of closed ports and fired one-shot registrations are
+    /// dropped.
+    pub fn notify(&self, signals: Signals) {
+        let mut observers = self.observers.lock();
+        observers.retain(|observer| {
+            let Some(port) = observer.port.upgrade() else {
+                return false;
+            };
+            if port.is_closed() {
+                return false;
+            }
+            if observer.trigger & signals == 0 {
+                return true;
+            }
+            let _ = port.queue(observer.key, observer.trigger & signals);
+            !observer.once
+        });
+    }
+
+    /// Number of live registrations
+    pub fn len(&self) -> usize {
+        self.observers.lock().len()
+    }
+
+    /// Check if no port is registered
+    pub fn is_empty(&self) -> bool {
+        self.len() == 0
+    }
+}
+
+impl Default for ObserverList {
+    fn default() -> Self {
+        Self::new()
+    }
+}
+
+/// ============================================================================
+/// Port Registry
+/// ============================================================================
+
+/// Live ports, by port ID
+static PORTS: SpinMutex<BTreeMap<PortId, Arc<Port>>> = SpinMutex::new(BTreeMap::new());
+
+/// Create a port in the registry
+pub fn create_port() -> Result<PortId, RxStatus> {
+    let port = Arc::new(Port::new());
+    let id = port.id();
+    PORTS.lock().insert(id, port);
+    Ok(id)
+}
+
+/// Look up a port
+pub fn get_port(id: PortId) -> Result<Arc<Port>, RxStatus> {
+    PORTS.lock().get(&id).cloned().ok_or(RxStatus::ERR_NOT_FOUND)
+}
+
+/// Count another descriptor naming a port (a duplicate)
+pub fn retain_port(id: PortId) -> Result<(), RxStatus> {
+    PORTS.lock().get(&id).map(|port| port.base.ref_inc()).ok_or(RxStatus::ERR_NOT_FOUND)
+}
+
+/// Drop a descriptor's reference to a port
+///
+/// The last one closes the port: waiters return with an error, and
+/// registrations on objects are dropped the next time those objects
+/// notify.
+pub fn close_port(id: PortId) {
+    let port = {
+        let mut ports = PORTS.lock();
+        match ports.get(&id) {
+            Some(port) if port.base.ref_dec() => ports.remove(&id),
+            _ => None,
+        }
+    };
+    if let Some(port) = port {
+        port.close();
+    }
+}
+
+// ============================================================================
+// Tests
+// ============================================================================
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    #[test]
+    fn test_port_coalesces_by_key() {
+        let port = Port::new();
+        port.queue(7, SIGNAL_READABLE).unwrap();
+        port.queue(9, SIGNAL_SIGNALED).unwrap();
+        port.queue(7, SIGNAL_PEER_CLOSED).unwrap();
+        assert_eq!(port.pending(), 2);
+
+        let mut out = [PortPacket::default(); 4];
+        assert_eq!(port.try_dequeue(&mut out), 2);
+        assert_eq!(out[0], PortPacket { key: 7, signals: SIGNAL_READABLE | SIGNAL_PEER_CLOSED, count: 2 });
+        assert_eq!(out[1], PortPacket { key: 9, signals: SIGNAL_SIGNALED, count: 1 });
+        assert_eq!(port.try_dequeue(&mut out), 0);
+
+        port.close();
+        assert!(port.queue(7, SIGNAL_READABLE).is_err());
+    }
+
+    #[test]
+    fn test_observer_list() {
+        let port = Arc::new(Port::new());
+        let observers = ObserverList::new();
+        let mut out = [PortPacket::default(); 4];
+
+        // Already-asserted signals post at once; a fired one-shot is not kept
+        observers.add(&port, 1, SIGNAL_READABLE, true, SIGNAL_READABLE).unwrap();
+        assert!(observers.is_empty());
+        assert_eq!(port.try_dequeue(&mut out), 1);
+
+        observers.add(&port, 2, SIGNAL_READABLE, false, 0).unwrap();
+        observers.add(&port, 3, SIGNAL_PEER_CLOSED, true, 0).unwrap();
+        observers.notify(SIGNAL_READABLE);
+        observers.notify(SIGNAL_PEER_CLOSED);
+        assert_eq!(observers.len(), 1);
+        assert_eq!(port.try_dequeue(&mut out), 2);
+        assert_eq!((out[0].key, out[1].key), (2, 3));
+
+        // Dropping the port drops its registrations
+        drop(port);
+        observers.notify(SIGNAL_READABLE);
+        assert!(observers.is_empty());
+    }
+}
@@ -16,6 +16,21 @@
 //! - **Periodic**: Fire repeatedly at specified interval
 //! - **Slack**: Allow coalescing for power efficiency
 //!
+//! # Timer Queue
+//!
+//! Armed timers are kept in one global min-heap ordered by deadline
+//! ([`TimerQueue`]). The earliest deadline is published in an atomic, so
+//! the scheduler can program each CPU's one-shot APIC timer for it
+//! without taking a lock (see `sched::tickless`). When the interrupt
+//! comes, [`fire_expired`] pops every timer whose deadline has passed,
+//! signals its event (and the ports watching it), and re-arms periodic
+//! ones.
+//!
+//! Canceling or re-setting a timer leaves its old heap entry behind;
+//! stale entries are recognised by sequence number and dropped when they
+//! reach the top. Slack is recorded but not yet used: timers fire at
+//! their deadline.
+//!
 //! # Usage
 //!
 //! ```rust
@@ -24,11 +39,17 @@
 //! timer.wait()?;
 //! ```
 
+use alloc::collections::{BTreeMap, BinaryHeap};
+use alloc::sync::Arc;
+use alloc::vec::Vec;
+use core::cmp::Reverse;
 use core::num::NonZeroU64;
 use core::sync::atomic::{AtomicU64, AtomicU8, Ordering};
+use crate::arch::amd64::mm::RxStatus;
 use crate::sync::SpinMutex;
 use crate::object::handle::{KernelObjectBase, ObjectType};
 use crate::object::event::Event;
+use crate::object::port::{Port, Signals, SIGNAL_SIGNALED};
 
 /// ============================================================================
 /// Timer ID
@@ -83,6 +104,113 @@ impl TimerState {
     }
 }
 
+/// ============================================================================
+/// Timer Queue
+/// ============================================================================
+
+/// Min-heap of armed timer deadlines
+pub struct TimerQueue {
+    /// (deadline, timer, sequence), earliest deadline on top
+    heap: BinaryHeap<Reverse<(u64, TimerId, u64)>>,
+
+    /// Sequence number of each armed timer's live heap entry
+    armed: BTreeMap<TimerId, u64>,
+
+    /// Next sequence number
+    next_seq: u64,
+}
+
+impl TimerQueue {
+    /// Create an empty queue
+    pub const fn new() -> Self {
+        Self {
+            heap: BinaryHeap::new(),
+            armed: BTreeMap::new(),
+            next_seq: 0,
+        }
+    }
+
+    /// Arm a timer, replacing any deadline it already had
+    pub fn arm(&mut self, id: TimerId, deadline: u64) {
+        let seq = self.next_seq;
+        self.next_seq += 1;
+        self.armed.insert(id, seq);
+        self.heap.push(Reverse((deadline, id, seq)));
+    }
+
+    /// Disarm a timer
+    ///
+    /// Returns false if it was not armed.
+    pub fn disarm(&mut self, id: TimerId) -> bool {
+        self.armed.remove(&id).is_some()
+    }
+
+    /// Drop stale entries from the top of the heap
+    fn prune(&mut self) {
+        while let Some(&Reverse((_, id, seq))) = self.heap.peek() {
+            if self.armed.get(&id) == Some(&seq) {
+                break;
+            }
+            self.heap.pop();
+        }
+    }
+
+    /// Earliest armed deadline
+    pub fn next_deadline(&mut self) -> Option<u64> {
+        self.prune();
+        self.heap.peek().map(|&Reverse((deadline, _, _))| deadline)
+    }
+
+    /// Pop a timer whose deadline is at or before `now`
+    pub fn pop_expired(&mut self, now: u64) -> Option<TimerId> {
+        if self.next_deadline()? > now {
+            return None;
+        }
+        let Reverse((_, id, _)) = self.heap.pop()?;
+        self.armed.remove(&id);
+        Some(id)
+    }
+
+    /// Number of armed timers
+    pub fn len(&self) -> usize {
+        self.armed.len()
+    }
+
+    /// Check if no timer is armed
+    pub fn is_empty(&self) -> bool {
+        self.armed.is_empty()
+    }
+}
+
+impl Default for TimerQueue {
+    fn default() -> Self {
+        Self::new()
+    }
+}
+
+/// Armed timers of all processes
+static TIMER_QUEUE: SpinMutex<TimerQueue> = SpinMutex::new(TimerQueue::new());
+
+/// Earliest armed deadline in nanoseconds (u64::MAX = none)
+static NEXT_DEADLINE: AtomicU64 = AtomicU64::new(u64::MAX);
+
+/// Publish the queue's earliest deadline (caller holds the queue lock)
+fn publish_next_deadline(queue: &mut TimerQueue) {
+    let next = queue.next_deadline().unwrap_or(u64::MAX);
+    NEXT_DEADLINE.store(next, Ordering::Release);
+}
+
+/// Earliest deadline of any armed timer, in nanoseconds
+///
+/// Lock-free; may briefly report a timer that was just canceled, which
+/// only costs a spurious interrupt.
+pub fn next_deadline() -> Option<u64> {
+    match NEXT_DEADLINE.load(Ordering::Acquire) {
+        u64::MAX => None,
+        deadline => Some(deadline),
+    }
+}
+
 /// ============================================================================
 /// Slack Policy
 /// ============================================================================
@@ -212,7 +340,9 @@ impl Timer {
         // Unsignal event
         self.event.lock().unsignal();
 
-        // TODO: Add to global timer queue
+        let mut queue = TIMER_QUEUE.lock();
+        queue.arm(self.id, deadline);
+        publish_next_deadline(&mut queue);
 
         Ok(())
     }
@@ -256,7 +386,10 @@ impl Timer {
                 // Cancel timer
                 self.state.store(TimerState::Canceled as u8, Ordering::Release);
 
-                // TODO: Remove from global timer queue
+                let mut queue = TIMER_QUEUE.lock();
+                queue.disarm(self.id);
+                publish_next_deadline(&mut queue);
+                drop(queue);
 
                 // Unsignal event
                 self.event.lock().unsignal();
@@ -284,6 +417,39 @@ impl Timer {
         Ok(())
     }
 
+    /// Fire the timer (its deadline has passed at `now`)
+    ///
+    /// Signals the event and the ports watching it. A periodic timer is
+    /// re-armed for its next deadline after `now`, skipping missed
+    /// periods.
+    fn fire(&self, now: u64) {
+        if self.state() != TimerState::Armed {
+            return;
+        }
+
+        let period = *self.period.lock();
+        match period {
+            Some(period) => {
+                let deadline = self.deadline();
+                let missed = now.saturating_sub(deadline) / period.get();
+                let next = deadline + (missed + 1) * period.get();
+                self.deadline.store(next, Ordering::Release);
+
+                let mut queue = TIMER_QUEUE.lock();
+                queue.arm(self.id, next);
+                publish_next_deadline(&mut queue);
+            }
+            None => self.state.store(TimerState::Fired as u8, Ordering::Release),
+        }
+
+        self.event.lock().signal();
+    }
+
+    /// Signals this timer asserts now
+    pub fn signals(&self) -> Signals {
+        self.event.lock().signals()
+    }
+
     /// Get current deadline
     pub fn deadline(&self) -> u64 {
         self.deadline.load(Ordering::Acquire)
@@ -317,6 +483,88 @@ impl Timer {
     }
 }
 
+/// ============================================================================
+/// Timer Registry
+/// ============================================================================
+
+/// Timer objects by ID
+static TIMERS: SpinMutex<BTreeMap<TimerId, Arc<Timer>>> = SpinMutex::new(BTreeMap::new());
+
+/// Create a timer in the registry
+pub fn create_timer() -> Result<TimerId, RxStatus> {
+    let timer = Arc::new(Timer::create().map_err(|_| RxStatus::ERR_NO_MEMORY)?);
+    let id = timer.id();
+    TIMERS.lock().insert(id, timer);
+    Ok(id)
+}
+
+/// Look up a timer
+pub fn get_timer(id: TimerId) -> Result<Arc<Timer>, RxStatus> {
+    TIMERS.lock().get(&id).cloned().ok_or(RxStatus::ERR_NOT_FOUND)
+}
+
+/// Count another descriptor naming a timer (a duplicate)
+pub fn retain_timer(id: TimerId) -> Result<(), RxStatus> {
+    TIMERS.lock().get(&id).map(|timer| timer.ref_inc()).ok_or(RxStatus::ERR_NOT_FOUND)
+}
+
+/// Drop a descriptor's reference to a timer
+///
+/// The last one closes the timer, canceling it if armed.
+pub fn close_timer(id: TimerId) {
+    let timer = {
+        let mut timers = TIMERS.lock();
+        match timers.get(&id) {
+            Some(timer) if timer.ref_dec() => timers.remove(&id),
+            _ => None,
+        }
+    };
+    if let Some(timer) = timer {
+        let _ = timer.cancel();
+    }
+}
+
+/// Post a packet to `port` when a timer asserts any of `trigger`
+///
+/// With `once`, the registration ends after the first packet.
+pub fn watch_timer(
+    id: TimerId,
+    port: &Arc<Port>,
+    key: u64,
+    trigger: Signals,
+    once: bool,
+) -> Result<(), RxStatus> {
+    let timer = get_timer(id)?;
+    let event = timer.event.lock();
+    event.observers
+        .add(port, key, trigger & SIGNAL_SIGNALED, once, event.signals())
+        .map_err(|_| RxStatus::ERR_INVALID_ARGS)
+}
+
+/// Fire every timer whose deadline is at or before `now` (nanoseconds)
+///
+/// Called from the timer interrupt. Expired timers are collected first
+/// and fired with no queue lock held, since signaling wakes processes.
+///
+/// Returns the number of timers fired.
+pub fn fire_expired(now: u64) -> usize {
+    let mut expired = Vec::new();
+    {
+        let mut queue = TIMER_QUEUE.lock();
+        while let Some(id) = queue.pop_expired(now) {
+            expired.push(id);
+        }
+        publish_next_deadline(&mut queue);
+    }
+
+    for &id in &expired {
+        if let Ok(timer) = get_timer(id) {
+            timer.fire(now);
+        }
+    }
+    expired.len()
+}
+
 // ============================================================================
 // Tests
 // ============================================================================
@@ -390,6 +638,39 @@ mod tests {
         assert_eq!(period.map(|p| p.get()), Some(100_000));
     }
 
+    #[test]
+    fn test_timer_queue_order() {
+        let mut queue = TimerQueue::new();
+        queue.arm(1, 300);
+        queue.arm(2, 100);
+        queue.arm(3, 200);
+        assert_eq!(queue.next_deadline(), Some(100));
+
+        assert_eq!(queue.pop_expired(50), None);
+        assert_eq!(queue.pop_expired(250), Some(2));
+        assert_eq!(queue.pop_expired(250), Some(3));
+        assert_eq!(queue.pop_expired(250), None);
+        assert_eq!(queue.len(), 1);
+    }
+
+    #[test]
+    fn test_timer_queue_stale_entries() {
+        let mut queue = TimerQueue::new();
+        queue.arm(1, 100);
+        queue.arm(2, 200);
+
+        // Re-arming moves the deadline; the old entry is skipped
+        queue.arm(1, 300);
+        assert_eq!(queue.next_deadline(), Some(200));
+
+        assert!(queue.disarm(2));
+        assert!(!queue.disarm(2));
+        assert_eq!(queue.next_deadline(), Some(300));
+        assert_eq!(queue.pop_expired(1000), Some(1));
+        assert!(queue.is_empty());
+        assert_eq!(queue.next_deadline(), None);
+    }
+
     #[test]
     fn test_timer_periodic_zero() {
         let timer = Timer::create().unwrap();
@@ -16,6 +16,19 @@
 //! - **Resizable**: VMOs can grow/shrink if created with RESIZABLE flag
 //! - **Cache policy**: Control cache behavior (uncached, write-combining, etc.)
 //!
+//! # Copy-on-Write Clones
+//!
+//! [`Vmo::clone`] copies no data: the clone gets the parent's page map,
+//! every shared page takes a PMM reference for the clone, and both sides
+//! mark it `cow`. Writable mappings of the parent are write-protected so
+//! they fault on their next write (see `AddressSpace::break_cow`).
+//! Cloning costs one map entry and one PTE update per page, whatever the
+//! size.
+//!
+//! A write through [`Vmo::write`] to a `cow` page copies that page only,
+//! and drops the shared reference. The last holder of a page writes it
+//! in place.
+//!
 //! # Usage
 //!
 //! ```rust
@@ -29,6 +42,7 @@ use crate::sync::SpinMutex;
 use crate::object::handle::{KernelObjectBase, ObjectType};
 use crate::arch::amd64::mm::page_tables::PAddr;
 use alloc::collections::BTreeMap;
+use alloc::vec::Vec;
 
 /// ============================================================================
 /// VMO ID
@@ -146,6 +160,21 @@ pub struct PageMapEntry {
 
     /// Whether page is writable
     pub writable: bool,
+
+    /// Whether the page may be shared with a clone: it is copied before
+    /// the first write
+    pub cow: bool,
+}
+
+/// A writable mapping of a VMO in some address space
+#[derive(Debug, Clone, Copy)]
+pub struct VmoMapping {
+    /// PML4 physical address of the address space
+    pub page_table: PAddr,
+    /// First virtual address
+    pub vaddr: u64,
+    /// Size in bytes (whole pages)
+    pub size: u64,
 }
 
 /// ============================================================================
@@ -176,8 +205,17 @@ pub struct Vmo {
 
     /// Parent VMO (for COW clones)
     pub parent: SpinMutex<Option<*const Vmo>>,
+
+    /// Writable mappings, write-protected when the VMO is cloned
+    pub mappings: SpinMutex<Vec<VmoMapping>>,
 }
 
+// The parent pointer is only read under its lock; all other state is
+// atomic or locked, so VMOs can be shared between CPUs (cached program
+// images, demand-paged regions)
+unsafe impl Send for Vmo {}
+unsafe impl Sync for Vmo {}
+
 impl Vmo {
     /// Create a new VMO
     ///
@@ -202,9 +240,73 @@ impl Vmo {
             cache_policy: SpinMutex::new(CachePolicy::Default),
             pages: SpinMutex::new(BTreeMap::new()),
             parent: SpinMutex::new(None),
+            mappings: SpinMutex::new(Vec::new()),
         })
     }
 
+    /// Create a VMO over existing physical memory
+    ///
+    /// The pages are not owned by the VMO: nothing is allocated, and the
+    /// memory must outlive every mapping made from it. Used to map
+    /// immutable kernel data (such as ramdisk files) into userspace
+    /// without copying.
+    ///
+    /// # Arguments
+    ///
+    /// * `paddr` - Physical base address (must be page-aligned)
+    /// * `size` - Size in bytes (will be rounded up to page size)
+    /// * `writable` - Whether the pages may be mapped writable
+    pub fn from_physical(paddr: PAddr, size: usize, writable: bool) -> Result<Self, &'static str> {
+        if paddr & 0xFFF != 0 {
+            return Err("physical address not page-aligned");
+        }
+
+        let vmo = Self::create(size, VmoFlags::empty)?;
+        {
+            let mut pages = vmo.pages.lock();
+            let mut offset = 0;
+            while offset < vmo.size() {
+                pages.insert(offset, PageMapEntry {
+                    paddr: paddr + offset as PAddr,
+                    present: true,
+                    writable,
+                    cow: false,
+                });
+                offset += 4096;
+            }
+        }
+
+        Ok(vmo)
+    }
+
+    /// Create a VMO over a list of existing physical pages
+    ///
+    /// Like [`Vmo::from_physical`], but the pages need not be contiguous:
+    /// page N of the VMO is `pages[N]`. Used to map pages handed over
+    /// through a channel, or tmpfs file pages, into the reader. The VMO
+    /// takes no references: the caller must hold one to each page on
+    /// behalf of the mappings made from it.
+    pub fn from_pages(pages: &[PAddr], writable: bool) -> Result<Self, &'static str> {
+        if pages.iter().any(|&paddr| paddr & 0xFFF != 0) {
+            return Err("physical address not page-aligned");
+        }
+
+        let vmo = Self::create(pages.len() * 4096, VmoFlags::empty)?;
+        {
+            let mut map = vmo.pages.lock();
+            for (i, &paddr) in pages.iter().enumerate() {
+                map.insert(i * 4096, PageMapEntry {
+                    paddr,
+                    present: true,
+                    writable,
+                    cow: false,
+                });
+            }
+        }
+
+        Ok(vmo)
+    }
+
     /// Get VMO ID
     pub const fn id(&self) -> VmoId {
         self.id
@@ -290,6 +392,7 @@ impl Vmo {
                 paddr,
                 present: true,
                 writable: true,
+                cow: false,
             });
         }
 
@@ -303,10 +406,11 @@ impl Vmo {
             let page_offset = write_offset % page_size;
             let key = page_index * page_size;
 
-            // Get page entry (holding lock briefly)
+            // Get page entry (holding lock briefly), unsharing it first
             let (page_paddr, page_present) = {
-                let pages = self.pages.lock();
-                let entry = pages.get(&key).unwrap();
+                let mut pages = self.pages.lock();
+                let entry = pages.get_mut(&key).unwrap();
+                Self::unshare(entry)?;
                 (entry.paddr, entry.present)
             };
 
@@ -401,69 +505,47 @@ impl Vmo {
 
     /// Clone the VMO (copy-on-write)
     ///
+    /// No page is copied: see the module documentation.
+    ///
     /// # Returns
     ///
     /// New VMO that shares pages with parent
     pub fn clone(&self) -> Result<Self, &'static str> {
-        let cloned = Self::create(self.size(), VmoFlags::empty)?;
+        use crate::mm::pmm;
+        use crate::process::address_space::AddressSpace;
+
+        let cloned = Self::create(self.size(), VmoFlags::COW)?;
 
-        // Copy all pages from parent to child
         {
-            let parent_pages = self.pages.lock();
+            let mut parent_pages = self.pages.lock();
             let mut child_pages = cloned.pages.lock();
 
-            for (offset, page_entry) in parent_pages.iter() {
-                if page_entry.present {
-                    unsafe {
-                        let msg = b"[VMO] Before PMM alloc for clone\n";
-                        for &byte in msg {
-                            core::arch::asm!("out dx, al", in("dx") 0xE9u16, in("al") byte, options(nomem, nostack));
-                        }
-                    }
-
-                    // Allocate a new physical page for the child from user zone
-                    use crate::mm::pmm;
-                    let new_paddr = pmm::pmm_alloc_user_page()
-                        .map_err(|_| "Failed to allocate page for clone")?;
+            for (offset, page_entry) in parent_pages.iter_mut() {
+                if !page_entry.present {
+                    continue;
+                }
 
-                    unsafe {
-                        let msg = b"[VMO] After PMM alloc - checking heap integrity\n";
-                        for &byte in msg {
-                            core::arch::asm!("out dx, al", in("dx") 0xE9u16, in("al") byte, options(nomem, nostack));
-                        }
-                    }
+                // Pages the PMM does not own (kernel image data) are
+                // shared without a reference: they are never freed
+                let _ = pmm::pmm_page_ref(page_entry.paddr);
+                page_entry.cow = true;
+                child_pages.insert(*offset, PageMapEntry {
+                    paddr: page_entry.paddr,
+                    present: true,
+                    writable: page_entry.writable,
+                    cow: true,
+                });
+            }
 
-                    // Copy the page data using small chunks to avoid stack overflow
-                    // Use a 256-byte buffer instead of 4KB to fit within kernel stack
-                    let chunk_size = 256usize;
-                    let page_size = 4096usize;
-                    let mut offset_in_page = 0usize;
-
-                    while offset_in_page < page_size {
-                        let mut buffer = [0u8; 256];
-                        let bytes_to_copy = core::cmp::min(chunk_size, page_size - offset_in_page);
-
-                        unsafe {
-                            // Copy from source to buffer
-                            let src_vaddr = pmm::paddr_to_vaddr_user_zone(page_entry.paddr + offset_in_page as u64);
-                            let src_ptr = src_vaddr as *const u8;
-                            core::ptr::copy_nonoverlapping(src_ptr, buffer.as_mut_ptr(), bytes_to_copy);
-
-                            // Copy from buffer to destination
-                            let dst_vaddr = pmm::paddr_to_vaddr_user_zone(new_paddr + offset_in_page as u64);
-                            let dst_ptr = dst_vaddr as *mut u8;
-                            core::ptr::copy_nonoverlapping(buffer.as_ptr(), dst_ptr, bytes_to_copy);
-                        }
-
-                        offset_in_page += bytes_to_copy;
+            // Existing writable mappings would write the shared pages:
+            // make them copy-on-write too. They no longer need protecting
+            // on the next clone.
+            for mapping in self.mappings.lock().drain(..) {
+                let space = AddressSpace::from_page_table(mapping.page_table);
+                for offset in (0..mapping.size).step_by(4096) {
+                    if parent_pages.contains_key(&(offset as usize)) {
+                        space.protect_cow(mapping.vaddr + offset);
                     }
-
-                    // Add the page to the child
-                    child_pages.insert(*offset, PageMapEntry {
-                        paddr: new_paddr,
-                        present: true,
-                        writable: true,
-                    });
                 }
             }
         } // Locks are released here
@@ -471,6 +553,38 @@ impl Vmo {
         Ok(cloned)
     }
 
+    /// Give a `cow` page a physical page of its own before it is written
+    ///
+    /// Copies the page, unless no one else holds it any more.
+    fn unshare(entry: &mut PageMapEntry) -> Result<(), &'static str> {
+        use crate::mm::pmm;
+
+        if !entry.cow {
+            return Ok(());
+        }
+
+        if pmm::pmm_page_ref_count(entry.paddr) != 1 {
+            let copy = pmm::pmm_alloc_user_page()
+                .map_err(|_| "Failed to allocate user page")?;
+            unsafe {
+                core::ptr::copy_nonoverlapping(
+                    pmm::paddr_to_vaddr_user_zone(entry.paddr) as *const u8,
+                    pmm::paddr_to_vaddr_user_zone(copy) as *mut u8,
+                    4096,
+                );
+            }
+            let _ = pmm::pmm_page_unref(entry.paddr);
+            entry.paddr = copy;
+        }
+        entry.cow = false;
+        Ok(())
+    }
+
+    /// Record a writable mapping of the VMO (see [`Vmo::clone`])
+    pub fn add_writable_mapping(&self, page_table: PAddr, vaddr: u64, size: u64) {
+        self.mappings.lock().push(VmoMapping { page_table, vaddr, size });
+    }
+
     /// Get cache policy
     pub fn cache_policy(&self) -> CachePolicy {
         *self.cache_policy.lock()
@@ -599,4 +713,21 @@ mod tests {
         assert!(child.flags.is_cow());
         assert_eq!(child.size(), parent.size());
     }
+
+    #[test]
+    fn test_vmo_clone_shares_pages() {
+        let parent = Vmo::from_physical(0x4000_0000, 0x2000, true).unwrap();
+        let child = parent.clone().unwrap();
+
+        // Same pages on both sides, copied only when written
+        let parent_pages = parent.pages.lock();
+        let child_pages = child.pages.lock();
+        assert_eq!(child_pages.len(), 2);
+        for (offset, entry) in child_pages.iter() {
+            let shared = &parent_pages[offset];
+            assert_eq!(entry.paddr, shared.paddr);
+            assert!(entry.cow && shared.cow);
+            assert!(entry.writable);
+        }
+    }
 }
@@ -8,13 +8,45 @@
 //!
 //! This module provides address space management for processes.
 //! Each process has its own address space with page tables.
+//!
+//! # Demand Paging
+//!
+//! Program segments are not copied in when a process is built. They are
+//! registered as [`Region`]s of its address space instead, and the page
+//! fault handler populates each page on first touch ([`AddressSpace::fault_in`]):
+//! from the program file, or with zeros past its end (`.bss`).
+//!
+//! Regions are kept per page table (the PML4 physical address), so the
+//! short-lived `AddressSpace` wrappers of a running process see them.
+//!
+//! # Copy-on-Write
+//!
+//! Pages a VMO shares with its clones (see `Vmo::clone`) are mapped
+//! read-only and tagged [`PTE_COW`], and each such mapping holds a
+//! reference to its page. The first write faults, and [`AddressSpace::break_cow`]
+//! gives the mapping a copy of that one page, or makes it writable in
+//! place if no one else holds the page any more. Like a private file
+//! mapping, a mapping that broke away no longer follows its VMO.
+//!
+//! Pages sent through a channel without copying ([`AddressSpace::share_page`])
+//! are write-protected the same way, so the sender's next write goes to a
+//! copy and the message keeps the contents it was sent with.
+//!
+//! # Threads
+//!
+//! The threads of a process share its page table and may fault on the
+//! same page from several CPUs at once. User page table changes are made
+//! under [`PAGE_TABLES`], and each fault re-checks the page under it, so
+//! the first fault maps (or copies) the page and the others just retry.
 
 #![allow(dead_code)]
 
 use core::sync::atomic::{AtomicU64, Ordering};
 use alloc::collections::BTreeMap;
+use alloc::vec::Vec;
 use crate::sync::SpinMutex;
 use crate::object::{Vmo, VmoId};
+use crate::object::vmo::PageMapEntry;
 
 use crate::arch::amd64::mm::page_tables::{
     X86PageTableBase, PageTableEntry, PageTableRole, PageTableLevel,
@@ -24,6 +56,14 @@ use crate::arch::amd64::mm::page_tables::{
 // Page size
 const PAGE_SIZE: usize = 4096;
 
+/// Software-available PTE bit: the page is shared copy-on-write
+pub const PTE_COW: u64 = 1 << 9;
+
+// Hardware PTE bits
+const PTE_PRESENT: u64 = 1;
+const PTE_WRITABLE: u64 = 2;
+const PTE_ADDR_MASK: u64 = 0x000F_FFFF_FFFF_F000;
+
 // Page table indices from virtual address
 fn pml4_index(vaddr: VAddr) -> usize {
     (vaddr >> 39) & 0x1FF
@@ -53,6 +93,75 @@ struct VmoMapping {
     flags: u32,
 }
 
+/// Where the pages of a demand-paged region come from
+#[derive(Clone, Copy)]
+pub enum PageSource {
+    /// Pages of a VMO shared by every address space mapping it: a page is
+    /// filled once, by the first fault of any of them (read-only data)
+    Shared(&'static Vmo),
+    /// Pages private to the address space, filled on each one's faults
+    Private,
+}
+
+/// A demand-paged range of an address space
+#[derive(Clone, Copy)]
+pub struct Region {
+    /// First virtual address (page-aligned)
+    pub vaddr: u64,
+    /// Size in bytes (whole pages)
+    pub size: u64,
+    /// Segment permissions (PF_R, PF_W, PF_X)
+    pub flags: u32,
+    /// Initial contents; the rest of the region reads as zeros
+    pub data: &'static [u8],
+    /// Offset of `data` from `vaddr`
+    pub data_offset: u64,
+    /// Backing of the pages
+    pub source: PageSource,
+}
+
+impl Region {
+    /// Whether `vaddr` lies in the region
+    pub fn contains(&self, vaddr: u64) -> bool {
+        vaddr >= self.vaddr && vaddr - self.vaddr < self.size
+    }
+
+    /// Fill `page` with the initial contents of the page at `offset`
+    fn fill(&self, offset: u64, page: &mut [u8]) {
+        page.fill(0);
+
+        let data_end = self.data_offset + self.data.len() as u64;
+        let start = offset.max(self.data_offset);
+        let end = (offset + page.len() as u64).min(data_end);
+        if start < end {
+            let src = &self.data[(start - self.data_offset) as usize..(end - self.data_offset) as usize];
+            page[(start - offset) as usize..(end - offset) as usize].copy_from_slice(src);
+        }
+    }
+
+    /// Allocate a user page holding the initial contents of the page at
+    /// `offset`
+    fn alloc_page(&self, offset: u64) -> Result<PAddr, &'static str> {
+        use crate::mm::pmm;
+
+        let paddr = pmm::pmm_alloc_user_page()
+            .map_err(|_| "Failed to allocate user page")?;
+        let page = unsafe {
+            core::slice::from_raw_parts_mut(pmm::paddr_to_vaddr_user_zone(paddr) as *mut u8, PAGE_SIZE)
+        };
+        self.fill(offset, page);
+        Ok(paddr)
+    }
+}
+
+/// Demand-paged regions, by page table (PML4 physical address)
+static REGIONS: SpinMutex<BTreeMap<PAddr, Vec<Region>>> = SpinMutex::new(BTreeMap::new());
+
+/// Serializes changes to user page tables
+///
+/// Taken after a VMO's page lock, never before it.
+static PAGE_TABLES: SpinMutex<()> = SpinMutex::new(());
+
 /// Address Space
 ///
 /// Represents a process's virtual address space with page tables.
@@ -86,7 +195,7 @@ impl AddressSpace {
     /// New address space with empty page tables
     pub fn new() -> Result<Self, &'static str> {
         use crate::mm::pmm;
-        use crate::arch::amd64::init;
+        use crate::arch::amd64::{mmu, tlb};
 
         // Allocate a page for the PML4 from kernel zone
         let pml4_paddr = pmm::pmm_alloc_kernel_page()
@@ -118,7 +227,7 @@ impl AddressSpace {
         // to copy all entries, not just the higher-half entries.
 
         unsafe {
-            let kernel_cr3 = init::x86_read_cr3();
+            let kernel_cr3 = mmu::x86_kernel_cr3();
             let kernel_pml4_paddr = kernel_cr3 & !0xFFF;
             let kernel_pml4_vaddr = pmm::paddr_to_vaddr(kernel_pml4_paddr) as *const pt_entry_t;
 
@@ -137,6 +246,9 @@ impl AddressSpace {
             }
         }
 
+        // Tag its TLB entries, so switching to and from it keeps them
+        tlb::assign_pcid(pml4_paddr);
+
         Ok(Self {
             id: alloc_as_id(),
             page_table,
@@ -145,6 +257,28 @@ impl AddressSpace {
         })
     }
 
+    /// Wrap the existing page table of a running process
+    ///
+    /// Used to add mappings (I/O rings, mapped files) to a process after
+    /// its image was loaded. The wrapper does not own the page table and
+    /// has no address space ID of its own (id 0).
+    pub fn from_page_table(pml4_paddr: PAddr) -> Self {
+        use crate::mm::pmm;
+
+        Self {
+            id: 0,
+            page_table: X86PageTableBase {
+                phys: pml4_paddr,
+                virt: pmm::paddr_to_vaddr(pml4_paddr) as *mut pt_entry_t,
+                pages: 1,
+                role: PageTableRole::Independent,
+                num_references: 0,
+            },
+            mappings: SpinMutex::new(BTreeMap::new()),
+            ref_count: AtomicU64::new(1),
+        }
+    }
+
     /// Get address space ID
     pub fn id(&self) -> u64 {
         self.id
@@ -212,21 +346,36 @@ impl AddressSpace {
             // Get the physical page from the VMO
             let page_entry = vmo_pages.get(&page_offset);
 
-            let paddr = match page_entry {
+            let (paddr, cow) = match page_entry {
                 Some(entry) => {
                     if !entry.present {
                         return Err("VMO page not present");
                     }
-                    entry.paddr
+                    (entry.paddr, entry.cow)
                 }
                 None => {
                     return Err("VMO page not present");
                 }
             };
 
-            self.map_page(page_vaddr as u64, paddr, flags)?;
+            if cow && flags & 0x2 != 0 {
+                // Shared with a clone: writable only after the first
+                // write copies it, and held while mapped
+                self.map_page(page_vaddr as u64, paddr, flags & !0x2)?;
+                if let Some(pte) = self.leaf_entry(page_vaddr as u64) {
+                    unsafe { *pte |= PTE_COW };
+                }
+                let _ = crate::mm::pmm::pmm_page_ref(paddr);
+            } else {
+                self.map_page(page_vaddr as u64, paddr, flags)?;
+            }
+        }
+        drop(vmo_pages);
+
+        // Cloning the VMO later must write-protect this mapping
+        if flags & 0x2 != 0 {
+            vmo.add_writable_mapping(self.page_table.phys, vaddr, num_pages as u64 * PAGE_SIZE as u64);
         }
-        // Lock is released here
 
         // Store the mapping - skip VMO cloning for now to avoid corruption
         // TODO: Fix VMO clone corruption and re-enable cloning
@@ -244,6 +393,87 @@ impl AddressSpace {
         Ok(())
     }
 
+    /// Register a demand-paged region
+    ///
+    /// Nothing is mapped: each page is populated by the first fault on
+    /// it. Regions last as long as the page table.
+    pub fn add_region(&self, region: Region) -> Result<(), &'static str> {
+        if region.vaddr & 0xFFF != 0 || region.size & 0xFFF != 0 {
+            return Err("Region not page-aligned");
+        }
+
+        let mut regions = REGIONS.lock();
+        let list = regions.entry(self.page_table.phys).or_insert_with(Vec::new);
+        let end = region.vaddr + region.size;
+        if list.iter().any(|r| r.vaddr < end && region.vaddr < r.vaddr + r.size) {
+            return Err("Region overlaps an existing region");
+        }
+        list.push(region);
+        Ok(())
+    }
+
+    /// Populate the page containing `vaddr` from its demand-paged region
+    ///
+    /// Called on not-present page faults. The page gets the region's
+    /// initial contents and is mapped with its permissions.
+    ///
+    /// # Returns
+    ///
+    /// * `Ok(())` - The page is mapped; the faulting access can be retried
+    /// * `Err(&str)` - `vaddr` is in no region, or the access is not allowed
+    pub fn fault_in(&self, vaddr: u64, write: bool) -> Result<(), &'static str> {
+        let page_vaddr = vaddr & !0xFFF;
+        let region = REGIONS.lock()
+            .get(&self.page_table.phys)
+            .and_then(|regions| regions.iter().find(|r| r.contains(page_vaddr)).copied())
+            .ok_or("Address not in a demand-paged region")?;
+
+        if write && region.flags & 0x2 == 0 {
+            return Err("Write to a read-only region");
+        }
+
+        // Populated since the fault was taken
+        if self.translate(page_vaddr).is_some() {
+            return Ok(());
+        }
+
+        let offset = page_vaddr - region.vaddr;
+        let paddr = match region.source {
+            PageSource::Private => {
+                let _tables = PAGE_TABLES.lock();
+                // Another thread of the process may have got here first
+                if self.translate(page_vaddr).is_some() {
+                    return Ok(());
+                }
+                let paddr = region.alloc_page(offset)?;
+                return self.map_page_locked(page_vaddr, paddr, region.flags);
+            }
+            PageSource::Shared(vmo) => {
+                // Held across the fill, so concurrent faults fill a page once
+                let mut pages = vmo.pages.lock();
+                match pages.get(&(offset as usize)) {
+                    Some(entry) => entry.paddr,
+                    None => {
+                        let paddr = region.alloc_page(offset)?;
+                        pages.insert(offset as usize, PageMapEntry {
+                            paddr,
+                            present: true,
+                            writable: false,
+                            cow: false,
+                        });
+                        paddr
+                    }
+                }
+            }
+        };
+
+        let _tables = PAGE_TABLES.lock();
+        if self.translate(page_vaddr).is_some() {
+            return Ok(());
+        }
+        self.map_page_locked(page_vaddr, paddr, region.flags)
+    }
+
     /// Map a single page
     ///
     /// # Arguments
@@ -252,6 +482,12 @@ impl AddressSpace {
     /// * `paddr` - Physical address (must be page-aligned)
     /// * `flags` - Page flags (PF_R, PF_W, PF_X)
     fn map_page(&self, vaddr: u64, paddr: PAddr, flags: u32) -> Result<(), &'static str> {
+        let _tables = PAGE_TABLES.lock();
+        self.map_page_locked(vaddr, paddr, flags)
+    }
+
+    /// Map a single page, with [`PAGE_TABLES`] held
+    fn map_page_locked(&self, vaddr: u64, paddr: PAddr, flags: u32) -> Result<(), &'static str> {
         // Helper: get virtual address of a page table from a PML4/PDP/PD/PT entry
         // CRITICAL: Always call this AFTER updating the parent entry, never cache and reuse!
         unsafe fn table_from_entry(entry: u64) -> *mut pt_entry_t {
@@ -271,6 +507,10 @@ impl AddressSpace {
 
             let pml4 = self.page_table.virt;
 
+            // A present entry replaced on the way (kernel tables swapped
+            // for private copies, or a remapped page) needs a TLB flush
+            let mut replaced = false;
+
             // Walk the page tables
             let pml4_idx = pml4_index(vaddr as usize);
             let pdp_idx = pdp_index(vaddr as usize);
@@ -288,8 +528,9 @@ impl AddressSpace {
             // - This ensures kernel PML4 entries are never modified by userspace mappings
             // - Process-specific PML4 entries are safe to reuse
             unsafe {
-                use crate::arch::amd64::init::x86_read_cr3;
-                let kernel_cr3 = x86_read_cr3();
+                // The kernel's own page table, not CR3: that is this
+                // address space itself when it maps into a running process
+                let kernel_cr3 = crate::arch::amd64::mmu::x86_kernel_cr3();
                 let kernel_pml4_paddr = kernel_cr3 & !0xFFF;
                 let kernel_pml4_vaddr = crate::mm::pmm::paddr_to_vaddr(kernel_pml4_paddr) as *const pt_entry_t;
                 let kernel_pml4_entry = *kernel_pml4_vaddr.add(pml4_idx);
@@ -315,6 +556,7 @@ impl AddressSpace {
 
                     // Update PML4 to point to new process-specific PDP
                     *pml4.add(pml4_idx) = (new_pdp | 7); // Present + Writable + User
+                    replaced = true;
                     debug_msg(b"[MAP-P] Process PDP allocated and installed\n");
                 } else if (process_pml4_entry & 1) == 0 {
                     // Empty PML4 entry - allocate new PDP
@@ -353,8 +595,9 @@ impl AddressSpace {
             // CRITICAL: Check if this PD entry is from the kernel
             // If so, we MUST NOT reuse it - allocate a new process-specific PD
             unsafe {
-                use crate::arch::amd64::init::x86_read_cr3;
-                let kernel_cr3 = x86_read_cr3();
+                // The kernel's own page table, not CR3: that is this
+                // address space itself when it maps into a running process
+                let kernel_cr3 = crate::arch::amd64::mmu::x86_kernel_cr3();
                 let kernel_pml4_paddr = kernel_cr3 & !0xFFF;
                 let kernel_pml4_vaddr = crate::mm::pmm::paddr_to_vaddr(kernel_pml4_paddr) as *const pt_entry_t;
                 let kernel_pml4_entry = *kernel_pml4_vaddr.add(pml4_idx);
@@ -389,6 +632,7 @@ impl AddressSpace {
 
                     // Update PDP to point to new process-specific PD
                     *pdp.add(pdp_idx) = (new_pd | 7);
+                    replaced = true;
                     debug_msg(b"[MAP-P] Process PD allocated and installed\n");
                 } else if (process_pd_entry & 1) == 0 {
                     // Empty PD entry - allocate new PD
@@ -461,14 +705,200 @@ impl AddressSpace {
             // Set user bit (CPL=3 can access)
             pt_entry |= 4;
 
+            replaced |= *pt.add(pt_idx) & 1 != 0;
             *pt.add(pt_idx) = pt_entry;
 
+            if replaced {
+                crate::arch::amd64::tlb::flush_page(self.page_table.phys, vaddr);
+            }
+
             debug_msg(b"[MAP-P] map_page complete\n");
 
             Ok(())
         }
     }
 
+    /// Look up the physical page behind a user virtual address
+    ///
+    /// # Returns
+    ///
+    /// Physical address of the 4 KB page containing `vaddr` and whether
+    /// it is writable, or None unless it is mapped present and
+    /// user-accessible at every level.
+    pub fn translate(&self, vaddr: u64) -> Option<(PAddr, bool)> {
+        const PRESENT: u64 = 1;
+        const WRITABLE: u64 = 2;
+        const USER: u64 = 4;
+        const LARGE: u64 = 0x80;
+        const ADDR_MASK: u64 = 0x000F_FFFF_FFFF_F000;
+
+        let vaddr_usize = vaddr as usize;
+        let indices = [
+            pml4_index(vaddr_usize),
+            pdp_index(vaddr_usize),
+            pd_index(vaddr_usize),
+            pt_index(vaddr_usize),
+        ];
+
+        let mut table = self.page_table.virt as *const pt_entry_t;
+        let mut writable = true;
+        for (level, &index) in indices.iter().enumerate() {
+            let entry = unsafe { *table.add(index) };
+            if entry & (PRESENT | USER) != (PRESENT | USER) {
+                return None;
+            }
+            writable &= entry & WRITABLE != 0;
+
+            let large = entry & LARGE != 0;
+            if level == 3 || (large && level > 0) {
+                // Leaf: a 4 KB page, or a 1 GB / 2 MB page at the PDP / PD
+                let shift = 12 + 9 * (3 - level as u32);
+                let page_mask = (1u64 << shift) - 1;
+                let base = entry & ADDR_MASK & !page_mask;
+                return Some((base + (vaddr & page_mask & !0xFFF), writable));
+            }
+
+            table = crate::mm::pmm::paddr_to_vaddr(entry & ADDR_MASK) as *const pt_entry_t;
+        }
+        None
+    }
+
+    /// Page table entry of a 4 KB user page
+    ///
+    /// # Returns
+    ///
+    /// The entry's address, or None if a table on the way to it is
+    /// missing, or a large page maps `vaddr`
+    fn leaf_entry(&self, vaddr: u64) -> Option<*mut pt_entry_t> {
+        const LARGE: u64 = 0x80;
+
+        let vaddr_usize = vaddr as usize;
+        let mut table = self.page_table.virt;
+        for index in [pml4_index(vaddr_usize), pdp_index(vaddr_usize), pd_index(vaddr_usize)] {
+            let entry = unsafe { *table.add(index) };
+            if entry & PTE_PRESENT == 0 || entry & LARGE != 0 {
+                return None;
+            }
+            table = crate::mm::pmm::paddr_to_vaddr(entry & PTE_ADDR_MASK) as *mut pt_entry_t;
+        }
+        Some(unsafe { table.add(pt_index(vaddr_usize)) })
+    }
+
+    /// Whether `vaddr` is mapped copy-on-write
+    pub fn is_cow(&self, vaddr: u64) -> bool {
+        self.leaf_entry(vaddr & !0xFFF)
+            .map_or(false, |pte| unsafe { *pte } & (PTE_PRESENT | PTE_COW) == PTE_PRESENT | PTE_COW)
+    }
+
+    /// Turn a writable mapping of a page into a copy-on-write one
+    ///
+    /// Used when the VMO behind it is cloned. The mapping takes its own
+    /// reference to the page. Does nothing unless `vaddr` is mapped
+    /// writable.
+    pub fn protect_cow(&self, vaddr: u64) {
+        let _tables = PAGE_TABLES.lock();
+        self.protect_cow_locked(vaddr & !0xFFF, true);
+    }
+
+    /// [`AddressSpace::protect_cow`] with [`PAGE_TABLES`] held
+    ///
+    /// `take_ref` is false for a mapping that already holds a reference
+    /// to its page (a private page).
+    fn protect_cow_locked(&self, page_vaddr: u64, take_ref: bool) {
+        let Some(pte) = self.leaf_entry(page_vaddr) else { return };
+
+        unsafe {
+            let entry = *pte;
+            if entry & (PTE_PRESENT | PTE_WRITABLE) != PTE_PRESENT | PTE_WRITABLE {
+                return;
+            }
+            if take_ref {
+                let _ = crate::mm::pmm::pmm_page_ref(entry & PTE_ADDR_MASK);
+            }
+            *pte = (entry & !PTE_WRITABLE) | PTE_COW;
+        }
+        crate::arch::amd64::tlb::flush_page(self.page_table.phys, page_vaddr);
+    }
+
+    /// Hand the page at `vaddr` to someone else without copying it
+    ///
+    /// The mapping becomes copy-on-write (if it was writable), so later
+    /// writes through it leave the shared page alone. The caller gets a
+    /// reference to the page of its own.
+    ///
+    /// # Returns
+    ///
+    /// The physical page, or None if `vaddr` is not mapped
+    pub fn share_page(&self, vaddr: u64) -> Option<PAddr> {
+        let page_vaddr = vaddr & !0xFFF;
+        // A private page's only reference is its mapping's already
+        let private = REGIONS.lock()
+            .get(&self.page_table.phys)
+            .and_then(|regions| regions.iter().find(|r| r.contains(page_vaddr)))
+            .map_or(false, |region| matches!(region.source, PageSource::Private));
+
+        let _tables = PAGE_TABLES.lock();
+        self.protect_cow_locked(page_vaddr, !private);
+        let entry = unsafe { *self.leaf_entry(page_vaddr)? };
+        if entry & PTE_PRESENT == 0 {
+            return None;
+        }
+        let paddr = entry & PTE_ADDR_MASK;
+        let _ = crate::mm::pmm::pmm_page_ref(paddr);
+        Some(paddr)
+    }
+
+    /// Resolve a write fault on a copy-on-write page
+    ///
+    /// Copies the page into a private one, or, if the mapping holds the
+    /// last reference to it, just makes it writable.
+    ///
+    /// # Returns
+    ///
+    /// * `Ok(())` - The page is writable; the faulting write can be retried
+    /// * `Err(&str)` - `vaddr` is not mapped copy-on-write
+    pub fn break_cow(&self, vaddr: u64) -> Result<(), &'static str> {
+        use crate::mm::pmm;
+
+        let page_vaddr = vaddr & !0xFFF;
+        let _tables = PAGE_TABLES.lock();
+        let pte = self.leaf_entry(page_vaddr).ok_or("Address not mapped")?;
+        let entry = unsafe { *pte };
+        if entry & (PTE_PRESENT | PTE_WRITABLE) == PTE_PRESENT | PTE_WRITABLE {
+            // Another thread of the process broke it first (the fault
+            // dropped our stale TLB entry)
+            return Ok(());
+        }
+        if entry & (PTE_PRESENT | PTE_COW) != PTE_PRESENT | PTE_COW {
+            return Err("Write to a read-only page");
+        }
+
+        let shared = entry & PTE_ADDR_MASK;
+        let paddr = if pmm::pmm_page_ref_count(shared) == 1 {
+            shared
+        } else {
+            let copy = pmm::pmm_alloc_user_page()
+                .map_err(|_| "Failed to allocate user page")?;
+            unsafe {
+                core::ptr::copy_nonoverlapping(
+                    pmm::paddr_to_vaddr_user_zone(shared) as *const u8,
+                    pmm::paddr_to_vaddr_user_zone(copy) as *mut u8,
+                    PAGE_SIZE,
+                );
+            }
+            // Not a PMM page (kernel image data) if this fails: nothing
+            // to release
+            let _ = pmm::pmm_page_unref(shared);
+            copy
+        };
+
+        unsafe {
+            *pte = (entry & !(PTE_ADDR_MASK | PTE_COW)) | paddr | PTE_WRITABLE;
+        }
+        crate::arch::amd64::tlb::flush_page(self.page_table.phys, page_vaddr);
+        Ok(())
+    }
+
     /// Allocate a new page table
     ///
     /// # Returns
@@ -506,3 +936,48 @@ impl Default for AddressSpace {
         Self::new().expect("Failed to create default address space")
     }
 }
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    fn region(data: &'static [u8], data_offset: u64) -> Region {
+        Region {
+            vaddr: 0x40_0000,
+            size: 3 * PAGE_SIZE as u64,
+            flags: 0x6,
+            data,
+            data_offset,
+            source: PageSource::Private,
+        }
+    }
+
+    #[test]
+    fn test_region_contains() {
+        let r = region(&[], 0);
+        assert!(!r.contains(0x3F_FFFF));
+        assert!(r.contains(0x40_0000));
+        assert!(r.contains(0x40_2FFF));
+        assert!(!r.contains(0x40_3000));
+    }
+
+    #[test]
+    fn test_region_fill() {
+        // Data starts 0x10 into the first page and spills into the second
+        static DATA: [u8; PAGE_SIZE] = [0xAB; PAGE_SIZE];
+        let r = region(&DATA, 0x10);
+        let mut page = [0xFFu8; PAGE_SIZE];
+
+        r.fill(0, &mut page);
+        assert!(page[..0x10].iter().all(|&b| b == 0));
+        assert!(page[0x10..].iter().all(|&b| b == 0xAB));
+
+        r.fill(PAGE_SIZE as u64, &mut page);
+        assert!(page[..0x10].iter().all(|&b| b == 0xAB));
+        assert!(page[0x10..].iter().all(|&b| b == 0));
+
+        // Past the data: zero-filled (.bss)
+        r.fill(2 * PAGE_SIZE as u64, &mut page);
+        assert!(page.iter().all(|&b| b == 0));
+    }
+}
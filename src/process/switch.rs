@@ -11,7 +11,10 @@
 //! saving the current process's state and restoring the next process's
 //! state.
 
-use crate::process::table::{Process, SavedState};
+use core::arch::naked_asm;
+
+use crate::process::table::SavedState;
+use crate::sched::runqueue::RUN_QUEUES;
 
 /// ============================================================================
 /// Assembly Context Switch Function
@@ -36,6 +39,21 @@ extern "C" {
     /// This function never returns in the normal sense - it "returns"
     /// to the RIP saved in the next process's SavedState.
     fn context_switch(prev: *mut SavedState, next: *const SavedState, next_cr3: u64);
+
+    /// Voluntary context switch saving only callee-saved state
+    ///
+    /// Same contract as `context_switch`; it saves RBX, RBP, R12-R15,
+    /// RSP, RIP, RFLAGS and CR3 only. CR3 is only written if it changes.
+    fn context_switch_cooperative(prev: *mut SavedState, next: *const SavedState, next_cr3: u64);
+}
+
+/// How the outgoing task gives up the CPU
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+pub enum SwitchKind {
+    /// Involuntary (timer preemption): save the full register frame
+    Preempt,
+    /// Voluntary (yield): save only callee-saved registers
+    Cooperative,
 }
 
 /// ============================================================================
@@ -66,122 +84,94 @@ pub unsafe fn context_switch_raw(
     context_switch(prev, next, next_cr3);
 }
 
-/// Switch from one process to another
-///
-/// This function saves the current process's CPU state and restores
-/// the next process's CPU state, then jumps to the next process's
-/// instruction pointer.
+/// Raw cooperative context switch using pointers
 ///
-/// # Arguments
-///
-/// * `current` - Mutable reference to the current process
-/// * `next` - Reference to the next process to run
+/// Like `context_switch_raw`, but only saves the registers a function
+/// call preserves. Only valid when the current task is switching out
+/// voluntarily from a normal call chain (sys_yield, blocking).
 ///
 /// # Safety
 ///
-/// This function is unsafe because:
-/// - It performs a low-level context switch
-/// - The caller must ensure both processes are valid
-/// - The caller must ensure the next process's page tables are valid
-/// - This function changes the current execution context
-///
-/// After calling this function, code execution continues in the
-/// next process at its saved RIP. The current process will later
-/// be resumed when another context switch back to it occurs.
-pub unsafe fn switch_to(current: &mut Process, next: &Process) {
-    // Update process states
-    current.state = crate::process::table::ProcessState::Ready;
-
-    // Perform the context switch
-    // The assembly function will save current's state to current.saved_state
-    // and restore next's state from next.saved_state
-    context_switch(
-        &mut current.saved_state as *mut SavedState,
-        &next.saved_state as *const SavedState,
-        next.page_table,
-    );
-
-    // After returning here, we are now executing as the `next` process
-    // (or we've been switched back to this process later)
+/// Same requirements as `context_switch_raw`.
+pub unsafe fn context_switch_cooperative_raw(
+    prev: *mut SavedState,
+    next: *const SavedState,
+    next_cr3: u64,
+) {
+    context_switch_cooperative(prev, next, next_cr3);
 }
 
-/// Switch to a process by PID
-///
-/// This is a convenience wrapper that looks up the process by PID
-/// and then calls switch_to().
-///
-/// # Arguments
-///
-/// * `next_pid` - PID of the process to switch to
-///
-/// # Returns
-///
-/// * `Ok(())` - Successfully switched to the next process
-/// * `Err(&str)` - Failed to switch (process not found, etc.)
+/// Switch using the variant appropriate for `kind`
 ///
 /// # Safety
 ///
-/// This function is unsafe because it performs a context switch.
-/// The caller must ensure proper locking and state management.
-pub unsafe fn switch_to_pid(next_pid: u32) -> Result<(), &'static str> {
-    use crate::process::table::PROCESS_TABLE;
-
-    let mut table = PROCESS_TABLE.lock();
-
-    // Get current process
-    let current_pid = table
-        .current_pid()
-        .ok_or("No current process")?;
-
-    // Can't switch to ourselves
-    if current_pid == next_pid {
-        return Ok(());
-    }
-
-    // Extract the data we need first to avoid borrowing issues
-    let next_cr3 = table.get(next_pid)
-        .map(|p| p.page_table)
-        .ok_or("Next process not found")?;
-
-    let next_state = table.get(next_pid)
-        .map(|p| p.state)
-        .ok_or("Next process not found")?;
-
-    // Check that next process is runnable
-    if !next_state.is_runnable() {
-        return Err("Next process is not runnable");
-    }
-
-    // Get the saved state pointers
-    let next_saved_ptr = table.get(next_pid)
-        .map(|p| &p.saved_state as *const SavedState)
-        .ok_or("Next process not found")?;
-
-    let current_saved_ptr = table.get_mut(current_pid)
-        .map(|p| &mut p.saved_state as *mut SavedState)
-        .ok_or("Current process not found")?;
-
-    // Update current process state
-    if let Some(process) = table.get_mut(current_pid) {
-        process.state = crate::process::table::ProcessState::Ready;
-    }
-
-    // Update the table's current pointer
-    table.set_current(next_pid);
-
-    // Mark next as running
-    if let Some(process) = table.get_mut(next_pid) {
-        process.state = crate::process::table::ProcessState::Running;
+/// Same requirements as `context_switch_raw`.
+pub unsafe fn context_switch_kind(
+    kind: SwitchKind,
+    prev: *mut SavedState,
+    next: *const SavedState,
+    next_cr3: u64,
+) {
+    match kind {
+        SwitchKind::Preempt => context_switch(prev, next, next_cr3),
+        SwitchKind::Cooperative => context_switch_cooperative(prev, next, next_cr3),
     }
+}
 
-    // Release the table lock before context switch
-    // (we can't hold locks across context switches)
-    drop(table);
+/// ============================================================================
+/// First Entry of a New Process
+/// ============================================================================
 
-    // Perform the context switch
-    context_switch(current_saved_ptr, next_saved_ptr, next_cr3);
+/// Release the run queue lock handed over by the switch
+extern "C" fn finish_first_entry() {
+    // Safety: the CPU that switched to us holds the lock on our behalf
+    unsafe { RUN_QUEUES.finish_switch(); }
+}
 
-    Ok(())
+/// Kernel-side start of a new process (see `SavedState::for_first_entry`)
+///
+/// Entered by a context switch on the process's empty kernel stack with
+/// RBX = user entry point, R12 = user stack top and R13 = the entry
+/// point's argument. Releases the run queue lock the switch was made
+/// under, then drops to ring 3 with the argument in RDI, interrupts
+/// enabled and no kernel register contents left behind.
+///
+/// # Safety
+///
+/// Must only be reached through a context switch to a state built by
+/// `SavedState::for_first_entry`.
+#[unsafe(naked)]
+#[no_mangle]
+pub unsafe extern "C" fn process_first_entry() {
+    naked_asm!(
+        // RSP is the 16-byte aligned stack top
+        "call {finish}",
+
+        // iretq frame: SS, RSP, RFLAGS (IF), CS, RIP
+        "push 0x23",
+        "push r12",
+        "push 0x202",
+        "push 0x1B",
+        "push rbx",
+
+        "xor eax, eax",
+        "xor ebx, ebx",
+        "xor ecx, ecx",
+        "xor edx, edx",
+        "xor esi, esi",
+        "mov rdi, r13",
+        "xor ebp, ebp",
+        "xor r8d, r8d",
+        "xor r9d, r9d",
+        "xor r10d, r10d",
+        "xor r11d, r11d",
+        "xor r12d, r12d",
+        "xor r13d, r13d",
+        "xor r14d, r14d",
+        "xor r15d, r15d",
+        "iretq",
+        finish = sym finish_first_entry,
+    );
 }
 
 /// Initialize the SavedState for a new process
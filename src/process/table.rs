@@ -9,9 +9,35 @@
 //! This module provides the global process table for tracking all processes
 //! in the system. It implements the Phase 5B requirements for process
 //! management and context switching.
+//!
+//! # Scheduling State
+//!
+//! A process's scheduling state (state, priority, affinity, saved
+//! registers, CPU time) is not part of its entry. `Process::new` builds
+//! it as a `sched::runqueue::Task`, and `ProcessTable::insert` hands that
+//! to the run queues, which keep it under per-CPU locks: scheduling and
+//! context switches never take the table lock. Ready processes are on
+//! per-CPU priority run queues, so picking the next process is a bit scan
+//! plus a list pop whatever the table size.
+//!
+//! The "current process" is per CPU: `current()` and friends refer to the
+//! process running on the calling CPU.
+//!
+//! # Threads
+//!
+//! A thread is a table entry of its own (PID, kernel stack, saved state)
+//! that shares the page table of the process it was started in.
+//! `Process::tgid` names the process's first thread, whose entry holds
+//! what all of them share: the file descriptor table, the mapping region
+//! and the I/O ring. Syscalls reach those through `current_group()`.
 
+use crate::arch::amd64::fpu::FpuState;
 use crate::arch::amd64::mm::page_tables::PAddr;
-use crate::syscall::fd::FileDescriptorTable;
+use crate::arch::amd64::percpu;
+use crate::arch::amd64::tlb;
+use crate::sched::runqueue::{RunQueues, Task, RUN_QUEUES};
+use crate::syscall::fd::{FileDescriptor, FileDescriptorTable};
+use crate::syscall::ring::IoRing;
 use crate::sync::SpinMutex;
 
 /// ============================================================================
@@ -54,6 +80,9 @@ impl ProcessState {
 /// This structure contains all the CPU state that needs to be saved
 /// and restored during a context switch. It's designed to match the
 /// layout expected by the context_switch assembly function.
+///
+/// FPU/SSE state is not part of it: it lives in `Process::fpu` and is
+/// switched lazily (see `arch::amd64::fpu`).
 #[repr(C)]
 #[derive(Debug, Clone, Copy)]
 pub struct SavedState {
@@ -85,10 +114,6 @@ pub struct SavedState {
     // Segment selectors
     pub cs: u64,
     pub ss: u64,
-
-    // FPU state (512 bytes for FXSAVE)
-    #[doc(hidden)]
-    pub fpu: [u8; 512],
 }
 
 impl SavedState {
@@ -104,7 +129,6 @@ impl SavedState {
             rip: 0,
             cs: 0,
             ss: 0,
-            fpu: [0; 512],
         }
     }
 
@@ -126,10 +150,35 @@ impl SavedState {
             rip: entry,
             cs: 0x1B,      // User code segment (RPL=3)
             ss: 0x23,      // User data segment (RPL=3)
-            fpu: [0; 512],
         }
     }
 
+    /// Create a SavedState for the first switch to a new process
+    ///
+    /// The switch lands in `switch::process_first_entry` on the process's
+    /// kernel stack, which enters user mode at `entry` (RBX) with the user
+    /// stack `user_stack_top` (R12) and `arg` (R13) in RDI. Interrupts
+    /// stay masked until then.
+    pub fn for_first_entry(
+        entry: u64,
+        arg: u64,
+        user_stack_top: u64,
+        kernel_stack_top: u64,
+        cr3: u64,
+    ) -> Self {
+        let mut state = Self::new();
+        state.rbx = entry;
+        state.r12 = user_stack_top;
+        state.r13 = arg;
+        state.rsp = kernel_stack_top;
+        state.cr3 = cr3;
+        state.rflags = 0x2; // Reserved bit only (IF=0)
+        state.rip = crate::process::switch::process_first_entry as u64;
+        state.cs = 0x08;
+        state.ss = 0x10;
+        state
+    }
+
     /// Create a SavedState for returning from a syscall
     ///
     /// This is used when a process makes a syscall and needs to
@@ -152,33 +201,65 @@ impl Default for SavedState {
 /// ============================================================================
 
 /// Maximum number of processes in the system
-const MAX_PROCESSES: usize = 256;
+pub const MAX_PROCESSES: usize = 256;
+
+/// Number of scheduling priority levels
+pub const NUM_PRIORITIES: usize = 32;
+
+/// Lowest priority (batch work)
+pub const PRIORITY_MIN: u8 = 0;
+
+/// Priority of newly created processes
+pub const PRIORITY_DEFAULT: u8 = 16;
+
+/// Highest priority (interactive work)
+pub const PRIORITY_MAX: u8 = (NUM_PRIORITIES - 1) as u8;
+
+/// Affinity mask allowing every CPU
+pub const AFFINITY_ALL: u64 = u64::MAX;
+
+/// Base of the per-process region for kernel-created mappings
+///
+/// I/O rings and other objects mapped into a running process are placed
+/// here, well away from the ELF image and the stack at the top of the
+/// lower half.
+pub const USER_MMAP_BASE: u64 = 0x0000_6000_0000_0000;
 
 /// Process descriptor (Phase 5B)
 ///
-/// This represents a process in the system with all the state needed
-/// for scheduling and context switching.
+/// This represents a process in the system and the resources it holds.
+/// Its scheduling state lives in the run queues once it is in the table
+/// (see the module docs).
 pub struct Process {
     /// Process ID
     pub pid: u32,
 
+    /// Thread group: PID of the first thread of the process (`pid` itself
+    /// unless this is a thread started with SYS_THREAD_START)
+    pub tgid: u32,
+
     /// Parent process ID
     pub ppid: u32,
 
-    /// Process state
-    pub state: ProcessState,
-
     /// Physical address of page table (CR3 value)
     pub page_table: PAddr,
 
+    /// PCID tagging the page table's TLB entries (0 = none, see
+    /// `arch::amd64::tlb`)
+    pub pcid: u16,
+
     /// Kernel stack base (virtual address)
     pub kernel_stack: u64,
 
     /// User stack top (virtual address)
     pub user_stack: u64,
 
-    /// Saved CPU state
-    pub saved_state: SavedState,
+    /// Scheduling state until `ProcessTable::insert` hands it to the run
+    /// queues (None afterwards)
+    pub task: Option<Task>,
+
+    /// FPU/SSE save area (switched lazily on first use)
+    pub fpu: FpuState,
 
     /// Syscall return value
     pub syscall_ret: u64,
@@ -186,12 +267,14 @@ pub struct Process {
     /// File descriptor table
     pub fd_table: FileDescriptorTable,
 
-    /// Time accounting
-    pub cpu_time: u64,
-    pub sched_time: u64,
-
     /// Process name (for debugging)
     pub name: Option<alloc::string::String>,
+
+    /// Next free address in the kernel-managed mapping region
+    pub mmap_next: u64,
+
+    /// Batched I/O submission ring (SYS_RING_SETUP)
+    pub io_ring: Option<IoRing>,
 }
 
 impl Process {
@@ -216,22 +299,62 @@ impl Process {
         let mut fd_table = FileDescriptorTable::new();
         fd_table.init();
 
+        let pcid = tlb::pcid_of(page_table);
+        let saved_state = SavedState::for_first_entry(entry, 0, user_stack, kernel_stack, page_table);
+
         Self {
             pid,
+            tgid: pid,
             ppid,
-            state: ProcessState::Ready,
             page_table,
+            pcid,
             kernel_stack,
             user_stack,
-            saved_state: SavedState::for_userspace(entry, user_stack, page_table),
+            task: Some(Task::new(page_table, pcid, kernel_stack, saved_state)),
+            fpu: FpuState::new(),
             syscall_ret: 0,
             fd_table,
-            cpu_time: 0,
-            sched_time: 0,
             name: None,
+            mmap_next: USER_MMAP_BASE,
+            io_ring: None,
         }
     }
 
+    /// Create a thread of an existing process
+    ///
+    /// The thread shares `group`'s page table and inherits its parent and
+    /// name, and the priority and affinity of `group_task`. It enters user
+    /// mode at `entry` with `arg` as its first argument (RDI).
+    ///
+    /// # Arguments
+    ///
+    /// * `pid` - Thread ID (a PID of its own)
+    /// * `group` - Any thread of the process
+    /// * `group_task` - Scheduling state of `group`
+    /// * `kernel_stack` - Kernel stack base (virtual address)
+    /// * `user_stack` - User stack top (virtual address)
+    /// * `entry` - Entry point address
+    /// * `arg` - Argument passed to the entry point
+    pub fn new_thread(
+        pid: u32,
+        group: &Process,
+        group_task: &Task,
+        kernel_stack: u64,
+        user_stack: u64,
+        entry: u64,
+        arg: u64,
+    ) -> Self {
+        let mut thread = Self::new(pid, group.ppid, group.page_table, kernel_stack, user_stack, entry);
+        thread.tgid = group.tgid;
+        thread.name = group.name.clone();
+        if let Some(task) = thread.task.as_mut() {
+            task.priority = group_task.priority;
+            task.affinity = group_task.affinity;
+            task.saved_state.r13 = arg;
+        }
+        thread
+    }
+
     /// Set the process name
     pub fn set_name(&mut self, name: alloc::string::String) {
         self.name = Some(name);
@@ -255,35 +378,54 @@ pub struct ProcessTable {
     /// Process array (indexed by PID)
     processes: [Option<Process>; MAX_PROCESSES],
 
-    /// Current running process
-    current: Option<u32>,
-
     /// Next PID to allocate
     next_pid: u32,
+
+    /// Run queues holding the processes' scheduling state
+    run_queues: &'static RunQueues,
 }
 
 impl ProcessTable {
     /// Create a new process table
     pub const fn new() -> Self {
+        Self::with_run_queues(&RUN_QUEUES)
+    }
+
+    /// Create a process table scheduling onto the given run queues
+    pub const fn with_run_queues(run_queues: &'static RunQueues) -> Self {
         const NONE: Option<Process> = None;
         Self {
             processes: [NONE; MAX_PROCESSES],
-            current: None,
             next_pid: 1, // PID 0 is kernel
+            run_queues,
         }
     }
 
     /// Get the current process
     pub fn current(&self) -> Option<&Process> {
-        self.current.and_then(|pid| self.processes.get(pid as usize)?.as_ref())
+        let pid = self.current_pid()?;
+        self.processes.get(pid as usize)?.as_ref()
     }
 
     /// Get the current process (mutable)
     pub fn current_mut(&mut self) -> Option<&mut Process> {
-        let pid = self.current?;
+        let pid = self.current_pid()?;
         self.processes.get_mut(pid as usize)?.as_mut()
     }
 
+    /// Get the entry holding the resources of the current process (its
+    /// first thread, see the module docs)
+    pub fn current_group(&self) -> Option<&Process> {
+        let tgid = self.current()?.tgid;
+        self.get(tgid)
+    }
+
+    /// Get the entry holding the resources of the current process (mutable)
+    pub fn current_group_mut(&mut self) -> Option<&mut Process> {
+        let tgid = self.current()?.tgid;
+        self.get_mut(tgid)
+    }
+
     /// Get a process by PID
     pub fn get(&self, pid: u32) -> Option<&Process> {
         self.processes.get(pid as usize)?.as_ref()
@@ -319,10 +461,13 @@ impl ProcessTable {
 
     /// Insert a process into the table
     ///
+    /// Its scheduling state (`Process::task`) goes to the run queues,
+    /// owned by this CPU; a Ready process is queued.
+    ///
     /// # Panics
     ///
     /// Panics if the PID is already in use or out of range
-    pub fn insert(&mut self, process: Process) {
+    pub fn insert(&mut self, mut process: Process) {
         let pid = process.pid;
         if (pid as usize) >= MAX_PROCESSES {
             panic!("PID out of range: {}", pid);
@@ -330,64 +475,51 @@ impl ProcessTable {
         if self.processes[pid as usize].is_some() {
             panic!("PID already in use: {}", pid);
         }
-        self.processes[pid as usize] = Some(process);
-    }
+        let task = process.task.take();
+        let process = self.processes[pid as usize].insert(process);
 
-    /// Set the current running process
-    pub fn set_current(&mut self, pid: u32) {
-        self.current = Some(pid);
+        if let Some(mut task) = task {
+            // The save area stays put from here until `remove`
+            task.fpu = process.fpu.as_ptr();
+            self.run_queues.insert(pid, task);
+        }
     }
 
-    /// Get the current PID
+    /// Get the PID running on this CPU
     pub fn current_pid(&self) -> Option<u32> {
-        self.current
+        self.run_queues.current(percpu::this_cpu())
     }
 
     /// Remove a process from the table
     pub fn remove(&mut self, pid: u32) -> Option<Process> {
-        if pid >= MAX_PROCESSES as u32 {
+        if pid >= MAX_PROCESSES as u32 || self.processes[pid as usize].is_none() {
             return None;
         }
-
-        // If this is the current process, clear current
-        if self.current == Some(pid) {
-            self.current = None;
-        }
-
+        self.run_queues.release(pid);
         self.processes[pid as usize].take()
     }
 
-    /// Find the next runnable process
-    pub fn find_next_runnable(&self, current_pid: Option<u32>) -> Option<u32> {
-        // Start from the process after current (or 0 if none)
-        let start = current_pid.map_or(0, |p| (p + 1) % MAX_PROCESSES as u32);
-
-        // Search for a runnable process
-        let mut pid = start;
-        loop {
-            if let Some(process) = self.get(pid) {
-                if process.state.is_runnable() {
-                    return Some(pid);
-                }
-            }
-
-            pid = (pid + 1) % MAX_PROCESSES as u32;
-
-            if pid == start {
-                // Wrapped around, no runnable process
-                return None;
-            }
+    /// Take a thread group's descriptors once none of its threads is alive
+    ///
+    /// Returns None while one still is. The caller releases the
+    /// descriptors' objects without the table lock: closing an object
+    /// wakes its waiters, which takes it.
+    pub fn take_exited_group_fds(&mut self, tgid: u32) -> Option<impl Iterator<Item = FileDescriptor>> {
+        let run_queues = self.run_queues;
+        let alive = self.processes.iter().flatten()
+            .any(|p| p.tgid == tgid && run_queues.state(p.pid).is_alive());
+        if alive {
+            return None;
         }
+        Some(self.get_mut(tgid)?.fd_table.drain())
     }
 
     /// Get all runnable PIDs
     pub fn runnable_pids(&self) -> alloc::vec::Vec<u32> {
         let mut pids = alloc::vec::Vec::new();
-        for (pid, process) in self.processes.iter().enumerate() {
-            if let Some(p) = process {
-                if p.state.is_runnable() {
-                    pids.push(pid as u32);
-                }
+        for process in self.processes.iter().flatten() {
+            if self.run_queues.state(process.pid).is_runnable() {
+                pids.push(process.pid);
             }
         }
         pids
@@ -397,6 +529,11 @@ impl ProcessTable {
     pub fn count(&self) -> usize {
         self.processes.iter().filter(|p| p.is_some()).count()
     }
+
+    /// Iterate over all processes, in PID order
+    pub fn iter(&self) -> impl Iterator<Item = &Process> {
+        self.processes.iter().flatten()
+    }
 }
 
 impl Default for ProcessTable {
@@ -442,11 +579,35 @@ where
     F: FnOnce(&mut Process) -> R,
 {
     let mut table = PROCESS_TABLE.lock();
-    let current = table.current?;
+    let current = table.current_pid()?;
     let process = table.get_mut(current)?;
     Some(f(process))
 }
 
+/// Get a reference to the resources of the current process
+///
+/// Like `with_current_process`, but a thread gets its process's first
+/// thread (see the module docs): use this for the fd table, the mapping
+/// region and the I/O ring.
+pub fn with_current_group<F, R>(f: F) -> Option<R>
+where
+    F: FnOnce(&Process) -> R,
+{
+    let table = PROCESS_TABLE.lock();
+    let process = table.current_group()?;
+    Some(f(process))
+}
+
+/// Get a mutable reference to the resources of the current process
+pub fn with_current_group_mut<F, R>(f: F) -> Option<R>
+where
+    F: FnOnce(&mut Process) -> R,
+{
+    let mut table = PROCESS_TABLE.lock();
+    let process = table.current_group_mut()?;
+    Some(f(process))
+}
+
 /// Get a process by PID with manual locking
 pub fn with_process<F, R>(pid: u32, f: F) -> Option<R>
 where
@@ -490,6 +651,25 @@ mod tests {
         assert_eq!(state.rflags, 0x202);
     }
 
+    #[test]
+    fn test_saved_state_layout() {
+        // Offsets hard-coded in switch.S
+        use core::mem::offset_of;
+        assert_eq!(offset_of!(SavedState, rax), 0);
+        assert_eq!(offset_of!(SavedState, rsi), 32);
+        assert_eq!(offset_of!(SavedState, rdi), 40);
+        assert_eq!(offset_of!(SavedState, rbp), 48);
+        assert_eq!(offset_of!(SavedState, rsp), 56);
+        assert_eq!(offset_of!(SavedState, r8), 64);
+        assert_eq!(offset_of!(SavedState, r15), 120);
+        assert_eq!(offset_of!(SavedState, cr3), 128);
+        assert_eq!(offset_of!(SavedState, rflags), 136);
+        assert_eq!(offset_of!(SavedState, rip), 144);
+        assert_eq!(offset_of!(SavedState, cs), 152);
+        assert_eq!(offset_of!(SavedState, ss), 160);
+        assert_eq!(core::mem::size_of::<SavedState>(), 168);
+    }
+
     #[test]
     fn test_process_state() {
         assert!(ProcessState::Ready.is_runnable());
@@ -499,9 +679,15 @@ mod tests {
         assert!(!ProcessState::Dead.is_runnable());
     }
 
+    /// Table with run queues of its own (tests run in parallel)
+    fn test_table() -> ProcessTable {
+        let queues: &'static RunQueues = alloc::boxed::Box::leak(alloc::boxed::Box::new(RunQueues::new()));
+        ProcessTable::with_run_queues(queues)
+    }
+
     #[test]
     fn test_process_table_new() {
-        let table = ProcessTable::new();
+        let table = test_table();
         assert!(table.current().is_none());
         assert_eq!(table.next_pid, 1);
         assert_eq!(table.count(), 0);
@@ -509,7 +695,7 @@ mod tests {
 
     #[test]
     fn test_process_table_alloc_pid() {
-        let mut table = ProcessTable::new();
+        let mut table = test_table();
         assert_eq!(table.alloc_pid(), Some(1));
         assert_eq!(table.alloc_pid(), Some(2));
         assert_eq!(table.next_pid, 3);
@@ -517,7 +703,7 @@ mod tests {
 
     #[test]
     fn test_process_table_insert_get() {
-        let mut table = ProcessTable::new();
+        let mut table = test_table();
         let process = Process::new(1, 0, PhysAddr::new(0x1000), 0x2000, 0x7000_0000_0000, 0x4000);
 
         table.insert(process);
@@ -526,37 +712,51 @@ mod tests {
         let retrieved = table.get(1);
         assert!(retrieved.is_some());
         assert_eq!(retrieved.unwrap().pid, 1);
+
+        // The scheduling state went to the run queues
+        assert!(retrieved.unwrap().task.is_none());
+        assert_eq!(table.run_queues.state(1), ProcessState::Ready);
+        assert_eq!(table.run_queues.ready_count(), 1);
+
+        assert!(table.remove(1).is_some());
+        assert_eq!(table.run_queues.state(1), ProcessState::Dead);
+        assert_eq!(table.run_queues.ready_count(), 0);
     }
 
     #[test]
     fn test_process_table_current() {
-        let mut table = ProcessTable::new();
+        let mut table = test_table();
         let process = Process::new(1, 0, PhysAddr::new(0x1000), 0x2000, 0x7000_0000_0000, 0x4000);
 
         table.insert(process);
-        table.set_current(1);
+        table.run_queues.lock(0).set_current(Some(1));
 
         assert_eq!(table.current_pid(), Some(1));
         assert_eq!(table.current().unwrap().pid, 1);
     }
 
     #[test]
-    fn test_process_table_find_next_runnable() {
-        let mut table = ProcessTable::new();
-
-        // Add some processes
-        let p1 = Process::new(1, 0, PhysAddr::new(0x1000), 0x2000, 0x7000_0000_0000, 0x4000);
-        let p2 = Process::new(2, 1, PhysAddr::new(0x5000), 0x6000, 0x7000_0000_0000, 0x7000);
-        let p3 = Process::new(3, 1, PhysAddr::new(0x9000), 0xA000, 0x7000_0000_0000, 0xB000);
-
-        table.insert(p1);
-        table.insert(p2);
-        table.insert(p3);
-
-        // All should be runnable (state=Ready)
-        assert_eq!(table.find_next_runnable(None), Some(1));
-        assert_eq!(table.find_next_runnable(Some(1)), Some(2));
-        assert_eq!(table.find_next_runnable(Some(2)), Some(3));
-        assert_eq!(table.find_next_runnable(Some(3)), Some(1)); // Wrap around
+    fn test_thread_group() {
+        let mut table = test_table();
+        let mut leader = Process::new(1, 7, 0x1000, 0x2000, 0x7000_0000_0000, 0x4000);
+        let mut leader_task = leader.task.take().unwrap();
+        leader_task.priority = 20;
+        let thread = Process::new_thread(2, &leader, &leader_task, 0x3000, 0x6000_0000_0000, 0x5000, 42);
+        assert_eq!(thread.tgid, 1);
+        assert_eq!(thread.ppid, 7);
+        assert_eq!(thread.page_table, 0x1000);
+        let task = thread.task.as_ref().unwrap();
+        assert_eq!(task.priority, 20);
+        assert_eq!(task.saved_state.rbx, 0x5000);
+        assert_eq!(task.saved_state.r12, 0x6000_0000_0000);
+        assert_eq!(task.saved_state.r13, 42);
+
+        leader.task = Some(leader_task);
+        table.insert(leader);
+        table.insert(thread);
+        table.run_queues.lock(0).set_current(Some(2));
+        assert_eq!(table.current().unwrap().pid, 2);
+        assert_eq!(table.current_group().unwrap().pid, 1);
+        assert_eq!(table.run_queues.task(2).unwrap().priority, 20);
     }
 }
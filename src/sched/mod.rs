@@ -22,6 +22,8 @@ pub mod thread;
 pub mod scheduler;
 pub mod state;
 pub mod round_robin;
+pub mod runqueue;
+pub mod tickless;
 
 pub use thread::{Thread, ThreadId, EntryPoint};
 pub use scheduler::{Scheduler, SchedulingPolicy};
@@ -7,12 +7,50 @@
 //! Round-Robin Scheduler (Phase 5B)
 //!
 //! This module provides a simple round-robin scheduler that works with
-//! the process table to schedule multiple processes. It implements the
+//! the per-CPU run queues to schedule multiple processes. It implements the
 //! Phase 5B requirements for timer-based scheduling and context switching.
-
-use crate::process::table::{Process, ProcessState, ProcessTable, PROCESS_TABLE};
-use crate::process::switch;
-use crate::sync::SpinMutex;
+//!
+//! Processes are picked from this CPU's priority run queue: the highest
+//! non-empty priority runs first, round-robin within a level. Blocked
+//! processes are off the queues and cost nothing to schedule.
+//!
+//! # SMP
+//!
+//! Each CPU has its own scheduler instance in [`SCHEDULERS`] and its own
+//! run queue (`sched::runqueue`). A CPU whose queue is empty steals from
+//! the others when it reschedules. Application processors wait in
+//! [`idle_loop`] and are woken by reschedule IPIs when work is queued for
+//! them. The boot CPU gets its idle loop in [`enter_first_process`], so
+//! every CPU that runs a process has an idle context to switch to when
+//! the process blocks, and a blocked process never stays on a CPU.
+//!
+//! Scheduling on a CPU takes that CPU's scheduler and run queue locks and
+//! no global one: the scheduling state of a process is in the run queues
+//! (`sched::runqueue::Task`), not the process table. The run queue lock
+//! is held across the register switch and released by the context that
+//! resumes (`RunQueues::finish_switch`): on its way out of its own
+//! `reschedule()`, or in `switch::process_first_entry` for a process that
+//! has never run. Lock order is scheduler, then process table, then run
+//! queue.
+//!
+//! There is no periodic tick: each switch re-arms the CPU's one-shot
+//! timer for the end of the new process's slice (`sched::tickless`), and
+//! [`timer_tick`] runs when it expires.
+
+use core::sync::atomic::{AtomicU64, Ordering};
+
+use crate::arch::amd64::fpu;
+use crate::arch::amd64::percpu::{self, MAX_CPUS};
+use crate::arch::amd64::syscall;
+use crate::arch::amd64::tlb;
+use crate::arch::amd64::tsc;
+use crate::boot;
+use crate::drivers::keyboard;
+use crate::process::table::{ProcessState, SavedState, MAX_PROCESSES, PROCESS_TABLE};
+use crate::process::switch::{self, SwitchKind};
+use crate::sched::runqueue::{self, QueueGuard, RUN_QUEUES};
+use crate::sched::tickless;
+use crate::sync::{SpinMutex, SpinMutexGuard, WaitQueue, WaiterId};
 
 /// Default time slice in milliseconds
 pub const DEFAULT_TIME_SLICE_MS: u64 = 10;
@@ -58,6 +96,11 @@ impl RoundRobinScheduler {
         self.current = Some(pid);
     }
 
+    /// Record that no process is running (the CPU is idle)
+    pub fn clear_current(&mut self) {
+        self.current = None;
+    }
+
     /// Get the time slice in milliseconds
     pub fn time_slice_ms(&self) -> u64 {
         self.time_slice_ms
@@ -80,100 +123,42 @@ impl RoundRobinScheduler {
 
     /// Schedule the next process to run
     ///
-    /// This function implements the core round-robin scheduling algorithm:
-    /// 1. Mark the current process as Ready (if it was Running)
-    /// 2. Find the next runnable process
-    /// 3. Mark the next process as Running
-    /// 4. Return the next process PID
+    /// This function implements the core scheduling algorithm:
+    /// 1. Put the current process at the back of its run queue level
+    ///    (if it was Running)
+    /// 2. Take the head of the highest non-empty level and mark it Running
+    /// 3. Return the next process PID
+    ///
+    /// Every step is O(1) in the number of processes.
     ///
     /// # Arguments
     ///
-    /// * `process_table` - Mutable reference to the process table
+    /// * `queue` - This CPU's locked run queue
     ///
     /// # Returns
     ///
     /// The PID of the next process to run, or None if no runnable process
-    pub fn schedule(&mut self, process_table: &mut ProcessTable) -> Option<u32> {
-        // Mark current as Ready if it was Running
+    pub fn schedule(&mut self, queue: &mut QueueGuard) -> Option<u32> {
+        // Requeue current at the tail if it was Running
         if let Some(current_pid) = self.current {
-            if let Some(process) = process_table.get_mut(current_pid) {
-                if process.state == ProcessState::Running {
-                    process.state = ProcessState::Ready;
-                }
+            let running = queue.task(current_pid)
+                .map_or(false, |t| t.state == ProcessState::Running);
+            if running {
+                queue.requeue(current_pid);
             }
         }
 
-        // Find next runnable process
-        let next_pid = process_table.find_next_runnable(self.current);
+        // Highest-priority ready process here, or one stolen from another CPU
+        let next_pid = queue.peek_next();
 
         if let Some(pid) = next_pid {
             self.current = Some(pid);
-            process_table.set_current(pid);
-
-            if let Some(process) = process_table.get_mut(pid) {
-                process.state = ProcessState::Running;
-            }
+            queue.set_current(Some(pid));
+            queue.set_running(pid);
         }
 
         next_pid
     }
-
-    /// Perform a context switch to the next process
-    ///
-    /// This function:
-    /// 1. Calls schedule() to find the next process
-    /// 2. If the next process is different from current, performs context switch
-    ///
-    /// # Arguments
-    ///
-    /// * `process_table` - Mutable reference to the process table
-    ///
-    /// # Safety
-    ///
-    /// This function performs an unsafe context switch. The caller must ensure
-    /// that the process table is properly locked and that both processes are valid.
-    pub unsafe fn context_switch(&mut self, process_table: &mut ProcessTable) {
-        let next_pid = self.schedule(process_table);
-
-        if let Some(next_pid) = next_pid {
-            if let Some(current_pid) = self.current {
-                if current_pid != next_pid {
-                    // We need to extract the data we need before the mutable borrow
-                    // This is a simplified approach - in a real kernel we'd have
-                    // more sophisticated locking
-                    let next_cr3 = process_table.get(next_pid)
-                        .map(|p| p.page_table)
-                        .unwrap_or(0);
-
-                    // Update current process state before switch
-                    if let Some(process) = process_table.get_mut(current_pid) {
-                        process.state = crate::process::table::ProcessState::Ready;
-                    }
-
-                    // Get pointers after the mutable borrow ends
-                    let next_saved_ptr: *const crate::process::table::SavedState =
-                        process_table.get(next_pid)
-                            .map(|p| &p.saved_state as *const _)
-                            .unwrap_or(core::ptr::null());
-
-                    let current_saved_ptr: *mut crate::process::table::SavedState =
-                        process_table.get_mut(current_pid)
-                            .map(|p| &mut p.saved_state as *mut _)
-                            .unwrap_or(core::ptr::null_mut());
-
-                    // Perform the context switch using raw pointers
-                    if !current_saved_ptr.is_null() && !next_saved_ptr.is_null() {
-                        // Call the assembly function directly
-                        crate::process::switch::context_switch_raw(
-                            current_saved_ptr,
-                            next_saved_ptr,
-                            next_cr3,
-                        );
-                    }
-                }
-            }
-        }
-    }
 }
 
 impl Default for RoundRobinScheduler {
@@ -183,11 +168,188 @@ impl Default for RoundRobinScheduler {
 }
 
 /// ============================================================================
-/// Global Scheduler Instance
+/// Global Scheduler Instances
 /// ============================================================================
 
-/// Global round-robin scheduler instance
-pub static SCHEDULER: SpinMutex<RoundRobinScheduler> = SpinMutex::new(RoundRobinScheduler::new());
+/// Round-robin scheduler of each CPU
+pub static SCHEDULERS: [SpinMutex<RoundRobinScheduler>; MAX_CPUS] = {
+    const SCHEDULER: SpinMutex<RoundRobinScheduler> = SpinMutex::new(RoundRobinScheduler::new());
+    [SCHEDULER; MAX_CPUS]
+};
+
+/// Scheduler of the calling CPU
+pub fn this_scheduler() -> &'static SpinMutex<RoundRobinScheduler> {
+    &SCHEDULERS[percpu::this_cpu()]
+}
+
+/// PIDs blocked waiting for keyboard input (one bit per PID)
+static INPUT_WAITERS: [AtomicU64; MAX_PROCESSES / 64] = {
+    const EMPTY: AtomicU64 = AtomicU64::new(0);
+    [EMPTY; MAX_PROCESSES / 64]
+};
+
+/// Saved context of each CPU's idle loop
+static mut IDLE_STATES: [SavedState; MAX_CPUS] = [SavedState::new(); MAX_CPUS];
+
+/// Bit N set once CPU N has an idle loop to switch back to
+static IDLE_VALID: AtomicU64 = AtomicU64::new(0);
+
+/// Save slot for a context that is never resumed (a removed process)
+static mut DISCARD_STATES: [SavedState; MAX_CPUS] = [SavedState::new(); MAX_CPUS];
+
+/// Context switches performed by each CPU
+static SWITCH_COUNTS: [AtomicU64; MAX_CPUS] = {
+    const ZERO: AtomicU64 = AtomicU64::new(0);
+    [ZERO; MAX_CPUS]
+};
+
+/// Context switches performed by all CPUs since boot
+pub fn context_switch_count() -> u64 {
+    SWITCH_COUNTS.iter().map(|count| count.load(Ordering::Relaxed)).sum()
+}
+
+/// Record that a process is blocked waiting for keyboard input
+pub fn add_input_waiter(pid: u32) {
+    if (pid as usize) < MAX_PROCESSES {
+        INPUT_WAITERS[pid as usize / 64].fetch_or(1 << (pid % 64), Ordering::AcqRel);
+    }
+}
+
+/// Forget an input waiter
+pub fn clear_input_waiter(pid: u32) {
+    if (pid as usize) < MAX_PROCESSES {
+        INPUT_WAITERS[pid as usize / 64].fetch_and(!(1 << (pid % 64)), Ordering::AcqRel);
+    }
+}
+
+/// Check whether an input waiter can be woken
+fn input_waiters_ready() -> bool {
+    INPUT_WAITERS.iter().any(|w| w.load(Ordering::Acquire) != 0) && keyboard::has_data()
+}
+
+/// Make every input waiter Ready once the keyboard has data
+fn wake_input_waiters() {
+    if !input_waiters_ready() {
+        return;
+    }
+
+    for (index, word) in INPUT_WAITERS.iter().enumerate() {
+        let mut bits = word.swap(0, Ordering::AcqRel);
+        while bits != 0 {
+            let pid = (index * 64) as u32 + bits.trailing_zeros();
+            bits &= bits - 1;
+            RUN_QUEUES.wake(pid);
+        }
+    }
+}
+
+/// Lock this CPU's run queue to reschedule
+///
+/// Wakes the input waiters first: that locks their run queues, which must
+/// not happen with this one held.
+fn lock_for_reschedule() -> QueueGuard<'static> {
+    wake_input_waiters();
+    RUN_QUEUES.lock(percpu::this_cpu())
+}
+
+/// Switch this CPU to the next process, or back to its idle loop
+///
+/// Takes this CPU's scheduler and run queue by guard. The scheduler lock
+/// is released before the register switch; the run queue lock is handed
+/// to the context that resumes (see the module docs).
+///
+/// Returns false without switching if the current process keeps running,
+/// or if nothing is runnable and this CPU has no idle loop to fall back
+/// to (only before it has entered its first process or idle loop).
+/// Returns true once the calling context has been switched out and
+/// resumed again.
+///
+/// # Safety
+///
+/// Interrupts must be disabled, and the guards must be this CPU's
+/// scheduler and run queue.
+unsafe fn reschedule(
+    mut scheduler: SpinMutexGuard<'static, RoundRobinScheduler>,
+    mut queue: QueueGuard<'static>,
+    kind: SwitchKind,
+) -> bool {
+    let cpu = queue.cpu();
+
+    // schedule() replaces the current process: remember who is switching out
+    let prev_pid = scheduler.current();
+    let next_pid = scheduler.schedule(&mut queue);
+
+    if next_pid.is_some() && next_pid == prev_pid {
+        return false;
+    }
+    if next_pid.is_none() {
+        // Nothing for this CPU. The previous process blocked, exited, or
+        // was requeued on a CPU it is allowed on (or we are already idle)
+        if prev_pid.is_none() || IDLE_VALID.load(Ordering::Acquire) & (1 << cpu) == 0 {
+            // No idle loop to go to: a requeued or blocked process keeps
+            // running here (a waker must not queue it while it does)
+            if let Some(pid) = prev_pid {
+                let stays = queue.task(pid)
+                    .map_or(false, |t| matches!(t.state, ProcessState::Ready | ProcessState::Blocked));
+                if stays {
+                    queue.set_running(pid);
+                }
+            }
+            return false;
+        }
+        scheduler.clear_current();
+        queue.set_current(None);
+    }
+    let slice_ms = scheduler.time_slice_ms();
+    drop(scheduler);
+
+    // Bill the outgoing process and start the incoming one's run (the
+    // idle loop gets no slice: with no armed timer the CPU stops ticking)
+    let now = tsc::tsc_ticks();
+    queue.account_switch(prev_pid, next_pid, now);
+    SWITCH_COUNTS[cpu].fetch_add(1, Ordering::Relaxed);
+    tickless::start_slice(now, next_pid.is_some(), slice_ms);
+
+    // Outgoing context; a process requeued for another CPU only moves
+    // (and has its FPU state flushed) once the switch is done
+    let (prev_saved, prev_fpu) = match prev_pid {
+        None => (&raw mut IDLE_STATES[cpu], core::ptr::null_mut()),
+        Some(pid) => match queue.task_mut(pid) {
+            Some(prev) if prev.state != ProcessState::Dead => {
+                (&mut prev.saved_state as *mut SavedState, prev.fpu)
+            }
+            _ => (&raw mut DISCARD_STATES[cpu], core::ptr::null_mut()),
+        },
+    };
+
+    // Incoming context
+    let (next_saved, next_cr3, next_fpu) = match next_pid {
+        None => {
+            let idle = &raw const IDLE_STATES[cpu];
+            (idle, (*idle).cr3, core::ptr::null_mut())
+        }
+        Some(pid) => match queue.task(pid) {
+            Some(next) => {
+                // Entries from user mode (SYSCALL, interrupts) must land
+                // on the next process's own kernel stack
+                syscall::set_kernel_stack(next.kernel_stack);
+                let cr3 = tlb::switch_cr3(next.page_table, next.pcid);
+                (&next.saved_state as *const SavedState, cr3, next.fpu)
+            }
+            None => return false,
+        },
+    };
+
+    // FPU state follows lazily on the next task's first use
+    fpu::switch_fpu(prev_fpu, next_fpu);
+    core::mem::forget(queue);
+    switch::context_switch_kind(kind, prev_saved, next_saved, next_cr3);
+
+    // Resumed, possibly on another CPU: release the queue lock the
+    // switching context handed over
+    RUN_QUEUES.finish_switch();
+    true
+}
 
 /// ============================================================================
 /// Scheduler API Functions
@@ -195,27 +357,17 @@ pub static SCHEDULER: SpinMutex<RoundRobinScheduler> = SpinMutex::new(RoundRobin
 
 /// Timer tick handler
 ///
-/// This function is called by the timer interrupt handler to implement
-/// time-slice based preemption. It schedules the next process and may
-/// perform a context switch.
-///
-/// # Usage
-///
-/// ```ignore
-/// // In timer interrupt handler
-/// unsafe {
-///     sched::round_robin::timer_tick();
-/// }
-/// ```
+/// Called by `tickless::timer_interrupt` when the running process's time
+/// slice has expired. It schedules the next process and may perform a
+/// context switch.
 pub unsafe fn timer_tick() {
-    if !SCHEDULER.lock().is_preemption_enabled() {
+    let scheduler = this_scheduler().lock();
+    if !scheduler.is_preemption_enabled() {
         return;
     }
 
-    let mut scheduler = SCHEDULER.lock();
-    let mut process_table = PROCESS_TABLE.lock();
-
-    scheduler.context_switch(&mut process_table);
+    let queue = lock_for_reschedule();
+    reschedule(scheduler, queue, SwitchKind::Preempt);
 }
 
 /// Yield the CPU to another process
@@ -228,24 +380,292 @@ pub unsafe fn timer_tick() {
 /// * `Ok(())` - Successfully yielded
 /// * `Err(&str)` - Failed to yield (no current process, etc.)
 pub fn yield_cpu() -> Result<(), &'static str> {
-    let mut scheduler = SCHEDULER.lock();
-    let mut process_table = PROCESS_TABLE.lock();
+    let scheduler = this_scheduler().lock();
+    let queue = lock_for_reschedule();
 
     // Get current process
     let current_pid = scheduler.current().ok_or("No current process")?;
+    let priority = queue.task(current_pid)
+        .map(|t| t.priority)
+        .ok_or("No current process")?;
+
+    // Only a ready process at the same or a higher priority can take over
+    if queue.highest().map_or(false, |p| p >= priority) {
+        unsafe {
+            reschedule(scheduler, queue, SwitchKind::Cooperative);
+        }
+    }
+
+    Ok(())
+}
+
+/// Block the current process until keyboard input is available
+///
+/// Called by stdin reads around `keyboard::read_char`. The process leaves
+/// the run queue until the scheduler sees input, and the CPU goes to its
+/// idle loop if nothing else is ready. Callers loop, re-checking for
+/// input.
+pub fn wait_for_input() {
+    let scheduler = this_scheduler().lock();
+    let mut queue = lock_for_reschedule();
+
+    let pid = match scheduler.current() {
+        Some(pid) => pid,
+        None => return,
+    };
+    if !queue.task(pid).map_or(false, |t| t.state.is_alive()) {
+        return;
+    }
 
-    // Check if there's another runnable process
-    let next_pid = process_table.find_next_runnable(Some(current_pid));
+    if keyboard::has_data() {
+        // Input arrived before we slept, or while we spun blocked
+        clear_input_waiter(pid);
+        let blocked = queue.task(pid)
+            .map_or(false, |t| t.state == ProcessState::Blocked);
+        if blocked {
+            queue.set_running(pid);
+        }
+        return;
+    }
+
+    add_input_waiter(pid);
+    queue.set_state(pid, ProcessState::Blocked);
+
+    unsafe {
+        reschedule(scheduler, queue, SwitchKind::Cooperative);
+    }
+}
+
+/// Block the current process on a wait queue until `ready` holds
+///
+/// The process is queued before `ready` is checked, so a waker that makes
+/// the condition true and then calls [`wake_waiter`] cannot be missed:
+/// one that dequeued it before it blocked makes it return instead.
+/// `ready` runs with this CPU's scheduler locked and must not take it.
+/// Returns after a wakeup, or at once if the condition already holds or
+/// nothing else can run; callers re-check and loop.
+pub fn wait_on(queue: &WaitQueue, ready: impl Fn() -> bool) {
+    let scheduler = this_scheduler().lock();
+
+    let pid = match scheduler.current() {
+        Some(pid) => pid,
+        None => return,
+    };
+    // An exited thread (its process ended) must not come back as Blocked
+    let priority = match RUN_QUEUES.task(pid) {
+        Some(task) if task.state == ProcessState::Running => task.priority,
+        _ => return,
+    };
+
+    // A spurious wakeup may have left us queued from the last round
+    queue.remove(pid as WaiterId);
+    queue.block(pid as WaiterId, priority, u64::MAX);
+    if ready() {
+        queue.remove(pid as WaiterId);
+        return;
+    }
+
+    // Woken (taken off `queue`) or exited since the check: don't block
+    let mut run_queue = lock_for_reschedule();
+    let running = run_queue.task(pid).map_or(false, |t| t.state == ProcessState::Running);
+    if !running || !queue.contains(pid as WaiterId) {
+        drop(run_queue);
+        queue.remove(pid as WaiterId);
+        return;
+    }
+
+    run_queue.set_state(pid, ProcessState::Blocked);
+    let switched = unsafe { reschedule(scheduler, run_queue, SwitchKind::Cooperative) };
+
+    if !switched {
+        // Kept the CPU (reschedule made us Running again): stop waiting
+        queue.remove(pid as WaiterId);
+    }
+}
+
+/// Wake the first waiter of a wait queue
+///
+/// A waiter that is no longer blocked (it is about to re-check its
+/// condition) is just taken off the queue. Waiters that have exited are
+/// skipped.
+///
+/// # Returns
+///
+/// false if the queue was empty
+pub fn wake_waiter(queue: &WaitQueue) -> bool {
+    loop {
+        let pid = match queue.wake_one() {
+            Some(waiter) => waiter as u32,
+            None => return false,
+        };
+
+        if RUN_QUEUES.wake(pid) {
+            return true;
+        }
+    }
+}
 
-    if let Some(next_pid) = next_pid {
-        if next_pid != current_pid {
-            unsafe {
-                scheduler.context_switch(&mut process_table);
+/// Terminate the current process and give the CPU away for good
+///
+/// The process stays in the table as a Zombie. The last thread of a
+/// process to exit closes the process's descriptors, which tells channel
+/// peers and releases ports and timers. With nothing else to run, the CPU
+/// waits for interrupts (input, reschedule IPIs) and tries again.
+pub fn exit_current() -> ! {
+    let descs = {
+        let mut process_table = PROCESS_TABLE.lock();
+        match process_table.current().map(|p| (p.pid, p.tgid)) {
+            Some((pid, tgid)) => {
+                RUN_QUEUES.exit(pid);
+                process_table.take_exited_group_fds(tgid)
             }
+            None => None,
         }
+    };
+    // Released without the table lock (closing wakes waiters)
+    for desc in descs.into_iter().flatten() {
+        crate::syscall::release_object(desc.kind);
     }
 
-    Ok(())
+    loop {
+        let scheduler = this_scheduler().lock();
+        let mut queue = lock_for_reschedule();
+
+        if let Some(pid) = scheduler.current() {
+            if queue.task(pid).map_or(false, |t| t.state.is_alive()) {
+                queue.set_state(pid, ProcessState::Zombie);
+            }
+        }
+
+        unsafe {
+            reschedule(scheduler, queue, SwitchKind::Cooperative);
+            core::arch::asm!("sti", "hlt", "cli", options(nomem, nostack));
+        }
+    }
+}
+
+/// Terminate every thread of the current process and give the CPU away
+///
+/// The other threads become Zombies too: a ready or blocked one at once,
+/// one running on another CPU when that CPU next reschedules (it is no
+/// longer requeued).
+pub fn exit_group() -> ! {
+    {
+        let process_table = PROCESS_TABLE.lock();
+        if let Some(tgid) = process_table.current().map(|p| p.tgid) {
+            for member in process_table.iter().filter(|p| p.tgid == tgid) {
+                RUN_QUEUES.exit(member.pid);
+            }
+        }
+    }
+    exit_current()
+}
+
+/// Idle loop of a CPU
+///
+/// Application processors enter it once they are up; the boot CPU comes
+/// back to it from [`enter_first_process`].
+/// Runs whatever is queued for (or can be stolen by) this CPU, and halts
+/// until the next interrupt (normally a reschedule IPI) otherwise. The
+/// loop is also the context the CPU returns to whenever its process
+/// blocks with nothing else to run.
+///
+/// The first idle CPU also runs the deferred boot tasks (`crate::boot`)
+/// once PID 1 has started.
+pub fn idle_loop() -> ! {
+    let cpu = percpu::this_cpu();
+    IDLE_VALID.fetch_or(1 << cpu, Ordering::AcqRel);
+
+    loop {
+        unsafe { core::arch::asm!("cli", options(nomem, nostack)); }
+        if boot::pending() {
+            boot::run_deferred();
+        }
+        runqueue::set_idle(cpu, true);
+
+        let pending = input_waiters_ready() || RUN_QUEUES.any_ready();
+        if pending {
+            runqueue::set_idle(cpu, false);
+            let scheduler = SCHEDULERS[cpu].lock();
+            let queue = lock_for_reschedule();
+            if unsafe { reschedule(scheduler, queue, SwitchKind::Cooperative) } {
+                continue;
+            }
+        }
+
+        // STI's one-instruction shadow: an IPI that arrived since the
+        // check still wakes the HLT
+        unsafe { core::arch::asm!("sti", "hlt", options(nomem, nostack)); }
+    }
+}
+
+/// Run the boot CPU's first process, making the boot context its idle loop
+///
+/// `pid` must already be this CPU's running process in the scheduler and
+/// its run queue, and must never have run. The boot context is saved
+/// as this CPU's idle context, like an application processor's when it
+/// first switches away from [`idle_loop`], and resumes there whenever
+/// the CPU has nothing to run.
+///
+/// # Safety
+///
+/// Called once, on the boot CPU, with this CPU's run queue unlocked. The
+/// boot stack must stay valid: it becomes the idle loop's stack.
+pub unsafe fn enter_first_process(pid: u32) -> ! {
+    let cpu = percpu::this_cpu();
+    core::arch::asm!("cli", options(nomem, nostack));
+    IDLE_VALID.fetch_or(1 << cpu, Ordering::AcqRel);
+
+    let queue = RUN_QUEUES.lock(cpu);
+    let (next_saved, next_cr3, next_fpu) = match queue.task(pid) {
+        Some(next) => {
+            syscall::set_kernel_stack(next.kernel_stack);
+            let cr3 = tlb::switch_cr3(next.page_table, next.pcid);
+            (&next.saved_state as *const SavedState, cr3, next.fpu)
+        }
+        None => panic!("first process {} not found", pid),
+    };
+
+    // The queue lock is handed over: switch::process_first_entry
+    // releases it, as for any process that has never run
+    fpu::switch_fpu(core::ptr::null_mut(), next_fpu);
+    core::mem::forget(queue);
+    switch::context_switch_kind(SwitchKind::Cooperative, &raw mut IDLE_STATES[cpu], next_saved, next_cr3);
+
+    // Resumed as the idle context: release the lock the switching
+    // context handed over
+    RUN_QUEUES.finish_switch();
+    idle_loop()
+}
+
+/// Set a process's scheduling priority
+///
+/// Used by sys_set_priority. Returns the previous priority, or None if
+/// the process does not exist.
+pub fn set_priority(pid: u32, priority: u8) -> Option<u8> {
+    RUN_QUEUES.set_priority(pid, priority)
+}
+
+/// Set the CPUs a process may run on
+///
+/// Used by sys_set_affinity. Returns the previous mask, or None if the
+/// process does not exist. A process that excludes the CPU it is running
+/// on moves right away if this CPU has something else to run (or an idle
+/// loop); otherwise, like a process running on another CPU, it moves the
+/// next time it yields or blocks.
+pub fn set_affinity(pid: u32, affinity: u64) -> Option<u64> {
+    let scheduler = this_scheduler().lock();
+    let old = RUN_QUEUES.set_affinity(pid, affinity)?;
+
+    let cpu = percpu::this_cpu();
+    if scheduler.current() == Some(pid) && affinity & (1 << cpu) == 0 {
+        let queue = lock_for_reschedule();
+        unsafe {
+            reschedule(scheduler, queue, SwitchKind::Cooperative);
+        }
+    }
+
+    Some(old)
 }
 
 /// Get the current process PID
@@ -257,7 +677,7 @@ pub fn yield_cpu() -> Result<(), &'static str> {
 ///
 /// The PID of the current process, or None if no process is running
 pub fn get_current_pid() -> Option<u32> {
-    SCHEDULER.lock().current()
+    this_scheduler().lock().current()
 }
 
 /// Get the parent process PID of the current process
@@ -268,8 +688,8 @@ pub fn get_current_pid() -> Option<u32> {
 ///
 /// The PPID of the current process, or None if no process is running
 pub fn get_current_ppid() -> Option<u32> {
+    let current_pid = get_current_pid()?;
     let table = PROCESS_TABLE.lock();
-    let current_pid = SCHEDULER.lock().current()?;
     let process = table.get(current_pid)?;
     Some(process.ppid)
 }
@@ -288,15 +708,12 @@ pub fn get_current_ppid() -> Option<u32> {
 /// * `Ok(())` - Successfully added
 /// * `Err(&str)` - Failed to add (process not found, etc.)
 pub fn add_process(pid: u32) -> Result<(), &'static str> {
-    let table = PROCESS_TABLE.lock();
-    let process = table.get(pid).ok_or("Process not found")?;
-
     // Process should be in Ready state
-    if process.state != ProcessState::Ready {
-        return Err("Process not in Ready state");
+    match RUN_QUEUES.state(pid) {
+        ProcessState::Ready => Ok(()),
+        ProcessState::Dead => Err("Process not found"),
+        _ => Err("Process not in Ready state"),
     }
-
-    Ok(())
 }
 
 /// Remove a process from the scheduler
@@ -307,7 +724,9 @@ pub fn add_process(pid: u32) -> Result<(), &'static str> {
 ///
 /// * `pid` - PID of the process to remove
 pub fn remove_process(pid: u32) {
-    let mut scheduler = SCHEDULER.lock();
+    clear_input_waiter(pid);
+
+    let mut scheduler = this_scheduler().lock();
 
     // If this is the current process, clear current
     if scheduler.current() == Some(pid) {
@@ -320,8 +739,9 @@ pub fn remove_process(pid: u32) {
 /// This function must be called during kernel initialization to set up
 /// the scheduler.
 pub fn init() {
-    let mut scheduler = SCHEDULER.lock();
-    scheduler.set_preemption_enabled(true);
+    for scheduler in SCHEDULERS.iter() {
+        scheduler.lock().set_preemption_enabled(true);
+    }
 }
 
 #[cfg(test)]
@@ -341,4 +761,25 @@ mod tests {
         let scheduler = RoundRobinScheduler::default();
         assert!(scheduler.current().is_none());
     }
+
+    #[test]
+    fn test_input_waiters() {
+        add_input_waiter(3);
+        add_input_waiter(200);
+        assert_ne!(INPUT_WAITERS[0].load(Ordering::Relaxed) & (1 << 3), 0);
+        assert_ne!(INPUT_WAITERS[3].load(Ordering::Relaxed) & (1 << (200 - 192)), 0);
+
+        clear_input_waiter(3);
+        clear_input_waiter(200);
+        assert_eq!(INPUT_WAITERS[0].load(Ordering::Relaxed) & (1 << 3), 0);
+
+        // Out-of-range PIDs are ignored
+        add_input_waiter(MAX_PROCESSES as u32);
+    }
+
+    #[test]
+    fn test_schedulers_per_cpu() {
+        assert_eq!(SCHEDULERS.len(), MAX_CPUS);
+        assert!(core::ptr::eq(this_scheduler(), &SCHEDULERS[0]));
+    }
 }
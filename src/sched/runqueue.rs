@@ -0,0 +1,1122 @@
+// Copyright 2025 The Rustux Authors
+//
+// Use of this source code is governed by a MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT
+
+//! Per-CPU Run Queues
+//!
+//! Every CPU has its own queue of Ready processes behind its own
+//! spinlock. A queue is a set of per-priority FIFO lists with a bitmap of
+//! non-empty levels, so picking the next process is a bit scan plus a
+//! list pop. The list links are arrays indexed by PID inside the queue,
+//! which keeps a queue usable without the process table; a process is on
+//! at most one queue at a time.
+//!
+//! # Tasks
+//!
+//! The scheduling state of a process (state, priority, affinity, saved
+//! registers, CPU time) is a [`Task`], kept here by PID rather than in the
+//! process table. Each task is owned by one CPU: the one whose queue it
+//! is on while Ready, otherwise the one it runs or last ran on. A task is
+//! only read or written with its owner's queue locked ([`QueueGuard`]),
+//! and changes owner only with both queues locked. Scheduling, blocking
+//! and switching on a CPU therefore take that CPU's queue lock and no
+//! global one; the process table lock is only needed to look processes
+//! up and to create them.
+//!
+//! [`RunQueues`] keeps the invariant that a process is queued exactly
+//! when it is Ready (see [`RunQueues::set_state`]), apart from the moment
+//! it is handed from one queue to another, and decides which queue it
+//! goes on (see [`select_cpu`]).
+//!
+//! # Locking
+//!
+//! Lock order is scheduler, then process table, then run queues in
+//! ascending CPU order. A CPU rescheduling holds only its own queue lock
+//! and reaches other queues with `try_lock` (stealing), so an idle CPU
+//! never stalls a busy one.
+//!
+//! The lock is held across the register switch and released by the
+//! context that resumes ([`RunQueues::finish_switch`]): a process being
+//! switched out cannot be woken, stolen or run elsewhere before its
+//! registers are saved.
+
+use core::cell::UnsafeCell;
+use core::ops::{Deref, DerefMut};
+use core::sync::atomic::{AtomicU32, AtomicU64, Ordering};
+
+use crate::arch::amd64::fpu::{self, FpuState};
+use crate::arch::amd64::mm::page_tables::PAddr;
+use crate::arch::amd64::percpu::{self, MAX_CPUS};
+use crate::process::table::{
+    ProcessState, SavedState, AFFINITY_ALL, MAX_PROCESSES, NUM_PRIORITIES, PRIORITY_DEFAULT, PRIORITY_MAX,
+};
+use crate::sync::{SpinMutex, SpinMutexGuard};
+
+/// End-of-list marker for the link arrays (and "no process")
+const NONE: u32 = u32::MAX;
+
+/// Ready processes of one CPU
+pub struct RunQueue {
+    /// First (next to run) process at each priority
+    heads: [u32; NUM_PRIORITIES],
+
+    /// Last process at each priority
+    tails: [u32; NUM_PRIORITIES],
+
+    /// Next process at the same priority, by PID
+    next: [u32; MAX_PROCESSES],
+
+    /// Previous process at the same priority, by PID
+    prev: [u32; MAX_PROCESSES],
+
+    /// Priority each queued process was queued at, by PID
+    priority: [u8; MAX_PROCESSES],
+
+    /// Bit N of word N / 64 set while PID N is queued
+    queued: [u64; MAX_PROCESSES / 64],
+
+    /// Bit N set when priority N has at least one process
+    bitmap: u32,
+
+    /// Number of queued processes
+    count: usize,
+}
+
+impl RunQueue {
+    /// Create an empty run queue
+    pub const fn new() -> Self {
+        Self {
+            heads: [NONE; NUM_PRIORITIES],
+            tails: [NONE; NUM_PRIORITIES],
+            next: [NONE; MAX_PROCESSES],
+            prev: [NONE; MAX_PROCESSES],
+            priority: [0; MAX_PROCESSES],
+            queued: [0; MAX_PROCESSES / 64],
+            bitmap: 0,
+            count: 0,
+        }
+    }
+
+    /// Check whether a process is on this queue
+    pub fn contains(&self, pid: u32) -> bool {
+        (pid as usize) < MAX_PROCESSES && self.queued[pid as usize / 64] & (1 << (pid % 64)) != 0
+    }
+
+    /// Append a process to the tail of its priority level
+    ///
+    /// Already-queued and out-of-range PIDs are ignored.
+    pub fn push_back(&mut self, pid: u32, priority: u8) {
+        if (pid as usize) >= MAX_PROCESSES || self.contains(pid) {
+            return;
+        }
+        let level = (priority as usize).min(NUM_PRIORITIES - 1);
+        let index = pid as usize;
+
+        let tail = self.tails[level];
+        self.prev[index] = tail;
+        self.next[index] = NONE;
+        if tail == NONE {
+            self.heads[level] = pid;
+        } else {
+            self.next[tail as usize] = pid;
+        }
+        self.tails[level] = pid;
+
+        self.priority[index] = level as u8;
+        self.queued[index / 64] |= 1 << (pid % 64);
+        self.bitmap |= 1 << level;
+        self.count += 1;
+    }
+
+    /// Remove a process from its priority level
+    ///
+    /// Returns false if it was not queued here.
+    pub fn remove(&mut self, pid: u32) -> bool {
+        if !self.contains(pid) {
+            return false;
+        }
+        let index = pid as usize;
+        let level = self.priority[index] as usize;
+        let (prev, next) = (self.prev[index], self.next[index]);
+
+        if prev == NONE {
+            self.heads[level] = next;
+        } else {
+            self.next[prev as usize] = next;
+        }
+        if next == NONE {
+            self.tails[level] = prev;
+        } else {
+            self.prev[next as usize] = prev;
+        }
+
+        self.prev[index] = NONE;
+        self.next[index] = NONE;
+        self.queued[index / 64] &= !(1 << (pid % 64));
+        if self.heads[level] == NONE {
+            self.bitmap &= !(1 << level);
+        }
+        self.count -= 1;
+        true
+    }
+
+    /// Highest non-empty priority level
+    pub fn highest(&self) -> Option<u8> {
+        if self.bitmap == 0 {
+            None
+        } else {
+            Some((31 - self.bitmap.leading_zeros()) as u8)
+        }
+    }
+
+    /// Next process to run: the head of the highest non-empty level
+    pub fn peek(&self) -> Option<u32> {
+        Some(self.heads[self.highest()? as usize])
+    }
+
+    /// Number of queued processes
+    pub fn len(&self) -> usize {
+        self.count
+    }
+
+    /// Check if the queue is empty
+    pub fn is_empty(&self) -> bool {
+        self.count == 0
+    }
+
+    /// Find a process another CPU may take
+    ///
+    /// Scans from the highest level down, and within a level from the
+    /// tail (the process that will wait longest here, and whose cache
+    /// footprint is the coldest).
+    pub fn find_stealable(&self, mut allowed: impl FnMut(u32) -> bool) -> Option<u32> {
+        let mut levels = self.bitmap;
+        while levels != 0 {
+            let level = 31 - levels.leading_zeros() as usize;
+            levels &= !(1 << level);
+
+            let mut pid = self.tails[level];
+            while pid != NONE {
+                if allowed(pid) {
+                    return Some(pid);
+                }
+                pid = self.prev[pid as usize];
+            }
+        }
+        None
+    }
+}
+
+impl Default for RunQueue {
+    fn default() -> Self {
+        Self::new()
+    }
+}
+
+/// ============================================================================
+/// Tasks
+/// ============================================================================
+
+/// Scheduling state of one process
+///
+/// Reached through the locked queue of the CPU that owns it (see the
+/// module docs). `page_table`, `pcid`, `kernel_stack` and `fpu` are
+/// copies of the process's own, so a switch needs nothing from the
+/// process table.
+#[derive(Debug, Clone, Copy)]
+pub struct Task {
+    /// Process state (change via `RunQueues::set_state`)
+    pub state: ProcessState,
+
+    /// Scheduling priority (higher runs first)
+    pub priority: u8,
+
+    /// CPUs the process may run on (bit N = CPU N)
+    pub affinity: u64,
+
+    /// Saved CPU state
+    pub saved_state: SavedState,
+
+    /// Physical address of page table (CR3 value)
+    pub page_table: PAddr,
+
+    /// PCID tagging the page table's TLB entries
+    pub pcid: u16,
+
+    /// Kernel stack base (virtual address)
+    pub kernel_stack: u64,
+
+    /// FPU/SSE save area (the process's `Process::fpu`, set on insert)
+    pub fpu: *mut FpuState,
+
+    /// TSC cycles spent running, up to the last switch out
+    pub cpu_time: u64,
+
+    /// TSC at the last switch in (0 if never switched in)
+    pub sched_time: u64,
+
+    /// Times the process has been switched in
+    pub context_switches: u64,
+}
+
+impl Task {
+    /// Free slot
+    const EMPTY: Self = {
+        let mut task = Self::new(0, 0, 0, SavedState::new());
+        task.state = ProcessState::Dead;
+        task
+    };
+
+    /// Create the scheduling state of a new, Ready process
+    ///
+    /// # Arguments
+    ///
+    /// * `page_table` - Physical address of page table
+    /// * `pcid` - PCID of the page table
+    /// * `kernel_stack` - Kernel stack base (virtual address)
+    /// * `saved_state` - Context the process starts from
+    pub const fn new(page_table: PAddr, pcid: u16, kernel_stack: u64, saved_state: SavedState) -> Self {
+        Self {
+            state: ProcessState::Ready,
+            priority: PRIORITY_DEFAULT,
+            affinity: AFFINITY_ALL,
+            saved_state,
+            page_table,
+            pcid,
+            kernel_stack,
+            fpu: core::ptr::null_mut(),
+            cpu_time: 0,
+            sched_time: 0,
+            context_switches: 0,
+        }
+    }
+
+    /// CPU whose registers may hold the task's FPU state
+    fn fpu_cpu(&self) -> Option<usize> {
+        if self.fpu.is_null() {
+            None
+        } else {
+            fpu::live_cpu(self.fpu)
+        }
+    }
+}
+
+/// A task and the CPU that owns it
+struct TaskSlot {
+    /// Owning CPU (written with the old and the new owner's queues locked)
+    cpu: AtomicU32,
+
+    /// Only touched with the owner's queue locked
+    task: UnsafeCell<Task>,
+}
+
+/// ============================================================================
+/// Run Queues
+/// ============================================================================
+
+/// The run queues of all CPUs and the tasks they own
+pub struct RunQueues {
+    /// Ready processes of each CPU
+    queues: [SpinMutex<RunQueue>; MAX_CPUS],
+
+    /// Scheduling state of each process, by PID
+    tasks: [TaskSlot; MAX_PROCESSES],
+
+    /// Process running on each CPU (NONE if idle), written with that
+    /// CPU's queue locked
+    current: [AtomicU32; MAX_CPUS],
+
+    /// Process each CPU requeued for another CPU, to be placed once the
+    /// switch away from it is done (NONE if none)
+    deferred: [AtomicU32; MAX_CPUS],
+}
+
+// Safety: a task is only reached through its owner's locked queue
+unsafe impl Sync for RunQueues {}
+
+impl RunQueues {
+    /// Create empty run queues with no tasks
+    pub const fn new() -> Self {
+        const QUEUE: SpinMutex<RunQueue> = SpinMutex::new(RunQueue::new());
+        const SLOT: TaskSlot = TaskSlot {
+            cpu: AtomicU32::new(0),
+            task: UnsafeCell::new(Task::EMPTY),
+        };
+        const NO_PID: AtomicU32 = AtomicU32::new(NONE);
+        Self {
+            queues: [QUEUE; MAX_CPUS],
+            tasks: [SLOT; MAX_PROCESSES],
+            current: [NO_PID; MAX_CPUS],
+            deferred: [NO_PID; MAX_CPUS],
+        }
+    }
+
+    /// Lock a CPU's queue
+    pub fn lock(&self, cpu: usize) -> QueueGuard<'_> {
+        QueueGuard { queues: self, cpu, queue: self.queues[cpu].lock() }
+    }
+
+    /// Lock a CPU's queue if nobody holds it
+    fn try_lock(&self, cpu: usize) -> Option<QueueGuard<'_>> {
+        let queue = self.queues[cpu].try_lock()?;
+        Some(QueueGuard { queues: self, cpu, queue })
+    }
+
+    /// Lock two different queues, lower CPU first
+    fn lock_pair(&self, a: usize, b: usize) -> (QueueGuard<'_>, QueueGuard<'_>) {
+        if a < b {
+            let first = self.lock(a);
+            (first, self.lock(b))
+        } else {
+            let first = self.lock(b);
+            (self.lock(a), first)
+        }
+    }
+
+    /// CPU owning a process's task
+    pub fn cpu_of(&self, pid: u32) -> Option<usize> {
+        let slot = self.tasks.get(pid as usize)?;
+        Some(slot.cpu.load(Ordering::Acquire) as usize)
+    }
+
+    /// Lock the queue of the CPU owning a process's task
+    ///
+    /// None if the PID is out of range.
+    pub fn lock_owner(&self, pid: u32) -> Option<QueueGuard<'_>> {
+        loop {
+            let queue = self.lock(self.cpu_of(pid)?);
+            // The owner only changes under its lock: recheck holding it
+            if queue.owns(pid) {
+                return Some(queue);
+            }
+        }
+    }
+
+    /// Make `cpu` the owner of a task that is on no queue, and lock it
+    fn lock_moved(&self, pid: u32, cpu: usize) -> Option<QueueGuard<'_>> {
+        loop {
+            let from = self.cpu_of(pid)?;
+            if from == cpu {
+                let queue = self.lock(cpu);
+                if queue.owns(pid) {
+                    return Some(queue);
+                }
+                continue;
+            }
+
+            let (from_queue, to_queue) = self.lock_pair(from, cpu);
+            if from_queue.owns(pid) {
+                self.tasks[pid as usize].cpu.store(cpu as u32, Ordering::Release);
+                return Some(to_queue);
+            }
+        }
+    }
+
+    /// Process running on a CPU
+    pub fn current(&self, cpu: usize) -> Option<u32> {
+        let pid = self.current[cpu].load(Ordering::Acquire);
+        if pid == NONE {
+            None
+        } else {
+            Some(pid)
+        }
+    }
+
+    /// Copy of a process's task (None if no process has the PID)
+    pub fn task(&self, pid: u32) -> Option<Task> {
+        let queue = self.lock_owner(pid)?;
+        queue.task(pid).filter(|task| task.state != ProcessState::Dead).copied()
+    }
+
+    /// State of a process (Dead if no process has the PID)
+    pub fn state(&self, pid: u32) -> ProcessState {
+        self.lock_owner(pid)
+            .and_then(|queue| queue.task(pid).map(|task| task.state))
+            .unwrap_or(ProcessState::Dead)
+    }
+
+    /// Start scheduling a new process, owned by this CPU
+    ///
+    /// A Ready task is queued right away.
+    pub fn insert(&self, pid: u32, task: Task) {
+        let mut queue = match self.lock_moved(pid, percpu::this_cpu()) {
+            Some(queue) => queue,
+            None => return,
+        };
+        if let Some(slot) = queue.task_mut(pid) {
+            *slot = task;
+        }
+        if task.state == ProcessState::Ready {
+            self.place(pid, queue);
+        }
+    }
+
+    /// Stop scheduling a process that leaves the table
+    pub fn release(&self, pid: u32) {
+        // If this is the current process of any CPU, clear it
+        for current in self.current.iter() {
+            let _ = current.compare_exchange(pid, NONE, Ordering::AcqRel, Ordering::Relaxed);
+        }
+
+        if let Some(mut queue) = self.lock_owner(pid) {
+            queue.remove(pid);
+            if let Some(task) = queue.task_mut(pid) {
+                // The save area goes with the process: drop any claim on it
+                fpu::release(task.fpu);
+                task.state = ProcessState::Dead;
+            }
+        }
+    }
+
+    /// Change a process's state, moving it onto or off the run queues
+    ///
+    /// Becoming Ready appends the process to the tail of its priority
+    /// level on the queue `place` picks; leaving Ready (to Running,
+    /// Blocked, ...) unlinks it.
+    pub fn set_state(&self, pid: u32, state: ProcessState) {
+        let mut queue = match self.lock_owner(pid) {
+            Some(queue) => queue,
+            None => return,
+        };
+        let was_ready = match queue.task_mut(pid) {
+            Some(task) if task.state != ProcessState::Dead => {
+                let was_ready = task.state == ProcessState::Ready;
+                task.state = state;
+                was_ready
+            }
+            _ => return,
+        };
+
+        if state == ProcessState::Ready {
+            if !was_ready {
+                self.place(pid, queue);
+            }
+        } else {
+            queue.remove(pid);
+        }
+    }
+
+    /// Make a Blocked process Ready
+    ///
+    /// A Ready or Running process is left alone. Returns false if the
+    /// process is not alive (it exited, or there is none).
+    pub fn wake(&self, pid: u32) -> bool {
+        let mut queue = match self.lock_owner(pid) {
+            Some(queue) => queue,
+            None => return false,
+        };
+        let state = queue.task(pid).map_or(ProcessState::Dead, |task| task.state);
+        if state == ProcessState::Blocked {
+            if let Some(task) = queue.task_mut(pid) {
+                task.state = ProcessState::Ready;
+            }
+            self.place(pid, queue);
+        }
+        state.is_alive()
+    }
+
+    /// Make a live process a Zombie, taking it off its queue
+    ///
+    /// One running on another CPU stops when that CPU next reschedules
+    /// (it is no longer requeued). Returns false if it was not alive.
+    pub fn exit(&self, pid: u32) -> bool {
+        let mut queue = match self.lock_owner(pid) {
+            Some(queue) => queue,
+            None => return false,
+        };
+        let alive = queue.task(pid).map_or(false, |task| task.state.is_alive());
+        if alive {
+            queue.set_state(pid, ProcessState::Zombie);
+        }
+        alive
+    }
+
+    /// Change a process's priority, returning the previous one
+    ///
+    /// A queued process moves to the tail of its new level (on the same
+    /// CPU).
+    pub fn set_priority(&self, pid: u32, priority: u8) -> Option<u8> {
+        let priority = priority.min(PRIORITY_MAX);
+        let mut queue = self.lock_owner(pid)?;
+        let old = match queue.task_mut(pid) {
+            Some(task) if task.state != ProcessState::Dead => {
+                let old = task.priority;
+                task.priority = priority;
+                old
+            }
+            _ => return None,
+        };
+
+        if queue.remove(pid) {
+            queue.push_back(pid, priority);
+        }
+        Some(old)
+    }
+
+    /// Change the set of CPUs a process may run on, returning the old one
+    ///
+    /// A queued process on a CPU outside the new set moves to an allowed
+    /// one. A running process moves when it is next rescheduled.
+    pub fn set_affinity(&self, pid: u32, affinity: u64) -> Option<u64> {
+        let mut queue = self.lock_owner(pid)?;
+        let cpu = queue.cpu();
+        let old = match queue.task_mut(pid) {
+            Some(task) if task.state != ProcessState::Dead => {
+                let old = task.affinity;
+                task.affinity = affinity;
+                old
+            }
+            _ => return None,
+        };
+
+        if affinity & (1 << cpu) == 0 && queue.remove(pid) {
+            self.place(pid, queue);
+        }
+        Some(old)
+    }
+
+    /// Check whether any CPU has a process queued
+    pub fn any_ready(&self) -> bool {
+        self.queues.iter().any(|queue| !queue.lock().is_empty())
+    }
+
+    /// Number of processes on all run queues
+    pub fn ready_count(&self) -> usize {
+        self.queues.iter().map(|queue| queue.lock().len()).sum()
+    }
+
+    /// Put a process that has just become Ready on a run queue
+    ///
+    /// `queue` is the locked queue of its owner. The running process
+    /// being requeued stays on this CPU if nothing else is waiting here. A
+    /// process whose FPU state is live on another CPU goes back there
+    /// (only that CPU can save it). Otherwise [`select_cpu`] decides, a
+    /// queue that is locked at the moment counting as full, and a CPU
+    /// other than this one is sent a reschedule IPI.
+    fn place(&self, pid: u32, mut queue: QueueGuard<'_>) {
+        let this_cpu = percpu::this_cpu();
+        let owner = queue.cpu();
+        let (affinity, priority, fpu_state, live) = match queue.task(pid) {
+            Some(task) => (task.affinity, task.priority, task.fpu, task.fpu_cpu()),
+            None => return,
+        };
+
+        let requeue = owner == this_cpu
+            && self.current(this_cpu) == Some(pid)
+            && affinity & (1 << this_cpu) != 0
+            && queue.is_empty();
+        let cpu = match live {
+            _ if requeue => this_cpu,
+            Some(cpu) if cpu != this_cpu => cpu,
+            _ => select_cpu(owner, affinity, percpu::online_mask(), idle_mask(), |cpu| {
+                if cpu == owner {
+                    queue.len()
+                } else {
+                    self.queues[cpu].try_lock().map_or(usize::MAX, |other| other.len())
+                }
+            }),
+        };
+        if live == Some(this_cpu) && cpu != this_cpu {
+            unsafe { fpu::flush(fpu_state) };
+        }
+
+        if cpu == owner {
+            queue.push_back(pid, priority);
+        } else {
+            drop(queue);
+            let mut queue = match self.lock_moved(pid, cpu) {
+                Some(queue) => queue,
+                None => return,
+            };
+            // It was on no queue in between: it may no longer be Ready
+            let priority = match queue.task(pid) {
+                Some(task) if task.state == ProcessState::Ready => task.priority,
+                _ => return,
+            };
+            queue.push_back(pid, priority);
+        }
+
+        if cpu != this_cpu {
+            // Claim the CPU so the next placement looks elsewhere
+            set_idle(cpu, false);
+            crate::arch::amd64::smp::send_reschedule(cpu);
+        }
+    }
+
+    /// Complete a context switch, in the context that has just resumed
+    ///
+    /// Releases this CPU's queue lock, which the switching context held
+    /// across the switch, then places the process [`QueueGuard::requeue`]
+    /// left for afterwards: with its registers saved, it may now move to
+    /// another CPU.
+    ///
+    /// # Safety
+    ///
+    /// Only right after a context switch made with this CPU's queue
+    /// locked and its guard forgotten.
+    pub unsafe fn finish_switch(&self) {
+        let cpu = percpu::this_cpu();
+        let deferred = self.deferred[cpu].swap(NONE, Ordering::AcqRel);
+        self.queues[cpu].force_unlock();
+
+        if deferred == NONE {
+            return;
+        }
+        if let Some(queue) = self.lock_owner(deferred) {
+            // Unless it exited (or was woken by a move) meanwhile
+            let ready = queue.task(deferred).map_or(false, |task| task.state == ProcessState::Ready);
+            if ready && !queue.contains(deferred) {
+                self.place(deferred, queue);
+            }
+        }
+    }
+}
+
+impl Default for RunQueues {
+    fn default() -> Self {
+        Self::new()
+    }
+}
+
+/// A CPU's locked run queue, with access to the tasks that CPU owns
+pub struct QueueGuard<'a> {
+    queues: &'a RunQueues,
+    cpu: usize,
+    queue: SpinMutexGuard<'a, RunQueue>,
+}
+
+impl Deref for QueueGuard<'_> {
+    type Target = RunQueue;
+
+    fn deref(&self) -> &RunQueue {
+        &self.queue
+    }
+}
+
+impl DerefMut for QueueGuard<'_> {
+    fn deref_mut(&mut self) -> &mut RunQueue {
+        &mut self.queue
+    }
+}
+
+impl<'a> QueueGuard<'a> {
+    /// CPU whose queue this is
+    pub fn cpu(&self) -> usize {
+        self.cpu
+    }
+
+    /// Check whether this CPU owns a process's task
+    fn owns(&self, pid: u32) -> bool {
+        self.queues.tasks.get(pid as usize)
+            .map_or(false, |slot| slot.cpu.load(Ordering::Acquire) as usize == self.cpu)
+    }
+
+    /// Task of a process this CPU owns
+    pub fn task(&self, pid: u32) -> Option<&Task> {
+        if !self.owns(pid) {
+            return None;
+        }
+        // Safety: owned tasks are only reached through this locked queue
+        Some(unsafe { &*self.queues.tasks[pid as usize].task.get() })
+    }
+
+    /// Task of a process this CPU owns (mutable)
+    pub fn task_mut(&mut self, pid: u32) -> Option<&mut Task> {
+        if !self.owns(pid) {
+            return None;
+        }
+        // Safety: as for `task`, and `self` is borrowed mutably
+        Some(unsafe { &mut *self.queues.tasks[pid as usize].task.get() })
+    }
+
+    /// Set the process running on this CPU (None when idle)
+    pub fn set_current(&mut self, pid: Option<u32>) {
+        self.queues.current[self.cpu].store(pid.unwrap_or(NONE), Ordering::Release);
+    }
+
+    /// Change the state of a process this CPU owns to anything but Ready
+    ///
+    /// A queued process leaves the queue. Becoming Ready goes through
+    /// [`RunQueues::set_state`] or [`QueueGuard::requeue`] instead, which
+    /// pick a queue.
+    pub fn set_state(&mut self, pid: u32, state: ProcessState) {
+        debug_assert!(state != ProcessState::Ready);
+        if let Some(task) = self.task_mut(pid) {
+            task.state = state;
+            self.queue.remove(pid);
+        }
+    }
+
+    /// Mark a process this CPU owns Running, taking it off the queue
+    ///
+    /// Also cancels a requeue of it left for [`RunQueues::finish_switch`].
+    pub fn set_running(&mut self, pid: u32) {
+        self.set_state(pid, ProcessState::Running);
+        let _ = self.queues.deferred[self.cpu].compare_exchange(pid, NONE, Ordering::AcqRel, Ordering::Relaxed);
+    }
+
+    /// Put this CPU's running process back to Ready
+    ///
+    /// It goes to the tail of its level here if it may run here and
+    /// nothing else is waiting. Otherwise another CPU may suit it better,
+    /// but it cannot move before this CPU has switched away from it:
+    /// [`RunQueues::finish_switch`] places it then.
+    pub fn requeue(&mut self, pid: u32) {
+        let cpu = self.cpu;
+        let (priority, allowed) = match self.task_mut(pid) {
+            Some(task) => {
+                task.state = ProcessState::Ready;
+                (task.priority, task.affinity & (1 << cpu) != 0)
+            }
+            None => return,
+        };
+
+        if allowed && self.queue.is_empty() {
+            self.queue.push_back(pid, priority);
+        } else {
+            self.queues.deferred[cpu].store(pid, Ordering::Release);
+        }
+    }
+
+    /// Next process to run on this CPU
+    ///
+    /// The head of the highest non-empty level of this queue or, if it is
+    /// empty, a process stolen from another CPU's queue. The process stays
+    /// queued (here); `set_running` takes it off.
+    pub fn peek_next(&mut self) -> Option<u32> {
+        if let Some(pid) = self.queue.peek() {
+            return Some(pid);
+        }
+        self.steal()
+    }
+
+    /// Move one Ready process from another CPU's queue to this one
+    ///
+    /// Skips queues that are locked at the moment, processes whose
+    /// affinity excludes this CPU, and processes whose FPU state is still
+    /// live on the victim (only the victim can save it).
+    fn steal(&mut self) -> Option<u32> {
+        let cpu = self.cpu;
+        let online = percpu::online_mask();
+
+        for offset in 1..MAX_CPUS {
+            let victim = (cpu + offset) % MAX_CPUS;
+            if online & (1 << victim) == 0 {
+                continue;
+            }
+            let mut queue = match self.queues.try_lock(victim) {
+                Some(queue) => queue,
+                None => continue,
+            };
+            if queue.is_empty() {
+                continue;
+            }
+
+            let pid = queue.find_stealable(|pid| {
+                queue.task(pid).map_or(false, |task| {
+                    task.affinity & (1 << cpu) != 0 && task.fpu_cpu() != Some(victim)
+                })
+            });
+            if let Some(pid) = pid {
+                queue.remove(pid);
+                let priority = queue.task(pid).map_or(PRIORITY_DEFAULT, |task| task.priority);
+                // Both queues are locked: hand the task over
+                self.queues.tasks[pid as usize].cpu.store(cpu as u32, Ordering::Release);
+                drop(queue);
+
+                self.queue.push_back(pid, priority);
+                return Some(pid);
+            }
+        }
+        None
+    }
+
+    /// Charge a context switch at TSC `now`
+    ///
+    /// `prev` is billed for the time since it was switched in, and `next`
+    /// starts a new run. Either may be None (the idle loop).
+    pub fn account_switch(&mut self, prev: Option<u32>, next: Option<u32>, now: u64) {
+        if let Some(prev) = prev.and_then(|pid| self.task_mut(pid)) {
+            if prev.sched_time != 0 {
+                prev.cpu_time += now.saturating_sub(prev.sched_time);
+            }
+        }
+        if let Some(next) = next.and_then(|pid| self.task_mut(pid)) {
+            next.sched_time = now;
+            next.context_switches += 1;
+        }
+    }
+}
+
+/// ============================================================================
+/// Global Run Queues
+/// ============================================================================
+
+/// Run queues of all CPUs
+pub static RUN_QUEUES: RunQueues = RunQueues::new();
+
+/// Bit N set while CPU N sits in its idle loop with nothing to run
+static IDLE_CPUS: AtomicU64 = AtomicU64::new(0);
+
+/// Mark a CPU as idle or busy
+pub fn set_idle(cpu: usize, idle: bool) {
+    if idle {
+        IDLE_CPUS.fetch_or(1 << cpu, Ordering::AcqRel);
+    } else {
+        IDLE_CPUS.fetch_and(!(1 << cpu), Ordering::AcqRel);
+    }
+}
+
+/// Mask of idle CPUs
+pub fn idle_mask() -> u64 {
+    IDLE_CPUS.load(Ordering::Acquire)
+}
+
+/// Choose the CPU whose queue a process that became Ready goes on
+///
+/// In order of preference:
+/// 1. `last` (where its caches are warm) if it is allowed and idle
+/// 2. Any allowed idle CPU
+/// 3. `last` if it is allowed
+/// 4. The allowed CPU with the shortest queue
+///
+/// An affinity mask with no online CPU falls back to all online CPUs.
+pub fn select_cpu(
+    last: usize,
+    affinity: u64,
+    online: u64,
+    idle: u64,
+    load: impl Fn(usize) -> usize,
+) -> usize {
+    let mut allowed = affinity & online;
+    if allowed == 0 {
+        allowed = online | 1;
+    }
+
+    let last_bit = 1u64 << (last % MAX_CPUS);
+    if allowed & idle & last_bit != 0 {
+        return last;
+    }
+    if allowed & idle != 0 {
+        return (allowed & idle).trailing_zeros() as usize;
+    }
+    if allowed & last_bit != 0 {
+        return last;
+    }
+
+    let mut best = allowed.trailing_zeros() as usize;
+    let mut best_load = usize::MAX;
+    let mut candidates = allowed;
+    while candidates != 0 {
+        let cpu = candidates.trailing_zeros() as usize;
+        candidates &= candidates - 1;
+        let cpu_load = load(cpu);
+        if cpu_load < best_load {
+            best = cpu;
+            best_load = cpu_load;
+        }
+    }
+    best
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    #[test]
+    fn test_run_queue_fifo_and_priority() {
+        let mut queue = RunQueue::new();
+        queue.push_back(1, 16);
+        queue.push_back(2, 16);
+        queue.push_back(3, 20);
+        assert_eq!(queue.len(), 3);
+        assert_eq!(queue.highest(), Some(20));
+        assert_eq!(queue.peek(), Some(3));
+
+        assert!(queue.remove(3));
+        assert_eq!(queue.peek(), Some(1));
+        assert!(queue.remove(1));
+        queue.push_back(1, 16);
+        assert_eq!(queue.peek(), Some(2));
+
+        // Double insert and stale removal are no-ops
+        queue.push_back(2, 16);
+        assert!(!queue.remove(3));
+        assert_eq!(queue.len(), 2);
+    }
+
+    #[test]
+    fn test_run_queue_find_stealable() {
+        let mut queue = RunQueue::new();
+        queue.push_back(1, 16);
+        queue.push_back(2, 16);
+        queue.push_back(3, 8);
+
+        // Tail of the highest level first
+        assert_eq!(queue.find_stealable(|_| true), Some(2));
+        assert_eq!(queue.find_stealable(|pid| pid != 2), Some(1));
+        assert_eq!(queue.find_stealable(|pid| pid == 3), Some(3));
+        assert_eq!(queue.find_stealable(|_| false), None);
+    }
+
+    #[test]
+    fn test_select_cpu() {
+        let online = 0b1111;
+        let loads = [3, 1, 2, 0];
+        let load = |cpu: usize| loads[cpu];
+
+        // Warm CPU when idle, else any idle CPU, else warm CPU
+        assert_eq!(select_cpu(2, u64::MAX, online, 0b0100, load), 2);
+        assert_eq!(select_cpu(2, u64::MAX, online, 0b1000, load), 3);
+        assert_eq!(select_cpu(2, u64::MAX, online, 0, load), 2);
+
+        // Affinity excludes the warm CPU: least loaded allowed CPU
+        assert_eq!(select_cpu(2, 0b0011, online, 0, load), 1);
+
+        // Affinity to offline CPUs only falls back to any online CPU
+        assert_eq!(select_cpu(0, 0b1_0000, online, 0, load), 0);
+        assert_eq!(select_cpu(1, 0b1_0000, online, 0, load), 1);
+    }
+
+    /// Run queues of their own (tests run in parallel) with `count` Ready
+    /// processes
+    fn queues_with(count: u32) -> &'static RunQueues {
+        let queues: &'static RunQueues = alloc::boxed::Box::leak(alloc::boxed::Box::new(RunQueues::new()));
+        for pid in 1..=count {
+            queues.insert(pid, Task::new(0x1000, 0, 0x2000, SavedState::new()));
+        }
+        queues
+    }
+
+    /// Run the next process and put it back on the queue (one time slice)
+    fn run_one(queues: &RunQueues) -> Option<u32> {
+        let pid = {
+            let mut queue = queues.lock(0);
+            let pid = queue.peek_next()?;
+            queue.set_running(pid);
+            pid
+        };
+        queues.set_state(pid, ProcessState::Ready);
+        Some(pid)
+    }
+
+    #[test]
+    fn test_run_queue_round_robin() {
+        let queues = queues_with(3);
+        assert_eq!(queues.ready_count(), 3);
+
+        // FIFO within one level, wrapping around
+        assert_eq!(run_one(queues), Some(1));
+        assert_eq!(run_one(queues), Some(2));
+        assert_eq!(run_one(queues), Some(3));
+        assert_eq!(run_one(queues), Some(1));
+    }
+
+    #[test]
+    fn test_run_queue_blocked_leaves_queue() {
+        let queues = queues_with(3);
+
+        queues.set_state(2, ProcessState::Blocked);
+        assert_eq!(queues.ready_count(), 2);
+        assert_eq!(run_one(queues), Some(1));
+        assert_eq!(run_one(queues), Some(3));
+        assert_eq!(run_one(queues), Some(1));
+
+        // Waking appends at the tail
+        assert!(queues.wake(2));
+        assert_eq!(run_one(queues), Some(3));
+        assert_eq!(run_one(queues), Some(1));
+        assert_eq!(run_one(queues), Some(2));
+
+        queues.release(1);
+        assert_eq!(queues.ready_count(), 2);
+        assert_eq!(queues.state(1), ProcessState::Dead);
+        assert!(!queues.wake(1));
+        assert_eq!(run_one(queues), Some(3));
+        assert_eq!(run_one(queues), Some(2));
+    }
+
+    #[test]
+    fn test_run_queue_priority() {
+        let queues = queues_with(3);
+
+        assert_eq!(queues.set_priority(3, PRIORITY_MAX), Some(PRIORITY_DEFAULT));
+        assert_eq!(queues.lock(0).highest(), Some(PRIORITY_MAX));
+        assert_eq!(run_one(queues), Some(3));
+        assert_eq!(run_one(queues), Some(3));
+
+        // Lower levels run once the high one is empty
+        queues.set_state(3, ProcessState::Blocked);
+        assert_eq!(run_one(queues), Some(1));
+        assert_eq!(run_one(queues), Some(2));
+
+        // Out-of-range priorities clamp
+        queues.set_priority(1, 200);
+        assert_eq!(queues.task(1).unwrap().priority, PRIORITY_MAX);
+        assert_eq!(queues.set_priority(9, 1), None);
+    }
+
+    #[test]
+    fn test_requeue_and_exit() {
+        let queues = queues_with(2);
+        let mut queue = queues.lock(0);
+        assert_eq!(queue.peek_next(), Some(1));
+        queue.set_running(1);
+        queue.set_current(Some(1));
+
+        // Something else is waiting: the requeue is left for after the switch
+        queue.requeue(1);
+        assert!(!queue.contains(1));
+        queue.set_running(1);
+        assert_eq!(queue.task(1).unwrap().state, ProcessState::Running);
+
+        // Alone here: straight back on this queue
+        queue.set_running(2);
+        queue.requeue(1);
+        assert!(queue.contains(1));
+        drop(queue);
+
+        assert!(queues.exit(1));
+        assert!(!queues.exit(1));
+        assert_eq!(queues.ready_count(), 0);
+        assert_eq!(queues.current(0), Some(1));
+        queues.release(1);
+        assert_eq!(queues.current(0), None);
+    }
+
+    #[test]
+    fn test_account_switch() {
+        let queues = queues_with(2);
+        let mut queue = queues.lock(0);
+
+        // Never switched in: nothing to bill yet
+        queue.account_switch(Some(1), Some(2), 1000);
+        assert_eq!(queue.task(1).unwrap().cpu_time, 0);
+        assert_eq!(queue.task(2).unwrap().context_switches, 1);
+
+        queue.account_switch(Some(2), None, 1500);
+        queue.account_switch(None, Some(2), 2000);
+        queue.account_switch(Some(2), Some(1), 2100);
+        let task = queue.task(2).unwrap();
+        assert_eq!(task.cpu_time, 600);
+        assert_eq!(task.context_switches, 2);
+        assert_eq!(queue.task(1).unwrap().sched_time, 2100);
+    }
+
+    #[test]
+    fn test_set_affinity() {
+        let queues = queues_with(2);
+
+        assert_eq!(queues.set_affinity(1, 0b1), Some(AFFINITY_ALL));
+        assert_eq!(queues.task(1).unwrap().affinity, 0b1);
+        assert_eq!(queues.set_affinity(9, 0b1), None);
+
+        // Only CPU 0 is online here: everything stays on its queue
+        assert_eq!(queues.cpu_of(1), Some(0));
+        assert_eq!(queues.ready_count(), 2);
+        assert_eq!(run_one(queues), Some(1));
+        assert_eq!(run_one(queues), Some(2));
+    }
+}
@@ -0,0 +1,142 @@
+// Copyright 2025 The Rustux Authors
+//
+// Use of this source code is governed by a MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT
+
+//! Tickless Timer Interrupts
+//!
+//! There is no periodic tick. Each CPU's Local APIC timer is armed one
+//! shot (TSC-deadline mode where the CPU has it) for the nearest of:
+//!
+//! - the end of the running process's time slice
+//! - the earliest armed `Timer` object (`object::timer`)
+//!
+//! A CPU that switches to its idle loop stops slicing, so with no armed
+//! timer it takes no timer interrupts at all and sleeps until an IPI or
+//! a device interrupt. Timer objects fire within the interrupt latency of
+//! their deadline instead of on the next 10 ms tick.
+//!
+//! Every CPU considers the earliest timer: whichever one gets there
+//! first fires it. Arming a timer reprograms only the calling CPU, which
+//! is enough for it to be served on time.
+
+use core::sync::atomic::{AtomicU64, Ordering};
+
+use crate::arch::amd64::apic;
+use crate::arch::amd64::percpu::{self, MAX_CPUS};
+use crate::arch::amd64::tsc;
+use crate::boot;
+use crate::object::timer;
+use crate::sched::round_robin;
+
+/// TSC value at which each CPU's current slice ends (0 = idle, no slice)
+static SLICE_END: [AtomicU64; MAX_CPUS] = {
+    const ZERO: AtomicU64 = AtomicU64::new(0);
+    [ZERO; MAX_CPUS]
+};
+
+/// Slice length of each CPU's current process, in TSC ticks
+static SLICE_TICKS: [AtomicU64; MAX_CPUS] = {
+    const ZERO: AtomicU64 = AtomicU64::new(0);
+    [ZERO; MAX_CPUS]
+};
+
+/// TSC deadline each CPU's APIC timer is armed for (0 = stopped)
+static ARMED: [AtomicU64; MAX_CPUS] = {
+    const ZERO: AtomicU64 = AtomicU64::new(0);
+    [ZERO; MAX_CPUS]
+};
+
+/// Timer interrupts taken by all CPUs
+static INTERRUPTS: AtomicU64 = AtomicU64::new(0);
+
+/// Next deadline of a CPU: the nearer of its slice end and the earliest
+/// armed timer
+fn next_deadline(cpu: usize) -> Option<u64> {
+    let slice_end = match SLICE_END[cpu].load(Ordering::Relaxed) {
+        0 => None,
+        end => Some(end),
+    };
+    let timer = timer::next_deadline().map(tsc::ns_to_tsc);
+
+    match (slice_end, timer) {
+        (Some(a), Some(b)) => Some(a.min(b)),
+        (a, b) => a.or(b),
+    }
+}
+
+/// Arm (or stop) the calling CPU's APIC timer for its next deadline
+///
+/// A no-op if the timer is already armed for that deadline.
+pub fn program() {
+    let cpu = percpu::this_cpu();
+    let deadline = next_deadline(cpu).unwrap_or(0);
+    if ARMED[cpu].swap(deadline, Ordering::Relaxed) == deadline {
+        return;
+    }
+
+    if deadline == 0 {
+        apic::apic_timer_stop();
+    } else {
+        apic::apic_timer_set_deadline(deadline);
+    }
+}
+
+/// Start a time slice on the calling CPU at TSC `now`
+///
+/// Called by the scheduler when it switches to a process (`running`) or
+/// to the idle loop, which has no slice.
+pub fn start_slice(now: u64, running: bool, slice_ms: u64) {
+    let cpu = percpu::this_cpu();
+    if running {
+        let ticks = tsc::ns_to_tsc(slice_ms * 1_000_000).max(1);
+        SLICE_TICKS[cpu].store(ticks, Ordering::Relaxed);
+        SLICE_END[cpu].store(now + ticks, Ordering::Relaxed);
+    } else {
+        SLICE_END[cpu].store(0, Ordering::Relaxed);
+    }
+    program();
+}
+
+/// Timer interrupts taken since boot
+pub fn interrupt_count() -> u64 {
+    INTERRUPTS.load(Ordering::Relaxed)
+}
+
+/// Timer interrupt handler body
+///
+/// Fires expired timer objects, preempts the running process if its
+/// slice is over, and arms the timer for the next deadline. Runs the
+/// deferred boot tasks if no idle CPU has taken them (a uniprocessor
+/// boots them from init's first slice end). Must be
+/// called after the interrupt is acknowledged: the preemption may switch
+/// away for a long time.
+///
+/// # Safety
+///
+/// Must only be called from the timer interrupt handler, with interrupts
+/// disabled.
+pub unsafe fn timer_interrupt() {
+    let cpu = percpu::this_cpu();
+    ARMED[cpu].store(0, Ordering::Relaxed);
+    INTERRUPTS.fetch_add(1, Ordering::Relaxed);
+
+    let now = tsc::tsc_ticks();
+    timer::fire_expired(tsc::tsc_to_ns(now));
+    if boot::pending() {
+        boot::run_deferred();
+    }
+
+    let slice_end = SLICE_END[cpu].load(Ordering::Relaxed);
+    if slice_end != 0 && now >= slice_end {
+        // A new slice starts if the process keeps the CPU; a switch
+        // starts the next process's own
+        let ticks = SLICE_TICKS[cpu].load(Ordering::Relaxed);
+        SLICE_END[cpu].store(now + ticks, Ordering::Relaxed);
+        round_robin::timer_tick();
+    }
+
+    // Possibly resumed on another CPU, long after the switch
+    program();
+}
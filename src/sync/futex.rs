@@ -0,0 +1,234 @@
+// Copyright 2025 The Rustux Authors
+//
+// Use of this source code is governed by a MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT
+
+//! Futexes
+//!
+//! A futex is a 32-bit word of user memory that threads sleep on. The
+//! word itself is the lock or condition, manipulated with atomics in
+//! userspace; the kernel is only entered to sleep while it holds some
+//! value ([`wait`]) and to wake sleepers after changing it ([`wake`]).
+//! Nothing is allocated per futex: a word is a futex while someone
+//! waits on it.
+//!
+//! # Design
+//!
+//! - **Keys**: A futex is named by its address space (page table) and
+//!   user address, so the threads of one process share it
+//! - **Buckets**: Waiters are kept in [`BUCKETS`] lists hashed by key,
+//!   in arrival order; a wake scans one short list
+//! - **No lost wakeups**: A waiter is listed before it reads the word, so
+//!   a waker that changes the word and then wakes either finds it listed
+//!   or is seen by its read
+//!
+//! Lock order is bucket, then run queue (a bucket is also locked inside
+//! the `wait_on` condition, under the scheduler lock only).
+
+use alloc::vec::Vec;
+use core::sync::atomic::{fence, Ordering};
+
+use crate::arch::amd64::mm::page_tables::PAddr;
+use crate::arch::amd64::mm::RxStatus;
+use crate::sched::round_robin;
+use crate::sched::runqueue::{RunQueues, RUN_QUEUES};
+use crate::sync::{SpinMutex, WaitQueue, WaiterId};
+use crate::syscall::usercopy;
+
+/// Number of hash buckets (a power of two)
+pub const NUM_BUCKETS: usize = 64;
+
+/// A futex: user address in an address space
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+pub struct FutexKey {
+    /// Page table (PML4 physical address) of the address space
+    pub page_table: PAddr,
+    /// User address of the word (4-byte aligned)
+    pub addr: u64,
+}
+
+impl FutexKey {
+    /// Bucket the key hashes to
+    fn bucket(&self) -> usize {
+        let mixed = (self.addr >> 2) ^ (self.page_table >> 12).rotate_left(32);
+        (mixed.wrapping_mul(0x9E37_79B9_7F4A_7C15) >> (64 - NUM_BUCKETS.trailing_zeros())) as usize
+    }
+}
+
+/// A thread sleeping on a futex
+#[derive(Debug, Clone, Copy)]
+struct Waiter {
+    key: FutexKey,
+    pid: u32,
+    /// Set by the wake that picked it
+    woken: bool,
+}
+
+/// Waiters of every futex hashing to a bucket, in arrival order
+static BUCKETS: [SpinMutex<Vec<Waiter>>; NUM_BUCKETS] = {
+    const EMPTY: SpinMutex<Vec<Waiter>> = SpinMutex::new(Vec::new());
+    [EMPTY; NUM_BUCKETS]
+};
+
+/// Queue futex waiters sleep on (wakes go by PID, not through the queue)
+static SLEEPERS: WaitQueue = WaitQueue::new();
+
+/// Sleep until woken, if the futex word still holds `expected`
+///
+/// # Arguments
+///
+/// * `key` - The futex
+/// * `pid` - The calling thread
+///
+/// # Errors
+///
+/// * ERR_SHOULD_WAIT - The word no longer holds `expected`
+/// * ERR_INVALID_ARGS - The address is misaligned or not mapped
+pub fn wait(key: FutexKey, pid: u32, expected: u32) -> Result<(), RxStatus> {
+    if key.addr & 3 != 0 {
+        return Err(RxStatus::ERR_INVALID_ARGS);
+    }
+    let bucket = &BUCKETS[key.bucket()];
+
+    {
+        let mut waiters = bucket.lock();
+        waiters.try_reserve(1).map_err(|_| RxStatus::ERR_NO_MEMORY)?;
+        waiters.push(Waiter { key, pid, woken: false });
+    }
+    // The listing must be visible before the word is read
+    fence(Ordering::SeqCst);
+
+    let mut word = [0u8; 4];
+    let current = usercopy::copy_from_user(&mut word, key.addr).map(|_| u32::from_ne_bytes(word));
+    if current != Ok(expected) {
+        unlist(bucket, pid);
+        return current.and(Err(RxStatus::ERR_SHOULD_WAIT));
+    }
+
+    while !is_woken(bucket, pid) {
+        round_robin::wait_on(&SLEEPERS, || is_woken(bucket, pid));
+    }
+    unlist(bucket, pid);
+    Ok(())
+}
+
+/// Wake up to `count` threads sleeping on a futex, oldest first
+///
+/// # Returns
+///
+/// The number of threads woken
+pub fn wake(key: FutexKey, count: usize) -> usize {
+    let mut waiters = BUCKETS[key.bucket()].lock();
+    pick_waiters(&mut waiters, key, count, &RUN_QUEUES)
+}
+
+/// Whether a wake has picked the thread
+fn is_woken(bucket: &SpinMutex<Vec<Waiter>>, pid: u32) -> bool {
+    bucket.lock().iter().any(|w| w.pid == pid && w.woken)
+}
+
+/// Take the thread's entry off a bucket
+fn unlist(bucket: &SpinMutex<Vec<Waiter>>, pid: u32) {
+    let mut waiters = bucket.lock();
+    if let Some(index) = waiters.iter().position(|w| w.pid == pid) {
+        waiters.remove(index);
+    }
+}
+
+/// Mark up to `count` waiters of `key` woken and make them runnable
+///
+/// Waiters that have exited are dropped from the list on the way.
+fn pick_waiters(
+    waiters: &mut Vec<Waiter>,
+    key: FutexKey,
+    count: usize,
+    run_queues: &RunQueues,
+) -> usize {
+    let mut woken = 0;
+    waiters.retain_mut(|waiter| {
+        if waiter.key != key || waiter.woken || woken == count {
+            return true;
+        }
+        if !run_queues.state(waiter.pid).is_alive() {
+            return false;
+        }
+
+        waiter.woken = true;
+        woken += 1;
+        SLEEPERS.remove(waiter.pid as WaiterId);
+        run_queues.wake(waiter.pid);
+        true
+    });
+    woken
+}
+
+/// ============================================================================
+/// Tests
+/// ============================================================================
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use crate::process::table::{ProcessState, SavedState};
+    use crate::sched::runqueue::Task;
+
+    fn key(addr: u64) -> FutexKey {
+        FutexKey { page_table: 0x1000, addr }
+    }
+
+    /// Run queues of their own (tests run in parallel) with blocked tasks
+    fn queues_with(count: u32) -> &'static RunQueues {
+        let queues: &'static RunQueues = alloc::boxed::Box::leak(alloc::boxed::Box::new(RunQueues::new()));
+        for pid in 1..=count {
+            queues.insert(pid, Task::new(0x1000, 0, 0x2000, SavedState::new()));
+            queues.set_state(pid, ProcessState::Blocked);
+        }
+        queues
+    }
+
+    fn waiter(addr: u64, pid: u32) -> Waiter {
+        Waiter { key: key(addr), pid, woken: false }
+    }
+
+    #[test]
+    fn test_bucket_spread() {
+        // Neighbouring words of one page use different buckets
+        let mut used = [false; NUM_BUCKETS];
+        for i in 0..16 {
+            used[key(0x4000 + i * 4).bucket()] = true;
+        }
+        assert!(used.iter().filter(|&&u| u).count() > 8);
+        // The same address in another address space is another futex
+        assert_ne!(key(0x4000), FutexKey { page_table: 0x2000, addr: 0x4000 });
+    }
+
+    #[test]
+    fn test_wake_in_order() {
+        let queues = queues_with(4);
+        let mut waiters = alloc::vec![waiter(0x10, 1), waiter(0x20, 2), waiter(0x10, 3), waiter(0x10, 4)];
+
+        assert_eq!(pick_waiters(&mut waiters, key(0x10), 2, queues), 2);
+        let woken: Vec<u32> = waiters.iter().filter(|w| w.woken).map(|w| w.pid).collect();
+        assert_eq!(woken, [1, 3]);
+        assert_eq!(queues.state(1), ProcessState::Ready);
+        assert_eq!(queues.state(2), ProcessState::Blocked);
+        assert_eq!(queues.state(4), ProcessState::Blocked);
+
+        // Already woken waiters are not counted again
+        assert_eq!(pick_waiters(&mut waiters, key(0x10), usize::MAX, queues), 1);
+        assert_eq!(queues.state(4), ProcessState::Ready);
+        assert_eq!(pick_waiters(&mut waiters, key(0x30), 1, queues), 0);
+    }
+
+    #[test]
+    fn test_exited_waiters_dropped() {
+        let queues = queues_with(2);
+        queues.exit(1);
+        let mut waiters = alloc::vec![waiter(0x10, 1), waiter(0x10, 2), waiter(0x10, 9)];
+
+        assert_eq!(pick_waiters(&mut waiters, key(0x10), 1, queues), 1);
+        assert_eq!(waiters.len(), 2);
+        assert!(waiters[0].pid == 2 && waiters[0].woken);
+    }
+}
@@ -15,6 +15,7 @@
 //! - **SpinMutex**: Spin-based mutual exclusion lock for short critical sections
 //! - **Event**: Single-signal synchronization primitive
 //! - **WaitQueue**: Queue for threads waiting on a condition
+//! - **Futex**: Wait/wake on a user memory word, for userspace locks
 //!
 //! # Design
 //!
@@ -24,6 +25,7 @@
 pub mod spinlock;
 pub mod event;
 pub mod wait_queue;
+pub mod futex;
 
 // Re-exports
 pub use spinlock::{SpinMutex, SpinMutexGuard, SpinLock, SpinLockGuard};
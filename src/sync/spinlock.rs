@@ -13,6 +13,8 @@ use core::sync::atomic::{AtomicBool, Ordering};
 use core::cell::UnsafeCell;
 use core::ops::{Deref, DerefMut};
 
+use crate::arch::amd64::registers;
+
 /// A simple spinlock
 pub struct SpinMutex<T> {
     locked: AtomicBool,
@@ -34,12 +36,26 @@ impl<T> SpinMutex<T> {
     /// Acquire the lock, spinning until it becomes available
     pub fn lock(&self) -> SpinMutexGuard<'_, T> {
         while self.locked.compare_exchange(false, true, Ordering::Acquire, Ordering::Relaxed).is_err() {
+            // The holder may be waiting for this CPU to flush its TLB
+            crate::arch::amd64::tlb::poll_shootdown();
             // Spin with pause to reduce bus contention
             core::hint::spin_loop();
         }
         SpinMutexGuard { mutex: self }
     }
 
+    /// Acquire the lock with interrupts disabled on this CPU
+    ///
+    /// For data whose holder must not be interrupted (and so must not be
+    /// preempted) while it holds the lock. Interrupts are restored to
+    /// their previous state when the guard is dropped, after the unlock.
+    pub fn lock_irqsave(&self) -> SpinMutexIrqGuard<'_, T> {
+        let ints_were_enabled = !registers::arch_ints_disabled();
+        unsafe { registers::x86_cli() };
+        core::mem::forget(self.lock());
+        SpinMutexIrqGuard { mutex: self, ints_were_enabled }
+    }
+
     /// Try to acquire the lock without spinning
     pub fn try_lock(&self) -> Option<SpinMutexGuard<'_, T>> {
         if self.locked.compare_exchange(false, true, Ordering::Acquire, Ordering::Relaxed).is_ok() {
@@ -63,6 +79,21 @@ impl<T> SpinMutex<T> {
     pub fn is_locked(&self) -> bool {
         self.locked.load(Ordering::Relaxed)
     }
+
+    /// Release the lock without a guard
+    ///
+    /// For lock handoff across a context switch: the context that resumes
+    /// after the switch releases a lock the suspended one took, when it
+    /// has no guard of its own (a task running for the first time).
+    ///
+    /// # Safety
+    ///
+    /// The lock must be held, and its owner must never use its guard
+    /// (it must have been forgotten or belong to a context that is
+    /// switched away).
+    pub unsafe fn force_unlock(&self) {
+        self.locked.store(false, Ordering::Release);
+    }
 }
 
 /// RAII guard for a SpinMutex
@@ -89,6 +120,34 @@ impl<'a, T> DerefMut for SpinMutexGuard<'a, T> {
     }
 }
 
+/// RAII guard for a SpinMutex taken with interrupts disabled
+pub struct SpinMutexIrqGuard<'a, T> {
+    mutex: &'a SpinMutex<T>,
+    ints_were_enabled: bool,
+}
+
+impl<'a, T> Drop for SpinMutexIrqGuard<'a, T> {
+    fn drop(&mut self) {
+        self.mutex.locked.store(false, Ordering::Release);
+        if self.ints_were_enabled {
+            unsafe { registers::x86_sti() };
+        }
+    }
+}
+
+impl<'a, T> Deref for SpinMutexIrqGuard<'a, T> {
+    type Target = T;
+    fn deref(&self) -> &T {
+        unsafe { &*self.mutex.data.get() }
+    }
+}
+
+impl<'a, T> DerefMut for SpinMutexIrqGuard<'a, T> {
+    fn deref_mut(&mut self) -> &mut T {
+        unsafe { &mut *self.mutex.data.get() }
+    }
+}
+
 /// Type alias for SpinMutex as SpinLock for compatibility
 pub type SpinLock<T> = SpinMutex<T>;
 
@@ -139,4 +198,14 @@ mod tests {
 
         assert!(!mutex.is_locked());
     }
+
+    #[test]
+    fn test_spinlock_force_unlock() {
+        let mutex = SpinMutex::new(42);
+        core::mem::forget(mutex.lock());
+        assert!(mutex.is_locked());
+
+        unsafe { mutex.force_unlock(); }
+        assert!(mutex.try_lock().is_some());
+    }
 }
@@ -16,6 +16,10 @@
 //! - **Fair ordering**: FIFO within same priority level
 //! - **Multiple waiters**: Can handle many threads waiting simultaneously
 //!
+//! The queue only records waiters. Processes sleep on one through
+//! `sched::round_robin::wait_on`, and are woken by
+//! `sched::round_robin::wake_waiter`.
+//!
 //! # Usage
 //!
 //! ```rust
@@ -127,7 +131,7 @@ impl WaitQueueInner {
 
         // Find insertion point (higher priority first)
         let mut insert_pos = self.tail;
-        let mut current = self.tail;
+        let mut current = self.head;
 
         for _ in 0..self.size {
             if let Some(existing) = self.entries[current] {
@@ -167,6 +171,34 @@ impl WaitQueueInner {
         entry
     }
 
+    /// Remove the entry of a waiter, keeping the others in order
+    fn remove(&mut self, waiter_id: WaiterId) -> bool {
+        let mut pos = self.head;
+        for index in 0..self.size {
+            if self.entries[pos].map_or(false, |e| e.waiter_id == waiter_id) {
+                // Close the gap towards the tail
+                for _ in index + 1..self.size {
+                    let next = (pos + 1) % MAX_QUEUE_DEPTH;
+                    self.entries[pos] = self.entries[next];
+                    pos = next;
+                }
+                self.entries[pos] = None;
+                self.tail = pos;
+                self.size -= 1;
+                return true;
+            }
+            pos = (pos + 1) % MAX_QUEUE_DEPTH;
+        }
+        false
+    }
+
+    /// Check whether a waiter has an entry
+    fn contains(&self, waiter_id: WaiterId) -> bool {
+        (0..self.size)
+            .map(|index| (self.head + index) % MAX_QUEUE_DEPTH)
+            .any(|pos| self.entries[pos].map_or(false, |e| e.waiter_id == waiter_id))
+    }
+
     /// Peek at the front entry
     fn peek_front(&self) -> Option<&WaitQueueEntry> {
         if self.size == 0 {
@@ -294,6 +326,26 @@ impl WaitQueue {
         count
     }
 
+    /// Take a waiter off the queue without waking it
+    ///
+    /// Used by a waiter that gives up (its condition became true, or it
+    /// timed out). Returns false if it was not queued.
+    pub fn remove(&self, waiter_id: WaiterId) -> bool {
+        self.validate();
+
+        let removed = self.queue.lock().remove(waiter_id);
+        if removed {
+            self.count.fetch_sub(1, Ordering::Release);
+        }
+        removed
+    }
+
+    /// Check whether a waiter is queued (not yet woken or removed)
+    pub fn contains(&self, waiter_id: WaiterId) -> bool {
+        self.validate();
+        self.queue.lock().contains(waiter_id)
+    }
+
     /// Get the number of waiters
     pub fn count(&self) -> usize {
         self.count.load(Ordering::Relaxed)
@@ -361,6 +413,24 @@ mod tests {
         assert_eq!(wq.wake_one(), None);    // empty
     }
 
+    #[test]
+    fn test_wait_queue_remove() {
+        let wq = WaitQueue::new();
+
+        wq.block(1, 10, u64::MAX);
+        wq.block(2, 10, u64::MAX);
+        wq.block(3, 10, u64::MAX);
+
+        assert!(wq.remove(2));
+        assert!(!wq.remove(2));
+        assert!(!wq.contains(2));
+        assert!(wq.contains(3));
+        assert_eq!(wq.len(), 2);
+        assert_eq!(wq.wake_one(), Some(1));
+        assert_eq!(wq.wake_one(), Some(3));
+        assert_eq!(wq.wake_one(), None);
+    }
+
     #[test]
     fn test_wait_queue_wake_all() {
         let wq = WaitQueue::new();
@@ -10,11 +10,20 @@
 //!
 //! # Design
 //!
-//! - File descriptors (fd) are small integers (0-255)
+//! - File descriptors (fd) are small integers, indexing a table of up to
+//!   [`MAX_FDS`] slots
 //! - fd 0: stdin (keyboard input, future)
 //! - fd 1: stdout (kernel debug console, port 0xE9)
 //! - fd 2: stderr (same as stdout for now)
-//! - fd 3+: files, pipes, etc. (Phase 5C)
+//! - fd 3+: files, channel endpoints, pipes, etc. (Phase 5C)
+//!
+//! - Numbers carry a slot generation, so a closed fd cannot be mistaken
+//!   for whatever reuses its slot (see [`FileDescriptorTable`])
+//!
+//! Files are either read-only ramdisk files (`File`) or writable tmpfs
+//! files under `/tmp` (`TmpFile`).
+
+use alloc::vec::Vec;
 
 /// File descriptor kinds
 #[derive(Debug, Clone, Copy, PartialEq)]
@@ -36,6 +45,32 @@ pub enum FdKind {
         offset: u64,
     },
 
+    /// Writable tmpfs file (fd 3+, paths under /tmp)
+    TmpFile {
+        /// Inode number (see `fs::tmpfs`)
+        inode: u32,
+        /// Current file offset
+        offset: u64,
+    },
+
+    /// Channel endpoint (SYS_CHANNEL_CREATE)
+    Channel {
+        /// Endpoint's channel ID
+        channel_id: u64,
+    },
+
+    /// Port (SYS_PORT_CREATE)
+    Port {
+        /// Port ID
+        port_id: u64,
+    },
+
+    /// Timer (SYS_TIMER_CREATE)
+    Timer {
+        /// Timer ID
+        timer_id: u64,
+    },
+
     /// Pipe descriptor (future)
     Pipe {
         /// True if this is the read end
@@ -86,102 +121,235 @@ impl FileDescriptor {
     }
 }
 
+/// Descriptor number as seen by userspace
+///
+/// The low [`FD_INDEX_BITS`] bits index the table; the bits above hold
+/// the generation of the slot when the descriptor was allocated.
+pub type Fd = u32;
+
+/// Bits of a descriptor that index the table
+pub const FD_INDEX_BITS: u32 = 16;
+
+/// Most slots a table can have
+pub const MAX_FDS: usize = 1 << FD_INDEX_BITS;
+
+/// Generations a slot goes through before its numbers repeat (keeps
+/// descriptors positive as `i32`)
+const GENERATIONS: u32 = 1 << (31 - FD_INDEX_BITS);
+
+/// Most descriptors one batch call takes
+pub const MAX_FD_BATCH: usize = 64;
+
+/// A slot of the table
+#[derive(Debug, Clone)]
+struct Slot {
+    /// Bumped each time the slot is freed
+    generation: u32,
+    /// The descriptor, or the next free slot
+    entry: SlotEntry,
+}
+
+/// What a slot holds
+#[derive(Debug, Clone)]
+enum SlotEntry {
+    /// An open descriptor
+    Used(FileDescriptor),
+    /// Nothing; `next` is the next slot on the free list
+    Free { next: Option<u32> },
+}
+
 /// Per-process file descriptor table
 ///
-/// Manages file descriptors for a single process.
-/// FD 0, 1, 2 are pre-allocated as stdin, stdout, stderr.
+/// Descriptors live in a dense slot array. Lookup is an index and a
+/// generation compare, and closed slots are chained on a free list that
+/// allocation pops, so both are O(1) however many descriptors are open.
+/// A slot's generation changes whenever it is freed, so a closed
+/// descriptor's number stays invalid after its slot is reused (until the
+/// generation wraps, after [`GENERATIONS`] reuses of that slot).
+///
+/// FD 0, 1, 2 are pre-allocated as stdin, stdout, stderr, at generation
+/// 0; a descriptor is a small integer until its slot is first reused.
 pub struct FileDescriptorTable {
-    /// File descriptors (indexed by fd number)
-    fds: [Option<FileDescriptor>; 256],
+    /// Slots, indexed by the low bits of the descriptor
+    slots: Vec<Slot>,
 
-    /// Next fd to allocate (starts at 3, after stdin/stdout/stderr)
-    next_fd: u8,
+    /// Most recently freed slot
+    free_head: Option<u32>,
+
+    /// Slots on the free list
+    free_count: usize,
 }
 
 impl FileDescriptorTable {
-    /// Create a new file descriptor table with stdin/stdout/stderr pre-allocated
+    /// Create an empty file descriptor table (see [`init`](Self::init))
     pub const fn new() -> Self {
-        const NONE: Option<FileDescriptor> = None;
-
-        // Initialize array with None values
-        let mut fds = [NONE; 256];
-
-        // Pre-allocate stdin, stdout, stderr (will be set up in init below)
-        // For now, we use const fn, so we can't actually set them here
-
         Self {
-            fds,
-            next_fd: 3,
+            slots: Vec::new(),
+            free_head: None,
+            free_count: 0,
         }
     }
 
     /// Initialize the standard file descriptors (0, 1, 2)
     ///
     /// This must be called after creating the table to set up stdin/stdout/stderr.
-    /// Note: This can't be done in `new()` because it requires mutable access.
     pub fn init(&mut self) {
-        self.fds[0] = Some(FileDescriptor::stdin());
-        self.fds[1] = Some(FileDescriptor::stdout());
-        self.fds[2] = Some(FileDescriptor::stderr());
+        for desc in [FileDescriptor::stdin(), FileDescriptor::stdout(), FileDescriptor::stderr()] {
+            self.slots.push(Slot { generation: 0, entry: SlotEntry::Used(desc) });
+        }
     }
 
-    /// Allocate a new file descriptor
-    ///
-    /// Returns the fd number, or None if the table is full.
-    pub fn alloc(&mut self, kind: FdKind, flags: u32) -> Option<u8> {
-        // Check if we've wrapped around (table is full)
-        if self.next_fd == 0 {
-            return None;
-        }
+    /// Descriptor number of a slot at its current generation
+    fn fd_of(&self, index: u32) -> Fd {
+        self.slots[index as usize].generation << FD_INDEX_BITS | index
+    }
 
-        let fd = self.next_fd;
-        self.fds[fd as usize] = Some(FileDescriptor::new(kind, flags));
+    /// Slot index of a live descriptor
+    fn index_of(&self, fd: Fd) -> Option<usize> {
+        let index = (fd & (MAX_FDS as u32 - 1)) as usize;
+        let slot = self.slots.get(index)?;
+        match slot.entry {
+            SlotEntry::Used(_) if slot.generation == fd >> FD_INDEX_BITS => Some(index),
+            _ => None,
+        }
+    }
 
-        // Increment and check for wrap
-        self.next_fd = self.next_fd.wrapping_add(1);
-        if self.next_fd == 0 {
-            // Table is full after this allocation
+    /// Make sure `count` descriptors can be allocated without failing
+    ///
+    /// # Errors
+    ///
+    /// Fails if the table would pass [`MAX_FDS`] slots or memory is short.
+    pub fn reserve(&mut self, count: usize) -> Result<(), &'static str> {
+        let extra = count.saturating_sub(self.free_count);
+        if self.slots.len() + extra > MAX_FDS {
+            return Err("descriptor table full");
         }
+        self.slots.try_reserve(extra).map_err(|_| "out of memory")
+    }
+
+    /// Allocate a new file descriptor
+    ///
+    /// Returns the fd number, or None if the table is full.
+    pub fn alloc(&mut self, kind: FdKind, flags: u32) -> Option<Fd> {
+        self.reserve(1).ok()?;
+        Some(self.insert(FileDescriptor::new(kind, flags)))
+    }
 
-        Some(fd)
+    /// Place a descriptor in a free slot (room must be reserved)
+    fn insert(&mut self, desc: FileDescriptor) -> Fd {
+        let index = match self.free_head {
+            Some(index) => {
+                let slot = &mut self.slots[index as usize];
+                self.free_head = match slot.entry {
+                    SlotEntry::Free { next } => next,
+                    SlotEntry::Used(_) => unreachable!("used slot on the free list"),
+                };
+                slot.entry = SlotEntry::Used(desc);
+                self.free_count -= 1;
+                index
+            }
+            None => {
+                self.slots.push(Slot { generation: 0, entry: SlotEntry::Used(desc) });
+                (self.slots.len() - 1) as u32
+            }
+        };
+        self.fd_of(index)
     }
 
     /// Get a file descriptor by number
     ///
-    /// Returns None if the fd is not allocated.
-    pub fn get(&self, fd: u8) -> Option<&FileDescriptor> {
-        self.fds.get(fd as usize)?.as_ref()
+    /// Returns None if the fd is not allocated (or was closed).
+    pub fn get(&self, fd: Fd) -> Option<&FileDescriptor> {
+        match &self.slots[self.index_of(fd)?].entry {
+            SlotEntry::Used(desc) => Some(desc),
+            SlotEntry::Free { .. } => None,
+        }
     }
 
     /// Get a mutable file descriptor by number
     ///
-    /// Returns None if the fd is not allocated.
-    pub fn get_mut(&mut self, fd: u8) -> Option<&mut FileDescriptor> {
-        self.fds.get_mut(fd as usize)?.as_mut()
+    /// Returns None if the fd is not allocated (or was closed).
+    pub fn get_mut(&mut self, fd: Fd) -> Option<&mut FileDescriptor> {
+        let index = self.index_of(fd)?;
+        match &mut self.slots[index].entry {
+            SlotEntry::Used(desc) => Some(desc),
+            SlotEntry::Free { .. } => None,
+        }
     }
 
     /// Close a file descriptor
     ///
     /// Returns the closed descriptor, or None if the fd was not allocated.
-    pub fn close(&mut self, fd: u8) -> Option<FileDescriptor> {
-        // u8 can't be >= 256, so we skip that check
+    pub fn close(&mut self, fd: Fd) -> Option<FileDescriptor> {
+        let index = self.index_of(fd)?;
 
         // Don't allow closing stdin/stdout/stderr
-        if fd < 3 {
+        if index < 3 {
             return None;
         }
 
-        self.fds.get_mut(fd as usize)?.take()
+        let slot = &mut self.slots[index];
+        slot.generation = (slot.generation + 1) % GENERATIONS;
+        let entry = core::mem::replace(&mut slot.entry, SlotEntry::Free { next: self.free_head });
+        self.free_head = Some(index as u32);
+        self.free_count += 1;
+        match entry {
+            SlotEntry::Used(desc) => Some(desc),
+            SlotEntry::Free { .. } => None,
+        }
+    }
+
+    /// Copy out a batch of descriptors, to duplicate or move them
+    ///
+    /// # Errors
+    ///
+    /// Fails if any fd is not allocated, or (with `movable`) is one of
+    /// stdin/stdout/stderr or appears twice.
+    pub fn collect(&self, fds: &[Fd], movable: bool) -> Result<Vec<FileDescriptor>, &'static str> {
+        let mut descs = Vec::new();
+        descs.try_reserve(fds.len()).map_err(|_| "out of memory")?;
+        for (i, &fd) in fds.iter().enumerate() {
+            let index = self.index_of(fd).ok_or("bad descriptor")?;
+            if movable && (index < 3 || fds[..i].contains(&fd)) {
+                return Err("descriptor cannot be moved");
+            }
+            descs.push(self.get(fd).cloned().ok_or("bad descriptor")?);
+        }
+        Ok(descs)
+    }
+
+    /// Allocate a descriptor for each of `descs`, all or none
+    ///
+    /// The new numbers are written to `out` (as long as `descs`).
+    pub fn insert_all(&mut self, descs: &[FileDescriptor], out: &mut [Fd]) -> Result<(), &'static str> {
+        self.reserve(descs.len())?;
+        for (desc, fd) in descs.iter().zip(out.iter_mut()) {
+            *fd = self.insert(desc.clone());
+        }
+        Ok(())
     }
 
     /// Get the number of active file descriptors
     pub fn count(&self) -> usize {
-        self.fds.iter().filter(|f| f.is_some()).count()
+        self.slots.len() - self.free_count
+    }
+
+    /// Take every open descriptor, stdin/stdout/stderr included
+    ///
+    /// For a process that has exited: the table is left empty, as from
+    /// [`new`](Self::new), and the caller releases the descriptors' objects.
+    pub fn drain(&mut self) -> impl Iterator<Item = FileDescriptor> {
+        self.free_head = None;
+        self.free_count = 0;
+        core::mem::take(&mut self.slots).into_iter().filter_map(|slot| match slot.entry {
+            SlotEntry::Used(desc) => Some(desc),
+            SlotEntry::Free { .. } => None,
+        })
     }
 }
 
 // ============================================================================
-// Open Flags (for future use with sys_open)
+// Open Flags
 // ============================================================================
 
 /// Open flags (for sys_open)
@@ -195,6 +363,9 @@ pub mod flags {
     /// Read-write
     pub const O_RDWR: u32 = 2;
 
+    /// Mask of the access mode (O_RDONLY, O_WRONLY or O_RDWR)
+    pub const O_ACCMODE: u32 = 3;
+
     /// Create file if it doesn't exist
     pub const O_CREAT: u32 = 1 << 3;
 
@@ -206,6 +377,16 @@ pub mod flags {
 
     /// Append mode
     pub const O_APPEND: u32 = 1 << 6;
+
+    /// Whether the flags allow reading
+    pub const fn readable(flags: u32) -> bool {
+        flags & O_ACCMODE != O_WRONLY
+    }
+
+    /// Whether the flags allow writing
+    pub const fn writable(flags: u32) -> bool {
+        flags & O_ACCMODE != O_RDONLY
+    }
 }
 
 // ============================================================================
@@ -265,6 +446,96 @@ mod tests {
         assert!(table.get(0).is_some());
     }
 
+    #[test]
+    fn test_fd_drain() {
+        let mut table = FileDescriptorTable::new();
+        table.init();
+
+        let port = table.alloc(FdKind::Port { port_id: 1 }, 0).unwrap();
+        let timer = table.alloc(FdKind::Timer { timer_id: 2 }, 0).unwrap();
+        table.close(port).unwrap();
+
+        // The open descriptors come out, the closed one does not
+        let drained: Vec<FileDescriptor> = table.drain().collect();
+        assert_eq!(drained.len(), 4);
+        assert!(matches!(drained[3].kind, FdKind::Timer { timer_id: 2 }));
+        assert_eq!(table.count(), 0);
+        assert!(table.get(0).is_none());
+        assert!(table.get(timer).is_none());
+    }
+
+    #[test]
+    fn test_fd_stale_generation() {
+        let mut table = FileDescriptorTable::new();
+        table.init();
+
+        let fd = table.alloc(FdKind::Port { port_id: 1 }, 0).unwrap();
+        table.close(fd).unwrap();
+
+        // The slot is reused under a new number; the old one stays dead
+        let reused = table.alloc(FdKind::Port { port_id: 2 }, 0).unwrap();
+        assert_eq!(reused & (MAX_FDS as u32 - 1), fd);
+        assert_ne!(reused, fd);
+        assert!(table.get(fd).is_none());
+        assert!(table.close(fd).is_none());
+        assert!(matches!(table.get(reused).unwrap().kind, FdKind::Port { port_id: 2 }));
+
+        // Unused indices and generations are rejected
+        assert!(table.get(4).is_none());
+        assert!(table.get(1 << FD_INDEX_BITS | 1).is_none());
+    }
+
+    #[test]
+    fn test_fd_many() {
+        let mut table = FileDescriptorTable::new();
+        table.init();
+
+        let fds: Vec<Fd> = (0..4000)
+            .map(|i| table.alloc(FdKind::Timer { timer_id: i }, 0).unwrap())
+            .collect();
+        assert_eq!(table.count(), 4003);
+        for (i, &fd) in fds.iter().enumerate().step_by(2) {
+            assert!(matches!(table.close(fd).unwrap().kind, FdKind::Timer { timer_id } if timer_id == i as u64));
+        }
+        assert_eq!(table.count(), 2003);
+
+        // Freed slots are reused before the table grows
+        for _ in 0..2000 {
+            table.alloc(FdKind::Stdout, 1).unwrap();
+        }
+        assert_eq!(table.slots.len(), 4003);
+    }
+
+    #[test]
+    fn test_fd_duplicate_batch() {
+        let mut table = FileDescriptorTable::new();
+        table.init();
+
+        let fd = table.alloc(FdKind::File { inode: 7, offset: 12 }, flags::O_RDONLY).unwrap();
+        let mut out = [0; 2];
+        let descs = table.collect(&[fd, 1], false).unwrap();
+        table.insert_all(&descs, &mut out).unwrap();
+        assert!(matches!(table.get(out[0]).unwrap().kind, FdKind::File { inode: 7, offset: 12 }));
+        assert!(matches!(table.get(out[1]).unwrap().kind, FdKind::Stdout));
+        assert_eq!(table.count(), 6);
+
+        // One bad descriptor fails the whole batch
+        assert!(table.collect(&[fd, 99], false).is_err());
+    }
+
+    #[test]
+    fn test_fd_collect_movable() {
+        let mut table = FileDescriptorTable::new();
+        table.init();
+
+        let fd = table.alloc(FdKind::Channel { channel_id: 3 }, 0).unwrap();
+        assert_eq!(table.collect(&[fd], true).unwrap().len(), 1);
+        // stdin/stdout/stderr stay put, and a descriptor moves once
+        assert!(table.collect(&[2], true).is_err());
+        assert!(table.collect(&[fd, fd], true).is_err());
+        assert_eq!(table.collect(&[fd, fd], false).unwrap().len(), 2);
+    }
+
     #[test]
     fn test_fd_kind() {
         let stdin = FileDescriptor::stdin();
@@ -276,4 +547,14 @@ mod tests {
         let stderr = FileDescriptor::stderr();
         assert!(matches!(stderr.kind, FdKind::Stderr));
     }
+
+    #[test]
+    fn test_access_mode() {
+        assert!(flags::readable(flags::O_RDONLY));
+        assert!(!flags::writable(flags::O_RDONLY));
+        assert!(!flags::readable(flags::O_WRONLY | flags::O_CREAT));
+        assert!(flags::writable(flags::O_WRONLY | flags::O_CREAT));
+        assert!(flags::readable(flags::O_RDWR | flags::O_APPEND));
+        assert!(flags::writable(flags::O_RDWR | flags::O_APPEND));
+    }
 }
@@ -32,8 +32,13 @@
 //! ```
 
 pub mod fd;
+pub mod ring;
+pub mod stats;
+pub mod usercopy;
 
 use crate::arch::amd64::mm::RxStatus;
+use fd::Fd;
+use usercopy::USER_ADDR_LIMIT;
 
 // ============================================================================
 // Common Syscall Types
@@ -284,8 +289,21 @@ pub const fn ok_to_ret_isize(val: isize) -> SyscallRet {
 /// # Calling Convention
 ///
 /// This function uses the C ABI and is callable from assembly.
+///
+/// Every call is timed and counted in `stats` (per CPU, per syscall).
 #[no_mangle]
 pub extern "C" fn syscall_dispatch(args: SyscallArgs) -> SyscallRet {
+    use crate::arch::amd64::tsc;
+
+    let num = args.number;
+    let start = tsc::tsc_ticks();
+    let ret = dispatch(args);
+    stats::record(num, tsc::tsc_ticks().wrapping_sub(start));
+    ret
+}
+
+/// Run the handler of a syscall
+fn dispatch(args: SyscallArgs) -> SyscallRet {
     let num = args.number;
 
     // Dispatch to handler based on syscall number
@@ -320,6 +338,12 @@ pub extern "C" fn syscall_dispatch(args: SyscallArgs) -> SyscallRet {
         0x25 => sys_object_signal(args),
         0x26 => sys_object_wait_one(args),
         0x27 => sys_object_wait_many(args),
+        0x28 => sys_port_create(args),
+        0x29 => sys_port_wait_async(args),
+        0x2A => sys_port_wait(args),
+        0x2B => sys_port_queue(args),
+        0x2C => sys_futex_wait(args),
+        0x2D => sys_futex_wake(args),
 
         // Jobs & Handles (0x30-0x3F)
         0x30 => sys_job_create(args),
@@ -334,6 +358,7 @@ pub extern "C" fn syscall_dispatch(args: SyscallArgs) -> SyscallRet {
 
         // Debug (0x50-0x5F)
         0x50 => sys_debug_write(args),
+        0x51 => sys_stats(args),
 
         // I/O (0x60-0x6F) - Phase 5A
         0x60 => sys_write(args),
@@ -341,11 +366,18 @@ pub extern "C" fn syscall_dispatch(args: SyscallArgs) -> SyscallRet {
         0x62 => sys_open(args),
         0x63 => sys_close(args),
         0x64 => sys_lseek(args),
+        0x65 => sys_writev(args),
+        0x66 => sys_readv(args),
+        0x67 => sys_ring_setup(args),
+        0x68 => sys_ring_enter(args),
+        0x69 => sys_map_file(args),
 
         // Process Info (0x70-0x7F) - Phase 5A
         0x70 => sys_getpid(args),
         0x71 => sys_getppid(args),
         0x72 => sys_yield(args),
+        0x73 => sys_set_priority(args),
+        0x74 => sys_set_affinity(args),
 
         _ => {
             // Unknown syscall
@@ -354,6 +386,9 @@ pub extern "C" fn syscall_dispatch(args: SyscallArgs) -> SyscallRet {
     }
 }
 
+/// Buddy order of a process kernel stack (4 pages)
+const KERNEL_STACK_ORDER: u8 = 2;
+
 /// ============================================================================
 /// Syscall Handler Implementations (Stubs)
 /// ============================================================================
@@ -371,8 +406,86 @@ macro_rules! syscall_stub {
 
 // Process & Thread syscalls
 syscall_stub!(sys_process_start);
-syscall_stub!(sys_thread_start);
-syscall_stub!(sys_thread_exit);
+
+/// Thread start syscall
+///
+/// Starts another thread in the current process. It shares the address
+/// space, file descriptors and mappings, and enters user mode at `entry`
+/// with `arg` as its first argument. The caller supplies the stack; the
+/// entry function must not return (end the thread with SYS_THREAD_EXIT).
+///
+/// Arguments:
+///   arg0: entry point (user address)
+///   arg1: user stack top (RSP on entry)
+///   arg2: argument passed in RDI
+///
+/// Returns:
+///   Positive: thread ID (a PID of its own)
+///   Negative: error code
+fn sys_thread_start(args: SyscallArgs) -> SyscallRet {
+    use crate::mm::pmm;
+    use crate::process::table::{Process, PROCESS_TABLE};
+    use crate::sched::runqueue::RUN_QUEUES;
+
+    let entry = args.arg(0) as u64;
+    let stack_top = args.arg(1) as u64;
+    let arg = args.arg(2) as u64;
+
+    if entry == 0 || entry >= USER_ADDR_LIMIT || stack_top == 0 || stack_top > USER_ADDR_LIMIT {
+        return err_to_ret(RxStatus::ERR_INVALID_ARGS);
+    }
+
+    let kernel_stack_paddr = match pmm::pmm_alloc_pages(KERNEL_STACK_ORDER, pmm::PMM_ALLOC_FLAG_KERNEL) {
+        Ok(p) => p,
+        Err(_) => return err_to_ret(RxStatus::ERR_NO_MEMORY),
+    };
+    let kernel_stack_top = (pmm::paddr_to_vaddr(kernel_stack_paddr) + (4096 << KERNEL_STACK_ORDER)) as u64;
+
+    let mut table = PROCESS_TABLE.lock();
+    let thread = table.alloc_pid().and_then(|tid| {
+        let current = table.current()?;
+        let current_task = RUN_QUEUES.task(current.pid)?;
+        Some(Process::new_thread(tid, current, &current_task, kernel_stack_top, stack_top, entry, arg))
+    });
+    match thread {
+        Some(thread) => {
+            let tid = thread.pid;
+            table.insert(thread);
+            ok_to_ret(tid as usize)
+        }
+        None => {
+            drop(table);
+            let _ = pmm::pmm_free_pages(kernel_stack_paddr, KERNEL_STACK_ORDER);
+            err_to_ret(RxStatus::ERR_NO_MEMORY)
+        }
+    }
+}
+
+/// Thread exit syscall
+///
+/// Ends the calling thread; the process goes on while it has others. If
+/// `clear_addr` is non-zero, the 32-bit word there is set to 0 and its
+/// futex waiters are woken once the thread no longer runs on its user
+/// stack, so a joining thread may free the stack when it wakes.
+///
+/// Arguments:
+///   arg0: clear_addr (user address of a u32, or 0)
+///
+/// Does not return.
+fn sys_thread_exit(args: SyscallArgs) -> SyscallRet {
+    use crate::sync::futex;
+
+    let clear_addr = args.arg_u64(0);
+    if clear_addr != 0 {
+        if let Ok(key) = futex_key(clear_addr) {
+            if usercopy::copy_to_user(clear_addr, &0u32.to_ne_bytes()).is_ok() {
+                futex::wake(key, usize::MAX);
+            }
+        }
+    }
+
+    crate::sched::round_robin::exit_current()
+}
 
 /// Process create syscall (Phase 5B)
 ///
@@ -394,27 +507,29 @@ fn sys_process_create(args: SyscallArgs) -> SyscallRet {
     use crate::mm::pmm;
     use crate::sync::SpinMutex;
 
-    let elf_ptr = args.arg_u64(0) as *const u8;
+    let elf_ptr = args.arg_u64(0);
     let elf_size = args.arg(1);
 
     // Validate arguments
-    if elf_ptr.is_null() || elf_size == 0 {
+    if elf_ptr == 0 || elf_size == 0 {
         return err_to_ret(RxStatus::ERR_INVALID_ARGS);
     }
 
     // Get parent PID
     let parent_pid = {
         let table = PROCESS_TABLE.lock();
-        table.current_pid().unwrap_or(0)
+        table.current_group().map_or(0, |p| p.pid)
     };
 
-    // Read ELF data from userspace
-    let elf_data = unsafe {
-        core::slice::from_raw_parts(elf_ptr, elf_size)
+    // Copy the ELF data in from userspace (the loader parses it at
+    // leisure, so it must not be user memory)
+    let elf_data = match usercopy::copy_records_from_user::<u8>(elf_ptr, elf_size) {
+        Ok(data) => data,
+        Err(e) => return err_to_ret(e),
     };
 
     // Load the ELF binary
-    let process_image = match load_elf_process(elf_data) {
+    let process_image = match load_elf_process(&elf_data) {
         Ok(img) => img,
         Err(e) => {
             // Debug output for error
@@ -439,36 +554,14 @@ fn sys_process_create(args: SyscallArgs) -> SyscallRet {
         }
     };
 
-    // Allocate a kernel stack (4 pages)
-    let kernel_stack_paddrs = [
-        match pmm::pmm_alloc_kernel_page() {
-            Ok(p) => p,
-            Err(_) => return err_to_ret(RxStatus::ERR_NO_MEMORY),
-        },
-        match pmm::pmm_alloc_kernel_page() {
-            Ok(p) => p,
-            Err(_) => return err_to_ret(RxStatus::ERR_NO_MEMORY),
-        },
-        match pmm::pmm_alloc_kernel_page() {
-            Ok(p) => p,
-            Err(_) => return err_to_ret(RxStatus::ERR_NO_MEMORY),
-        },
-        match pmm::pmm_alloc_kernel_page() {
-            Ok(p) => p,
-            Err(_) => return err_to_ret(RxStatus::ERR_NO_MEMORY),
-        },
-    ];
-
-    // Get the kernel stack virtual addresses
-    let kernel_stack_vaddrs = [
-        pmm::paddr_to_vaddr(kernel_stack_paddrs[0]),
-        pmm::paddr_to_vaddr(kernel_stack_paddrs[1]),
-        pmm::paddr_to_vaddr(kernel_stack_paddrs[2]),
-        pmm::paddr_to_vaddr(kernel_stack_paddrs[3]),
-    ];
+    // Allocate a kernel stack (4 contiguous pages)
+    let kernel_stack_paddr = match pmm::pmm_alloc_pages(KERNEL_STACK_ORDER, pmm::PMM_ALLOC_FLAG_KERNEL) {
+        Ok(p) => p,
+        Err(_) => return err_to_ret(RxStatus::ERR_NO_MEMORY),
+    };
 
     // Stack grows down, so top is at the highest address
-    let kernel_stack_top = (kernel_stack_vaddrs[3] + 4096) as u64;
+    let kernel_stack_top = (pmm::paddr_to_vaddr(kernel_stack_paddr) + (4096 << KERNEL_STACK_ORDER)) as u64;
 
     // Get page table physical address
     let page_table_phys = process_image.address_space.page_table.phys;
@@ -492,7 +585,6 @@ fn sys_process_create(args: SyscallArgs) -> SyscallRet {
         );
 
         table.insert(process);
-        table.set_current(pid);
 
         (pid, process_image.entry, process_image.stack_top)
     };
@@ -558,35 +650,20 @@ fn sys_process_create(args: SyscallArgs) -> SyscallRet {
 /// The path must be a null-terminated string in userspace memory.
 /// This is simpler than sys_process_create because userspace doesn't
 /// need to know the ELF format - just provides the path.
+///
+/// Each program is parsed and loaded once (exec::image_cache); later
+/// spawns share its read-only pages and copy only its writable segments.
 fn sys_spawn(args: SyscallArgs) -> SyscallRet {
-    use crate::exec::load_elf_process;
+    use crate::exec::image_cache;
     use crate::fs::ramdisk;
     use crate::process::table::{Process, PROCESS_TABLE};
     use crate::mm::pmm;
 
-    let path_ptr = args.arg_u64(0) as *const u8;
-
-    // Validate path pointer
-    if path_ptr.is_null() {
-        return err_to_ret(RxStatus::ERR_INVALID_ARGS);
-    }
-
-    // Read null-terminated path string from userspace (max 256 bytes)
-    let mut path_bytes = alloc::vec::Vec::new();
-    unsafe {
-        let mut i = 0;
-        loop {
-            if i >= 256 {
-                return err_to_ret(RxStatus::ERR_INVALID_ARGS); // Path too long
-            }
-            let c = *path_ptr.add(i);
-            if c == 0 {
-                break;
-            }
-            path_bytes.push(c);
-            i += 1;
-        }
-    }
+    // Read null-terminated path string from userspace
+    let path_bytes = match read_user_path(args.arg_u64(0) as *const u8) {
+        Ok(p) => p,
+        Err(e) => return err_to_ret(e),
+    };
 
     // Convert to string
     let path = match core::str::from_utf8(&path_bytes) {
@@ -600,11 +677,15 @@ fn sys_spawn(args: SyscallArgs) -> SyscallRet {
         Err(_) => return err_to_ret(RxStatus::ERR_NOT_FOUND),
     };
 
-    // Look up file in ramdisk
-    let ramdisk_file = match ramdisk.find_file(path) {
-        Some(f) => f,
+    // Look up file in ramdisk (its index keys the program image cache)
+    let inode = match ramdisk.find_index(path) {
+        Some(index) => index as u32,
         None => return err_to_ret(RxStatus::ERR_NOT_FOUND), // ENOENT
     };
+    let ramdisk_file = match ramdisk.file(inode as usize) {
+        Some(f) => f,
+        None => return err_to_ret(RxStatus::ERR_NOT_FOUND),
+    };
 
     // Debug output
     unsafe {
@@ -621,16 +702,15 @@ fn sys_spawn(args: SyscallArgs) -> SyscallRet {
         }
     }
 
-    // Read the ELF data from ramdisk
-    let elf_data_ptr = unsafe {
-        ramdisk.data.as_ptr().add(ramdisk_file.data_offset as usize)
-    };
-    let elf_data = unsafe {
-        core::slice::from_raw_parts(elf_data_ptr, ramdisk_file.size as usize)
+    // The ELF data stays in the ramdisk (or its decompressed pages):
+    // pages are filled from it on demand
+    let elf_data = match ramdisk.file_data(&ramdisk_file) {
+        Ok(data) => data,
+        Err(e) => return err_to_ret(errno_to_status(e)),
     };
 
-    // Load the ELF binary
-    let process_image = match load_elf_process(elf_data) {
+    // Build the process from the cached image (loaded on first spawn)
+    let process_image = match image_cache::load_cached_process(inode, elf_data) {
         Ok(img) => img,
         Err(e) => {
             // Debug output for error
@@ -654,39 +734,17 @@ fn sys_spawn(args: SyscallArgs) -> SyscallRet {
     // Get parent PID
     let parent_pid = {
         let table = PROCESS_TABLE.lock();
-        table.current_pid().unwrap_or(0)
+        table.current_group().map_or(0, |p| p.pid)
     };
 
-    // Allocate a kernel stack (4 pages)
-    let kernel_stack_paddrs = [
-        match pmm::pmm_alloc_kernel_page() {
-            Ok(p) => p,
-            Err(_) => return err_to_ret(RxStatus::ERR_NO_MEMORY),
-        },
-        match pmm::pmm_alloc_kernel_page() {
-            Ok(p) => p,
-            Err(_) => return err_to_ret(RxStatus::ERR_NO_MEMORY),
-        },
-        match pmm::pmm_alloc_kernel_page() {
-            Ok(p) => p,
-            Err(_) => return err_to_ret(RxStatus::ERR_NO_MEMORY),
-        },
-        match pmm::pmm_alloc_kernel_page() {
-            Ok(p) => p,
-            Err(_) => return err_to_ret(RxStatus::ERR_NO_MEMORY),
-        },
-    ];
-
-    // Get the kernel stack virtual addresses
-    let kernel_stack_vaddrs = [
-        pmm::paddr_to_vaddr(kernel_stack_paddrs[0]),
-        pmm::paddr_to_vaddr(kernel_stack_paddrs[1]),
-        pmm::paddr_to_vaddr(kernel_stack_paddrs[2]),
-        pmm::paddr_to_vaddr(kernel_stack_paddrs[3]),
-    ];
+    // Allocate a kernel stack (4 contiguous pages)
+    let kernel_stack_paddr = match pmm::pmm_alloc_pages(KERNEL_STACK_ORDER, pmm::PMM_ALLOC_FLAG_KERNEL) {
+        Ok(p) => p,
+        Err(_) => return err_to_ret(RxStatus::ERR_NO_MEMORY),
+    };
 
     // Stack grows down, so top is at the highest address
-    let kernel_stack_top = (kernel_stack_vaddrs[3] + 4096) as u64;
+    let kernel_stack_top = (pmm::paddr_to_vaddr(kernel_stack_paddr) + (4096 << KERNEL_STACK_ORDER)) as u64;
 
     // Get page table physical address
     let page_table_phys = process_image.address_space.page_table.phys;
@@ -774,9 +832,8 @@ fn sys_spawn(args: SyscallArgs) -> SyscallRet {
 
 /// Process exit syscall
 ///
-/// Terminates the current process. For now, this just halts the CPU.
-/// In a full implementation, this would mark the process as exited
-/// and schedule another process.
+/// Terminates the current process: it and all of its threads become
+/// Zombies and the CPU moves on to the next ready process (or idles).
 fn sys_process_exit(args: SyscallArgs) -> SyscallRet {
     let exit_code = args.arg_i64(0) as i32;
     let _ = exit_code; // TODO: track exit code
@@ -791,10 +848,8 @@ fn sys_process_exit(args: SyscallArgs) -> SyscallRet {
         }
     }
 
-    // Halt forever - process has exited
-    loop {
-        unsafe { core::arch::asm!("hlt") };
-    }
+    // Every thread of the process ends with it
+    crate::sched::round_robin::exit_group()
 }
 
 fn sys_handle_close(args: SyscallArgs) -> SyscallRet {
@@ -814,224 +869,1128 @@ syscall_stub!(sys_vmar_unmap);
 syscall_stub!(sys_vmar_protect);
 
 // IPC & Sync syscalls
-syscall_stub!(sys_channel_create);
-syscall_stub!(sys_channel_write);
-syscall_stub!(sys_channel_read);
-syscall_stub!(sys_event_create);
-syscall_stub!(sys_eventpair_create);
-syscall_stub!(sys_object_signal);
-syscall_stub!(sys_object_wait_one);
-syscall_stub!(sys_object_wait_many);
 
-// Jobs & Handles syscalls
-syscall_stub!(sys_job_create);
-syscall_stub!(sys_handle_duplicate);
-syscall_stub!(sys_handle_transfer);
+/// Look up the channel endpoint behind a file descriptor of the current process
+fn channel_of_fd(fd: Fd) -> Result<u64, RxStatus> {
+    use crate::process::table::with_current_group;
+    use crate::syscall::fd::FdKind;
 
-// Time syscalls
-fn sys_clock_get(args: SyscallArgs) -> SyscallRet {
-    let _clock_id = args.arg_u32(0);
-    // Return current time in nanoseconds (placeholder)
-    // Use the TSC for now
-    use crate::arch::amd64::tsc;
-    let time_ns = tsc::tsc_to_ns(unsafe { tsc::rdtsc() });
-    ok_to_ret_isize(time_ns as isize)
+    match with_current_group(|p| p.fd_table.get(fd).map(|f| f.kind)) {
+        Some(Some(FdKind::Channel { channel_id })) => Ok(channel_id),
+        Some(_) => Err(RxStatus::ERR_INVALID_ARGS), // EBADF or not a channel
+        None => Err(RxStatus::ERR_INVALID_ARGS),
+    }
 }
 
-syscall_stub!(sys_timer_create);
-syscall_stub!(sys_timer_set);
-syscall_stub!(sys_timer_cancel);
-
-// Debug syscalls
-/// Debug write syscall - writes a string to the debug console
-///
-/// Arguments:
-///   arg0: pointer to string (userspace virtual address)
-///   arg1: length of string
+/// Physical pages backing `len` bytes at a page-aligned user address of
+/// the current process, to send them through a channel
 ///
-/// Returns: number of bytes written, or negative error code
-fn sys_debug_write(args: SyscallArgs) -> SyscallRet {
-    use crate::arch::amd64::uspace;
-    let ptr = args.arg_u64(0) as *const u8;
-    let len = args.arg(1);
+/// Each page comes with a reference for the message, and the caller's
+/// mappings of them become copy-on-write (`AddressSpace::share_page`).
+fn user_pages(addr: u64, len: usize) -> Result<alloc::vec::Vec<u64>, RxStatus> {
+    use crate::mm::pmm;
+    use crate::process::address_space::AddressSpace;
+    use crate::process::table::PROCESS_TABLE;
 
-    // For now, just write to port 0xE9 (kernel-mediated)
-    // In the future, this could go to a proper logging system
-    unsafe {
-        for i in 0..len {
-            let c = *(ptr.add(i));
-            // Write to debug console
-            core::arch::asm!("out dx, al",
-                in("dx") 0xE9u16,
-                in("al") c,
-                options(nomem, nostack)
-            );
-        }
+    let end = addr.checked_add(len as u64).ok_or(RxStatus::ERR_INVALID_ARGS)?;
+    if addr & 0xFFF != 0 || end > USER_ADDR_LIMIT {
+        return Err(RxStatus::ERR_INVALID_ARGS);
     }
 
-    ok_to_ret_isize(len as isize)
+    let page_table = {
+        let table = PROCESS_TABLE.lock();
+        table.current_group().ok_or(RxStatus::ERR_INVALID_ARGS)?.page_table
+    };
+    let space = AddressSpace::from_page_table(page_table);
+
+    let mut pages = alloc::vec::Vec::with_capacity((len + 4095) / 4096);
+    let mut page = addr;
+    while page < end {
+        // Demand-paged memory may not be populated yet
+        let shared = match space.translate(page) {
+            Some(_) => space.share_page(page),
+            None => space.fault_in(page, false).ok().and_then(|()| space.share_page(page)),
+        };
+        match shared {
+            Some(paddr) => pages.push(paddr),
+            None => {
+                for &paddr in &pages {
+                    pmm::pmm_page_unref(paddr);
+                }
+                return Err(RxStatus::ERR_INVALID_ARGS);
+            }
+        }
+        page += 4096;
+    }
+    Ok(pages)
 }
 
-// ============================================================================
-// I/O Syscalls (Phase 5A)
-// ============================================================================
-
-/// Write to file descriptor
+/// Create a channel
 ///
 /// Arguments:
-///   arg0: file descriptor (fd)
-///   arg1: pointer to buffer
-///   arg2: length to write
+///   arg0: options (must be 0)
+///   arg1: pointer to two int32 slots receiving the endpoint descriptors
 ///
-/// Returns: number of bytes written, or negative error code
+/// Returns: 0 on success, or negative error code
 ///
-/// File descriptor mapping:
-///   fd 0: stdin (write not allowed)
-///   fd 1: stdout (kernel debug console, port 0xE9)
-///   fd 2: stderr (same as stdout)
-///   fd 3+: reserved for files (Phase 5C)
-fn sys_write(args: SyscallArgs) -> SyscallRet {
-    let fd = args.arg(0) as u8;
-    let ptr = args.arg_u64(1) as *const u8;
-    let len = args.arg(2);
+/// The endpoints are file descriptors of the calling process; close them
+/// with SYS_CLOSE. Whatever is written to one is read from the other.
+fn sys_channel_create(args: SyscallArgs) -> SyscallRet {
+    use crate::object::channel;
+    use crate::process::table::with_current_group_mut;
+    use crate::syscall::fd::FdKind;
 
-    use crate::drivers::display;
+    let out = args.arg_u64(1);
+    if args.arg(0) != 0 || out == 0 {
+        return err_to_ret(RxStatus::ERR_INVALID_ARGS);
+    }
 
-    // Handle stdout/stderr via display console
-    if fd == 1 || fd == 2 {
-        // Check if display console is initialized
-        if display::is_initialized() {
-            // Write to framebuffer console
-            for i in 0..len {
-                let c = unsafe { *(ptr.add(i)) };
-                display::put_char(c);
+    let (id_a, id_b) = match channel::create_endpoints() {
+        Ok(ids) => ids,
+        Err(e) => return err_to_ret(e),
+    };
+
+    let fds = with_current_group_mut(|p| {
+        let fd_a = p.fd_table.alloc(FdKind::Channel { channel_id: id_a }, 0)?;
+        match p.fd_table.alloc(FdKind::Channel { channel_id: id_b }, 0) {
+            Some(fd_b) => Some((fd_a, fd_b)),
+            None => {
+                p.fd_table.close(fd_a);
+                None
             }
-        } else {
-            // Fallback to debug port if console not initialized
-            unsafe {
-                for i in 0..len {
-                    let c = *(ptr.add(i));
-                    core::arch::asm!("out dx, al",
-                        in("dx") 0xE9u16,
-                        in("al") c,
-                        options(nomem, nostack)
-                    );
+        }
+    });
+
+    match fds {
+        Some(Some((fd_a, fd_b))) => match usercopy::copy_records_to_user(out, &[fd_a as i32, fd_b as i32]) {
+            Ok(()) => ok_to_ret(0),
+            Err(e) => {
+                // Nobody can learn the descriptors: close them again
+                let descs = with_current_group_mut(|p| (p.fd_table.close(fd_a), p.fd_table.close(fd_b)));
+                if let Some((Some(_), Some(_))) = descs {
+                    channel::close_endpoint(id_a);
+                    channel::close_endpoint(id_b);
                 }
+                err_to_ret(e)
             }
+        },
+        _ => {
+            channel::close_endpoint(id_a);
+            channel::close_endpoint(id_b);
+            err_to_ret(RxStatus::ERR_NO_MEMORY)
         }
-        return ok_to_ret_isize(len as isize);
     }
+}
 
-    // stdin - cannot write
-    if fd == 0 {
-        return err_to_ret(RxStatus::ERR_INVALID_ARGS);
+/// Write a message to a channel
+///
+/// Arguments:
+///   arg0: channel endpoint descriptor
+///   arg1: message buffer (userspace)
+///   arg2: message size in bytes
+///   arg3: handle array (must be null: handle transfer is not supported yet)
+///   arg4: handle count (must be 0)
+///
+/// Returns: number of bytes written, or negative error code
+///
+/// A message larger than channel::LARGE_MSG_THRESHOLD whose buffer is
+/// page-aligned is not copied: the physical pages behind the buffer are
+/// queued and later mapped into the reader. The writer's mappings of them
+/// become copy-on-write, so it may go on using the buffer: a write to a
+/// page gives the writer a copy, and the reader sees what was sent.
+/// Other messages are copied (up to MAX_MSG_SIZE).
+fn sys_channel_write(args: SyscallArgs) -> SyscallRet {
+    use crate::object::channel::{self, Message, LARGE_MSG_THRESHOLD, MAX_LARGE_MSG_SIZE, MAX_MSG_SIZE};
+
+    let channel_id = match channel_of_fd(args.arg(0) as Fd) {
+        Ok(id) => id,
+        Err(e) => return err_to_ret(e),
+    };
+    let ptr = args.arg_u64(1);
+    let len = args.arg(2);
+    if args.arg(4) != 0 {
+        return err_to_ret(RxStatus::ERR_NOT_SUPPORTED);
     }
 
-    // For other file descriptors (fd 3+), return not implemented for now
-    // Future: Write to ramdisk files
-    ok_to_ret_isize(len as isize)
+    let msg = if len > LARGE_MSG_THRESHOLD && ptr & 0xFFF == 0 {
+        if len > MAX_LARGE_MSG_SIZE {
+            return err_to_ret(RxStatus::ERR_INVALID_ARGS);
+        }
+        match user_pages(ptr, len) {
+            Ok(pages) => Message::with_pages(pages, len, alloc::vec::Vec::new()),
+            Err(e) => return err_to_ret(e),
+        }
+    } else {
+        if len > MAX_MSG_SIZE {
+            return err_to_ret(RxStatus::ERR_INVALID_ARGS);
+        }
+        let mut data = alloc::vec![0u8; len];
+        if let Err(e) = usercopy::copy_from_user(&mut data, ptr) {
+            return err_to_ret(e);
+        }
+        Message::new(data, alloc::vec::Vec::new())
+    };
+
+    match channel::endpoint_write(channel_id, msg) {
+        Ok(()) => ok_to_ret(len),
+        Err(e) => err_to_ret(e),
+    }
 }
 
-/// Read from file descriptor
+/// Read a message from a channel
 ///
 /// Arguments:
-///   arg0: file descriptor (fd)
-///   arg1: pointer to buffer
-///   arg2: length to read
-///
-/// Returns: number of bytes read, or negative error code
+///   arg0: channel endpoint descriptor
+///   arg1: buffer (userspace)
+///   arg2: buffer size in bytes
+///   arg3: handle array (unused: handle transfer is not supported yet)
+///   arg4: handle array capacity
+///   arg5: optional pointer to a u64 receiving the address of a mapped
+///         page-transfer payload
 ///
-/// Read from a file descriptor
+/// Returns: message size in bytes, or negative error code
+///   (ERR_SHOULD_WAIT if no message is queued, ERR_PEER_CLOSED if none is
+///   queued and the other endpoint is closed)
 ///
-/// For stdin (fd 0): Blocks waiting for keyboard input, returns one character at a time
-/// For files: Reads from ramdisk files
-/// For stdout/stderr: Returns error (not readable)
-fn sys_read(args: SyscallArgs) -> SyscallRet {
-    use crate::syscall::fd::{FdKind, FileDescriptor};
-    use crate::process::table::PROCESS_TABLE;
-
-    let fd = args.arg(0) as u8;
-    let ptr = args.arg_u64(1) as *mut u8;
-    let len = args.arg(2);
+/// A page-transfer message is mapped read-only into the caller when arg5
+/// is given; its address is stored there and nothing is copied. Otherwise
+/// (and for copied messages, where *arg5 is set to 0) the payload is
+/// copied into the buffer; bytes beyond the buffer size are discarded.
+fn sys_channel_read(args: SyscallArgs) -> SyscallRet {
+    use crate::exec::elf::PF_R;
+    use crate::object::channel;
+    use crate::object::Vmo;
+
+    let channel_id = match channel_of_fd(args.arg(0) as Fd) {
+        Ok(id) => id,
+        Err(e) => return err_to_ret(e),
+    };
+    let buf = args.arg_u64(1);
+    let buf_len = args.arg(2);
+    let map_out = args.arg_u64(5);
+    if let Err(e) = usercopy::check_user_range(buf, buf_len) {
+        return err_to_ret(e);
+    }
+    // Cleared before a message is taken, so a bad pointer loses nothing
+    if map_out != 0 {
+        if let Err(e) = usercopy::copy_to_user(map_out, &0u64.to_ne_bytes()) {
+            return err_to_ret(e);
+        }
+    }
 
-    // Get the current process
-    let file_info = {
-        let mut table = PROCESS_TABLE.lock();
-        let current = match table.current_mut() {
-            Some(p) => p,
-            None => return err_to_ret(RxStatus::ERR_INVALID_ARGS),
+    let mut msg = match channel::endpoint_read(channel_id) {
+        Ok(m) => m,
+        Err(e) => return err_to_ret(e),
+    };
+    let len = msg.data_size();
+
+    if msg.is_page_transfer() && map_out != 0 {
+        // The message's page references become the mapping's
+        let pages = msg.take_pages();
+        let mapped = Vmo::from_pages(&pages, false)
+            .map_err(|_| RxStatus::ERR_NO_MEMORY)
+            .and_then(|vmo| map_into_current(&vmo, PF_R));
+        let user_addr = match mapped {
+            Ok(addr) => addr,
+            Err(e) => {
+                for &paddr in &pages {
+                    crate::mm::pmm::pmm_page_unref(paddr);
+                }
+                return err_to_ret(e);
+            }
         };
-
-        // Get the file descriptor
-        let file_desc = match current.fd_table.get(fd) {
-            Some(f) => f,
-            None => return err_to_ret(RxStatus::ERR_INVALID_ARGS), // EBADF
+        return match usercopy::copy_to_user(map_out, &user_addr.to_ne_bytes()) {
+            Ok(()) => ok_to_ret(len),
+            Err(e) => err_to_ret(e),
         };
+    }
 
-        match file_desc.kind {
-            FdKind::Stdin => {
-                // stdin (fd 0) - Read from keyboard driver
-                // Block until character available
-                if len == 0 {
-                    return ok_to_ret_isize(0);
-                }
+    match msg.copy_payload_with(buf_len, |at, chunk| usercopy::copy_to_user(buf + at as u64, chunk)) {
+        Ok(_) => ok_to_ret(len),
+        Err(e) => err_to_ret(e),
+    }
+}
 
-                // Release process table lock before blocking
-                drop(current);
-                drop(table);
+syscall_stub!(sys_event_create);
+syscall_stub!(sys_eventpair_create);
+syscall_stub!(sys_object_signal);
+syscall_stub!(sys_object_wait_one);
+syscall_stub!(sys_object_wait_many);
 
-                // Block until character available from keyboard
-                let ch = loop {
-                    if let Some(ch) = crate::drivers::keyboard::read_char() {
-                        break ch;
-                    }
-                    // Yield to other processes while waiting
-                    let _ = crate::sched::round_robin::yield_cpu();
-                };
+/// Most packets returned by one SYS_PORT_WAIT
+const PORT_WAIT_MAX_PACKETS: usize = 64;
 
-                // Write the character to userspace buffer
-                unsafe {
-                    *ptr = ch as u8;
-                }
+/// SYS_PORT_WAIT_ASYNC option: keep the registration after it fires
+const PORT_OPT_PERSISTENT: u32 = 1 << 0;
 
-                return ok_to_ret_isize(1); // Read one character
-            }
-            FdKind::File { inode, offset } => {
-                // Get the ramdisk file info
-                use crate::fs::ramdisk;
-                let ramdisk = match ramdisk::get_ramdisk() {
-                    Ok(r) => r,
-                    Err(_) => return err_to_ret(RxStatus::ERR_NOT_FOUND),
-                };
+/// SYS_PORT_WAIT option: fail with ERR_SHOULD_WAIT instead of blocking
+const PORT_OPT_NONBLOCK: u32 = 1 << 0;
 
-                // Get file headers array
-                let files = unsafe {
-                    let base = ramdisk.data.as_ptr().add(ramdisk.superblock.files_offset as usize);
-                    let count = ramdisk.superblock.num_files as usize;
-                    core::slice::from_raw_parts(base as *const ramdisk::RamdiskFile, count)
-                };
+/// Look up the port behind a file descriptor of the current process
+fn port_of_fd(fd: Fd) -> Result<alloc::sync::Arc<crate::object::Port>, RxStatus> {
+    use crate::process::table::with_current_group;
+    use crate::syscall::fd::FdKind;
 
-                // Find the file by inode (index)
-                let ramdisk_file = match files.get(inode as usize) {
-                    Some(&f) => f,
-                    None => return err_to_ret(RxStatus::ERR_INVALID_ARGS),
-                };
+    match with_current_group(|p| p.fd_table.get(fd).map(|f| f.kind)) {
+        Some(Some(FdKind::Port { port_id })) => crate::object::port::get_port(port_id),
+        _ => Err(RxStatus::ERR_INVALID_ARGS), // EBADF or not a port
+    }
+}
 
-                Some((ramdisk_file, offset, len, ptr))
-            }
-            _ => {
-                // Stdout/stderr not readable
-                return err_to_ret(RxStatus::ERR_INVALID_ARGS);
-            }
-        }
-    };
+/// Create a port
+///
+/// Arguments:
+///   arg0: options (must be 0)
+///
+/// Returns: port file descriptor, or negative error code
+///
+/// Close the port with SYS_CLOSE; processes blocked in SYS_PORT_WAIT on
+/// it then return ERR_PEER_CLOSED.
+fn sys_port_create(args: SyscallArgs) -> SyscallRet {
+    use crate::object::port;
+    use crate::process::table::with_current_group_mut;
+    use crate::syscall::fd::FdKind;
+
+    if args.arg(0) != 0 {
+        return err_to_ret(RxStatus::ERR_INVALID_ARGS);
+    }
+
+    let port_id = match port::create_port() {
+        Ok(id) => id,
+        Err(e) => return err_to_ret(e),
+    };
+
+    match with_current_group_mut(|p| p.fd_table.alloc(FdKind::Port { port_id }, 0)) {
+        Some(Some(fd)) => ok_to_ret(fd as usize),
+        _ => {
+            port::close_port(port_id);
+            err_to_ret(RxStatus::ERR_NO_MEMORY)
+        }
+    }
+}
+
+/// Watch an object's signals through a port
+///
+/// Arguments:
+///   arg0: object descriptor (a channel endpoint or a timer)
+///   arg1: port descriptor
+///   arg2: key, returned in the packets of this registration
+///   arg3: signals to watch (SIGNAL_READABLE, SIGNAL_PEER_CLOSED for
+///         channels, SIGNAL_SIGNALED for timers)
+///   arg4: options (PORT_OPT_PERSISTENT)
+///
+/// Returns: 0 on success, or negative error code
+///
+/// A packet is queued on the port when one of the signals is asserted,
+/// including right away if it already is. A one-shot registration ends
+/// with its first packet; a persistent one posts on every new message
+/// and lasts until the object or the port is closed.
+fn sys_port_wait_async(args: SyscallArgs) -> SyscallRet {
+    use crate::object::{channel, timer};
+    use crate::process::table::with_current_group;
+    use crate::syscall::fd::FdKind;
+
+    let object = match with_current_group(|p| p.fd_table.get(args.arg(0) as Fd).map(|f| f.kind)) {
+        Some(Some(kind @ (FdKind::Channel { .. } | FdKind::Timer { .. }))) => kind,
+        Some(Some(_)) => return err_to_ret(RxStatus::ERR_NOT_SUPPORTED),
+        _ => return err_to_ret(RxStatus::ERR_INVALID_ARGS), // EBADF
+    };
+    let port = match port_of_fd(args.arg(1) as Fd) {
+        Ok(p) => p,
+        Err(e) => return err_to_ret(e),
+    };
+    let key = args.arg_u64(2);
+    let signals = args.arg_u32(3);
+    let options = args.arg_u32(4);
+    if signals == 0 || options & !PORT_OPT_PERSISTENT != 0 {
+        return err_to_ret(RxStatus::ERR_INVALID_ARGS);
+    }
+
+    let once = options & PORT_OPT_PERSISTENT == 0;
+    let result = match object {
+        FdKind::Timer { timer_id } => timer::watch_timer(timer_id, &port, key, signals, once),
+        FdKind::Channel { channel_id } => channel::watch_endpoint(channel_id, &port, key, signals, once),
+        _ => Err(RxStatus::ERR_NOT_SUPPORTED),
+    };
+    match result {
+        Ok(()) => ok_to_ret(0),
+        Err(e) => err_to_ret(e),
+    }
+}
+
+/// Wait for packets on a port
+///
+/// Arguments:
+///   arg0: port descriptor
+///   arg1: packet array (userspace, struct rx_port_packet)
+///   arg2: packet array capacity (at most PORT_WAIT_MAX_PACKETS are returned)
+///   arg3: options (PORT_OPT_NONBLOCK)
+///
+/// Returns: number of packets stored, or negative error code
+///   (ERR_SHOULD_WAIT if none is pending and PORT_OPT_NONBLOCK is set,
+///   ERR_PEER_CLOSED if the port was closed while waiting)
+///
+/// Blocks until at least one packet is pending. Only pending packets are
+/// looked at, however many objects are registered.
+fn sys_port_wait(args: SyscallArgs) -> SyscallRet {
+    use crate::object::PortPacket;
+
+    let port = match port_of_fd(args.arg(0) as Fd) {
+        Ok(p) => p,
+        Err(e) => return err_to_ret(e),
+    };
+    let out = args.arg_u64(1);
+    let max = args.arg(2).min(PORT_WAIT_MAX_PACKETS);
+    let options = args.arg_u32(3);
+    if max == 0 || out == 0 {
+        return err_to_ret(RxStatus::ERR_INVALID_ARGS);
+    }
+    // Checked before dequeuing, so a bad buffer loses no packets
+    if let Err(e) = usercopy::check_user_range(out, max * core::mem::size_of::<PortPacket>()) {
+        return err_to_ret(e);
+    }
+    if options & !PORT_OPT_NONBLOCK != 0 {
+        return err_to_ret(RxStatus::ERR_INVALID_ARGS);
+    }
+
+    let mut packets = [PortPacket::default(); PORT_WAIT_MAX_PACKETS];
+    let count = if options & PORT_OPT_NONBLOCK != 0 {
+        match port.try_dequeue(&mut packets[..max]) {
+            0 => return err_to_ret(RxStatus::ERR_SHOULD_WAIT),
+            n => n,
+        }
+    } else {
+        match port.wait(&mut packets[..max]) {
+            Ok(n) => n,
+            Err(_) => return err_to_ret(RxStatus::ERR_PEER_CLOSED),
+        }
+    };
+
+    match usercopy::copy_records_to_user(out, &packets[..count]) {
+        Ok(()) => ok_to_ret(count),
+        Err(e) => err_to_ret(e),
+    }
+}
+
+/// Queue a user packet on a port
+///
+/// Arguments:
+///   arg0: port descriptor
+///   arg1: key
+///   arg2: signals (any value; ORed into a pending packet with the same key)
+///
+/// Returns: 0 on success, or negative error code
+///   (ERR_SHOULD_WAIT if the port already holds MAX_PORT_PACKETS keys)
+fn sys_port_queue(args: SyscallArgs) -> SyscallRet {
+    let port = match port_of_fd(args.arg(0) as Fd) {
+        Ok(p) => p,
+        Err(e) => return err_to_ret(e),
+    };
+
+    match port.queue(args.arg_u64(1), args.arg_u32(2)) {
+        Ok(()) => ok_to_ret(0),
+        Err("port full") => err_to_ret(RxStatus::ERR_SHOULD_WAIT),
+        Err(_) => err_to_ret(RxStatus::ERR_PEER_CLOSED),
+    }
+}
+
+/// The futex at a user address of the calling thread's process
+fn futex_key(addr: u64) -> Result<crate::sync::futex::FutexKey, RxStatus> {
+    use crate::process::table::with_current_process;
+
+    usercopy::check_user_range(addr, 4)?;
+    if addr == 0 || addr & 3 != 0 {
+        return Err(RxStatus::ERR_INVALID_ARGS);
+    }
+    let page_table = with_current_process(|p| p.page_table).ok_or(RxStatus::ERR_BAD_STATE)?;
+    Ok(crate::sync::futex::FutexKey { page_table, addr })
+}
+
+/// Sleep on a futex while it holds an expected value
+///
+/// Arguments:
+///   arg0: address of the 32-bit futex word (4-byte aligned)
+///   arg1: expected value
+///
+/// Returns: 0 once woken by SYS_FUTEX_WAKE, or negative error code
+///   (ERR_SHOULD_WAIT at once if the word does not hold the value)
+///
+/// Wakeups may be spurious: callers re-check the word and wait again.
+fn sys_futex_wait(args: SyscallArgs) -> SyscallRet {
+    use crate::sched::round_robin;
+    use crate::sync::futex;
+
+    let key = match futex_key(args.arg_u64(0)) {
+        Ok(key) => key,
+        Err(e) => return err_to_ret(e),
+    };
+    let pid = match round_robin::get_current_pid() {
+        Some(pid) => pid,
+        None => return err_to_ret(RxStatus::ERR_BAD_STATE),
+    };
+
+    match futex::wait(key, pid, args.arg_u32(1)) {
+        Ok(()) => ok_to_ret(0),
+        Err(e) => err_to_ret(e),
+    }
+}
+
+/// Wake threads sleeping on a futex
+///
+/// Arguments:
+///   arg0: address of the futex word
+///   arg1: most threads to wake (oldest sleepers first)
+///
+/// Returns: number of threads woken, or negative error code
+fn sys_futex_wake(args: SyscallArgs) -> SyscallRet {
+    use crate::sync::futex;
+
+    match futex_key(args.arg_u64(0)) {
+        Ok(key) => ok_to_ret(futex::wake(key, args.arg(1))),
+        Err(e) => err_to_ret(e),
+    }
+}
+
+// Jobs & Handles syscalls
+syscall_stub!(sys_job_create);
+
+/// Map a descriptor table error to a status
+fn fd_table_err(e: &'static str) -> RxStatus {
+    match e {
+        "out of memory" | "descriptor table full" => RxStatus::ERR_NO_MEMORY,
+        _ => RxStatus::ERR_INVALID_ARGS, // EBADF
+    }
+}
+
+/// Copy in a batch of at most `fd::MAX_FD_BATCH` descriptor numbers
+///
+/// The output array of the same length is checked first (by writing it),
+/// so a call fails before it changes anything if either is unmapped.
+///
+/// # Returns
+///
+/// The numbers, in the first `count` entries
+fn fd_batch_from_user(fds: u64, count: usize, out: u64) -> Result<[Fd; fd::MAX_FD_BATCH], RxStatus> {
+    if count == 0 || count > fd::MAX_FD_BATCH {
+        return Err(RxStatus::ERR_INVALID_ARGS);
+    }
+    let mut batch = [0 as Fd; fd::MAX_FD_BATCH];
+    usercopy::copy_records_to_user(out, &batch[..count])?;
+
+    let mut raw = [0u8; fd::MAX_FD_BATCH * 4];
+    usercopy::copy_from_user(&mut raw[..count * 4], fds)?;
+    for (fd, bytes) in batch.iter_mut().zip(raw.chunks_exact(4)) {
+        *fd = Fd::from_ne_bytes([bytes[0], bytes[1], bytes[2], bytes[3]]);
+    }
+    Ok(batch)
+}
+
+/// Count another descriptor for the object behind a descriptor
+fn retain_object(kind: fd::FdKind) -> Result<(), RxStatus> {
+    use crate::object::{channel, port, timer};
+    use fd::FdKind;
+
+    match kind {
+        FdKind::Channel { channel_id } => channel::retain_endpoint(channel_id),
+        FdKind::Port { port_id } => port::retain_port(port_id),
+        FdKind::Timer { timer_id } => timer::retain_timer(timer_id),
+        _ => Ok(()),
+    }
+}
+
+/// Drop a closed descriptor's reference to its object
+///
+/// Called without the process table lock: closing wakes waiters, which
+/// takes it. Also used to close an exited process's descriptors.
+pub(crate) fn release_object(kind: fd::FdKind) {
+    use crate::object::{channel, port, timer};
+    use fd::FdKind;
+
+    match kind {
+        FdKind::Channel { channel_id } => channel::close_endpoint(channel_id),
+        FdKind::Port { port_id } => port::close_port(port_id),
+        FdKind::Timer { timer_id } => timer::close_timer(timer_id),
+        _ => {}
+    }
+}
+
+/// Duplicate a batch of descriptors
+///
+/// Each copy names the same object as its original, which stays open
+/// until both are closed. A file copy starts at the original's offset
+/// and moves independently. All of the batch is duplicated, or none.
+///
+/// Arguments:
+///   arg0: array of descriptors (i32)
+///   arg1: count (1 to 64)
+///   arg2: array receiving the new descriptors (count entries)
+///
+/// Returns: count, or negative error code
+fn sys_handle_duplicate(args: SyscallArgs) -> SyscallRet {
+    use crate::process::table::{with_current_group, with_current_group_mut};
+
+    let count = args.arg(1);
+    let out = args.arg_u64(2);
+    let fds = match fd_batch_from_user(args.arg_u64(0), count, out) {
+        Ok(fds) => fds,
+        Err(e) => return err_to_ret(e),
+    };
+
+    let descs = match with_current_group(|p| p.fd_table.collect(&fds[..count], false)) {
+        Some(Ok(descs)) => descs,
+        Some(Err(e)) => return err_to_ret(fd_table_err(e)),
+        None => return err_to_ret(RxStatus::ERR_BAD_STATE),
+    };
+
+    // Objects are retained before the copies exist, without the process
+    // table lock; one closed in the meantime fails the batch
+    for (i, desc) in descs.iter().enumerate() {
+        if let Err(e) = retain_object(desc.kind) {
+            descs[..i].iter().for_each(|d| release_object(d.kind));
+            return err_to_ret(if e == RxStatus::ERR_NOT_FOUND { RxStatus::ERR_INVALID_ARGS } else { e });
+        }
+    }
+
+    let mut new_fds = [0 as Fd; fd::MAX_FD_BATCH];
+    match with_current_group_mut(|p| p.fd_table.insert_all(&descs, &mut new_fds[..count])) {
+        Some(Ok(())) => {}
+        result => {
+            descs.iter().for_each(|d| release_object(d.kind));
+            let e = match result {
+                Some(Err(e)) => fd_table_err(e),
+                _ => RxStatus::ERR_BAD_STATE,
+            };
+            return err_to_ret(e);
+        }
+    }
+
+    match usercopy::copy_records_to_user(out, &new_fds[..count]) {
+        Ok(()) => ok_to_ret(count),
+        Err(e) => err_to_ret(e),
+    }
+}
+
+/// Move a batch of descriptors to a child process
+///
+/// The descriptors are closed in the caller and opened in the child
+/// (a process the caller spawned), which learns their numbers from the
+/// caller, e.g. over a channel. The objects stay open throughout. All of
+/// the batch is moved, or none; stdin, stdout and stderr cannot be.
+///
+/// Arguments:
+///   arg0: child PID
+///   arg1: array of descriptors (i32)
+///   arg2: count (1 to 64)
+///   arg3: array receiving the descriptors' numbers in the child
+///
+/// Returns: count, or negative error code
+///   (ERR_ACCESS_DENIED if the PID is not a live child of the caller)
+fn sys_handle_transfer(args: SyscallArgs) -> SyscallRet {
+    use crate::process::table::PROCESS_TABLE;
+    use crate::sched::runqueue::RUN_QUEUES;
+
+    let pid = args.arg_u32(0);
+    let count = args.arg(2);
+    let out = args.arg_u64(3);
+    let fds = match fd_batch_from_user(args.arg_u64(1), count, out) {
+        Ok(fds) => fds,
+        Err(e) => return err_to_ret(e),
+    };
+
+    let mut new_fds = [0 as Fd; fd::MAX_FD_BATCH];
+    let moved = {
+        let mut table = PROCESS_TABLE.lock();
+        let caller = match table.current_group() {
+            Some(p) => p.pid,
+            None => return err_to_ret(RxStatus::ERR_BAD_STATE),
+        };
+        let reserved = match table.get_mut(pid) {
+            Some(child) if child.ppid == caller && child.tgid == pid && RUN_QUEUES.state(pid).is_alive() => {
+                // Room in the child first, so the move cannot fail halfway
+                child.fd_table.reserve(count).map_err(fd_table_err)
+            }
+            _ => Err(RxStatus::ERR_ACCESS_DENIED),
+        };
+        reserved.and_then(|()| {
+            let source = table.current_group_mut().ok_or(RxStatus::ERR_BAD_STATE)?;
+            let descs = source.fd_table.collect(&fds[..count], true).map_err(fd_table_err)?;
+            for &fd in &fds[..count] {
+                source.fd_table.close(fd);
+            }
+            Ok(descs)
+        })
+        .and_then(|descs| {
+            let child = table.get_mut(pid).ok_or(RxStatus::ERR_BAD_STATE)?;
+            child.fd_table.insert_all(&descs, &mut new_fds[..count]).map_err(fd_table_err)
+        })
+    };
+
+    match moved.and_then(|()| usercopy::copy_records_to_user(out, &new_fds[..count])) {
+        Ok(()) => ok_to_ret(count),
+        Err(e) => err_to_ret(e),
+    }
+}
+
+// Time syscalls
+fn sys_clock_get(args: SyscallArgs) -> SyscallRet {
+    let _clock_id = args.arg_u32(0);
+    // Return current time in nanoseconds (placeholder)
+    // Use the TSC for now
+    use crate::arch::amd64::tsc;
+    let time_ns = tsc::tsc_to_ns(unsafe { tsc::rdtsc() });
+    ok_to_ret_isize(time_ns as isize)
+}
+
+/// Look up the timer behind a file descriptor of the current process
+fn timer_of_fd(fd: Fd) -> Result<alloc::sync::Arc<crate::object::Timer>, RxStatus> {
+    use crate::process::table::with_current_group;
+    use crate::syscall::fd::FdKind;
+
+    match with_current_group(|p| p.fd_table.get(fd).map(|f| f.kind)) {
+        Some(Some(FdKind::Timer { timer_id })) => crate::object::timer::get_timer(timer_id),
+        _ => Err(RxStatus::ERR_INVALID_ARGS), // EBADF or not a timer
+    }
+}
+
+/// Create a timer
+///
+/// Arguments:
+///   arg0: options (must be 0)
+///
+/// Returns: timer file descriptor, or negative error code
+///
+/// The timer asserts SIGNAL_SIGNALED when it fires; watch it with
+/// SYS_PORT_WAIT_ASYNC. Close it with SYS_CLOSE, which cancels it.
+fn sys_timer_create(args: SyscallArgs) -> SyscallRet {
+    use crate::object::timer;
+    use crate::process::table::with_current_group_mut;
+    use crate::syscall::fd::FdKind;
+
+    if args.arg(0) != 0 {
+        return err_to_ret(RxStatus::ERR_INVALID_ARGS);
+    }
+
+    let timer_id = match timer::create_timer() {
+        Ok(id) => id,
+        Err(e) => return err_to_ret(e),
+    };
+
+    match with_current_group_mut(|p| p.fd_table.alloc(FdKind::Timer { timer_id }, 0)) {
+        Some(Some(fd)) => ok_to_ret(fd as usize),
+        _ => {
+            timer::close_timer(timer_id);
+            err_to_ret(RxStatus::ERR_NO_MEMORY)
+        }
+    }
+}
+
+/// Arm a timer
+///
+/// Arguments:
+///   arg0: timer descriptor
+///   arg1: deadline (absolute, nanoseconds in the SYS_CLOCK_GET timebase)
+///   arg2: slack (nanoseconds the timer may fire late)
+///   arg3: period (nanoseconds, 0 for a one-shot timer)
+///
+/// Returns: 0 on success, or negative error code
+///
+/// Re-arming replaces the previous deadline and clears SIGNAL_SIGNALED. A
+/// deadline in the past fires on the next timer interrupt. A periodic
+/// timer re-arms itself each period and stays signaled once it fired.
+fn sys_timer_set(args: SyscallArgs) -> SyscallRet {
+    let timer = match timer_of_fd(args.arg(0) as Fd) {
+        Ok(t) => t,
+        Err(e) => return err_to_ret(e),
+    };
+    let deadline = args.arg_u64(1);
+    let slack = args.arg_u64(2);
+    let period = args.arg_u64(3);
+
+    let result = if period == 0 {
+        *timer.period.lock() = None;
+        timer.set(deadline, Some(slack))
+    } else {
+        timer.set_periodic(deadline, period, Some(slack))
+    };
+    if result.is_err() {
+        return err_to_ret(RxStatus::ERR_INVALID_ARGS);
+    }
+
+    // The new deadline may be nearer than this CPU's next interrupt
+    crate::sched::tickless::program();
+    ok_to_ret(0)
+}
+
+/// Cancel a timer
+///
+/// Arguments:
+///   arg0: timer descriptor
+///
+/// Returns: 0 on success, or negative error code
+///   (ERR_BAD_STATE if the timer is not armed)
+fn sys_timer_cancel(args: SyscallArgs) -> SyscallRet {
+    let timer = match timer_of_fd(args.arg(0) as Fd) {
+        Ok(t) => t,
+        Err(e) => return err_to_ret(e),
+    };
+
+    match timer.cancel() {
+        Ok(()) => ok_to_ret(0),
+        Err(_) => err_to_ret(RxStatus::ERR_BAD_STATE),
+    }
+}
+
+// Debug syscalls
+/// Debug write syscall - writes a string to the debug console
+///
+/// Arguments:
+///   arg0: pointer to string (userspace virtual address)
+///   arg1: length of string
+///
+/// Returns: number of bytes written, or negative error code
+fn sys_debug_write(args: SyscallArgs) -> SyscallRet {
+    let len = args.arg(1);
+
+    // For now, just write to port 0xE9 (kernel-mediated)
+    // In the future, this could go to a proper logging system
+    match usercopy::debug_write_user(args.arg_u64(0), len) {
+        Ok(()) => ok_to_ret_isize(len as isize),
+        Err(e) => err_to_ret(e),
+    }
+}
+
+/// Snapshot kernel accounting into a user array
+///
+/// Arguments:
+///   arg0: snapshot kind (`stats::kind`: 0 system totals, 1 per-syscall
+///         counters, 2 processes, 3 boot phases)
+///   arg1: pointer to an array of the kind's records
+///   arg2: capacity of the array, in records
+///
+/// Returns: number of records written (truncated to the capacity), or
+/// negative error code
+fn sys_stats(args: SyscallArgs) -> SyscallRet {
+    let out = args.arg_u64(1);
+    let max = args.arg(2);
+
+    match args.arg_u32(0) {
+        stats::kind::SYSTEM => copy_records_out(out, max, &[stats::system_snapshot()]),
+        stats::kind::SYSCALLS => copy_records_out(out, max, &stats::syscall_snapshot()),
+        stats::kind::PROCESSES => copy_records_out(out, max, &stats::process_snapshot()),
+        stats::kind::BOOT => copy_records_out(out, max, &stats::boot_snapshot()),
+        _ => err_to_ret(RxStatus::ERR_INVALID_ARGS),
+    }
+}
+
+/// Copy up to `max` records to the user array at `out`
+fn copy_records_out<T: Copy>(out: u64, max: usize, records: &[T]) -> SyscallRet {
+    let size = max.saturating_mul(core::mem::size_of::<T>());
+    if max == 0 || usercopy::check_user_range(out, size).is_err() {
+        return err_to_ret(RxStatus::ERR_INVALID_ARGS);
+    }
+
+    let count = records.len().min(max);
+    match usercopy::copy_records_to_user(out, &records[..count]) {
+        Ok(()) => ok_to_ret(count),
+        Err(e) => err_to_ret(e),
+    }
+}
+
+// ============================================================================
+// I/O Syscalls (Phase 5A)
+// ============================================================================
+
+/// Write to file descriptor
+///
+/// Arguments:
+///   arg0: file descriptor (fd)
+///   arg1: pointer to buffer
+///   arg2: length to write
+///
+/// Returns: number of bytes written, or negative error code
+///
+/// File descriptor mapping:
+///   fd 0: stdin (write not allowed)
+///   fd 1: stdout (kernel debug console, port 0xE9)
+///   fd 2: stderr (same as stdout)
+///   fd 3+: tmpfs files (ramdisk files are read-only)
+fn sys_write(args: SyscallArgs) -> SyscallRet {
+    write_fd(args.arg(0) as Fd, args.arg_u64(1) as *const u8, args.arg(2))
+}
+
+/// Write `len` bytes at `ptr` to `fd` (shared by sys_write, sys_writev
+/// and the submission ring)
+fn write_fd(fd: Fd, ptr: *const u8, len: usize) -> SyscallRet {
+    use crate::drivers::display;
+
+    if let Err(e) = usercopy::check_user_range(ptr as u64, len) {
+        return err_to_ret(e);
+    }
+
+    // Handle stdout/stderr via display console
+    if fd == 1 || fd == 2 {
+        // Check if display console is initialized
+        if display::is_initialized() {
+            // Write to framebuffer console in bulk calls (one parse, at
+            // most one scroll per bounce buffer)
+            let mut buf = [0u8; BOUNCE_SIZE];
+            let mut done = 0;
+            while done < len {
+                let chunk = (len - done).min(buf.len());
+                if let Err(e) = usercopy::copy_from_user(&mut buf[..chunk], ptr as u64 + done as u64) {
+                    return if done > 0 { ok_to_ret_isize(done as isize) } else { err_to_ret(e) };
+                }
+                display::write_bytes(&buf[..chunk]);
+                done += chunk;
+            }
+        } else if let Err(e) = usercopy::debug_write_user(ptr as u64, len) {
+            // Fallback to debug port if console not initialized
+            return err_to_ret(e);
+        }
+        return ok_to_ret_isize(len as isize);
+    }
+
+    // stdin - cannot write
+    if fd == 0 {
+        return err_to_ret(RxStatus::ERR_INVALID_ARGS);
+    }
+
+    use crate::fs::tmpfs;
+    use crate::process::table::with_current_group;
+    use crate::syscall::fd::{flags, FdKind};
+
+    let desc = match with_current_group(|p| p.fd_table.get(fd).cloned()) {
+        Some(Some(desc)) => desc,
+        _ => return err_to_ret(RxStatus::ERR_INVALID_ARGS), // EBADF
+    };
+
+    match desc.kind {
+        FdKind::TmpFile { inode, offset } => {
+            if !flags::writable(desc.flags) {
+                return err_to_ret(RxStatus::ERR_ACCESS_DENIED); // EBADF
+            }
+
+            // Copied without the process table lock
+            let append = desc.flags & flags::O_APPEND != 0;
+            match tmpfs_write_user(inode, offset, append, ptr as u64, len) {
+                Ok((written, end)) => {
+                    set_file_offset(fd, end);
+                    ok_to_ret_isize(written as isize)
+                }
+                Err(e) => err_to_ret(e),
+            }
+        }
+        // The ramdisk is read-only
+        FdKind::File { .. } => err_to_ret(RxStatus::ERR_ACCESS_DENIED), // EROFS
+        _ => err_to_ret(RxStatus::ERR_NOT_SUPPORTED),
+    }
+}
+
+/// Bytes moved per step between user memory and a tmpfs file or the
+/// console (the bounce buffer is on the kernel stack)
+const BOUNCE_SIZE: usize = 1024;
+
+/// Write `len` user bytes at `src` to a tmpfs file
+///
+/// The bytes go through a kernel buffer, so a bad user address fails
+/// with ERR_INVALID_ARGS instead of faulting under the file's lock.
+///
+/// # Returns
+///
+/// Bytes written and the offset just past them. A write cut short after
+/// some bytes (by memory or an unmapped page) returns what was written.
+fn tmpfs_write_user(inode: u32, offset: u64, append: bool, src: u64, len: usize) -> Result<(usize, u64), RxStatus> {
+    use crate::fs::tmpfs;
+
+    let mut buf = [0u8; BOUNCE_SIZE];
+    let mut done = 0;
+    let mut end = offset;
+    loop {
+        let chunk = (len - done).min(buf.len());
+        let step = usercopy::copy_from_user(&mut buf[..chunk], src + done as u64)
+            .and_then(|()| tmpfs::write(inode, end, append, &buf[..chunk]).map_err(errno_to_status));
+        match step {
+            Ok((written, new_end)) => {
+                done += written;
+                end = new_end;
+                if written < chunk || done == len {
+                    return Ok((done, end));
+                }
+            }
+            Err(_) if done > 0 => return Ok((done, end)),
+            Err(e) => return Err(e),
+        }
+    }
+}
+
+/// Read up to `len` bytes of a tmpfs file at `offset` out to user `dst`
+///
+/// # Returns
+///
+/// Bytes read (0 at or past the end of the file)
+fn tmpfs_read_user(inode: u32, offset: u64, dst: u64, len: usize) -> Result<usize, RxStatus> {
+    use crate::fs::tmpfs;
+
+    let mut buf = [0u8; BOUNCE_SIZE];
+    let mut done = 0;
+    while done < len {
+        let chunk = (len - done).min(buf.len());
+        let read = tmpfs::read(inode, offset + done as u64, &mut buf[..chunk]).map_err(errno_to_status)?;
+        usercopy::copy_to_user(dst + done as u64, &buf[..read])?;
+        done += read;
+        if read < chunk {
+            break;
+        }
+    }
+    Ok(done)
+}
+
+/// Set the offset of a file descriptor of the current process
+fn set_file_offset(fd: Fd, new_offset: u64) {
+    use crate::process::table::with_current_group_mut;
+    use crate::syscall::fd::FdKind;
+
+    with_current_group_mut(|p| {
+        if let Some(desc) = p.fd_table.get_mut(fd) {
+            if let FdKind::File { ref mut offset, .. } | FdKind::TmpFile { ref mut offset, .. } = desc.kind {
+                *offset = new_offset;
+            }
+        }
+    });
+}
+
+/// Status code of a filesystem error
+fn errno_to_status(errno: crate::fs::Errno) -> RxStatus {
+    use crate::fs::Errno;
+
+    match errno {
+        Errno::ENOENT => RxStatus::ERR_NOT_FOUND,
+        Errno::ENOMEM | Errno::ENFILE => RxStatus::ERR_NO_MEMORY,
+        Errno::EEXIST => RxStatus::ERR_BAD_STATE,
+        Errno::EACCES | Errno::EROFS => RxStatus::ERR_ACCESS_DENIED,
+        Errno::ENODEV => RxStatus::ERR_NOT_FOUND,
+        Errno::EIO => RxStatus::ERR_IO,
+        _ => RxStatus::ERR_INVALID_ARGS,
+    }
+}
+
+/// Read from file descriptor
+///
+/// Arguments:
+///   arg0: file descriptor (fd)
+///   arg1: pointer to buffer
+///   arg2: length to read
+///
+/// Returns: number of bytes read, or negative error code
+///
+/// Read from a file descriptor
+///
+/// For stdin (fd 0): Blocks waiting for keyboard input, returns one character at a time
+/// For files: Reads from ramdisk or tmpfs files
+/// For stdout/stderr: Returns error (not readable)
+fn sys_read(args: SyscallArgs) -> SyscallRet {
+    read_fd(args.arg(0) as Fd, args.arg_u64(1) as *mut u8, args.arg(2))
+}
+
+/// Read up to `len` bytes from `fd` into `ptr` (shared by sys_read,
+/// sys_readv and the submission ring)
+fn read_fd(fd: Fd, ptr: *mut u8, len: usize) -> SyscallRet {
+    use crate::syscall::fd::{FdKind, FileDescriptor};
+    use crate::process::table::PROCESS_TABLE;
+
+    if let Err(e) = usercopy::check_user_range(ptr as u64, len) {
+        return err_to_ret(e);
+    }
+
+    // Get the current process
+    let file_info = {
+        let mut table = PROCESS_TABLE.lock();
+        let current = match table.current_group_mut() {
+            Some(p) => p,
+            None => return err_to_ret(RxStatus::ERR_INVALID_ARGS),
+        };
+
+        // Get the file descriptor
+        let file_desc = match current.fd_table.get(fd) {
+            Some(f) => f,
+            None => return err_to_ret(RxStatus::ERR_INVALID_ARGS), // EBADF
+        };
+
+        match file_desc.kind {
+            FdKind::Stdin => {
+                // stdin (fd 0) - Read from keyboard driver
+                // Block until character available
+                if len == 0 {
+                    return ok_to_ret_isize(0);
+                }
+
+                // Release process table lock before blocking
+                drop(current);
+                drop(table);
+
+                // Block until character available from keyboard
+                let ch = loop {
+                    if let Some(ch) = crate::drivers::keyboard::read_char() {
+                        break ch;
+                    }
+                    // Leave the run queue until the keyboard has input
+                    crate::sched::round_robin::wait_for_input();
+                };
+
+                // Write the character to userspace buffer
+                return match usercopy::copy_to_user(ptr as u64, &[ch as u8]) {
+                    Ok(()) => ok_to_ret_isize(1), // Read one character
+                    Err(e) => err_to_ret(e),
+                };
+            }
+            FdKind::File { inode, offset } => {
+                // Get the ramdisk file info
+                use crate::fs::ramdisk;
+                let ramdisk = match ramdisk::get_ramdisk() {
+                    Ok(r) => r,
+                    Err(_) => return err_to_ret(RxStatus::ERR_NOT_FOUND),
+                };
+
+                // Find the file by inode (index)
+                let ramdisk_file = match ramdisk.file(inode as usize) {
+                    Some(f) => f,
+                    None => return err_to_ret(RxStatus::ERR_INVALID_ARGS),
+                };
+
+                Some((ramdisk_file, offset, len, ptr))
+            }
+            FdKind::TmpFile { inode, offset } => {
+                if !crate::syscall::fd::flags::readable(file_desc.flags) {
+                    return err_to_ret(RxStatus::ERR_ACCESS_DENIED); // EBADF
+                }
+
+                // Copied without the process table lock
+                drop(table);
+                return match tmpfs_read_user(inode, offset, ptr as u64, len) {
+                    Ok(read) => {
+                        set_file_offset(fd, offset + read as u64);
+                        ok_to_ret_isize(read as isize)
+                    }
+                    Err(e) => err_to_ret(e),
+                };
+            }
+            _ => {
+                // Stdout/stderr not readable
+                return err_to_ret(RxStatus::ERR_INVALID_ARGS);
+            }
+        }
+    };
 
     if let Some((ramdisk_file, offset, len, ptr)) = file_info {
         use crate::fs::ramdisk;
         let ramdisk = ramdisk::get_ramdisk().unwrap();
+        let data = match ramdisk.file_data(&ramdisk_file) {
+            Ok(data) => data,
+            Err(e) => return err_to_ret(errno_to_status(e)),
+        };
 
         // Calculate remaining bytes from current offset
-        let file_size = ramdisk_file.size as u64;
+        let file_size = data.len() as u64;
         let remaining = if offset >= file_size {
             0
         } else {
@@ -1045,18 +2004,14 @@ fn sys_read(args: SyscallArgs) -> SyscallRet {
         let to_read = core::cmp::min(len as u64, remaining) as usize;
 
         // Read from the file at current offset
-        let data_offset = ramdisk_file.data_offset as usize + offset as usize;
-        let data_ptr = unsafe {
-            ramdisk.data.as_ptr().add(data_offset)
-        };
-
-        unsafe {
-            core::ptr::copy_nonoverlapping(data_ptr, ptr, to_read);
+        let from = offset as usize;
+        if let Err(e) = usercopy::copy_to_user(ptr as u64, &data[from..from + to_read]) {
+            return err_to_ret(e);
         }
 
         // Update offset in fd_table
         let mut table = PROCESS_TABLE.lock();
-        if let Some(current) = table.current_mut() {
+        if let Some(current) = table.current_group_mut() {
             if let Some(fd_entry) = current.fd_table.get_mut(fd) {
                 if let FdKind::File { ref mut offset, .. } = fd_entry.kind {
                     *offset += to_read as u64;
@@ -1070,54 +2025,50 @@ fn sys_read(args: SyscallArgs) -> SyscallRet {
     }
 }
 
-/// Open a file from the ramdisk
+/// Maximum path length accepted from userspace (excluding the NUL)
+const PATH_MAX: usize = 256;
+
+/// Copy a null-terminated path string in from userspace
+///
+/// Fails on a null or unmapped pointer, or a path longer than PATH_MAX.
+fn read_user_path(path_ptr: *const u8) -> Result<alloc::vec::Vec<u8>, RxStatus> {
+    usercopy::copy_str_from_user(path_ptr as u64, PATH_MAX)
+}
+
+/// Open a file from the ramdisk or tmpfs
 ///
 /// Arguments:
 ///   arg0: pointer to path string (null-terminated, userspace)
-///   arg1: flags (O_RDONLY, O_WRONLY, O_RDWR)
+///   arg1: flags (O_RDONLY, O_WRONLY, O_RDWR, with O_CREAT, O_EXCL,
+///         O_TRUNC and O_APPEND for tmpfs files)
 ///
 /// Returns: file descriptor number, or negative error code
 ///
-/// Phase 5C: This opens files from the embedded ramdisk filesystem.
-/// The path must be a null-terminated string in userspace memory.
+/// Paths under /tmp are tmpfs files, which can be created and written;
+/// every other path is a read-only file of the embedded ramdisk. The
+/// path must be a null-terminated string in userspace memory.
 fn sys_open(args: SyscallArgs) -> SyscallRet {
     use crate::fs::ramdisk::{self, Errno};
     use crate::syscall::fd::{FdKind, flags};
     use crate::process::table::PROCESS_TABLE;
 
-    let path_ptr = args.arg_u64(0) as *const u8;
     let flags_val = args.arg_u32(1);
 
-    // Validate path pointer
-    if path_ptr.is_null() {
-        return err_to_ret(RxStatus::ERR_INVALID_ARGS);
-    }
-
-    // Read null-terminated path string from userspace (max 256 bytes)
-    let mut path_bytes = alloc::vec::Vec::new();
-    unsafe {
-        let mut i = 0;
-        loop {
-            if i >= 256 {
-                return err_to_ret(RxStatus::ERR_INVALID_ARGS); // Path too long
-            }
-            let c = *path_ptr.add(i);
-            if c == 0 {
-                break;
-            }
-            path_bytes.push(c);
-            i += 1;
-        }
-    }
-
-    // Convert to string
+    let path_bytes = match read_user_path(args.arg_u64(0) as *const u8) {
+        Ok(p) => p,
+        Err(e) => return err_to_ret(e),
+    };
     let path = match core::str::from_utf8(&path_bytes) {
         Ok(s) => s,
         Err(_) => return err_to_ret(RxStatus::ERR_INVALID_ARGS),
     };
 
-    // Look up file in ramdisk
-    let ramdisk_file = {
+    if let Some(name) = crate::fs::tmpfs::tmpfs_name(path) {
+        return open_tmpfs(name, flags_val);
+    }
+
+    // Look up file in ramdisk (its index is the inode for offset tracking)
+    let inode = {
         let ramdisk = match ramdisk::get_ramdisk() {
             Ok(r) => r,
             Err(e) => {
@@ -1129,40 +2080,30 @@ fn sys_open(args: SyscallArgs) -> SyscallRet {
             }
         };
 
-        match ramdisk.find_file(path) {
-            Some(f) => f,
+        let index = match ramdisk.find_index(path) {
+            Some(index) => index,
             None => return err_to_ret(RxStatus::ERR_NOT_FOUND), // ENOENT
+        };
+
+        // A compressed file is decompressed here, on first open, so
+        // reads never fail on it
+        if let Some(file) = ramdisk.file(index) {
+            if let Err(e) = ramdisk.file_data(&file) {
+                return err_to_ret(errno_to_status(e));
+            }
         }
+
+        index as u32
     };
 
     // Get the current process and allocate fd
     let fd_result = {
         let mut table = PROCESS_TABLE.lock();
-        let current = match table.current_mut() {
+        let current = match table.current_group_mut() {
             Some(p) => p,
             None => return err_to_ret(RxStatus::ERR_INVALID_ARGS),
         };
 
-        // Find the inode (file index) for offset tracking
-        let inode = {
-            let ramdisk = match ramdisk::get_ramdisk() {
-                Ok(r) => r,
-                Err(_) => return err_to_ret(RxStatus::ERR_NOT_FOUND),
-            };
-
-            let files = unsafe {
-                let base = ramdisk.data.as_ptr().add(ramdisk.superblock.files_offset as usize);
-                let count = ramdisk.superblock.num_files as usize;
-                core::slice::from_raw_parts(base as *const ramdisk::RamdiskFile, count)
-            };
-
-            // Find the index of this file
-            files.iter().position(|&f| {
-                f.data_offset == ramdisk_file.data_offset &&
-                f.name_offset == ramdisk_file.name_offset
-            }).unwrap_or(0) as u32
-        };
-
         // Allocate file descriptor
         match current.fd_table.alloc(
             FdKind::File {
@@ -1179,6 +2120,32 @@ fn sys_open(args: SyscallArgs) -> SyscallRet {
     ok_to_ret(fd_result)
 }
 
+/// Open (or create) a tmpfs file for sys_open
+fn open_tmpfs(name: &str, flags_val: u32) -> SyscallRet {
+    use crate::fs::tmpfs;
+    use crate::process::table::with_current_group_mut;
+    use crate::syscall::fd::{flags, FdKind};
+
+    let create = flags_val & flags::O_CREAT != 0;
+    let exclusive = flags_val & flags::O_EXCL != 0;
+    let inode = match tmpfs::open(name, create, exclusive) {
+        Ok(inode) => inode,
+        Err(e) => return err_to_ret(errno_to_status(e)),
+    };
+
+    if flags_val & flags::O_TRUNC != 0 && flags::writable(flags_val) {
+        if let Err(e) = tmpfs::truncate(inode, 0) {
+            return err_to_ret(errno_to_status(e));
+        }
+    }
+
+    match with_current_group_mut(|p| p.fd_table.alloc(FdKind::TmpFile { inode, offset: 0 }, flags_val)) {
+        Some(Some(fd)) => ok_to_ret(fd as usize),
+        Some(None) => err_to_ret(RxStatus::ERR_NO_MEMORY), // EMFILE
+        None => err_to_ret(RxStatus::ERR_INVALID_ARGS),
+    }
+}
+
 /// Close a file descriptor
 ///
 /// Arguments:
@@ -1191,16 +2158,24 @@ fn sys_open(args: SyscallArgs) -> SyscallRet {
 fn sys_close(args: SyscallArgs) -> SyscallRet {
     use crate::process::table::PROCESS_TABLE;
 
-    let fd = args.arg(0) as u8;
+    let fd = args.arg(0) as Fd;
 
-    let mut table = PROCESS_TABLE.lock();
-    let current = match table.current_mut() {
-        Some(p) => p,
-        None => return err_to_ret(RxStatus::ERR_INVALID_ARGS),
+    let desc = {
+        let mut table = PROCESS_TABLE.lock();
+        let current = match table.current_group_mut() {
+            Some(p) => p,
+            None => return err_to_ret(RxStatus::ERR_INVALID_ARGS),
+        };
+        current.fd_table.close(fd)
     };
 
-    match current.fd_table.close(fd) {
-        Some(_) => ok_to_ret(0),
+    // Objects are closed without the process table lock: closing wakes
+    // waiters, which takes it
+    match desc {
+        Some(desc) => {
+            release_object(desc.kind);
+            ok_to_ret(0)
+        }
         None => err_to_ret(RxStatus::ERR_INVALID_ARGS), // EBADF
     }
 }
@@ -1220,7 +2195,7 @@ fn sys_lseek(args: SyscallArgs) -> SyscallRet {
     use crate::fs::ramdisk;
     use crate::process::table::PROCESS_TABLE;
 
-    let fd = args.arg(0) as u8;
+    let fd = args.arg(0) as Fd;
     let offset = args.arg_i64(1);
     let whence = args.arg(2) as u32;
 
@@ -1232,7 +2207,7 @@ fn sys_lseek(args: SyscallArgs) -> SyscallRet {
     // Get current offset and file info
     let (current_offset, file_size) = {
         let table = PROCESS_TABLE.lock();
-        let current = match table.current() {
+        let current = match table.current_group() {
             Some(p) => p,
             None => return err_to_ret(RxStatus::ERR_INVALID_ARGS),
         };
@@ -1250,19 +2225,17 @@ fn sys_lseek(args: SyscallArgs) -> SyscallRet {
                     Err(_) => return err_to_ret(RxStatus::ERR_NOT_FOUND),
                 };
 
-                let files = unsafe {
-                    let base = ramdisk.data.as_ptr().add(ramdisk.superblock.files_offset as usize);
-                    let count = ramdisk.superblock.num_files as usize;
-                    core::slice::from_raw_parts(base as *const ramdisk::RamdiskFile, count)
-                };
-
-                let file = match files.get(inode as usize) {
-                    Some(&f) => f,
+                let file = match ramdisk.file(inode as usize) {
+                    Some(f) => f,
                     None => return err_to_ret(RxStatus::ERR_INVALID_ARGS),
                 };
 
                 (offset, file.size as i64)
             }
+            FdKind::TmpFile { inode, offset } => match crate::fs::tmpfs::size(inode) {
+                Ok(size) => (offset, size as i64),
+                Err(e) => return err_to_ret(errno_to_status(e)),
+            },
             _ => {
                 // Cannot seek on stdin/stdout/stderr
                 return err_to_ret(RxStatus::ERR_INVALID_ARGS); // ESPIPE
@@ -1309,13 +2282,13 @@ fn sys_lseek(args: SyscallArgs) -> SyscallRet {
     // Update offset in fd_table
     {
         let mut table = PROCESS_TABLE.lock();
-        let current = match table.current_mut() {
+        let current = match table.current_group_mut() {
             Some(p) => p,
             None => return err_to_ret(RxStatus::ERR_INVALID_ARGS),
         };
 
         if let Some(fd_entry) = current.fd_table.get_mut(fd) {
-            if let FdKind::File { ref mut offset, .. } = fd_entry.kind {
+            if let FdKind::File { ref mut offset, .. } | FdKind::TmpFile { ref mut offset, .. } = fd_entry.kind {
                 *offset = clamped_offset;
             }
         }
@@ -1324,6 +2297,322 @@ fn sys_lseek(args: SyscallArgs) -> SyscallRet {
     ok_to_ret_isize(clamped_offset as isize)
 }
 
+// ============================================================================
+// Vectored and Batched I/O
+// ============================================================================
+
+/// Maximum number of iovecs accepted by sys_writev/sys_readv
+pub const IOV_MAX: usize = 64;
+
+/// I/O vector (matches `struct rx_iovec` in syscall.h)
+#[repr(C)]
+#[derive(Debug, Clone, Copy)]
+pub struct IoVec {
+    /// Buffer address
+    pub base: u64,
+    /// Buffer length in bytes
+    pub len: u64,
+}
+
+/// Copy an iovec array in from userspace
+fn copy_iovecs(iov_ptr: u64, iovcnt: usize) -> Result<alloc::vec::Vec<IoVec>, RxStatus> {
+    if iovcnt > IOV_MAX {
+        return Err(RxStatus::ERR_INVALID_ARGS);
+    }
+    usercopy::copy_records_from_user(iov_ptr, iovcnt)
+}
+
+/// Gather-write an iovec array to `fd`
+///
+/// Returns the total bytes written. An error after some data has been
+/// written returns the partial count instead, like POSIX writev.
+fn writev_fd(fd: Fd, iov_ptr: u64, iovcnt: usize) -> SyscallRet {
+    let iovs = match copy_iovecs(iov_ptr, iovcnt) {
+        Ok(v) => v,
+        Err(e) => return err_to_ret(e),
+    };
+
+    let mut total: isize = 0;
+    for iov in iovs.iter().filter(|iov| iov.len > 0) {
+        let ret = write_fd(fd, iov.base as *const u8, iov.len as usize);
+        if ret < 0 {
+            return if total > 0 { ok_to_ret_isize(total) } else { ret };
+        }
+        total += ret;
+        if (ret as u64) < iov.len {
+            break;
+        }
+    }
+
+    ok_to_ret_isize(total)
+}
+
+/// Scatter-read from `fd` into an iovec array
+///
+/// Stops at the first short read (EOF, or a single stdin character).
+fn readv_fd(fd: Fd, iov_ptr: u64, iovcnt: usize) -> SyscallRet {
+    let iovs = match copy_iovecs(iov_ptr, iovcnt) {
+        Ok(v) => v,
+        Err(e) => return err_to_ret(e),
+    };
+
+    let mut total: isize = 0;
+    for iov in iovs.iter().filter(|iov| iov.len > 0) {
+        let ret = read_fd(fd, iov.base as *mut u8, iov.len as usize);
+        if ret < 0 {
+            return if total > 0 { ok_to_ret_isize(total) } else { ret };
+        }
+        total += ret;
+        if (ret as u64) < iov.len {
+            break;
+        }
+    }
+
+    ok_to_ret_isize(total)
+}
+
+/// Vectored write
+///
+/// Arguments:
+///   arg0: file descriptor (fd)
+///   arg1: pointer to struct rx_iovec array
+///   arg2: number of iovecs (at most IOV_MAX)
+///
+/// Returns: total bytes written, or negative error code
+fn sys_writev(args: SyscallArgs) -> SyscallRet {
+    writev_fd(args.arg(0) as Fd, args.arg_u64(1), args.arg(2))
+}
+
+/// Vectored read
+///
+/// Arguments:
+///   arg0: file descriptor (fd)
+///   arg1: pointer to struct rx_iovec array
+///   arg2: number of iovecs (at most IOV_MAX)
+///
+/// Returns: total bytes read, or negative error code
+fn sys_readv(args: SyscallArgs) -> SyscallRet {
+    readv_fd(args.arg(0) as Fd, args.arg_u64(1), args.arg(2))
+}
+
+/// Map a VMO into the current process's kernel-managed mapping region
+///
+/// Returns the userspace address of the mapping.
+fn map_into_current(vmo: &crate::object::Vmo, flags: u32) -> Result<u64, RxStatus> {
+    use crate::process::address_space::AddressSpace;
+    use crate::process::table::PROCESS_TABLE;
+
+    let size = vmo.size() as u64;
+
+    let mut table = PROCESS_TABLE.lock();
+    let current = table.current_group_mut().ok_or(RxStatus::ERR_INVALID_ARGS)?;
+
+    let vaddr = current.mmap_next;
+    AddressSpace::from_page_table(current.page_table)
+        .map_vmo(vmo, vaddr, size, flags)
+        .map_err(|_| RxStatus::ERR_NO_MEMORY)?;
+
+    // Leave an unmapped guard page between mappings
+    current.mmap_next = vaddr + size + 4096;
+    Ok(vaddr)
+}
+
+/// Set up the batched I/O submission ring for the current process
+///
+/// Arguments:
+///   arg0: requested entries per queue (rounded up to a power of two,
+///         at most ring::RING_MAX_ENTRIES)
+///
+/// Returns: userspace address of the ring header, or negative error code
+///
+/// Each process has at most one ring; see `ring` for the layout.
+fn sys_ring_setup(args: SyscallArgs) -> SyscallRet {
+    use crate::exec::elf::{PF_R, PF_W};
+    use crate::process::table::with_current_group;
+
+    let entries = match ring::ring_entries(args.arg_u32(0)) {
+        Some(n) => n,
+        None => return err_to_ret(RxStatus::ERR_INVALID_ARGS),
+    };
+
+    match with_current_group(|p| p.io_ring.is_some()) {
+        Some(false) => {}
+        Some(true) => return err_to_ret(RxStatus::ERR_BUSY),
+        None => return err_to_ret(RxStatus::ERR_INVALID_ARGS),
+    }
+
+    let vmo = match ring::create_ring_vmo(entries) {
+        Ok(v) => v,
+        Err(e) => return err_to_ret(e),
+    };
+
+    let user_addr = match map_into_current(&vmo, PF_R | PF_W) {
+        Ok(addr) => addr,
+        Err(e) => return err_to_ret(e),
+    };
+
+    crate::process::table::with_current_group_mut(|p| {
+        p.io_ring = Some(ring::IoRing { user_addr, entries });
+    });
+
+    ok_to_ret(user_addr as usize)
+}
+
+/// Submit queued ring operations
+///
+/// Arguments:
+///   arg0: maximum number of submissions to consume
+///
+/// Returns: number of submissions consumed (each has a completion in the
+/// ring), or negative error code
+fn sys_ring_enter(args: SyscallArgs) -> SyscallRet {
+    use crate::process::table::with_current_group;
+
+    // Copy the ring state out so no lock is held while operations run
+    let io_ring = match with_current_group(|p| p.io_ring) {
+        Some(Some(r)) => r,
+        _ => return err_to_ret(RxStatus::ERR_NOT_FOUND),
+    };
+
+    io_ring.enter(args.arg_u32(0))
+}
+
+/// Map a ramdisk or tmpfs file read-only into the current process
+///
+/// Arguments:
+///   arg0: pointer to path string (null-terminated, userspace)
+///   arg1: optional pointer to a u64 that receives the file size
+///
+/// Returns: userspace address of the file contents, or negative error code
+///
+/// The mapping covers the file rounded up to whole pages; bytes past the
+/// end of the file read as zero. Ramdisk pages are mapped in place, so no
+/// data is copied. If the image is not page-aligned the file is copied
+/// into a fresh VMO instead, with the same result for the caller. A
+/// compressed ramdisk file maps its decompressed pages.
+///
+/// A tmpfs file maps its page cache: later writes to the mapped pages
+/// show through the mapping, which keeps the size it had when mapped.
+fn sys_map_file(args: SyscallArgs) -> SyscallRet {
+    use crate::exec::elf::PF_R;
+    use crate::fs::ramdisk;
+    use crate::object::{Vmo, VmoFlags};
+
+    // Checked before anything is mapped, so a bad pointer maps nothing
+    let size_ptr = args.arg_u64(1);
+    if size_ptr != 0 {
+        if let Err(e) = usercopy::copy_to_user(size_ptr, &0u64.to_ne_bytes()) {
+            return err_to_ret(e);
+        }
+    }
+
+    let path_bytes = match read_user_path(args.arg_u64(0) as *const u8) {
+        Ok(p) => p,
+        Err(e) => return err_to_ret(e),
+    };
+    let path = match core::str::from_utf8(&path_bytes) {
+        Ok(s) => s,
+        Err(_) => return err_to_ret(RxStatus::ERR_INVALID_ARGS),
+    };
+
+    if let Some(name) = crate::fs::tmpfs::tmpfs_name(path) {
+        return map_tmpfs_file(name, size_ptr);
+    }
+
+    let ramdisk = match ramdisk::get_ramdisk() {
+        Ok(r) => r,
+        Err(_) => return err_to_ret(RxStatus::ERR_NOT_FOUND),
+    };
+    let file = match ramdisk.find_file(path) {
+        Some(f) => f,
+        None => return err_to_ret(RxStatus::ERR_NOT_FOUND),
+    };
+
+    // There is nothing to map for an empty file
+    if file.size == 0 {
+        return err_to_ret(RxStatus::ERR_INVALID_ARGS);
+    }
+
+    let data = match ramdisk.file_data(&file) {
+        Ok(data) => data,
+        Err(e) => return err_to_ret(errno_to_status(e)),
+    };
+    let in_place = if ramdisk.file_mappable(&file) {
+        crate::mm::pmm::vaddr_to_paddr(data.as_ptr() as usize)
+    } else {
+        None
+    };
+
+    let vmo = match in_place {
+        Some(paddr) => Vmo::from_physical(paddr, data.len(), false),
+        None => Vmo::create(data.len(), VmoFlags::empty)
+            .and_then(|vmo| vmo.write(0, data).map(|_| vmo)),
+    };
+    let vmo = match vmo {
+        Ok(v) => v,
+        Err(_) => return err_to_ret(RxStatus::ERR_NO_MEMORY),
+    };
+
+    let user_addr = match map_into_current(&vmo, PF_R) {
+        Ok(addr) => addr,
+        Err(e) => return err_to_ret(e),
+    };
+
+    store_map_size(size_ptr, data.len() as u64, user_addr)
+}
+
+/// Map a tmpfs file's pages for sys_map_file
+fn map_tmpfs_file(name: &str, size_ptr: u64) -> SyscallRet {
+    use crate::exec::elf::PF_R;
+    use crate::fs::tmpfs;
+    use crate::mm::pmm;
+    use crate::object::Vmo;
+
+    let inode = match tmpfs::open(name, false, false) {
+        Ok(inode) => inode,
+        Err(e) => return err_to_ret(errno_to_status(e)),
+    };
+    // Each page comes with a reference for the mapping
+    let (pages, size) = match tmpfs::map_pages(inode) {
+        Ok(p) => p,
+        Err(e) => return err_to_ret(errno_to_status(e)),
+    };
+
+    let mapped = if pages.is_empty() {
+        // There is nothing to map for an empty file
+        Err(RxStatus::ERR_INVALID_ARGS)
+    } else {
+        Vmo::from_pages(&pages, false)
+            .map_err(|_| RxStatus::ERR_NO_MEMORY)
+            .and_then(|vmo| map_into_current(&vmo, PF_R))
+    };
+    let user_addr = match mapped {
+        Ok(addr) => addr,
+        Err(e) => {
+            for &paddr in pages.iter() {
+                pmm::pmm_page_unref(paddr);
+            }
+            return err_to_ret(e);
+        }
+    };
+
+    store_map_size(size_ptr, size, user_addr)
+}
+
+/// Store a mapped file's size for sys_map_file, if asked for
+///
+/// # Returns
+///
+/// The mapping's address, or the error of the store
+fn store_map_size(size_ptr: u64, size: u64, user_addr: u64) -> SyscallRet {
+    if size_ptr != 0 {
+        if let Err(e) = usercopy::copy_to_user(size_ptr, &size.to_ne_bytes()) {
+            return err_to_ret(e);
+        }
+    }
+    ok_to_ret(user_addr as usize)
+}
+
 // ============================================================================
 // Process Info Syscalls (Phase 5A)
 // ============================================================================
@@ -1334,11 +2623,12 @@ fn sys_lseek(args: SyscallArgs) -> SyscallRet {
 ///
 /// Returns: process ID (PID)
 ///
-/// Returns the PID of the currently running process.
+/// Returns the PID of the currently running process (the same for all of
+/// its threads: the ID of the first one).
 fn sys_getpid(_args: SyscallArgs) -> SyscallRet {
-    use crate::sched::round_robin;
+    use crate::process::table::with_current_process;
 
-    match round_robin::get_current_pid() {
+    match with_current_process(|p| p.tgid) {
         Some(pid) => ok_to_ret(pid as usize),
         None => {
             // No current process - return kernel PID (0)
@@ -1403,6 +2693,84 @@ fn sys_yield(_args: SyscallArgs) -> SyscallRet {
     }
 }
 
+/// Set scheduling priority
+///
+/// Arguments:
+///   arg0: PID (0 = current process)
+///   arg1: priority (0 = lowest, 31 = highest, 16 = default)
+///
+/// Returns: previous priority, or negative error code
+///
+/// Higher-priority ready processes always run first; processes of equal
+/// priority share the CPU round-robin.
+fn sys_set_priority(args: SyscallArgs) -> SyscallRet {
+    use crate::process::table::PRIORITY_MAX;
+    use crate::sched::round_robin;
+
+    let pid = args.arg_u32(0);
+    let priority = args.arg(1);
+
+    if priority > PRIORITY_MAX as usize {
+        return err_to_ret(RxStatus::ERR_INVALID_ARGS);
+    }
+
+    let pid = if pid == 0 {
+        match round_robin::get_current_pid() {
+            Some(pid) => pid,
+            None => return err_to_ret(RxStatus::ERR_NOT_FOUND),
+        }
+    } else {
+        pid
+    };
+
+    match round_robin::set_priority(pid, priority as u8) {
+        Some(old) => ok_to_ret(old as usize),
+        None => err_to_ret(RxStatus::ERR_NOT_FOUND),
+    }
+}
+
+/// Set the CPU affinity of a process
+///
+/// Arguments:
+///   arg0: PID (0 = current process)
+///   arg1: CPU mask (bit N = CPU N may run it; 0 = query only)
+///
+/// Returns: previous mask, or negative error code
+///
+/// The mask must include at least one online CPU.
+fn sys_set_affinity(args: SyscallArgs) -> SyscallRet {
+    use crate::arch::amd64::percpu;
+    use crate::sched::round_robin;
+    use crate::sched::runqueue::RUN_QUEUES;
+
+    let pid = args.arg_u32(0);
+    let mask = args.arg(1) as u64;
+
+    let pid = if pid == 0 {
+        match round_robin::get_current_pid() {
+            Some(pid) => pid,
+            None => return err_to_ret(RxStatus::ERR_NOT_FOUND),
+        }
+    } else {
+        pid
+    };
+
+    if mask == 0 {
+        return match RUN_QUEUES.task(pid) {
+            Some(task) => ok_to_ret(task.affinity as usize),
+            None => err_to_ret(RxStatus::ERR_NOT_FOUND),
+        };
+    }
+    if mask & percpu::online_mask() == 0 {
+        return err_to_ret(RxStatus::ERR_INVALID_ARGS);
+    }
+
+    match round_robin::set_affinity(pid, mask) {
+        Some(old) => ok_to_ret(old as usize),
+        None => err_to_ret(RxStatus::ERR_NOT_FOUND),
+    }
+}
+
 /// ============================================================================
 /// Module Initialization
 /// ============================================================================
@@ -1446,6 +2814,12 @@ pub mod number {
     pub const OBJECT_SIGNAL: u32 = 0x25;
     pub const OBJECT_WAIT_ONE: u32 = 0x26;
     pub const OBJECT_WAIT_MANY: u32 = 0x27;
+    pub const PORT_CREATE: u32 = 0x28;      // Create a port (waitset)
+    pub const PORT_WAIT_ASYNC: u32 = 0x29;  // Watch an object through a port
+    pub const PORT_WAIT: u32 = 0x2A;        // Dequeue ready packets
+    pub const PORT_QUEUE: u32 = 0x2B;       // Queue a user packet
+    pub const FUTEX_WAIT: u32 = 0x2C;       // Sleep while a user word holds a value
+    pub const FUTEX_WAKE: u32 = 0x2D;       // Wake sleepers on a user word
 
     /// Jobs & Handles (0x30-0x3F)
     pub const JOB_CREATE: u32 = 0x30;
@@ -1460,6 +2834,7 @@ pub mod number {
 
     /// Debug (0x50-0x5F)
     pub const DEBUG_WRITE: u32 = 0x50;
+    pub const STATS: u32 = 0x51;  // Snapshot kernel accounting
 
     /// I/O (0x60-0x6F) - Phase 5A
     pub const WRITE: u32 = 0x60;
@@ -1467,14 +2842,21 @@ pub mod number {
     pub const OPEN: u32 = 0x62;
     pub const CLOSE: u32 = 0x63;
     pub const LSEEK: u32 = 0x64;
+    pub const WRITEV: u32 = 0x65;
+    pub const READV: u32 = 0x66;
+    pub const RING_SETUP: u32 = 0x67;  // Map a batched I/O submission ring
+    pub const RING_ENTER: u32 = 0x68;  // Submit queued ring operations
+    pub const MAP_FILE: u32 = 0x69;    // Map a ramdisk file read-only
 
     /// Process Info (0x70-0x7F) - Phase 5A
     pub const GETPID: u32 = 0x70;
     pub const GETPPID: u32 = 0x71;
     pub const YIELD: u32 = 0x72;
+    pub const SET_PRIORITY: u32 = 0x73;  // Set scheduling priority
+    pub const SET_AFFINITY: u32 = 0x74;  // Restrict a process to a CPU set
 
     /// Maximum defined syscall number
-    pub const MAX_SYSCALL: u32 = 0x72;
+    pub const MAX_SYSCALL: u32 = 0x74;
 }
 
 #[cfg(test)]
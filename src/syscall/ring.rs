@@ -0,0 +1,273 @@
+// Copyright 2025 The Rustux Authors
+//
+// Use of this source code is governed by a MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT
+
+//! Batched I/O Submission Ring
+//!
+//! A per-process shared-memory ring that lets userspace queue several I/O
+//! operations and hand them all to the kernel with a single
+//! `SYS_RING_ENTER` trap. Completions are written back into the same
+//! ring.
+//!
+//! # Layout
+//!
+//! The ring is a VMO mapped read/write into the process by
+//! `SYS_RING_SETUP`:
+//!
+//! ```text
+//! +0              RingHeader (64 bytes)
+//! +sqe_offset     RingSqe[entries]   (submission queue, 32 bytes each)
+//! +cqe_offset     RingCqe[entries]   (completion queue, 16 bytes each)
+//! ```
+//!
+//! # Protocol
+//!
+//! - Userspace fills `sqes[sq_tail & mask]`, then bumps `sq_tail`
+//! - The kernel consumes from `sq_head` and bumps it
+//! - The kernel writes `cqes[cq_tail & mask]`, then bumps `cq_tail`
+//! - Userspace consumes from `cq_head` and bumps it
+//!
+//! Indices are free-running u32 counters; `entries` is a power of two.
+//! The kernel only consumes a submission when there is room for its
+//! completion, so the completion queue can never overflow.
+
+use core::sync::atomic::{AtomicU32, Ordering};
+
+use super::fd::Fd;
+use super::{err_to_ret, SyscallRet};
+use crate::arch::amd64::mm::RxStatus;
+use crate::object::{Vmo, VmoFlags};
+
+/// Maximum number of ring entries
+pub const RING_MAX_ENTRIES: u32 = 256;
+
+/// Size of the ring header in bytes
+pub const RING_HEADER_SIZE: usize = 64;
+
+/// Ring operation codes
+pub mod op {
+    /// No operation (completes with 0)
+    pub const NOP: u8 = 0;
+    /// write(fd, addr, len)
+    pub const WRITE: u8 = 1;
+    /// read(fd, addr, len)
+    pub const READ: u8 = 2;
+    /// writev(fd, iov = addr, iovcnt = len)
+    pub const WRITEV: u8 = 3;
+    /// readv(fd, iov = addr, iovcnt = len)
+    pub const READV: u8 = 4;
+}
+
+/// Shared ring header
+#[repr(C)]
+pub struct RingHeader {
+    /// Next submission the kernel will consume (written by kernel)
+    pub sq_head: AtomicU32,
+    /// Next free submission slot (written by userspace)
+    pub sq_tail: AtomicU32,
+    /// Next completion userspace will consume (written by userspace)
+    pub cq_head: AtomicU32,
+    /// Next free completion slot (written by kernel)
+    pub cq_tail: AtomicU32,
+    /// Number of entries in each queue (power of two)
+    pub entries: u32,
+    /// Byte offset of the submission queue
+    pub sqe_offset: u32,
+    /// Byte offset of the completion queue
+    pub cqe_offset: u32,
+    /// Reserved (pads the header to 64 bytes)
+    pub _reserved: [u32; 9],
+}
+
+/// Submission queue entry
+#[repr(C)]
+#[derive(Debug, Clone, Copy)]
+pub struct RingSqe {
+    /// Operation (see `op`)
+    pub opcode: u8,
+    /// Operation flags (must be zero)
+    pub flags: u8,
+    /// Reserved
+    pub _pad: u16,
+    /// File descriptor
+    pub fd: i32,
+    /// Buffer or iovec array address
+    pub addr: u64,
+    /// Buffer length or iovec count
+    pub len: u64,
+    /// Opaque value copied to the completion
+    pub user_data: u64,
+}
+
+/// Completion queue entry
+#[repr(C)]
+#[derive(Debug, Clone, Copy)]
+pub struct RingCqe {
+    /// `user_data` of the submission
+    pub user_data: u64,
+    /// Syscall-style result (bytes transferred or negative error)
+    pub result: i64,
+}
+
+/// Per-process ring state
+#[derive(Debug, Clone, Copy)]
+pub struct IoRing {
+    /// Userspace address of the ring header
+    pub user_addr: u64,
+    /// Number of entries in each queue
+    pub entries: u32,
+}
+
+/// Byte offset of the submission queue
+const fn sqe_offset() -> usize {
+    RING_HEADER_SIZE
+}
+
+/// Byte offset of the completion queue for a given entry count
+const fn cqe_offset(entries: u32) -> usize {
+    sqe_offset() + entries as usize * core::mem::size_of::<RingSqe>()
+}
+
+/// Total ring size in bytes for a given entry count
+pub const fn ring_size(entries: u32) -> usize {
+    cqe_offset(entries) + entries as usize * core::mem::size_of::<RingCqe>()
+}
+
+/// Round a requested entry count to a valid ring size
+///
+/// Returns None for 0 or counts above `RING_MAX_ENTRIES`.
+pub fn ring_entries(requested: u32) -> Option<u32> {
+    if requested == 0 || requested > RING_MAX_ENTRIES {
+        return None;
+    }
+    Some(requested.next_power_of_two())
+}
+
+/// Create the VMO backing a ring and write its initial header
+///
+/// All pages are committed up front so the mapping never faults.
+pub fn create_ring_vmo(entries: u32) -> Result<Vmo, RxStatus> {
+    let size = ring_size(entries);
+    let vmo = Vmo::create(size, VmoFlags::empty).map_err(|_| RxStatus::ERR_NO_MEMORY)?;
+
+    // Commit zeroed pages
+    let zero_page = [0u8; 4096];
+    let mut offset = 0;
+    while offset < vmo.size() {
+        vmo.write(offset, &zero_page).map_err(|_| RxStatus::ERR_NO_MEMORY)?;
+        offset += zero_page.len();
+    }
+
+    let header = RingHeader {
+        sq_head: AtomicU32::new(0),
+        sq_tail: AtomicU32::new(0),
+        cq_head: AtomicU32::new(0),
+        cq_tail: AtomicU32::new(0),
+        entries,
+        sqe_offset: sqe_offset() as u32,
+        cqe_offset: cqe_offset(entries) as u32,
+        _reserved: [0; 9],
+    };
+    let header_bytes = unsafe {
+        core::slice::from_raw_parts(&header as *const RingHeader as *const u8, RING_HEADER_SIZE)
+    };
+    vmo.write(0, header_bytes).map_err(|_| RxStatus::ERR_NO_MEMORY)?;
+
+    Ok(vmo)
+}
+
+impl IoRing {
+    /// Consume up to `to_submit` submissions and post their completions
+    ///
+    /// Runs in the submitting process's address space, so the ring is
+    /// accessed through its user mapping. Returns the number of
+    /// submissions consumed.
+    pub fn enter(&self, to_submit: u32) -> SyscallRet {
+        let base = self.user_addr as *mut u8;
+        let header = unsafe { &*(base as *const RingHeader) };
+        let mask = self.entries - 1;
+
+        let sqes = unsafe { base.add(sqe_offset()) as *const RingSqe };
+        let cqes = unsafe { base.add(cqe_offset(self.entries)) as *mut RingCqe };
+
+        let mut sq_head = header.sq_head.load(Ordering::Relaxed);
+        let sq_tail = header.sq_tail.load(Ordering::Acquire);
+        let mut cq_tail = header.cq_tail.load(Ordering::Relaxed);
+
+        // A corrupted header (more pending than slots) is a caller error
+        let pending = sq_tail.wrapping_sub(sq_head);
+        if pending > self.entries {
+            return err_to_ret(RxStatus::ERR_INVALID_ARGS);
+        }
+
+        let mut submitted = 0u32;
+        while submitted < to_submit && sq_head != sq_tail {
+            // Never consume a submission whose completion has nowhere to go
+            let cq_head = header.cq_head.load(Ordering::Acquire);
+            if cq_tail.wrapping_sub(cq_head) >= self.entries {
+                break;
+            }
+
+            let sqe = unsafe { sqes.add((sq_head & mask) as usize).read_volatile() };
+            let result = execute(&sqe);
+
+            unsafe {
+                cqes.add((cq_tail & mask) as usize).write_volatile(RingCqe {
+                    user_data: sqe.user_data,
+                    result: result as i64,
+                });
+            }
+
+            sq_head = sq_head.wrapping_add(1);
+            cq_tail = cq_tail.wrapping_add(1);
+            submitted += 1;
+
+            // Publish as we go so a blocking read later in the batch does
+            // not hide completed work
+            header.sq_head.store(sq_head, Ordering::Release);
+            header.cq_tail.store(cq_tail, Ordering::Release);
+        }
+
+        submitted as SyscallRet
+    }
+}
+
+/// Execute one submission with the same semantics as the direct syscall
+fn execute(sqe: &RingSqe) -> SyscallRet {
+    if sqe.flags != 0 || sqe.fd < 0 {
+        return err_to_ret(RxStatus::ERR_INVALID_ARGS);
+    }
+    let fd = sqe.fd as Fd;
+
+    match sqe.opcode {
+        op::NOP => 0,
+        op::WRITE => super::write_fd(fd, sqe.addr as *const u8, sqe.len as usize),
+        op::READ => super::read_fd(fd, sqe.addr as *mut u8, sqe.len as usize),
+        op::WRITEV => super::writev_fd(fd, sqe.addr, sqe.len as usize),
+        op::READV => super::readv_fd(fd, sqe.addr, sqe.len as usize),
+        _ => err_to_ret(RxStatus::ERR_NOT_SUPPORTED),
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    #[test]
+    fn test_ring_abi_sizes() {
+        // Shared with userspace (syscall.h) - must not change
+        assert_eq!(core::mem::size_of::<RingHeader>(), RING_HEADER_SIZE);
+        assert_eq!(core::mem::size_of::<RingSqe>(), 32);
+        assert_eq!(core::mem::size_of::<RingCqe>(), 16);
+    }
+
+    #[test]
+    fn test_ring_entries() {
+        assert_eq!(ring_entries(0), None);
+        assert_eq!(ring_entries(5), Some(8));
+        assert_eq!(ring_entries(RING_MAX_ENTRIES), Some(RING_MAX_ENTRIES));
+        assert_eq!(ring_entries(RING_MAX_ENTRIES + 1), None);
+    }
+}
@@ -0,0 +1,358 @@
+// Copyright 2025 The Rustux Authors
+//
+// Use of this source code is governed by a MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT
+
+//! Kernel Accounting
+//!
+//! Per-syscall latency counters and the snapshots `SYS_STATS` copies out
+//! to userspace.
+//!
+//! Boot phase markers (`crate::boot`) are copied out as well.
+//!
+//! # Syscall Counters
+//!
+//! `syscall_dispatch` times every call with the TSC and records it here:
+//! a call count, total and maximum cycles, and a log2 latency histogram
+//! per syscall number. Each CPU has its own counters, so recording never
+//! shares a cache line with another CPU; snapshots sum them.
+//!
+//! Blocking calls count the time spent blocked: the numbers are latency
+//! as the caller sees it, not CPU time. CPU time is charged per process
+//! at context switch (`QueueGuard::account_switch`).
+
+use alloc::vec::Vec;
+use core::sync::atomic::{AtomicU32, AtomicU64, Ordering};
+
+use super::number::MAX_SYSCALL;
+use crate::arch::amd64::percpu::{self, MAX_CPUS};
+use crate::arch::amd64::tsc;
+use crate::boot;
+use crate::exec::image_cache;
+use crate::mm::pmm;
+use crate::process::table::{Process, ProcessState, PROCESS_TABLE};
+use crate::sched::round_robin;
+use crate::sched::runqueue::{Task, RUN_QUEUES};
+
+/// Number of syscall slots counted (0 to MAX_SYSCALL)
+pub const NUM_SYSCALLS: usize = MAX_SYSCALL as usize + 1;
+
+/// Latency histogram buckets per syscall
+pub const HIST_BUCKETS: usize = 20;
+
+/// Bucket 0 holds calls under 2^HIST_MIN_SHIFT cycles; bucket N > 0
+/// holds [2^(HIST_MIN_SHIFT+N-1), 2^(HIST_MIN_SHIFT+N)), and the last
+/// bucket everything above
+pub const HIST_MIN_SHIFT: u32 = 7;
+
+/// Snapshot kinds (arg0 of SYS_STATS)
+pub mod kind {
+    /// One `SystemStat`
+    pub const SYSTEM: u32 = 0;
+    /// A `SyscallStat` for each syscall called at least once
+    pub const SYSCALLS: u32 = 1;
+    /// A `ProcessStat` for each process
+    pub const PROCESSES: u32 = 2;
+    /// A `BootPhaseStat` for each boot phase marker
+    pub const BOOT: u32 = 3;
+}
+
+/// ============================================================================
+/// Snapshot Records (shared with userspace, see syscall.h)
+/// ============================================================================
+
+/// System-wide totals
+#[repr(C)]
+#[derive(Debug, Clone, Copy, Default)]
+pub struct SystemStat {
+    /// Nanoseconds since reset
+    pub uptime_ns: u64,
+    /// TSC frequency in Hz (converts the cycle counts below)
+    pub tsc_hz: u64,
+    /// Context switches on all CPUs
+    pub context_switches: u64,
+    /// Syscalls made on all CPUs
+    pub syscalls: u64,
+    /// Free physical pages
+    pub free_pages: u64,
+    /// Physical pages managed by the PMM
+    pub total_pages: u64,
+    /// Online CPUs
+    pub cpus: u32,
+    /// Processes in the process table
+    pub processes: u32,
+    /// Programs in the spawn image cache
+    pub cached_images: u32,
+    pub reserved: u32,
+}
+
+/// Counters of one syscall number, summed over CPUs
+#[repr(C)]
+#[derive(Debug, Clone, Copy, Default)]
+pub struct SyscallStat {
+    /// Syscall number
+    pub number: u32,
+    pub reserved: u32,
+    /// Calls made
+    pub count: u64,
+    /// TSC cycles spent in all calls
+    pub total_cycles: u64,
+    /// Slowest call, in TSC cycles
+    pub max_cycles: u64,
+    /// Calls per latency bucket (see `HIST_MIN_SHIFT`)
+    pub histogram: [u32; HIST_BUCKETS],
+}
+
+/// One process
+#[repr(C)]
+#[derive(Debug, Clone, Copy, Default)]
+pub struct ProcessStat {
+    pub pid: u32,
+    pub ppid: u32,
+    /// 0 ready, 1 running, 2 blocked, 3 zombie, 4 dead
+    pub state: u8,
+    pub priority: u8,
+    pub reserved: u16,
+    /// CPU it runs (or last ran) on
+    pub cpu: u32,
+    /// TSC cycles spent running, including the current run
+    pub cpu_cycles: u64,
+    /// Times switched in
+    pub context_switches: u64,
+    /// Process name, NUL-padded (truncated to 15 bytes)
+    pub name: [u8; 16],
+}
+
+impl ProcessStat {
+    /// Snapshot a process and its scheduling state on `cpu` at TSC `now`
+    fn of(process: &Process, task: &Task, cpu: u32, now: u64) -> Self {
+        let mut cpu_cycles = task.cpu_time;
+        if task.state == ProcessState::Running && task.sched_time != 0 {
+            cpu_cycles += now.saturating_sub(task.sched_time);
+        }
+
+        let mut name = [0u8; 16];
+        if let Some(n) = process.get_name() {
+            let len = n.len().min(name.len() - 1);
+            name[..len].copy_from_slice(&n.as_bytes()[..len]);
+        }
+
+        Self {
+            pid: process.pid,
+            ppid: process.ppid,
+            state: match task.state {
+                ProcessState::Ready => 0,
+                ProcessState::Running => 1,
+                ProcessState::Blocked => 2,
+                ProcessState::Zombie => 3,
+                ProcessState::Dead => 4,
+            },
+            priority: task.priority,
+            reserved: 0,
+            cpu,
+            cpu_cycles,
+            context_switches: task.context_switches,
+            name,
+        }
+    }
+}
+
+/// The end of one boot phase
+#[repr(C)]
+#[derive(Debug, Clone, Copy, Default)]
+pub struct BootPhaseStat {
+    /// TSC when the phase ended (counts from reset)
+    pub tsc: u64,
+    /// The same, in nanoseconds since reset
+    pub ns: u64,
+    /// CPU that ran the phase
+    pub cpu: u32,
+    pub reserved: u32,
+    /// Phase name, NUL-padded (truncated to 15 bytes)
+    pub name: [u8; 16],
+}
+
+/// ============================================================================
+/// Syscall Counters
+/// ============================================================================
+
+/// Counters of one syscall number on one CPU
+struct SyscallCounter {
+    count: AtomicU64,
+    cycles: AtomicU64,
+    max_cycles: AtomicU64,
+    histogram: [AtomicU32; HIST_BUCKETS],
+}
+
+impl SyscallCounter {
+    const fn new() -> Self {
+        const ZERO: AtomicU32 = AtomicU32::new(0);
+        Self {
+            count: AtomicU64::new(0),
+            cycles: AtomicU64::new(0),
+            max_cycles: AtomicU64::new(0),
+            histogram: [ZERO; HIST_BUCKETS],
+        }
+    }
+}
+
+/// Counters of one CPU (cache-line aligned so CPUs never share a line)
+#[repr(align(64))]
+struct CpuCounters([SyscallCounter; NUM_SYSCALLS]);
+
+static COUNTERS: [CpuCounters; MAX_CPUS] = {
+    const COUNTER: SyscallCounter = SyscallCounter::new();
+    const CPU: CpuCounters = CpuCounters([COUNTER; NUM_SYSCALLS]);
+    [CPU; MAX_CPUS]
+};
+
+/// Histogram bucket of a call that took `cycles`
+pub fn bucket(cycles: u64) -> usize {
+    let log2 = 63 - (cycles | 1).leading_zeros();
+    (log2 + 1).saturating_sub(HIST_MIN_SHIFT).min(HIST_BUCKETS as u32 - 1) as usize
+}
+
+/// Record one call of syscall `number` that took `cycles`
+///
+/// Numbers above MAX_SYSCALL are not counted.
+#[inline]
+pub fn record(number: u32, cycles: u64) {
+    let Some(counter) = COUNTERS[percpu::this_cpu()].0.get(number as usize) else {
+        return;
+    };
+
+    // Only this CPU writes its counters, and it does so with interrupts
+    // masked (SYSCALL clears IF), so plain read-modify-write cannot lose
+    // an update and needs no locked instruction
+    let add = |c: &AtomicU64, v: u64| {
+        c.store(c.load(Ordering::Relaxed).wrapping_add(v), Ordering::Relaxed)
+    };
+    add(&counter.count, 1);
+    add(&counter.cycles, cycles);
+    if cycles > counter.max_cycles.load(Ordering::Relaxed) {
+        counter.max_cycles.store(cycles, Ordering::Relaxed);
+    }
+    let slot = &counter.histogram[bucket(cycles)];
+    slot.store(slot.load(Ordering::Relaxed).wrapping_add(1), Ordering::Relaxed);
+}
+
+/// Counters of one syscall number, summed over CPUs
+fn syscall_stat(number: usize) -> SyscallStat {
+    let mut stat = SyscallStat { number: number as u32, ..SyscallStat::default() };
+    for cpu in COUNTERS.iter() {
+        let counter = &cpu.0[number];
+        stat.count += counter.count.load(Ordering::Relaxed);
+        stat.total_cycles += counter.cycles.load(Ordering::Relaxed);
+        stat.max_cycles = stat.max_cycles.max(counter.max_cycles.load(Ordering::Relaxed));
+        for (sum, slot) in stat.histogram.iter_mut().zip(counter.histogram.iter()) {
+            *sum += slot.load(Ordering::Relaxed);
+        }
+    }
+    stat
+}
+
+/// ============================================================================
+/// Snapshots
+/// ============================================================================
+
+/// Counters of every syscall called at least once, by number
+pub fn syscall_snapshot() -> Vec<SyscallStat> {
+    (0..NUM_SYSCALLS).map(syscall_stat).filter(|stat| stat.count > 0).collect()
+}
+
+/// Every process in the table, by PID
+pub fn process_snapshot() -> Vec<ProcessStat> {
+    let now = tsc::tsc_ticks();
+    let table = PROCESS_TABLE.lock();
+    let mut stats = Vec::with_capacity(table.count());
+    stats.extend(table.iter().filter_map(|process| {
+        let task = RUN_QUEUES.task(process.pid)?;
+        let cpu = RUN_QUEUES.cpu_of(process.pid)? as u32;
+        Some(ProcessStat::of(process, &task, cpu, now))
+    }));
+    stats
+}
+
+/// Boot phase markers, in the order they were recorded
+pub fn boot_snapshot() -> Vec<BootPhaseStat> {
+    let mut phases = [boot::Phase { name: "", tsc: 0, cpu: 0 }; boot::MAX_PHASES];
+    let count = boot::phases(&mut phases);
+
+    phases[..count]
+        .iter()
+        .map(|phase| {
+            let mut name = [0u8; 16];
+            let len = phase.name.len().min(name.len() - 1);
+            name[..len].copy_from_slice(&phase.name.as_bytes()[..len]);
+            BootPhaseStat {
+                tsc: phase.tsc,
+                ns: tsc::tsc_to_ns(phase.tsc),
+                cpu: phase.cpu,
+                reserved: 0,
+                name,
+            }
+        })
+        .collect()
+}
+
+/// System-wide totals
+pub fn system_snapshot() -> SystemStat {
+    let syscalls = COUNTERS
+        .iter()
+        .flat_map(|cpu| cpu.0.iter())
+        .map(|counter| counter.count.load(Ordering::Relaxed))
+        .sum();
+
+    SystemStat {
+        uptime_ns: tsc::tsc_to_ns(tsc::tsc_ticks()),
+        tsc_hz: tsc::x86_tsc_frequency(),
+        context_switches: round_robin::context_switch_count(),
+        syscalls,
+        free_pages: pmm::pmm_count_free_pages(),
+        total_pages: pmm::pmm_count_total_pages(),
+        cpus: percpu::cpu_count() as u32,
+        processes: PROCESS_TABLE.lock().count() as u32,
+        cached_images: image_cache::cached_image_count() as u32,
+        reserved: 0,
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    #[test]
+    fn test_bucket() {
+        assert_eq!(bucket(0), 0);
+        assert_eq!(bucket(127), 0);
+        assert_eq!(bucket(128), 1);
+        assert_eq!(bucket(255), 1);
+        assert_eq!(bucket(256), 2);
+        assert_eq!(bucket(u64::MAX), HIST_BUCKETS - 1);
+    }
+
+    #[test]
+    fn test_record() {
+        // Syscall 0 is never dispatched, so the test owns its counters
+        record(0, 100);
+        record(0, 300);
+        record(MAX_SYSCALL + 1, 100); // ignored
+
+        let stat = syscall_stat(0);
+        assert_eq!(stat.count, 2);
+        assert_eq!(stat.total_cycles, 400);
+        assert_eq!(stat.max_cycles, 300);
+        assert_eq!(stat.histogram[0], 1);
+        assert_eq!(stat.histogram[2], 1);
+    }
+
+    #[test]
+    fn test_record_sizes() {
+        // Layouts are shared with userspace (syscall.h)
+        assert_eq!(core::mem::size_of::<SystemStat>(), 64);
+        assert_eq!(core::mem::size_of::<SyscallStat>(), 112);
+        assert_eq!(core::mem::size_of::<ProcessStat>(), 48);
+        assert_eq!(core::mem::size_of::<BootPhaseStat>(), 40);
+    }
+}
@@ -0,0 +1,174 @@
+// Copyright 2025 The Rustux Authors
+//
+// Use of this source code is governed by a MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT
+
+//! Copies To and From User Memory
+//!
+//! Syscalls move data across the user boundary through these helpers.
+//! Each one checks the user range first (below [`USER_ADDR_LIMIT`], not
+//! wrapping, non-null unless empty) and then copies with
+//! `arch::amd64::usercopy`, so a range that passes the check but is not
+//! mapped fails with ERR_INVALID_ARGS instead of a kernel page fault.
+//!
+//! The helpers may fault in demand-paged memory: callers must not hold
+//! the process table lock.
+
+use alloc::vec::Vec;
+
+use crate::arch::amd64::mm::RxStatus;
+use crate::arch::amd64::usercopy::{has_erms, x86_user_copy};
+
+/// Highest user virtual address (exclusive)
+pub const USER_ADDR_LIMIT: u64 = 0x0000_8000_0000_0000;
+
+/// Page size for string scans (a chunk never crosses a page)
+const PAGE_SIZE: u64 = 4096;
+
+/// Check that `len` bytes at user address `addr` are a user range
+///
+/// An empty range is always valid, whatever its address.
+pub fn check_user_range(addr: u64, len: usize) -> Result<(), RxStatus> {
+    if len == 0 {
+        return Ok(());
+    }
+    match addr.checked_add(len as u64) {
+        Some(end) if addr != 0 && end <= USER_ADDR_LIMIT => Ok(()),
+        _ => Err(RxStatus::ERR_INVALID_ARGS),
+    }
+}
+
+/// Copy `len` bytes, faulting safely on the user side
+fn copy(dst: *mut u8, src: *const u8, len: usize) -> Result<(), RxStatus> {
+    if len == 0 {
+        return Ok(());
+    }
+    match unsafe { x86_user_copy(dst, src, len, has_erms()) } {
+        0 => Ok(()),
+        _ => Err(RxStatus::ERR_INVALID_ARGS),
+    }
+}
+
+/// Copy `dst.len()` bytes in from user address `src`
+pub fn copy_from_user(dst: &mut [u8], src: u64) -> Result<(), RxStatus> {
+    check_user_range(src, dst.len())?;
+    copy(dst.as_mut_ptr(), src as *const u8, dst.len())
+}
+
+/// Copy `src` out to user address `dst`
+pub fn copy_to_user(dst: u64, src: &[u8]) -> Result<(), RxStatus> {
+    check_user_range(dst, src.len())?;
+    copy(dst as *mut u8, src.as_ptr(), src.len())
+}
+
+/// Copy an array of plain records out to user address `dst`
+///
+/// `T` must have no padding bytes (the records are copied as bytes).
+pub fn copy_records_to_user<T: Copy>(dst: u64, records: &[T]) -> Result<(), RxStatus> {
+    let bytes = unsafe {
+        core::slice::from_raw_parts(records.as_ptr() as *const u8, core::mem::size_of_val(records))
+    };
+    copy_to_user(dst, bytes)
+}
+
+/// Copy an array of `count` plain records in from user address `src`
+///
+/// `T` must be valid for any bytes (integers and records of them).
+pub fn copy_records_from_user<T: Copy>(src: u64, count: usize) -> Result<Vec<T>, RxStatus> {
+    let size = count.checked_mul(core::mem::size_of::<T>()).ok_or(RxStatus::ERR_INVALID_ARGS)?;
+    check_user_range(src, size)?;
+
+    let mut records = Vec::new();
+    records.try_reserve_exact(count).map_err(|_| RxStatus::ERR_NO_MEMORY)?;
+    copy(records.as_mut_ptr() as *mut u8, src as *const u8, size)?;
+    // The copy filled all `count` records
+    unsafe { records.set_len(count) };
+    Ok(records)
+}
+
+/// Copy in the bytes of a NUL-terminated user string (without the NUL)
+///
+/// The string is copied a page-bounded chunk at a time and searched for
+/// the terminator in kernel memory, so bytes past it are only read up to
+/// the end of their chunk and never fault on an unmapped next page.
+///
+/// # Errors
+///
+/// ERR_INVALID_ARGS if the pointer is null or not mapped, or if no NUL
+/// follows within `max` bytes.
+pub fn copy_str_from_user(src: u64, max: usize) -> Result<Vec<u8>, RxStatus> {
+    if src == 0 {
+        return Err(RxStatus::ERR_INVALID_ARGS);
+    }
+
+    let mut out = Vec::new();
+    let mut addr = src;
+    // Up to `max` bytes plus the terminator
+    let mut left = max + 1;
+    while left > 0 {
+        let to_page_end = (PAGE_SIZE - (addr & (PAGE_SIZE - 1))) as usize;
+        let chunk = to_page_end.min(left);
+
+        let start = out.len();
+        out.try_reserve(chunk).map_err(|_| RxStatus::ERR_NO_MEMORY)?;
+        out.resize(start + chunk, 0);
+        copy_from_user(&mut out[start..], addr)?;
+
+        if let Some(nul) = out[start..].iter().position(|&b| b == 0) {
+            out.truncate(start + nul);
+            return Ok(out);
+        }
+        addr += chunk as u64;
+        left -= chunk;
+    }
+
+    Err(RxStatus::ERR_INVALID_ARGS)
+}
+
+/// Write user bytes to the debug port (0xE9) with `rep outsb`
+///
+/// Copied through a kernel buffer first, so a bad pointer fails without
+/// a fault inside the string I/O.
+pub fn debug_write_user(src: u64, len: usize) -> Result<(), RxStatus> {
+    check_user_range(src, len)?;
+
+    let mut buf = [0u8; 256];
+    let mut done = 0;
+    while done < len {
+        let chunk = (len - done).min(buf.len());
+        copy_from_user(&mut buf[..chunk], src + done as u64)?;
+        debug_write(&buf[..chunk]);
+        done += chunk;
+    }
+    Ok(())
+}
+
+/// Write kernel bytes to the debug port (0xE9) in one `rep outsb`
+pub fn debug_write(bytes: &[u8]) {
+    unsafe {
+        core::arch::asm!(
+            "rep outsb",
+            in("dx") 0xE9u16,
+            inout("rsi") bytes.as_ptr() => _,
+            inout("rcx") bytes.len() => _,
+            options(nostack, readonly)
+        );
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    #[test]
+    fn test_check_user_range() {
+        assert!(check_user_range(0, 0).is_ok());
+        assert!(check_user_range(0x1000, 16).is_ok());
+        assert!(check_user_range(USER_ADDR_LIMIT - 16, 16).is_ok());
+        // Null, past the user half, wrapping
+        assert!(check_user_range(0, 1).is_err());
+        assert!(check_user_range(USER_ADDR_LIMIT - 16, 17).is_err());
+        assert!(check_user_range(u64::MAX - 4, 16).is_err());
+    }
+}
@@ -6,11 +6,15 @@
 
 //! Interrupt test harness
 //!
-//! Provides utilities for testing interrupt controller functionality.
+//! Provides utilities for testing interrupt controller functionality,
+//! plus an in-kernel context-switch cost benchmark.
 
 use crate::traits::InterruptController;
 use crate::arch::X86_64InterruptController;
+use crate::arch::amd64::{registers, tsc};
 use crate::acpi;
+use crate::process::switch::{context_switch_kind, SwitchKind};
+use crate::process::table::SavedState;
 
 /// Test results
 #[derive(Debug, Clone, Copy, PartialEq, Eq)]
@@ -128,6 +132,22 @@ impl InterruptTestHarness {
         TestResult::Passed
     }
 
+    /// Benchmark both context-switch variants
+    ///
+    /// Passes if both variants complete their round trips.
+    pub fn test_context_switch_cost(&mut self) -> TestResult {
+        let result = bench_context_switch(SWITCH_BENCH_ROUNDS);
+
+        self.log(&format!("  full-frame switch:  {} cycles", result.preempt_cycles));
+        self.log(&format!("  cooperative switch: {} cycles", result.cooperative_cycles));
+
+        if result.peer_switches == 2 * (SWITCH_BENCH_ROUNDS + 1) {
+            TestResult::Passed
+        } else {
+            TestResult::Failed("context switch benchmark lost round trips")
+        }
+    }
+
     /// Run all tests
     pub fn run_all_tests(&mut self) {
         self.log("Starting interrupt system tests...");
@@ -150,6 +170,9 @@ impl InterruptTestHarness {
         self.log("Testing EOI...");
         self.record_result(self.test_eoi(1));
 
+        self.log("Benchmarking context switch...");
+        self.record_result(self.test_context_switch_cost());
+
         self.print_summary();
     }
 
@@ -174,3 +197,101 @@ impl Default for InterruptTestHarness {
         Self::new()
     }
 }
+
+/// ============================================================================
+/// Context Switch Benchmark
+/// ============================================================================
+
+/// Round trips timed per switch variant
+pub const SWITCH_BENCH_ROUNDS: u64 = 10_000;
+
+/// Context-switch benchmark results
+#[derive(Debug, Clone, Copy)]
+pub struct SwitchBenchResult {
+    /// TSC cycles per full-frame switch (timer preemption path)
+    pub preempt_cycles: u64,
+    /// TSC cycles per cooperative switch (yield path)
+    pub cooperative_cycles: u64,
+    /// Switches the peer performed (sanity check: 2 * (rounds + 1))
+    pub peer_switches: u64,
+}
+
+/// Stack for the benchmark peer context
+#[repr(C, align(16))]
+struct BenchStack([u8; 16 * 1024]);
+
+static mut BENCH_STACK: BenchStack = BenchStack([0; 16 * 1024]);
+static mut BENCH_MAIN: SavedState = SavedState::new();
+static mut BENCH_PEER: SavedState = SavedState::new();
+static mut BENCH_KIND: SwitchKind = SwitchKind::Preempt;
+static mut BENCH_PEER_SWITCHES: u64 = 0;
+
+/// Benchmark peer: switch straight back to the measuring context forever
+extern "C" fn bench_peer() -> ! {
+    loop {
+        unsafe {
+            BENCH_PEER_SWITCHES += 1;
+            context_switch_kind(
+                BENCH_KIND,
+                &raw mut BENCH_PEER,
+                &raw const BENCH_MAIN,
+                BENCH_MAIN.cr3,
+            );
+        }
+    }
+}
+
+/// Time `rounds` ping-pong round trips with one switch variant
+///
+/// Returns TSC cycles per switch (half a round trip).
+unsafe fn bench_switch_variant(kind: SwitchKind, rounds: u64, cr3: u64, rflags: u64) -> u64 {
+    // Fresh peer context entering bench_peer with an ABI-aligned stack
+    let stack_top = (&raw mut BENCH_STACK) as u64 + core::mem::size_of::<BenchStack>() as u64;
+    BENCH_KIND = kind;
+    BENCH_PEER = SavedState::new();
+    BENCH_PEER.rsp = stack_top - 8;
+    BENCH_PEER.rip = bench_peer as usize as u64;
+    BENCH_PEER.rflags = rflags;
+    BENCH_PEER.cr3 = cr3;
+
+    // Start the peer (and warm the path) outside the timed loop
+    context_switch_kind(kind, &raw mut BENCH_MAIN, &raw const BENCH_PEER, cr3);
+
+    let start = tsc::rdtsc_serialized();
+    for _ in 0..rounds {
+        context_switch_kind(kind, &raw mut BENCH_MAIN, &raw const BENCH_PEER, cr3);
+    }
+    let end = tsc::rdtsc_serialized();
+
+    end.wrapping_sub(start) / (2 * rounds.max(1))
+}
+
+/// Measure the cost of both context-switch variants
+///
+/// Switches between the caller and a peer kernel context in the same
+/// address space, so CR3 is never reloaded: the numbers are the register
+/// save/restore cost alone. Runs with interrupts disabled.
+pub fn bench_context_switch(rounds: u64) -> SwitchBenchResult {
+    unsafe {
+        let rflags = registers::x86_read_rflags();
+        registers::x86_cli();
+
+        let cr3 = registers::x86_get_cr3();
+        let peer_rflags = registers::x86_read_rflags();
+        BENCH_PEER_SWITCHES = 0;
+
+        let preempt_cycles = bench_switch_variant(SwitchKind::Preempt, rounds, cr3, peer_rflags);
+        let cooperative_cycles = bench_switch_variant(SwitchKind::Cooperative, rounds, cr3, peer_rflags);
+        let peer_switches = BENCH_PEER_SWITCHES;
+
+        if rflags & registers::rflags::IF != 0 {
+            registers::x86_sti();
+        }
+
+        SwitchBenchResult {
+            preempt_cycles,
+            cooperative_cycles,
+            peer_switches,
+        }
+    }
+}
@@ -50,7 +50,7 @@ echo ""
 echo "Starting QEMU..."
 echo ""
 
-# Run QEMU with debug console enabled
+# Run QEMU with debug console enabled (SMP=N sets the CPU count)
 qemu-system-x86_64 \
     -bios "$OVMF_FD" \
     -drive file=rustux.img,format=raw \
@@ -59,7 +59,7 @@ qemu-system-x86_64 \
     -chardev file,id=debug,path=/tmp/rustux-qemu-debug.log \
     -m 512M \
     -machine q35 \
-    -smp 1 \
+    -smp "${SMP:-2}" \
     -no-reboot \
     -no-shutdown
 
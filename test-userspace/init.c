@@ -19,13 +19,27 @@
 // File descriptor numbers
 #define STDOUT  1
 
+// SYSCALL/SYSRET ABI: number in rax, arguments in rdi, rsi, rdx, r10, r8, r9,
+// result in rax. The instruction clobbers rcx (user RIP) and r11 (RFLAGS).
+
 static inline long syscall1(long number, long arg1) {
     long ret;
     __asm__ volatile (
-        "int $0x80"
+        "syscall"
+        : "=a" (ret)
+        : "a" (number), "D" (arg1)
+        : "rcx", "r11", "memory"
+    );
+    return ret;
+}
+
+static inline long syscall3(long number, long arg1, long arg2, long arg3) {
+    long ret;
+    __asm__ volatile (
+        "syscall"
         : "=a" (ret)
-        : "a" (number), "b" (arg1)
-        : "memory"
+        : "a" (number), "D" (arg1), "S" (arg2), "d" (arg3)
+        : "rcx", "r11", "memory"
     );
     return ret;
 }
@@ -46,8 +60,7 @@ static inline void print(const char *str) {
         len++;
         p++;
     }
-    syscall1(SYS_WRITE, (long)str);
-    syscall1(SYS_WRITE, len);
+    syscall3(SYS_WRITE, STDOUT, (long)str, len);
 }
 
 void _start(void) {
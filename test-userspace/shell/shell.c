@@ -6,28 +6,14 @@
 
 //! Rustux Shell - Userspace Shell Program
 //!
-//! Build: x86_64-linux-gnu-gcc -static -nostdlib -fno-stack-protector shell.c -o shell.elf
-
-// Syscall numbers (matching rustux kernel)
-#define SYS_WRITE        0x60  // write(fd, buf, len)
-#define SYS_READ         0x61  // read(fd, buf, len)
-#define SYS_OPEN         0x62  // open(path, flags)
-#define SYS_CLOSE        0x63  // close(fd)
-#define SYS_LSEEK        0x64  // lseek(fd, offset, whence)
-#define SYS_GETPID       0x70  // getpid()
-#define SYS_GETPPID      0x71  // getppid()
-#define SYS_YIELD        0x72  // yield()
-#define SYS_EXIT         0x06  // exit(code)
-#define SYS_SPAWN        0x03  // spawn(path)
-
-// File descriptor numbers
-#define STDIN   0
-#define STDOUT  1
-#define STDERR  2
+//! Build: make -C userspace/c-progs shell.elf (links against librx.a)
+
+#include "rx.h"
 
 // Buffer sizes
 #define INPUT_BUFFER_SIZE  512
 #define MAX_ARGS           16
+#define MAX_PROCESSES      256  // Kernel process table size
 
 // ANSI Color Codes
 #define ANSI_RESET         "\033[0m"
@@ -39,92 +25,17 @@
 #define ANSI_CYAN          "\033[36m"
 #define ANSI_WHITE         "\033[37m"
 
-// =============================================================
-// SYSCALL INTERFACE
-// =============================================================
-
-static inline long syscall1(long number, long arg1) {
-    long ret;
-    __asm__ volatile (
-        "int $0x80"
-        : "=a" (ret)
-        : "a" (number), "b" (arg1)
-        : "memory"
-    );
-    return ret;
-}
-
-static inline long syscall3(long number, long arg1, long arg2, long arg3) {
-    long ret;
-    __asm__ volatile (
-        "int $0x80"
-        : "=a" (ret)
-        : "a" (number), "b" (arg1), "c" (arg2), "d" (arg3)
-        : "memory"
-    );
-    return ret;
-}
-
-// Syscall wrappers
-static inline long sys_write(int fd, const char *buf, long len) {
-    return syscall3(SYS_WRITE, fd, (long)buf, len);
-}
-
-static inline long sys_read(int fd, char *buf, long len) {
-    return syscall3(SYS_READ, fd, (long)buf, len);
-}
-
-static inline long sys_spawn(const char *path) {
-    return syscall1(SYS_SPAWN, (long)path);
-}
-
-static inline void sys_exit(int code) {
-    syscall1(SYS_EXIT, code);
-    __builtin_unreachable();
-}
-
 // =============================================================
 // UTILITY FUNCTIONS
 // =============================================================
 
+// stdout is line buffered: call rx_flush() before blocking on input
 static inline void print(const char *str) {
-    long len = 0;
-    const char *p = str;
-    while (*p) {
-        len++;
-        p++;
-    }
-    sys_write(STDOUT, str, len);
+    rx_fputs(STDOUT_FILENO, str);
 }
 
 static inline void print_color(const char *color, const char *str) {
-    print(color);
-    print(str);
-    print(ANSI_RESET);
-}
-
-static inline long strlen(const char *str) {
-    long len = 0;
-    while (str[len]) len++;
-    return len;
-}
-
-static inline int strcmp(const char *a, const char *b) {
-    while (*a && *a == *b) {
-        a++;
-        b++;
-    }
-    return *(unsigned char*)a - *(unsigned char*)b;
-}
-
-static inline int strncmp(const char *a, const char *b, long n) {
-    while (n > 0 && *a && *a == *b) {
-        a++;
-        b++;
-        n--;
-    }
-    if (n == 0) return 0;
-    return *(unsigned char*)a - *(unsigned char*)b;
+    rx_printf("%s%s" ANSI_RESET, color, str);
 }
 
 // =============================================================
@@ -138,11 +49,14 @@ static void cmd_help(void) {
     print("    help     - Show this help message\n");
     print("    clear    - Clear the screen\n");
     print("    echo     - Print arguments\n");
-    print("    ps       - List running processes\n");
+    print("    ps       - List processes and their CPU time\n");
+    print("    stats    - Show kernel and per-syscall statistics\n");
+    print("    boot     - Show boot phase timings\n");
     print("    exit     - Exit the shell\n\n");
     print("  External Programs:\n");
     print("    hello    - Hello world program\n");
-    print("    counter  - Counter program\n\n");
+    print("    counter  - Counter program\n");
+    print("    bench    - Syscall/scheduler microbenchmarks\n\n");
 }
 
 static void cmd_clear(void) {
@@ -158,13 +72,154 @@ static void cmd_echo(int argc, char **argv) {
     print("\n");
 }
 
+// TSC cycles per millisecond, from the kernel's system snapshot
+static uint64_t cycles_per_ms(const struct rx_system_stat *sys) {
+    uint64_t per_ms = sys->tsc_hz / 1000;
+    return per_ms ? per_ms : 1;
+}
+
+static const char *state_name(uint8_t state) {
+    switch (state) {
+    case RX_PROC_READY:   return "ready";
+    case RX_PROC_RUNNING: return "running";
+    case RX_PROC_BLOCKED: return "blocked";
+    case RX_PROC_ZOMBIE:  return "zombie";
+    default:              return "dead";
+    }
+}
+
+static const char *syscall_name(uint32_t number) {
+    switch (number) {
+    case SYS_PROCESS_CREATE:  return "process_create";
+    case SYS_SPAWN:           return "spawn";
+    case SYS_PROCESS_EXIT:    return "exit";
+    case SYS_CHANNEL_CREATE:  return "channel_create";
+    case SYS_CHANNEL_WRITE:   return "channel_write";
+    case SYS_CHANNEL_READ:    return "channel_read";
+    case SYS_PORT_CREATE:     return "port_create";
+    case SYS_PORT_WAIT_ASYNC: return "port_wait_async";
+    case SYS_PORT_WAIT:       return "port_wait";
+    case SYS_PORT_QUEUE:      return "port_queue";
+    case SYS_CLOCK_GET:       return "clock_get";
+    case SYS_DEBUG_WRITE:     return "debug_write";
+    case SYS_STATS:           return "stats";
+    case SYS_WRITE:           return "write";
+    case SYS_READ:            return "read";
+    case SYS_OPEN:            return "open";
+    case SYS_CLOSE:           return "close";
+    case SYS_LSEEK:           return "lseek";
+    case SYS_WRITEV:          return "writev";
+    case SYS_READV:           return "readv";
+    case SYS_RING_SETUP:      return "ring_setup";
+    case SYS_RING_ENTER:      return "ring_enter";
+    case SYS_MAP_FILE:        return "map_file";
+    case SYS_GETPID:          return "getpid";
+    case SYS_GETPPID:         return "getppid";
+    case SYS_YIELD:           return "yield";
+    case SYS_SET_PRIORITY:    return "set_priority";
+    case SYS_SET_AFFINITY:    return "set_affinity";
+    default:                  return "?";
+    }
+}
+
+// Upper bound (cycles) of the histogram bucket holding the 99th percentile
+static uint64_t histogram_p99(const struct rx_syscall_stat *s) {
+    uint64_t target = s->count - s->count / 100;
+    uint64_t seen = 0;
+    for (int b = 0; b < RX_STATS_HIST_BUCKETS - 1; b++) {
+        seen += s->histogram[b];
+        if (seen >= target) {
+            return (uint64_t)1 << (RX_STATS_HIST_MIN_SHIFT + b);
+        }
+    }
+    return s->max_cycles;
+}
+
 static void cmd_ps(void) {
+    static struct rx_process_stat procs[MAX_PROCESSES];
+    struct rx_system_stat sys;
+
+    int64_t count = sys_stats(RX_STATS_PROCESSES, procs, MAX_PROCESSES);
+    if (count < 0 || sys_stats(RX_STATS_SYSTEM, &sys, 1) != 1) {
+        print_color(ANSI_RED, "error: ");
+        print("process snapshot failed\n");
+        return;
+    }
+
+    uint64_t per_ms = cycles_per_ms(&sys);
+    print("\n");
+    print_color(ANSI_CYAN, "Processes:\n\n");
+    print("  PID  PPID  STATE    PRI  CPU    TIME(ms)  SWITCHES  NAME\n");
+    print("  ---  ----  -------  ---  ---  ----------  --------  ----\n");
+    for (int64_t i = 0; i < count; i++) {
+        const struct rx_process_stat *p = &procs[i];
+        rx_printf("  %3u  %4u  %-7s  %3u  %3u  %10lu  %8lu  %s\n",
+                  p->pid, p->ppid, state_name(p->state), p->priority, p->cpu,
+                  p->cpu_cycles / per_ms, p->context_switches,
+                  p->name[0] ? p->name : "-");
+    }
+    print("\n");
+}
+
+static void cmd_stats(void) {
+    static struct rx_syscall_stat calls[RX_STATS_MAX_SYSCALLS];
+    struct rx_system_stat sys;
+
+    int64_t count = sys_stats(RX_STATS_SYSCALLS, calls, RX_STATS_MAX_SYSCALLS);
+    if (count < 0 || sys_stats(RX_STATS_SYSTEM, &sys, 1) != 1) {
+        print_color(ANSI_RED, "error: ");
+        print("stats snapshot failed\n");
+        return;
+    }
+
+    print("\n");
+    print_color(ANSI_CYAN, "System:\n\n");
+    rx_printf("  uptime            %lu ms\n", sys.uptime_ns / 1000000);
+    rx_printf("  cpus              %u (TSC %lu MHz)\n", sys.cpus, sys.tsc_hz / 1000000);
+    rx_printf("  processes         %u\n", sys.processes);
+    rx_printf("  context switches  %lu\n", sys.context_switches);
+    rx_printf("  syscalls          %lu\n", sys.syscalls);
+    rx_printf("  memory            %lu / %lu KB free\n",
+              sys.free_pages * 4, sys.total_pages * 4);
+    rx_printf("  cached programs   %u\n\n", sys.cached_images);
+
+    // Cycles: averages include time spent blocked in the call
+    print_color(ANSI_CYAN, "Syscalls (cycles):\n\n");
+    print("  NUM   NAME                  CALLS         AVG        P99<         MAX\n");
+    print("  ----  ---------------  ----------  ----------  ----------  ----------\n");
+    for (int64_t i = 0; i < count; i++) {
+        const struct rx_syscall_stat *s = &calls[i];
+        rx_printf("  0x%02x  %-15s  %10lu  %10lu  %10lu  %10lu\n",
+                  s->number, syscall_name(s->number), s->count,
+                  s->total_cycles / s->count, histogram_p99(s), s->max_cycles);
+    }
+    print("\n");
+}
+
+static void cmd_boot(void) {
+    static struct rx_boot_phase_stat phases[RX_STATS_MAX_BOOT_PHASES];
+
+    int64_t count = sys_stats(RX_STATS_BOOT, phases, RX_STATS_MAX_BOOT_PHASES);
+    if (count < 0) {
+        print_color(ANSI_RED, "error: ");
+        print("boot snapshot failed\n");
+        return;
+    }
+
+    // Times are since reset; deltas are from the previous marker
+    print("\n");
+    print_color(ANSI_CYAN, "Boot phases:\n\n");
+    print("  PHASE            CPU     TIME(us)    DELTA(us)\n");
+    print("  ---------------  ---  -----------  -----------\n");
+    uint64_t prev = 0;
+    for (int64_t i = 0; i < count; i++) {
+        const struct rx_boot_phase_stat *p = &phases[i];
+        uint64_t us = p->ns / 1000;
+        rx_printf("  %-15s  %3u  %11lu  %11lu\n", p->name, p->cpu, us,
+                  us > prev ? us - prev : 0);
+        prev = us;
+    }
     print("\n");
-    print_color(ANSI_CYAN, "Running Processes:\n\n");
-    print("  PID  PPID  NAME\n");
-    print("  ---  ----  ----\n");
-    print("    1     0  init\n");
-    print("    2     1  shell\n\n");
 }
 
 static void cmd_exit(int argc, char **argv) {
@@ -217,57 +272,30 @@ static int parse_command(char *line, int *argc, char **argv) {
 // =============================================================
 
 static int spawn_external(const char *name) {
+    static const char prefix[] = "/bin/";
     char path[128];
-    char *p = path;
 
     // Build path: /bin/<name>
-    const char prefix[] = "/bin/";
-    const char *pp = prefix;
-    while (*pp) *p++ = *pp++;
-
-    while (*name && p < path + sizeof(path) - 1) {
-        *p++ = *name++;
+    size_t name_len = strlen(name);
+    if (name_len > sizeof(path) - sizeof(prefix)) {
+        name_len = sizeof(path) - sizeof(prefix);
     }
-    *p = '\0';
+    memcpy(path, prefix, sizeof(prefix) - 1);
+    memcpy(path + sizeof(prefix) - 1, name, name_len);
+    path[sizeof(prefix) - 1 + name_len] = '\0';
 
     // Try to spawn the program
-    long pid = sys_spawn(path);
+    int64_t pid = sys_spawn(path);
 
     if (pid < 0) {
         print_color(ANSI_RED, "error: ");
-        print("command not found: ");
-        print(name);
-        print("\n");
+        rx_printf("command not found: %s\n", name);
         return -1;
     }
 
     // Success
     print_color(ANSI_GREEN, "✓ ");
-    print("started process with PID ");
-
-    // Simple decimal conversion for PID
-    char pid_buf[16];
-    char *ppid = pid_buf;
-    long temp = pid;
-    int digits = 0;
-    if (temp == 0) {
-        *ppid++ = '0';
-        digits++;
-    } else {
-        while (temp > 0) {
-            ppid[digits++] = '0' + (temp % 10);
-            temp /= 10;
-        }
-    }
-    // Reverse the digits
-    for (int i = 0; i < digits / 2; i++) {
-        char tmp = ppid[i];
-        ppid[i] = ppid[digits - 1 - i];
-        ppid[digits - 1 - i] = tmp;
-    }
-    ppid[digits] = '\0';
-    print(pid_buf);
-    print("\n");
+    rx_printf("started process with PID %ld\n", pid);
 
     return 0;
 }
@@ -294,6 +322,7 @@ static void print_prompt(void) {
     print(" ");
     print_color(ANSI_CYAN, ">");
     print(" ");
+    rx_flush(STDOUT_FILENO);
 }
 
 // =============================================================
@@ -305,6 +334,9 @@ void _start(void) {
     static char *argv[MAX_ARGS];
     int argc;
 
+    // Interactive: run ahead of batch programs whenever input arrives
+    sys_set_priority(0, RX_PRIORITY_INTERACTIVE);
+
     // Clear screen and show welcome
     cmd_clear();
     show_welcome();
@@ -314,11 +346,11 @@ void _start(void) {
         print_prompt();
 
         // Read input line
-        long count = 0;
+        int64_t count = 0;
         char *buf = input_buffer;
 
         while (1) {
-            long ret = sys_read(STDIN, buf, 1);
+            int64_t ret = sys_read(STDIN_FILENO, buf, 1);
             if (ret <= 0) break;
 
             if (*buf == '\n') {
@@ -330,6 +362,7 @@ void _start(void) {
                     buf--;
                     // Erase character on screen
                     print("\010 \010");  // backspace, space, backspace
+                    rx_flush(STDOUT_FILENO);
                 }
             } else if (*buf >= 0x20 && *buf <= 0x7E) {  // Printable ASCII
                 count++;
@@ -360,6 +393,10 @@ void _start(void) {
             cmd_echo(argc, argv);
         } else if (strcmp(cmd, "ps") == 0) {
             cmd_ps();
+        } else if (strcmp(cmd, "stats") == 0) {
+            cmd_stats();
+        } else if (strcmp(cmd, "boot") == 0) {
+            cmd_boot();
         } else if (strcmp(cmd, "exit") == 0) {
             cmd_exit(argc, argv);
         } else {
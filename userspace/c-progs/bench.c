@@ -0,0 +1,456 @@
+// Copyright 2025 The Rustux Authors
+//
+// Use of this source code is governed by a MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT
+
+//! Syscall and scheduler microbenchmarks for Rustux
+//!
+//! Times kernel hot paths from userspace with rdtsc and reports
+//! min/median/p99 in TSC cycles for:
+//! - null syscall (sys_getpid)
+//! - sys_yield ping-pong against a peer process on the same CPU
+//! - uncontended rx_mutex lock/unlock, and a futex ping-pong between two
+//!   threads
+//! - sys_write at several buffer sizes
+//! - sys_read of a ramdisk file at several buffer sizes
+//! - sys_spawn latency
+//! - descriptor lookup, with a few and with thousands of descriptors open
+//! - console throughput (sys_write to stdout)
+//!
+//! Besides the human-readable report on stdout, every result is emitted
+//! on the debug port (SYS_DEBUG_WRITE) as a machine-readable record:
+//!
+//!   @BENCH <metric> <value>
+//!
+//! Cycle metrics are named <test>.median / <test>.p99; the run ends with
+//! "@BENCH done 1". scripts/perf-test.sh parses these records and
+//! compares them against scripts/perf-baseline.txt.
+//!
+//! The same source built with -DBENCH_PEER produces bench-peer.elf, the
+//! partner process for the yield ping-pong.
+
+#include "rx.h"
+
+// Samples per measurement (also the size of the sample buffer)
+#define BENCH_SAMPLES       512
+
+// Yields performed by the peer; a little more than the parent's samples
+// so the parent never runs out of partner
+#define BENCH_PEER_YIELDS   (BENCH_SAMPLES + 64)
+
+// Fewer samples for operations that are slow or have side effects
+#define BENCH_WRITE_SAMPLES 32
+#define BENCH_SPAWN_SAMPLES 8
+
+// Console throughput: this many writes of BENCH_CONSOLE_CHUNK bytes
+#define BENCH_CONSOLE_WRITES 64
+#define BENCH_CONSOLE_CHUNK  1024
+
+// Stack of the futex ping-pong thread
+#define BENCH_THREAD_STACK  16384
+
+// Descriptors open for the second descriptor lookup measurement
+#define BENCH_MANY_FDS      4096
+
+#define BENCH_PEER_PATH     "/bin/bench-peer"
+
+// CPU the yield ping-pong runs on: with the parent and the peer on
+// different CPUs, each yield would find nothing to switch to
+#define BENCH_YIELD_CPU_MASK 0x1
+#define BENCH_READ_PATH     "/bin/bench"
+
+/**
+ * Serialized TSC read (lfence keeps earlier instructions from drifting
+ * past the timestamp)
+ */
+static inline uint64_t rdtsc(void) {
+    uint32_t lo, hi;
+    __asm__ volatile ("lfence\n" "rdtsc" : "=a" (lo), "=d" (hi) :: "memory");
+    return ((uint64_t)hi << 32) | lo;
+}
+
+#ifdef BENCH_PEER
+
+// Yield ping-pong partner: bounce the CPU back to the parent, then exit
+void _start(void) {
+    // Join the parent on its CPU before the first yield
+    sys_set_affinity(0, BENCH_YIELD_CPU_MASK);
+    for (int i = 0; i < BENCH_PEER_YIELDS; i++) {
+        sys_yield();
+    }
+    sys_exit(0);
+}
+
+#else
+
+static uint64_t samples[BENCH_SAMPLES];
+static char io_buf[4096];
+
+// TSC frequency measured over the run (0 until known)
+static uint64_t tsc_khz;
+
+/**
+ * Emit one "@BENCH <metric> <value>" record on the debug port
+ *
+ * The record bypasses stdout, so it is neither buffered nor interleaved
+ * with the human-readable report.
+ */
+static void emit(const char *metric, uint64_t value) {
+    char line[96];
+    int len = rx_snprintf(line, sizeof(line), "@BENCH %s %lu\n", metric, value);
+    if (len > (int)sizeof(line) - 1) {
+        len = (int)sizeof(line) - 1;
+    }
+    sys_debug_write(line, len);
+}
+
+/**
+ * Emit "<name>.<suffix>" (name may contain a size, as in "write/256")
+ */
+static void emit_pair(const char *name, const char *suffix, uint64_t value) {
+    char metric[64];
+    rx_snprintf(metric, sizeof(metric), "%s.%s", name, suffix);
+    emit(metric, value);
+}
+
+/**
+ * Shell sort of the sample buffer (in place, ascending)
+ */
+static void sort_samples(uint64_t *s, int n) {
+    for (int gap = n / 2; gap > 0; gap /= 2) {
+        for (int i = gap; i < n; i++) {
+            uint64_t v = s[i];
+            int j = i;
+            while (j >= gap && s[j - gap] > v) {
+                s[j] = s[j - gap];
+                j -= gap;
+            }
+            s[j] = v;
+        }
+    }
+}
+
+/**
+ * Sort n samples and print "name: min=.. median=.. p99=.. cycles"
+ */
+static void report(const char *name, uint64_t *s, int n) {
+    sort_samples(s, n);
+
+    rx_printf("  %s: min=%lu median=%lu p99=%lu cycles\n",
+              name, s[0], s[n / 2], s[(n * 99) / 100]);
+    emit_pair(name, "median", s[n / 2]);
+    emit_pair(name, "p99", s[(n * 99) / 100]);
+}
+
+/**
+ * Same as report(), with a size suffix on the name ("write/256")
+ */
+static void report_sized(const char *name, int64_t size, uint64_t *s, int n) {
+    char label[64];
+    rx_snprintf(label, sizeof(label), "%s/%ld", name, size);
+    report(label, s, n);
+}
+
+static void bench_null_syscall(void) {
+    for (int i = 0; i < BENCH_SAMPLES; i++) {
+        uint64_t start = rdtsc();
+        sys_getpid();
+        samples[i] = rdtsc() - start;
+    }
+    report("getpid", samples, BENCH_SAMPLES);
+}
+
+static void bench_yield_pingpong(void) {
+    // The peer pins itself to the same CPU as it starts
+    int64_t old_mask = sys_set_affinity(0, BENCH_YIELD_CPU_MASK);
+    if (old_mask < 0) {
+        rx_printf("  yield: skipped (cannot set affinity)\n");
+        return;
+    }
+    if (sys_spawn(BENCH_PEER_PATH) < 0) {
+        rx_printf("  yield: skipped (cannot spawn " BENCH_PEER_PATH ")\n");
+        sys_set_affinity(0, (uint64_t)old_mask);
+        return;
+    }
+
+    // Let the peer get onto the run queue before sampling
+    sys_yield();
+
+    // Each sample is a round trip: us -> peer -> us (two switches)
+    for (int i = 0; i < BENCH_SAMPLES; i++) {
+        uint64_t start = rdtsc();
+        sys_yield();
+        samples[i] = rdtsc() - start;
+    }
+    report("yield-roundtrip", samples, BENCH_SAMPLES);
+    sys_set_affinity(0, (uint64_t)old_mask);
+
+    // report() sorted the samples; a round trip is two switches
+    emit("ctxswitch.median", samples[BENCH_SAMPLES / 2] / 2);
+}
+
+/**
+ * Time n cancels of an unarmed timer: a descriptor lookup and an error
+ */
+static void sample_fd_lookup(int fd, int n) {
+    for (int i = 0; i < n; i++) {
+        uint64_t start = rdtsc();
+        sys_timer_cancel(fd);
+        samples[i] = rdtsc() - start;
+    }
+}
+
+static void bench_fd_lookup(void) {
+    int64_t timer = sys_timer_create();
+    if (timer < 0) {
+        rx_printf("  fd-lookup: skipped (cannot create a timer)\n");
+        return;
+    }
+
+    sample_fd_lookup((int)timer, BENCH_SAMPLES);
+    report("fd-lookup", samples, BENCH_SAMPLES);
+
+    // Fill the table with copies of the timer, a batch at a time
+    int32_t batch[RX_FD_BATCH_MAX];
+    int32_t copies[RX_FD_BATCH_MAX];
+    for (int i = 0; i < RX_FD_BATCH_MAX; i++) {
+        batch[i] = (int32_t)timer;
+    }
+    int open = 0;
+    while (open < BENCH_MANY_FDS &&
+           sys_handle_duplicate(batch, RX_FD_BATCH_MAX, copies) == RX_FD_BATCH_MAX) {
+        open += RX_FD_BATCH_MAX;
+    }
+    if (open == 0) {
+        rx_printf("  fd-lookup: many fds skipped (cannot duplicate)\n");
+        return;
+    }
+
+    // The last copy sits at the far end of the table
+    sample_fd_lookup(copies[RX_FD_BATCH_MAX - 1], BENCH_SAMPLES);
+    report_sized("fd-lookup", open, samples, BENCH_SAMPLES);
+}
+
+static void bench_mutex(void) {
+    static rx_mutex_t mutex = RX_MUTEX_INIT;
+
+    // Never contended: both calls stay in userspace
+    for (int i = 0; i < BENCH_SAMPLES; i++) {
+        uint64_t start = rdtsc();
+        rx_mutex_lock(&mutex);
+        rx_mutex_unlock(&mutex);
+        samples[i] = rdtsc() - start;
+    }
+    report("mutex-uncontended", samples, BENCH_SAMPLES);
+}
+
+// Futex ping-pong: the word says whose turn it is (0 main, 1 the thread)
+static uint32_t futex_turn;
+static uint8_t futex_stack[BENCH_THREAD_STACK] __attribute__((aligned(16)));
+
+static void futex_pass(uint32_t to) {
+    __atomic_store_n(&futex_turn, to, __ATOMIC_RELEASE);
+    sys_futex_wake(&futex_turn, 1);
+}
+
+static void futex_await(uint32_t mine) {
+    uint32_t turn;
+    while ((turn = __atomic_load_n(&futex_turn, __ATOMIC_ACQUIRE)) != mine) {
+        sys_futex_wait(&futex_turn, turn);
+    }
+}
+
+static void *futex_peer(void *arg) {
+    (void)arg;
+    for (int i = 0; i < BENCH_SAMPLES; i++) {
+        futex_await(1);
+        futex_pass(0);
+    }
+    return NULL;
+}
+
+static void bench_futex_pingpong(void) {
+    static rx_thread_t peer;
+
+    futex_turn = 0;
+    if (rx_thread_create(&peer, futex_peer, NULL, futex_stack, sizeof(futex_stack)) < 0) {
+        rx_printf("  futex: skipped (cannot start a thread)\n");
+        return;
+    }
+
+    // Each sample is a round trip: wake the peer, sleep until it wakes us
+    for (int i = 0; i < BENCH_SAMPLES; i++) {
+        uint64_t start = rdtsc();
+        futex_pass(1);
+        futex_await(0);
+        samples[i] = rdtsc() - start;
+    }
+    rx_thread_join(&peer);
+    report("futex-roundtrip", samples, BENCH_SAMPLES);
+}
+
+static void bench_write(void) {
+    static const int64_t sizes[] = { 1, 16, 64, 256, 1024 };
+
+    // Printable filler, ending in a newline so each write is one line
+    for (int i = 0; i < (int)sizeof(io_buf); i++) {
+        io_buf[i] = (char)('a' + (i % 26));
+    }
+
+    for (int k = 0; k < (int)(sizeof(sizes) / sizeof(sizes[0])); k++) {
+        int64_t size = sizes[k];
+        io_buf[size - 1] = '\n';
+
+        for (int i = 0; i < BENCH_WRITE_SAMPLES; i++) {
+            uint64_t start = rdtsc();
+            sys_write(STDOUT_FILENO, io_buf, size);
+            samples[i] = rdtsc() - start;
+        }
+
+        io_buf[size - 1] = (char)('a' + ((size - 1) % 26));
+        report_sized("write", size, samples, BENCH_WRITE_SAMPLES);
+    }
+}
+
+static void bench_read(void) {
+    static const int64_t sizes[] = { 64, 256, 1024, 4096 };
+
+    int64_t fd = sys_open(BENCH_READ_PATH, O_RDONLY);
+    if (fd < 0) {
+        rx_printf("  read: skipped (cannot open " BENCH_READ_PATH ")\n");
+        return;
+    }
+
+    for (int k = 0; k < (int)(sizeof(sizes) / sizeof(sizes[0])); k++) {
+        int64_t size = sizes[k];
+
+        for (int i = 0; i < BENCH_SAMPLES; i++) {
+            sys_lseek(fd, 0, SEEK_SET);
+            uint64_t start = rdtsc();
+            sys_read(fd, io_buf, size);
+            samples[i] = rdtsc() - start;
+        }
+        report_sized("read", size, samples, BENCH_SAMPLES);
+    }
+
+    sys_close(fd);
+}
+
+static void bench_console(void) {
+    for (int i = 0; i < BENCH_CONSOLE_CHUNK; i++) {
+        io_buf[i] = (i % 64 == 63) ? '\n' : (char)('a' + (i % 26));
+    }
+
+    uint64_t start = rdtsc();
+    for (int i = 0; i < BENCH_CONSOLE_WRITES; i++) {
+        sys_write(STDOUT_FILENO, io_buf, BENCH_CONSOLE_CHUNK);
+    }
+    uint64_t cycles = rdtsc() - start;
+
+    uint64_t bytes = (uint64_t)BENCH_CONSOLE_WRITES * BENCH_CONSOLE_CHUNK;
+    rx_printf("  console: %lu bytes in %lu cycles\n", bytes, cycles);
+    if (cycles > 0 && tsc_khz > 0) {
+        // bytes per ms = bytes * (cycles per ms) / cycles
+        emit("console.bytes_per_ms", bytes * tsc_khz / cycles);
+    }
+}
+
+static void bench_spawn(void) {
+    int n = 0;
+
+    // The peers yield a while and exit; they only cost run-queue time
+    for (int i = 0; i < BENCH_SPAWN_SAMPLES; i++) {
+        uint64_t start = rdtsc();
+        int64_t pid = sys_spawn(BENCH_PEER_PATH);
+        uint64_t end = rdtsc();
+
+        if (pid < 0) {
+            break;
+        }
+        samples[n++] = end - start;
+    }
+
+    if (n == 0) {
+        rx_printf("  spawn: skipped (cannot spawn " BENCH_PEER_PATH ")\n");
+        return;
+    }
+    report("spawn", samples, n);
+}
+
+/**
+ * TSC frequency in kHz, measured against the kernel clock over a
+ * short busy wait
+ */
+static uint64_t measure_tsc_khz(void) {
+    uint64_t ns0 = (uint64_t)sys_clock_get();
+    uint64_t tsc0 = rdtsc();
+    uint64_t ns1;
+    do {
+        ns1 = (uint64_t)sys_clock_get();
+    } while (ns1 - ns0 < 10 * 1000 * 1000); // 10 ms
+    uint64_t tsc1 = rdtsc();
+
+    return (tsc1 - tsc0) * 1000000 / (ns1 - ns0);
+}
+
+/**
+ * Emit the kernel's boot phase timings: time from reset to init's first
+ * instruction ("boot.user.ms"), and of that the time spent from the EFI
+ * entry point ("boot.kernel.us")
+ */
+static void emit_boot_phases(void) {
+    static struct rx_boot_phase_stat phases[RX_STATS_MAX_BOOT_PHASES];
+    int64_t count = sys_stats(RX_STATS_BOOT, phases, RX_STATS_MAX_BOOT_PHASES);
+
+    uint64_t entry_ns = 0;
+    uint64_t user_ns = 0;
+    for (int64_t i = 0; i < count; i++) {
+        if (strcmp(phases[i].name, "efi.entry") == 0) {
+            entry_ns = phases[i].ns;
+        } else if (strcmp(phases[i].name, "user") == 0) {
+            user_ns = phases[i].ns;
+        }
+    }
+    if (user_ns == 0) {
+        rx_printf("  boot phases: not recorded\n");
+        return;
+    }
+
+    rx_printf("  boot: init entered %lu us after reset (%lu us in the kernel)\n",
+              user_ns / 1000, (user_ns - entry_ns) / 1000);
+    emit("boot.user.ms", user_ns / 1000000);
+    emit("boot.kernel.us", (user_ns - entry_ns) / 1000);
+}
+
+// Userspace entry point
+void _start(void) {
+    // The clock counts from reset, so its first reading is the time the
+    // machine took to get to the first benchmark
+    uint64_t boot_ns = (uint64_t)sys_clock_get();
+
+    rx_printf("=== Rustux microbenchmarks (TSC cycles) ===\n");
+    tsc_khz = measure_tsc_khz();
+    emit("boot.ms", boot_ns / 1000000);
+    emit("tsc.khz", tsc_khz);
+    emit_boot_phases();
+
+    bench_null_syscall();
+    bench_write();
+    bench_read();
+    bench_console();
+    bench_yield_pingpong();
+    bench_mutex();
+    bench_futex_pingpong();
+    bench_fd_lookup();
+
+    // Last: the spawned peers stay runnable for a while afterwards
+    bench_spawn();
+
+    rx_printf("=== Benchmarks complete ===\n");
+    rx_flush_all();
+    emit("done", 1);
+    sys_exit(0);
+}
+
+#endif // BENCH_PEER
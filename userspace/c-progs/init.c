@@ -7,109 +7,77 @@
 //! Init process for Rustux
 //!
 //! This is the first userspace process (PID 1) that:
-//! - Opens /test.txt from the ramdisk
-//! - Reads and displays its contents
+//! - Maps /test.txt from the ramdisk
+//! - Displays its contents
 //! - Spawns child processes
 //! - Coordinates execution
+//!
+//! If the ramdisk has an /etc/autorun file (built with RUSTUX_AUTORUN
+//! set), init spawns the program it names; the performance harness uses
+//! this to run /bin/bench on a headless boot.
+
+#include "rx.h"
+
+#define AUTORUN_PATH "/etc/autorun"
+
+/**
+ * Spawn the program named in /etc/autorun, if there is one
+ */
+static void autorun(void) {
+    uint64_t size;
+    const char *text = sys_map_file(AUTORUN_PATH, &size);
+    if (text == NULL) {
+        return;
+    }
 
-#include "syscall.h"
+    // The file holds one path, possibly newline-terminated
+    char path[128];
+    size_t len = 0;
+    while (len < size && len < sizeof(path) - 1 && text[len] != '\n') {
+        path[len] = text[len];
+        len++;
+    }
+    path[len] = '\0';
 
-// Simple string length function
-static int strlen(const char *s) {
-    int len = 0;
-    while (s[len]) len++;
-    return len;
+    rx_printf("Autorun: %s\n", path);
+    if (sys_spawn(path) < 0) {
+        rx_printf("Autorun: cannot spawn %s\n", path);
+    }
 }
 
 // Userspace entry point
 void _start(void) {
-    const char *msg1 = "=== Init process started ===\n";
-    const char *msg2 = "Opening /test.txt...\n";
-    const char *msg3 = "File contents:\n";
-    const char *msg4 = "My PID: ";
-    const char *msg5 = "My PPID: ";
-    const char *newline = "\n";
-    const char *done = "=== Init complete ===\n";
-
     // Print startup message
-    sys_write(STDOUT_FILENO, msg1, 29);
+    rx_printf("=== Init process started ===\n");
 
     // Get and print PID
-    int64_t pid = sys_getpid();
-    sys_write(STDOUT_FILENO, msg4, 9);
-    char pid_buf[32];
-    int i = 0;
-    int64_t n = pid;
-    if (n == 0) {
-        pid_buf[i++] = '0';
-    } else {
-        while (n > 0) {
-            pid_buf[i++] = '0' + (n % 10);
-            n /= 10;
-        }
-        // Reverse
-        for (int j = 0; j < i / 2; j++) {
-            char tmp = pid_buf[j];
-            pid_buf[j] = pid_buf[i - 1 - j];
-            pid_buf[i - 1 - j] = tmp;
-        }
-    }
-    sys_write(STDOUT_FILENO, pid_buf, i);
-    sys_write(STDOUT_FILENO, newline, 1);
+    rx_printf("My PID: %ld\n", sys_getpid());
 
     // Get and print PPID
-    int64_t ppid = sys_getppid();
-    sys_write(STDOUT_FILENO, msg5, 10);
-    i = 0;
-    n = ppid;
-    if (n == 0) {
-        pid_buf[i++] = '0';
-    } else {
-        while (n > 0) {
-            pid_buf[i++] = '0' + (n % 10);
-            n /= 10;
-        }
-        // Reverse
-        for (int j = 0; j < i / 2; j++) {
-            char tmp = pid_buf[j];
-            pid_buf[j] = pid_buf[i - 1 - j];
-            pid_buf[i - 1 - j] = tmp;
-        }
-    }
-    sys_write(STDOUT_FILENO, pid_buf, i);
-    sys_write(STDOUT_FILENO, newline, 1);
+    rx_printf("My PPID: %ld\n", sys_getppid());
 
-    // Try to open /test.txt
-    sys_write(STDOUT_FILENO, msg2, 21);
-    int64_t fd = sys_open("/test.txt", O_RDONLY);
+    // Map /test.txt: the whole file in one syscall, with no copy
+    rx_printf("Mapping /test.txt...\n");
+    uint64_t size;
+    const char *text = sys_map_file("/test.txt", &size);
 
-    if (fd >= 0) {
-        // Successfully opened
-        sys_write(STDOUT_FILENO, msg3, 16);
-
-        // Read and print file contents
-        char buf[256];
-        int64_t bytes_read = sys_read(fd, buf, 255);
-        if (bytes_read > 0) {
-            sys_write(STDOUT_FILENO, buf, bytes_read);
-        }
-        sys_write(STDOUT_FILENO, newline, 1);
-
-        // Close the file
-        sys_close(fd);
+    if (text != NULL) {
+        rx_printf("File contents:\n");
+        rx_write(STDOUT_FILENO, text, (size_t)size);
+        rx_printf("\n");
     } else {
-        // Failed to open
-        const char *err = "Failed to open /test.txt\n";
-        sys_write(STDOUT_FILENO, err, 25);
+        rx_printf("Failed to map /test.txt\n");
     }
 
+    autorun();
+
     // Yield a few times
     for (int i = 0; i < 5; i++) {
         sys_yield();
     }
 
     // Print completion message
-    sys_write(STDOUT_FILENO, done, 26);
+    rx_printf("=== Init complete ===\n");
 
     // Exit cleanly
     sys_exit(0);
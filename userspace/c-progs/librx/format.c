@@ -0,0 +1,85 @@
+// Copyright 2025 The Rustux Authors
+//
+// Use of this source code is governed by a MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT
+
+//! librx number formatting and unbuffered output helpers
+//!
+//! Decimal conversion emits two digits per division using a 200-byte
+//! pair table, and writes digits right-to-left into a scratch buffer so
+//! no reversal pass is needed.
+
+#include "../rx.h"
+
+static const char DIGIT_PAIRS[201] =
+    "00010203040506070809"
+    "10111213141516171819"
+    "20212223242526272829"
+    "30313233343536373839"
+    "40414243444546474849"
+    "50515253545556575859"
+    "60616263646566676869"
+    "70717273747576777879"
+    "80818283848586878889"
+    "90919293949596979899";
+
+static const char HEX_DIGITS[16] = "0123456789abcdef";
+
+int rx_utoa(uint64_t value, char *buf) {
+    char tmp[RX_FMT_BUF_SIZE];
+    char *p = tmp + sizeof(tmp);
+
+    while (value >= 100) {
+        unsigned pair = (unsigned)(value % 100) * 2;
+        value /= 100;
+        *--p = DIGIT_PAIRS[pair + 1];
+        *--p = DIGIT_PAIRS[pair];
+    }
+    if (value >= 10) {
+        unsigned pair = (unsigned)value * 2;
+        *--p = DIGIT_PAIRS[pair + 1];
+        *--p = DIGIT_PAIRS[pair];
+    } else {
+        *--p = (char)('0' + value);
+    }
+
+    int len = (int)(tmp + sizeof(tmp) - p);
+    memcpy(buf, p, (size_t)len);
+    buf[len] = '\0';
+    return len;
+}
+
+int rx_itoa(int64_t value, char *buf) {
+    if (value < 0) {
+        buf[0] = '-';
+        // Negate in unsigned space so INT64_MIN does not overflow
+        return 1 + rx_utoa((uint64_t)0 - (uint64_t)value, buf + 1);
+    }
+    return rx_utoa((uint64_t)value, buf);
+}
+
+int rx_xtoa(uint64_t value, char *buf) {
+    char tmp[RX_FMT_BUF_SIZE];
+    char *p = tmp + sizeof(tmp);
+
+    do {
+        *--p = HEX_DIGITS[value & 0xF];
+        value >>= 4;
+    } while (value != 0);
+
+    int len = (int)(tmp + sizeof(tmp) - p);
+    memcpy(buf, p, (size_t)len);
+    buf[len] = '\0';
+    return len;
+}
+
+int64_t rx_puts(int fd, const char *s) {
+    return sys_write(fd, s, (int64_t)strlen(s));
+}
+
+int64_t rx_put_u64(int fd, uint64_t value) {
+    char buf[RX_FMT_BUF_SIZE];
+    int len = rx_utoa(value, buf);
+    return sys_write(fd, buf, len);
+}
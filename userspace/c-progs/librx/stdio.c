@@ -0,0 +1,376 @@
+// Copyright 2025 The Rustux Authors
+//
+// Use of this source code is governed by a MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT
+
+//! librx buffered output and printf-style formatting
+//!
+//! Output is staged in a per-fd buffer and handed to the kernel with one
+//! sys_write per line (line buffered) or per full buffer (fully
+//! buffered). The formatter writes straight into that buffer, so a
+//! formatted line costs a single kernel entry regardless of how many
+//! fields it has.
+
+#include "../rx.h"
+
+typedef struct {
+    char buf[RX_STDIO_BUF_SIZE];
+    size_t len;
+} rx_stream_t;
+
+// Buffers live in .bss; the modes are kept apart so they can be
+// statically initialized without moving 8 KiB of buffers into .data
+static rx_stream_t streams[RX_STDIO_MAX_FDS];
+static uint8_t stream_mode[RX_STDIO_MAX_FDS] = {
+    RX_IOFBF,   // stdin
+    RX_IOLBF,   // stdout
+    RX_IONBF,   // stderr
+    RX_IOFBF, RX_IOFBF, RX_IOFBF, RX_IOFBF, RX_IOFBF,
+};
+
+static inline int is_buffered_fd(int fd) {
+    return fd >= 0 && fd < RX_STDIO_MAX_FDS;
+}
+
+/**
+ * Hand len bytes to the kernel, retrying on short writes
+ */
+static int64_t write_all(int fd, const char *p, size_t len) {
+    while (len > 0) {
+        int64_t ret = sys_write(fd, p, (int64_t)len);
+        if (ret <= 0) {
+            return ret < 0 ? ret : -1;
+        }
+        p += ret;
+        len -= (size_t)ret;
+    }
+    return 0;
+}
+
+/**
+ * Write the buffered bytes of fd (the buffer is emptied even on error,
+ * so a failing fd cannot wedge later output)
+ */
+static int64_t stream_drain(int fd) {
+    rx_stream_t *s = &streams[fd];
+    if (s->len == 0) {
+        return 0;
+    }
+    int64_t ret = write_all(fd, s->buf, s->len);
+    s->len = 0;
+    return ret;
+}
+
+/**
+ * Append bytes to the buffer of fd, draining it whenever it fills
+ */
+static void stream_put(int fd, const char *p, size_t len) {
+    rx_stream_t *s = &streams[fd];
+
+    while (len > 0) {
+        size_t room = RX_STDIO_BUF_SIZE - s->len;
+        if (room == 0) {
+            stream_drain(fd);
+            room = RX_STDIO_BUF_SIZE;
+        }
+        size_t n = len < room ? len : room;
+        memcpy(s->buf + s->len, p, n);
+        s->len += n;
+        p += n;
+        len -= n;
+    }
+}
+
+/**
+ * Apply the buffering policy after an operation appended output
+ */
+static int64_t stream_commit(int fd, int wrote_newline) {
+    uint8_t mode = stream_mode[fd];
+    if (mode == RX_IONBF || (mode == RX_IOLBF && wrote_newline)) {
+        return stream_drain(fd);
+    }
+    return 0;
+}
+
+int rx_setvbuf(int fd, int mode) {
+    if (!is_buffered_fd(fd) || mode < RX_IONBF || mode > RX_IOFBF) {
+        return -1;
+    }
+    stream_drain(fd);
+    stream_mode[fd] = (uint8_t)mode;
+    return 0;
+}
+
+int64_t rx_flush(int fd) {
+    if (!is_buffered_fd(fd)) {
+        return 0;
+    }
+    return stream_drain(fd);
+}
+
+void rx_flush_all(void) {
+    for (int fd = 0; fd < RX_STDIO_MAX_FDS; fd++) {
+        stream_drain(fd);
+    }
+}
+
+// Called by sys_exit() through a weak reference (see syscall.h)
+void rx_stdio_exit(void) {
+    rx_flush_all();
+}
+
+int64_t rx_write(int fd, const void *buf, size_t len) {
+    if (!is_buffered_fd(fd)) {
+        return sys_write(fd, buf, (int64_t)len);
+    }
+
+    // Large writes skip the copy: flush what is pending, then go direct
+    if (len >= RX_STDIO_BUF_SIZE) {
+        int64_t ret = stream_drain(fd);
+        if (ret == 0) {
+            ret = write_all(fd, buf, len);
+        }
+        return ret < 0 ? ret : (int64_t)len;
+    }
+
+    stream_put(fd, buf, len);
+    int64_t ret = stream_commit(fd, memchr(buf, '\n', len) != NULL);
+    return ret < 0 ? ret : (int64_t)len;
+}
+
+int64_t rx_fputc(int fd, char c) {
+    return rx_write(fd, &c, 1);
+}
+
+int64_t rx_fputs(int fd, const char *s) {
+    return rx_write(fd, s, strlen(s));
+}
+
+// ============================================================================
+// Formatter
+// ============================================================================
+
+/**
+ * Formatter output target: either an fd buffer or a caller's string
+ */
+typedef struct {
+    int fd;             // Stream fd, or -1 for string output
+    char *str;          // String output buffer
+    size_t str_size;    // Capacity of str, including the NUL
+    size_t count;       // Characters produced so far
+    int newline;        // A '\n' went to the stream
+} rx_sink_t;
+
+static void sink_put(rx_sink_t *k, const char *p, size_t len) {
+    if (k->fd >= 0) {
+        if (!k->newline && memchr(p, '\n', len) != NULL) {
+            k->newline = 1;
+        }
+        stream_put(k->fd, p, len);
+    } else if (k->count + 1 < k->str_size) {
+        size_t room = k->str_size - 1 - k->count;
+        memcpy(k->str + k->count, p, len < room ? len : room);
+    }
+    k->count += len;
+}
+
+static void sink_pad(rx_sink_t *k, char c, int n) {
+    char pad[16];
+    memset(pad, c, sizeof(pad));
+    while (n > 0) {
+        int chunk = n < (int)sizeof(pad) ? n : (int)sizeof(pad);
+        sink_put(k, pad, (size_t)chunk);
+        n -= chunk;
+    }
+}
+
+/**
+ * Emit one field, padded to width (left-justified with '-');
+ * zero padding goes after any sign or "0x" prefix
+ */
+static void sink_field(rx_sink_t *k, const char *prefix, const char *body,
+                       size_t body_len, int width, int left, int zero) {
+    size_t prefix_len = strlen(prefix);
+    int pad = width - (int)(prefix_len + body_len);
+
+    if (pad > 0 && !left && !zero) {
+        sink_pad(k, ' ', pad);
+    }
+    sink_put(k, prefix, prefix_len);
+    if (pad > 0 && !left && zero) {
+        sink_pad(k, '0', pad);
+    }
+    sink_put(k, body, body_len);
+    if (pad > 0 && left) {
+        sink_pad(k, ' ', pad);
+    }
+}
+
+static int format(rx_sink_t *k, const char *fmt, va_list ap) {
+    while (*fmt) {
+        // Copy the literal run up to the next conversion in one go
+        const char *run = fmt;
+        while (*fmt && *fmt != '%') {
+            fmt++;
+        }
+        if (fmt != run) {
+            sink_put(k, run, (size_t)(fmt - run));
+        }
+        if (*fmt == '\0') {
+            break;
+        }
+        fmt++;
+
+        int left = 0, zero = 0;
+        for (;; fmt++) {
+            if (*fmt == '-') {
+                left = 1;
+            } else if (*fmt == '0') {
+                zero = 1;
+            } else {
+                break;
+            }
+        }
+
+        int width = 0;
+        while (*fmt >= '0' && *fmt <= '9') {
+            width = width * 10 + (*fmt++ - '0');
+        }
+
+        int precision = -1;
+        if (*fmt == '.') {
+            fmt++;
+            precision = 0;
+            while (*fmt >= '0' && *fmt <= '9') {
+                precision = precision * 10 + (*fmt++ - '0');
+            }
+        }
+
+        int is_long = 0;
+        while (*fmt == 'l' || *fmt == 'z') {
+            is_long = 1;
+            fmt++;
+        }
+
+        char num[RX_FMT_BUF_SIZE];
+        const char *prefix = "";
+        int len;
+
+        switch (*fmt) {
+        case 'd':
+        case 'i': {
+            int64_t v = is_long ? va_arg(ap, int64_t) : va_arg(ap, int);
+            if (v < 0) {
+                prefix = "-";
+                len = rx_utoa((uint64_t)0 - (uint64_t)v, num);
+            } else {
+                len = rx_utoa((uint64_t)v, num);
+            }
+            sink_field(k, prefix, num, (size_t)len, width, left, zero);
+            break;
+        }
+        case 'u':
+        case 'x':
+        case 'X': {
+            uint64_t v = is_long ? va_arg(ap, uint64_t) : va_arg(ap, unsigned);
+            if (*fmt == 'u') {
+                len = rx_utoa(v, num);
+            } else {
+                len = rx_xtoa(v, num);
+                if (*fmt == 'X') {
+                    for (int i = 0; i < len; i++) {
+                        if (num[i] >= 'a') {
+                            num[i] = (char)(num[i] - 'a' + 'A');
+                        }
+                    }
+                }
+            }
+            sink_field(k, prefix, num, (size_t)len, width, left, zero);
+            break;
+        }
+        case 'p':
+            len = rx_xtoa((uint64_t)(uintptr_t)va_arg(ap, void *), num);
+            sink_field(k, "0x", num, (size_t)len, width, left, zero);
+            break;
+        case 's': {
+            const char *s = va_arg(ap, const char *);
+            if (s == NULL) {
+                s = "(null)";
+            }
+            size_t slen = strlen(s);
+            if (precision >= 0 && (size_t)precision < slen) {
+                slen = (size_t)precision;
+            }
+            sink_field(k, prefix, s, slen, width, left, 0);
+            break;
+        }
+        case 'c':
+            num[0] = (char)va_arg(ap, int);
+            sink_field(k, prefix, num, 1, width, left, 0);
+            break;
+        case '%':
+            sink_put(k, "%", 1);
+            break;
+        case '\0':
+            // Trailing lone '%'
+            return (int)k->count;
+        default:
+            // Unknown conversion: emit it verbatim
+            sink_put(k, fmt - 1, 2);
+            break;
+        }
+        fmt++;
+    }
+
+    return (int)k->count;
+}
+
+int rx_vfprintf(int fd, const char *fmt, va_list ap) {
+    if (!is_buffered_fd(fd)) {
+        // No stream buffer: format on the stack and write once
+        char buf[RX_STDIO_BUF_SIZE];
+        int n = rx_vsnprintf(buf, sizeof(buf), fmt, ap);
+        size_t len = (size_t)n < sizeof(buf) ? (size_t)n : sizeof(buf) - 1;
+        sys_write(fd, buf, (int64_t)len);
+        return n;
+    }
+
+    rx_sink_t k = { .fd = fd };
+    int n = format(&k, fmt, ap);
+    stream_commit(fd, k.newline);
+    return n;
+}
+
+int rx_fprintf(int fd, const char *fmt, ...) {
+    va_list ap;
+    va_start(ap, fmt);
+    int n = rx_vfprintf(fd, fmt, ap);
+    va_end(ap);
+    return n;
+}
+
+int rx_printf(const char *fmt, ...) {
+    va_list ap;
+    va_start(ap, fmt);
+    int n = rx_vfprintf(STDOUT_FILENO, fmt, ap);
+    va_end(ap);
+    return n;
+}
+
+int rx_vsnprintf(char *buf, size_t size, const char *fmt, va_list ap) {
+    rx_sink_t k = { .fd = -1, .str = buf, .str_size = size };
+    int n = format(&k, fmt, ap);
+    if (size > 0) {
+        buf[k.count < size ? k.count : size - 1] = '\0';
+    }
+    return n;
+}
+
+int rx_snprintf(char *buf, size_t size, const char *fmt, ...) {
+    va_list ap;
+    va_start(ap, fmt);
+    int n = rx_vsnprintf(buf, size, fmt, ap);
+    va_end(ap);
+    return n;
+}
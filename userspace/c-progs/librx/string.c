@@ -0,0 +1,405 @@
+// Copyright 2025 The Rustux Authors
+//
+// Use of this source code is governed by a MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT
+
+//! librx string and memory routines
+//!
+//! strlen, strchr, memchr and strcmp scan 16 bytes at a time with SSE2
+//! (part of the x86-64 baseline), or 32 at a time with AVX2 where the
+//! CPU has it and the kernel has enabled the YMM state (CPUID.OSXSAVE
+//! and XCR0). The features are read once, on first use. Scans load
+//! aligned vectors, which never cross a page boundary, so reading past
+//! the terminator inside the final vector is safe; strcmp, whose two
+//! strings are rarely co-aligned, loads unaligned and steps a byte at a
+//! time near the end of either page.
+//!
+//! memcpy and memset use `rep movsb`/`rep stosb` for large sizes on CPUs
+//! with ERMS (CPUID.07H:EBX.ERMS), whose microcode moves whole cache
+//! lines, and SSE2 or word loops below that. The remaining routines work
+//! a machine word (8 bytes) at a time.
+//!
+//! This file is compiled with -fno-tree-loop-distribute-patterns so GCC
+//! does not turn the byte loops back into calls to memset/memcpy.
+
+#include "../rx.h"
+
+typedef uint64_t __attribute__((may_alias)) rx_word_t;
+
+// SSE2 and AVX2 vectors, aligned and unaligned
+typedef char rx_v16_t __attribute__((vector_size(16), may_alias));
+typedef char rx_v16u_t __attribute__((vector_size(16), may_alias, aligned(1)));
+typedef char rx_v32_t __attribute__((vector_size(32), may_alias));
+typedef char rx_v32u_t __attribute__((vector_size(32), may_alias, aligned(1)));
+
+#define WORD_SIZE   sizeof(rx_word_t)
+#define WORD_MASK   (WORD_SIZE - 1)
+#define PAGE_SIZE   4096
+
+// Sizes from which the ERMS string instructions beat vector loops
+#define ERMS_COPY_MIN   512
+#define ERMS_SET_MIN    1024
+
+// Whether a width-byte load at p stays inside p's page
+#define IN_PAGE(p, width) (((uintptr_t)(p) & (PAGE_SIZE - 1)) <= PAGE_SIZE - (width))
+
+// ============================================================================
+// CPU feature dispatch
+// ============================================================================
+
+#define FEAT_KNOWN  (1u << 0)
+#define FEAT_AVX2   (1u << 1)
+#define FEAT_ERMS   (1u << 2)
+
+static unsigned cpu_features;
+
+static void cpuid(uint32_t leaf, uint32_t sub, uint32_t regs[4]) {
+    __asm__ volatile ("cpuid"
+                      : "=a" (regs[0]), "=b" (regs[1]), "=c" (regs[2]), "=d" (regs[3])
+                      : "a" (leaf), "c" (sub));
+}
+
+static unsigned detect_features(void) {
+    uint32_t r[4];
+    unsigned features = FEAT_KNOWN;
+
+    cpuid(0, 0, r);
+    uint32_t max_leaf = r[0];
+
+    // AVX2 also needs the OS to save YMM state (OSXSAVE, XCR0 bits 1-2)
+    cpuid(1, 0, r);
+    int ymm_enabled = 0;
+    if (r[2] & (1u << 27)) {
+        uint32_t xcr0_lo, xcr0_hi;
+        __asm__ volatile ("xgetbv" : "=a" (xcr0_lo), "=d" (xcr0_hi) : "c" (0));
+        ymm_enabled = (xcr0_lo & 0x6) == 0x6;
+    }
+
+    if (max_leaf >= 7) {
+        cpuid(7, 0, r);
+        if ((r[1] & (1u << 5)) && ymm_enabled) {
+            features |= FEAT_AVX2;
+        }
+        if (r[1] & (1u << 9)) {
+            features |= FEAT_ERMS;
+        }
+    }
+
+    cpu_features = features;
+    return features;
+}
+
+static inline unsigned features(void) {
+    unsigned f = cpu_features;
+    return f ? f : detect_features();
+}
+
+// ============================================================================
+// Vector scans
+// ============================================================================
+
+static inline unsigned mask16(rx_v16_t v) {
+    return (unsigned)__builtin_ia32_pmovmskb128(v);
+}
+
+static size_t strlen_sse2(const char *s) {
+    const rx_v16_t zero = { 0 };
+    const rx_v16_t *v = (const rx_v16_t *)((uintptr_t)s & ~(uintptr_t)15);
+
+    // Drop the bytes before s in the first, aligned-down vector
+    unsigned m = mask16(*v == zero) >> ((uintptr_t)s & 15);
+    if (m) {
+        return __builtin_ctz(m);
+    }
+    for (;;) {
+        v++;
+        m = mask16(*v == zero);
+        if (m) {
+            return (size_t)((const char *)v + __builtin_ctz(m) - s);
+        }
+    }
+}
+
+__attribute__((target("avx2")))
+static size_t strlen_avx2(const char *s) {
+    const rx_v32_t zero = { 0 };
+    const rx_v32_t *v = (const rx_v32_t *)((uintptr_t)s & ~(uintptr_t)31);
+
+    uint32_t m = (uint32_t)__builtin_ia32_pmovmskb256(*v == zero) >> ((uintptr_t)s & 31);
+    if (m) {
+        return __builtin_ctz(m);
+    }
+    for (;;) {
+        v++;
+        m = (uint32_t)__builtin_ia32_pmovmskb256(*v == zero);
+        if (m) {
+            return (size_t)((const char *)v + __builtin_ctz(m) - s);
+        }
+    }
+}
+
+static void *memchr_sse2(const unsigned char *p, unsigned char ch, size_t n) {
+    const rx_v16_t pattern = (rx_v16_t){ 0 } + (char)ch;
+    const rx_v16_t *v = (const rx_v16_t *)((uintptr_t)p & ~(uintptr_t)15);
+    size_t skip = (uintptr_t)p & 15;
+    unsigned m = mask16(*v == pattern) >> skip;
+    size_t avail = 16 - skip;
+
+    for (;;) {
+        if (m) {
+            size_t i = __builtin_ctz(m);
+            return i < n ? (void *)(p + i) : NULL;
+        }
+        if (n <= avail) {
+            return NULL;
+        }
+        p += avail;
+        n -= avail;
+        v++;
+        m = mask16(*v == pattern);
+        avail = 16;
+    }
+}
+
+__attribute__((target("avx2")))
+static void *memchr_avx2(const unsigned char *p, unsigned char ch, size_t n) {
+    const rx_v32_t pattern = (rx_v32_t){ 0 } + (char)ch;
+    const rx_v32_t *v = (const rx_v32_t *)((uintptr_t)p & ~(uintptr_t)31);
+    size_t skip = (uintptr_t)p & 31;
+    uint32_t m = (uint32_t)__builtin_ia32_pmovmskb256(*v == pattern) >> skip;
+    size_t avail = 32 - skip;
+
+    for (;;) {
+        if (m) {
+            size_t i = __builtin_ctz(m);
+            return i < n ? (void *)(p + i) : NULL;
+        }
+        if (n <= avail) {
+            return NULL;
+        }
+        p += avail;
+        n -= avail;
+        v++;
+        m = (uint32_t)__builtin_ia32_pmovmskb256(*v == pattern);
+        avail = 32;
+    }
+}
+
+static int strcmp_sse2(const unsigned char *a, const unsigned char *b) {
+    const rx_v16_t zero = { 0 };
+    for (;;) {
+        if (IN_PAGE(a, 16) && IN_PAGE(b, 16)) {
+            rx_v16_t va = *(const rx_v16u_t *)a;
+            rx_v16_t vb = *(const rx_v16u_t *)b;
+            // First byte that differs or ends a
+            unsigned m = mask16((va != vb) | (va == zero));
+            if (m) {
+                unsigned i = __builtin_ctz(m);
+                return a[i] - b[i];
+            }
+            a += 16;
+            b += 16;
+        } else {
+            if (*a == '\0' || *a != *b) {
+                return *a - *b;
+            }
+            a++;
+            b++;
+        }
+    }
+}
+
+__attribute__((target("avx2")))
+static int strcmp_avx2(const unsigned char *a, const unsigned char *b) {
+    const rx_v32_t zero = { 0 };
+    for (;;) {
+        if (IN_PAGE(a, 32) && IN_PAGE(b, 32)) {
+            rx_v32_t va = *(const rx_v32u_t *)a;
+            rx_v32_t vb = *(const rx_v32u_t *)b;
+            uint32_t m = (uint32_t)__builtin_ia32_pmovmskb256((va != vb) | (va == zero));
+            if (m) {
+                unsigned i = __builtin_ctz(m);
+                return a[i] - b[i];
+            }
+            a += 32;
+            b += 32;
+        } else {
+            if (*a == '\0' || *a != *b) {
+                return *a - *b;
+            }
+            a++;
+            b++;
+        }
+    }
+}
+
+// ============================================================================
+// String routines
+// ============================================================================
+
+size_t strlen(const char *s) {
+    return (features() & FEAT_AVX2) ? strlen_avx2(s) : strlen_sse2(s);
+}
+
+int strcmp(const char *a, const char *b) {
+    const unsigned char *ua = (const unsigned char *)a;
+    const unsigned char *ub = (const unsigned char *)b;
+    return (features() & FEAT_AVX2) ? strcmp_avx2(ua, ub) : strcmp_sse2(ua, ub);
+}
+
+int strncmp(const char *a, const char *b, size_t n) {
+    while (n > 0 && *a && *a == *b) {
+        a++;
+        b++;
+        n--;
+    }
+    if (n == 0) {
+        return 0;
+    }
+    return *(const unsigned char *)a - *(const unsigned char *)b;
+}
+
+char *strchr(const char *s, int c) {
+    const char ch = (char)c;
+    const rx_v16_t zero = { 0 };
+    const rx_v16_t pattern = zero + ch;
+    const rx_v16_t *v = (const rx_v16_t *)((uintptr_t)s & ~(uintptr_t)15);
+
+    // Stop at the first byte that is ch or the terminator
+    unsigned m = mask16((*v == pattern) | (*v == zero)) >> ((uintptr_t)s & 15);
+    const char *p = s;
+    while (!m) {
+        v++;
+        p = (const char *)v;
+        m = mask16((*v == pattern) | (*v == zero));
+    }
+    p += __builtin_ctz(m);
+    return *p == ch ? (char *)p : NULL;
+}
+
+// ============================================================================
+// Memory routines
+// ============================================================================
+
+void *memcpy(void *dst, const void *src, size_t n) {
+    void *ret = dst;
+
+    if (n >= ERMS_COPY_MIN && (features() & FEAT_ERMS)) {
+        __asm__ volatile ("rep movsb"
+                          : "+D" (dst), "+S" (src), "+c" (n)
+                          :
+                          : "memory");
+        return ret;
+    }
+
+    if (n >= 16 && n < ERMS_COPY_MIN) {
+        // 16-byte moves, the last one overlapping the one before. The
+        // tail is loaded first, so a forward memmove may use this too.
+        unsigned char *d = dst;
+        const unsigned char *s = src;
+        rx_v16_t tail = *(const rx_v16u_t *)(s + n - 16);
+        for (size_t i = 0; i + 16 < n; i += 16) {
+            *(rx_v16u_t *)(d + i) = *(const rx_v16u_t *)(s + i);
+        }
+        *(rx_v16u_t *)(d + n - 16) = tail;
+        return ret;
+    }
+
+    // rep movsq for the bulk, rep movsb for the remainder
+    size_t words = n >> 3;
+    size_t bytes = n & WORD_MASK;
+
+    __asm__ volatile (
+        "rep movsq\n"
+        "mov %[bytes], %%rcx\n"
+        "rep movsb\n"
+        : "+D" (dst), "+S" (src), "+c" (words)
+        : [bytes] "r" (bytes)
+        : "memory"
+    );
+    return ret;
+}
+
+void *memmove(void *dst, const void *src, size_t n) {
+    unsigned char *d = dst;
+    const unsigned char *s = src;
+
+    if (d <= s || d >= s + n) {
+        return memcpy(dst, src, n);
+    }
+
+    // Overlapping with dst above src: copy backwards
+    unsigned char *d_last = d + n - 1;
+    const unsigned char *s_last = s + n - 1;
+    __asm__ volatile (
+        "std\n"
+        "rep movsb\n"
+        "cld\n"
+        : "+D" (d_last), "+S" (s_last), "+c" (n)
+        :
+        : "memory"
+    );
+    return dst;
+}
+
+void *memset(void *dst, int c, size_t n) {
+    unsigned char *d = dst;
+
+    if (n >= ERMS_SET_MIN && (features() & FEAT_ERMS)) {
+        __asm__ volatile ("rep stosb"
+                          : "+D" (d), "+c" (n)
+                          : "a" (c)
+                          : "memory");
+        return dst;
+    }
+
+    if (n >= 16) {
+        // Unaligned first and last vectors, aligned ones in between
+        const rx_v16_t v = (rx_v16_t){ 0 } + (char)c;
+        unsigned char *end = d + n;
+        *(rx_v16u_t *)d = v;
+        rx_v16_t *a = (rx_v16_t *)(((uintptr_t)d + 16) & ~(uintptr_t)15);
+        while ((unsigned char *)(a + 1) <= end) {
+            *a++ = v;
+        }
+        *(rx_v16u_t *)(end - 16) = v;
+        return dst;
+    }
+
+    while (n > 0) {
+        *d++ = (unsigned char)c;
+        n--;
+    }
+    return dst;
+}
+
+int memcmp(const void *a, const void *b, size_t n) {
+    const unsigned char *pa = a;
+    const unsigned char *pb = b;
+
+    while (n >= WORD_SIZE && *(const rx_word_t *)pa == *(const rx_word_t *)pb) {
+        pa += WORD_SIZE;
+        pb += WORD_SIZE;
+        n -= WORD_SIZE;
+    }
+
+    while (n > 0) {
+        if (*pa != *pb) {
+            return *pa - *pb;
+        }
+        pa++;
+        pb++;
+        n--;
+    }
+    return 0;
+}
+
+void *memchr(const void *s, int c, size_t n) {
+    if (n == 0) {
+        return NULL;
+    }
+    const unsigned char *p = s;
+    const unsigned char ch = (unsigned char)c;
+    return (features() & FEAT_AVX2) ? memchr_avx2(p, ch, n) : memchr_sse2(p, ch, n);
+}
@@ -0,0 +1,120 @@
+// Copyright 2025 The Rustux Authors
+//
+// Use of this source code is governed by a MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT
+
+//! librx threads, mutexes and condition variables
+//!
+//! Threads are started with sys_thread_start() on a caller-supplied
+//! stack. The mutex and condition variable are futex words: taking a
+//! free mutex or releasing one nobody waits for is a single atomic
+//! instruction, and the kernel is only entered to sleep or to wake a
+//! sleeper.
+
+#include "../rx.h"
+
+// Mutex word states
+#define MUTEX_UNLOCKED  0
+#define MUTEX_LOCKED    1   // held, nobody sleeping
+#define MUTEX_CONTENDED 2   // held, sleepers may be waiting
+
+// ============================================================================
+// Threads
+// ============================================================================
+
+__attribute__((noreturn)) static void thread_entry(void *arg) {
+    rx_thread_t *t = arg;
+    t->result = t->fn(t->arg);
+    // The kernel clears `running` and wakes rx_thread_join() once the
+    // thread is off its stack
+    sys_thread_exit(&t->running);
+}
+
+int64_t rx_thread_create(rx_thread_t *t, void *(*fn)(void *), void *arg,
+                         void *stack, size_t size) {
+    t->fn = fn;
+    t->arg = arg;
+    t->result = NULL;
+    t->running = 1;
+
+    // As if thread_entry had been called: 16-byte aligned, then a
+    // (never used) return address
+    uintptr_t top = ((uintptr_t)stack + size) & ~(uintptr_t)15;
+    top -= 8;
+    *(uint64_t *)top = 0;
+
+    int64_t tid = sys_thread_start(thread_entry, (void *)top, t);
+    if (tid < 0) {
+        t->running = 0;
+        return tid;
+    }
+    t->tid = (uint32_t)tid;
+    return tid;
+}
+
+void *rx_thread_join(rx_thread_t *t) {
+    uint32_t running;
+    while ((running = __atomic_load_n(&t->running, __ATOMIC_ACQUIRE)) != 0) {
+        sys_futex_wait(&t->running, running);
+    }
+    return t->result;
+}
+
+// ============================================================================
+// Mutex
+// ============================================================================
+
+void rx_mutex_lock(rx_mutex_t *m) {
+    uint32_t state = MUTEX_UNLOCKED;
+    if (__atomic_compare_exchange_n(&m->state, &state, MUTEX_LOCKED, 0,
+                                    __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+        return;
+    }
+
+    // Contended: mark it so the holder wakes us, and sleep until it is
+    // released. Once we have slept the mutex stays marked contended, as
+    // others may still be sleeping
+    while (__atomic_exchange_n(&m->state, MUTEX_CONTENDED, __ATOMIC_ACQUIRE) != MUTEX_UNLOCKED) {
+        sys_futex_wait(&m->state, MUTEX_CONTENDED);
+    }
+}
+
+int rx_mutex_trylock(rx_mutex_t *m) {
+    uint32_t state = MUTEX_UNLOCKED;
+    return __atomic_compare_exchange_n(&m->state, &state, MUTEX_LOCKED, 0,
+                                       __ATOMIC_ACQUIRE, __ATOMIC_RELAXED);
+}
+
+void rx_mutex_unlock(rx_mutex_t *m) {
+    if (__atomic_exchange_n(&m->state, MUTEX_UNLOCKED, __ATOMIC_RELEASE) == MUTEX_CONTENDED) {
+        sys_futex_wake(&m->state, 1);
+    }
+}
+
+// ============================================================================
+// Condition variable
+// ============================================================================
+
+void rx_cond_wait(rx_cond_t *c, rx_mutex_t *m) {
+    // A signal after this read changes seq, so the wait below returns at
+    // once instead of missing it
+    uint32_t seq = __atomic_load_n(&c->seq, __ATOMIC_RELAXED);
+    rx_mutex_unlock(m);
+    sys_futex_wait(&c->seq, seq);
+
+    // Relock as contended: other waiters may have been woken with us
+    while (__atomic_exchange_n(&m->state, MUTEX_CONTENDED, __ATOMIC_ACQUIRE) != MUTEX_UNLOCKED) {
+        sys_futex_wait(&m->state, MUTEX_CONTENDED);
+    }
+}
+
+void rx_cond_signal(rx_cond_t *c) {
+    __atomic_fetch_add(&c->seq, 1, __ATOMIC_RELEASE);
+    sys_futex_wake(&c->seq, 1);
+}
+
+void rx_cond_broadcast(rx_cond_t *c) {
+    __atomic_fetch_add(&c->seq, 1, __ATOMIC_RELEASE);
+    sys_futex_wake(&c->seq, INT64_MAX);
+}
@@ -0,0 +1,201 @@
+// Copyright 2025 The Rustux Authors
+//
+// Use of this source code is governed by a MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT
+
+//! Rustux userspace runtime (librx)
+//!
+//! Declarations for the static runtime library every C program links
+//! against. The syscall ABI itself lives in syscall.h; this header adds
+//! the string, memory and number formatting routines so programs no
+//! longer carry their own byte-loop copies.
+
+#ifndef RX_H
+#define RX_H
+
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "syscall.h"
+
+// ============================================================================
+// String and memory routines (librx/string.c)
+// ============================================================================
+
+size_t strlen(const char *s);
+int strcmp(const char *a, const char *b);
+int strncmp(const char *a, const char *b, size_t n);
+char *strchr(const char *s, int c);
+
+void *memcpy(void *dst, const void *src, size_t n);
+void *memmove(void *dst, const void *src, size_t n);
+void *memset(void *dst, int c, size_t n);
+int memcmp(const void *a, const void *b, size_t n);
+void *memchr(const void *s, int c, size_t n);
+
+// ============================================================================
+// Number formatting (librx/format.c)
+// ============================================================================
+
+// Maximum buffer size needed by any of the formatting routines below,
+// including the NUL terminator ("-9223372036854775808")
+#define RX_FMT_BUF_SIZE 24
+
+/**
+ * Format an unsigned value in decimal
+ *
+ * Writes the digits and a NUL terminator to buf (at least RX_FMT_BUF_SIZE
+ * bytes) and returns the number of digits written.
+ */
+int rx_utoa(uint64_t value, char *buf);
+
+/**
+ * Format a signed value in decimal (see rx_utoa)
+ */
+int rx_itoa(int64_t value, char *buf);
+
+/**
+ * Format an unsigned value in lowercase hex, without a "0x" prefix
+ */
+int rx_xtoa(uint64_t value, char *buf);
+
+// ============================================================================
+// Unbuffered output helpers (librx/format.c)
+// ============================================================================
+
+/**
+ * Write a NUL-terminated string to fd with a single sys_write
+ */
+int64_t rx_puts(int fd, const char *s);
+
+/**
+ * Write an unsigned decimal value to fd with a single sys_write
+ */
+int64_t rx_put_u64(int fd, uint64_t value);
+
+// ============================================================================
+// Buffered output (librx/stdio.c)
+// ============================================================================
+//
+// Every fd below RX_STDIO_MAX_FDS has its own output buffer. Defaults:
+// stdout is line buffered, stderr is unbuffered, everything else is fully
+// buffered. Buffers are flushed automatically by sys_exit(). Do not mix
+// these calls with the unbuffered helpers above on the same fd without an
+// rx_flush() in between, or output will be reordered.
+//
+// The formatter understands %d %i %u %x %X %p %s %c %%, the '-' and '0'
+// flags, a field width, a precision for %s, and the l/ll/z length
+// modifiers.
+
+#define RX_STDIO_MAX_FDS  8
+#define RX_STDIO_BUF_SIZE 1024
+
+// Buffering modes for rx_setvbuf()
+#define RX_IONBF 0  // Unbuffered: one sys_write per call
+#define RX_IOLBF 1  // Line buffered: flush when a newline is written
+#define RX_IOFBF 2  // Fully buffered: flush when the buffer fills
+
+/**
+ * Set the buffering mode of fd (flushes pending output first)
+ *
+ * Returns 0 on success, -1 if fd has no buffer or mode is invalid.
+ */
+int rx_setvbuf(int fd, int mode);
+
+/**
+ * Write pending output for fd
+ *
+ * Returns 0 on success or the negative sys_write error.
+ */
+int64_t rx_flush(int fd);
+
+/**
+ * Write pending output for every fd
+ */
+void rx_flush_all(void);
+
+/**
+ * Buffered write of len bytes; returns len or a negative error
+ */
+int64_t rx_write(int fd, const void *buf, size_t len);
+
+/**
+ * Buffered write of a single character
+ */
+int64_t rx_fputc(int fd, char c);
+
+/**
+ * Buffered write of a NUL-terminated string
+ */
+int64_t rx_fputs(int fd, const char *s);
+
+/**
+ * Buffered formatted output; returns the number of characters produced
+ */
+int rx_printf(const char *fmt, ...) __attribute__((format(printf, 1, 2)));
+int rx_fprintf(int fd, const char *fmt, ...) __attribute__((format(printf, 2, 3)));
+int rx_vfprintf(int fd, const char *fmt, va_list ap);
+
+/**
+ * Formatted output into buf (always NUL-terminated when size > 0)
+ *
+ * Returns the length the full output would have had, like snprintf.
+ */
+int rx_snprintf(char *buf, size_t size, const char *fmt, ...) __attribute__((format(printf, 3, 4)));
+int rx_vsnprintf(char *buf, size_t size, const char *fmt, va_list ap);
+
+// ============================================================================
+// Threads and locks (librx/thread.c)
+// ============================================================================
+
+// Threads share every librx buffer: buffered output from more than one
+// thread must be serialized by the caller (e.g. with an rx_mutex_t).
+
+typedef struct {
+    uint32_t running;           // futex word: 1 until the thread has exited
+    uint32_t tid;
+    void *(*fn)(void *);
+    void *arg;
+    void *result;
+} rx_thread_t;
+
+// Statically initialized to zero (unlocked, no signals)
+typedef struct { uint32_t state; } rx_mutex_t;
+typedef struct { uint32_t seq; } rx_cond_t;
+
+#define RX_MUTEX_INIT { 0 }
+#define RX_COND_INIT  { 0 }
+
+/**
+ * Start fn(arg) in a new thread on the caller's stack memory
+ *
+ * The stack must stay valid until rx_thread_join() returns. Returns the
+ * thread ID, or a negative error code
+ */
+int64_t rx_thread_create(rx_thread_t *t, void *(*fn)(void *), void *arg,
+                         void *stack, size_t size);
+
+/**
+ * Wait for a thread to exit; returns the value fn returned
+ */
+void *rx_thread_join(rx_thread_t *t);
+
+/**
+ * Mutex; lock and unlock stay in userspace unless threads contend
+ *
+ * rx_mutex_trylock() returns 1 if it took the mutex, 0 if it is held.
+ */
+void rx_mutex_lock(rx_mutex_t *m);
+int rx_mutex_trylock(rx_mutex_t *m);
+void rx_mutex_unlock(rx_mutex_t *m);
+
+/**
+ * Condition variable; wakeups may be spurious, so wait in a loop
+ */
+void rx_cond_wait(rx_cond_t *c, rx_mutex_t *m);
+void rx_cond_signal(rx_cond_t *c);
+void rx_cond_broadcast(rx_cond_t *c);
+
+#endif // RX_H
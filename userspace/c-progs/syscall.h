@@ -7,7 +7,8 @@
 //! Syscall interface for Rustux userspace programs
 //!
 //! This header provides inline functions for making syscalls
-//! to the Rustux kernel from userspace C programs.
+//! to the Rustux kernel from userspace C programs, using the
+//! SYSCALL/SYSRET fast-path entry.
 
 #ifndef SYSCALL_H
 #define SYSCALL_H
@@ -16,45 +17,177 @@
 
 // Syscall numbers
 #define SYS_PROCESS_CREATE  0x01
+#define SYS_SPAWN           0x03
+#define SYS_THREAD_START    0x04
+#define SYS_THREAD_EXIT     0x05
 #define SYS_PROCESS_EXIT    0x06
+#define SYS_CHANNEL_CREATE  0x20
+#define SYS_CHANNEL_WRITE   0x21
+#define SYS_CHANNEL_READ    0x22
+#define SYS_PORT_CREATE     0x28
+#define SYS_PORT_WAIT_ASYNC 0x29
+#define SYS_PORT_WAIT       0x2A
+#define SYS_PORT_QUEUE      0x2B
+#define SYS_FUTEX_WAIT      0x2C
+#define SYS_FUTEX_WAKE      0x2D
+#define SYS_HANDLE_DUPLICATE 0x31
+#define SYS_HANDLE_TRANSFER 0x32
 #define SYS_CLOCK_GET       0x40
+#define SYS_TIMER_CREATE    0x41
+#define SYS_TIMER_SET       0x42
+#define SYS_TIMER_CANCEL    0x43
 #define SYS_DEBUG_WRITE     0x50
+#define SYS_STATS           0x51
 #define SYS_WRITE           0x60
 #define SYS_READ            0x61
 #define SYS_OPEN            0x62
 #define SYS_CLOSE           0x63
 #define SYS_LSEEK           0x64
+#define SYS_WRITEV          0x65
+#define SYS_READV           0x66
+#define SYS_RING_SETUP      0x67
+#define SYS_RING_ENTER      0x68
+#define SYS_MAP_FILE        0x69
 #define SYS_GETPID          0x70
 #define SYS_GETPPID         0x71
 #define SYS_YIELD           0x72
+#define SYS_SET_PRIORITY    0x73
+#define SYS_SET_AFFINITY    0x74
+
+// Scheduling priorities (higher runs first)
+#define RX_PRIORITY_MIN         0
+#define RX_PRIORITY_DEFAULT     16
+#define RX_PRIORITY_INTERACTIVE 24
+#define RX_PRIORITY_MAX         31
 
 // Open flags
 #define O_RDONLY 0
 #define O_WRONLY 1
 #define O_RDWR   2
+#define O_CREAT  (1 << 3)
+#define O_EXCL   (1 << 4)
+#define O_TRUNC  (1 << 5)
+#define O_APPEND (1 << 6)
 
 // Seek whence
 #define SEEK_SET 0
 #define SEEK_CUR 1
 #define SEEK_END 2
 
+// Error codes (returned negated)
+#define RX_ERR_INVALID_ARGS 1
+#define RX_ERR_NO_MEMORY    2
+#define RX_ERR_ACCESS_DENIED 4
+#define RX_ERR_SHOULD_WAIT  10
+#define RX_ERR_PEER_CLOSED  11
+#define RX_ERR_BAD_STATE    12
+
+// Channel messages above this size are sent as pages when page-aligned
+#define RX_CHANNEL_LARGE_MSG 4096
+#define RX_CHANNEL_MAX_MSG   (64 * 1024)
+
+// Object signals reported in port packets
+#define RX_SIGNAL_READABLE    (1u << 0)
+#define RX_SIGNAL_PEER_CLOSED (1u << 1)
+#define RX_SIGNAL_SIGNALED    (1u << 2)
+
+// Port options
+#define RX_PORT_PERSISTENT 1   // sys_port_wait_async: keep watching after a packet
+#define RX_PORT_NONBLOCK   1   // sys_port_wait: return -RX_ERR_SHOULD_WAIT if empty
+#define RX_PORT_MAX_WAIT   64  // Most packets returned by one sys_port_wait
+
+// Packet dequeued from a port
+struct rx_port_packet {
+    uint64_t key;      // Key of the registration (or sys_port_queue)
+    uint32_t signals;  // RX_SIGNAL_* asserted since the last read
+    uint32_t count;    // Notifications coalesced into this packet
+};
+
+// sys_stats snapshot kinds
+#define RX_STATS_SYSTEM    0   // one struct rx_system_stat
+#define RX_STATS_SYSCALLS  1   // struct rx_syscall_stat per syscall used
+#define RX_STATS_PROCESSES 2   // struct rx_process_stat per process
+#define RX_STATS_BOOT      3   // struct rx_boot_phase_stat per boot phase
+#define RX_STATS_MAX_BOOT_PHASES 32
+
+// Latency histogram: bucket 0 counts calls under 2^7 cycles, bucket N
+// calls in [2^(N+6), 2^(N+7)), the last bucket everything slower
+#define RX_STATS_HIST_BUCKETS  20
+#define RX_STATS_HIST_MIN_SHIFT 7
+#define RX_STATS_MAX_SYSCALLS  128
+
+// Process states in struct rx_process_stat
+#define RX_PROC_READY    0
+#define RX_PROC_RUNNING  1
+#define RX_PROC_BLOCKED  2
+#define RX_PROC_ZOMBIE   3
+#define RX_PROC_DEAD     4
+
+struct rx_system_stat {
+    uint64_t uptime_ns;
+    uint64_t tsc_hz;            // Converts the cycle counts below
+    uint64_t context_switches;  // All CPUs, since boot
+    uint64_t syscalls;          // All CPUs, since boot
+    uint64_t free_pages;
+    uint64_t total_pages;
+    uint32_t cpus;
+    uint32_t processes;
+    uint32_t cached_images;     // Programs in the spawn image cache
+    uint32_t reserved;
+};
+
+struct rx_syscall_stat {
+    uint32_t number;
+    uint32_t reserved;
+    uint64_t count;
+    uint64_t total_cycles;      // Includes time spent blocked
+    uint64_t max_cycles;
+    uint32_t histogram[RX_STATS_HIST_BUCKETS];
+};
+
+struct rx_process_stat {
+    uint32_t pid;
+    uint32_t ppid;
+    uint8_t state;              // RX_PROC_*
+    uint8_t priority;
+    uint16_t reserved;
+    uint32_t cpu;               // CPU it runs (or last ran) on
+    uint64_t cpu_cycles;
+    uint64_t context_switches;  // Times switched in
+    char name[16];              // NUL-terminated
+};
+
+struct rx_boot_phase_stat {
+    uint64_t tsc;               // When the phase ended (counts from reset)
+    uint64_t ns;                // The same, in nanoseconds since reset
+    uint32_t cpu;               // CPU that ran the phase
+    uint32_t reserved;
+    char name[16];              // NUL-terminated ("user": PID 1 entered)
+};
+
 // File descriptors
 #define STDIN_FILENO  0
 #define STDOUT_FILENO 1
 #define STDERR_FILENO 2
 
+// Syscall ABI (SYSCALL/SYSRET fast path)
+//
+//   rax: syscall number (in) / return value (out)
+//   rdi, rsi, rdx, r10, r8, r9: arguments 1-6
+//   rcx, r11: clobbered by the SYSCALL instruction (user RIP / RFLAGS)
+//
+// All other registers are preserved by the kernel.
+
 /**
  * Make a syscall with 0 arguments
  */
 static inline int64_t syscall0(int num) {
     int64_t ret;
     __asm__ volatile (
-        "mov %0, %%rax\n"
-        "int $0x80\n"
-        "mov %%rax, %0\n"
-        : "=r" (ret)
-        : "0" ((int64_t)num)
-        : "rax", "rcx", "r11"
+        "syscall"
+        : "=a" (ret)
+        : "a" ((int64_t)num)
+        : "rcx", "r11", "memory"
     );
     return ret;
 }
@@ -65,13 +198,10 @@ static inline int64_t syscall0(int num) {
 static inline int64_t syscall1(int num, int64_t arg1) {
     int64_t ret;
     __asm__ volatile (
-        "mov %1, %%rax\n"
-        "mov %2, %%rdi\n"
-        "int $0x80\n"
-        "mov %%rax, %0\n"
-        : "=r" (ret)
-        : "r" ((int64_t)num), "r" (arg1)
-        : "rax", "rdi", "rcx", "r11"
+        "syscall"
+        : "=a" (ret)
+        : "a" ((int64_t)num), "D" (arg1)
+        : "rcx", "r11", "memory"
     );
     return ret;
 }
@@ -82,14 +212,10 @@ static inline int64_t syscall1(int num, int64_t arg1) {
 static inline int64_t syscall2(int num, int64_t arg1, int64_t arg2) {
     int64_t ret;
     __asm__ volatile (
-        "mov %1, %%rax\n"
-        "mov %2, %%rdi\n"
-        "mov %3, %%rsi\n"
-        "int $0x80\n"
-        "mov %%rax, %0\n"
-        : "=r" (ret)
-        : "r" ((int64_t)num), "r" (arg1), "r" (arg2)
-        : "rax", "rdi", "rsi", "rcx", "r11"
+        "syscall"
+        : "=a" (ret)
+        : "a" ((int64_t)num), "D" (arg1), "S" (arg2)
+        : "rcx", "r11", "memory"
     );
     return ret;
 }
@@ -100,15 +226,62 @@ static inline int64_t syscall2(int num, int64_t arg1, int64_t arg2) {
 static inline int64_t syscall3(int num, int64_t arg1, int64_t arg2, int64_t arg3) {
     int64_t ret;
     __asm__ volatile (
-        "mov %1, %%rax\n"
-        "mov %2, %%rdi\n"
-        "mov %3, %%rsi\n"
-        "mov %4, %%rdx\n"
-        "int $0x80\n"
-        "mov %%rax, %0\n"
-        : "=r" (ret)
-        : "r" ((int64_t)num), "r" (arg1), "r" (arg2), "r" (arg3)
-        : "rax", "rdi", "rsi", "rdx", "rcx", "r11"
+        "syscall"
+        : "=a" (ret)
+        : "a" ((int64_t)num), "D" (arg1), "S" (arg2), "d" (arg3)
+        : "rcx", "r11", "memory"
+    );
+    return ret;
+}
+
+/**
+ * Make a syscall with 4 arguments
+ */
+static inline int64_t syscall4(int num, int64_t arg1, int64_t arg2, int64_t arg3,
+                               int64_t arg4) {
+    int64_t ret;
+    register int64_t r10 __asm__("r10") = arg4;
+    __asm__ volatile (
+        "syscall"
+        : "=a" (ret)
+        : "a" ((int64_t)num), "D" (arg1), "S" (arg2), "d" (arg3), "r" (r10)
+        : "rcx", "r11", "memory"
+    );
+    return ret;
+}
+
+/**
+ * Make a syscall with 5 arguments
+ */
+static inline int64_t syscall5(int num, int64_t arg1, int64_t arg2, int64_t arg3,
+                               int64_t arg4, int64_t arg5) {
+    int64_t ret;
+    register int64_t r10 __asm__("r10") = arg4;
+    register int64_t r8 __asm__("r8") = arg5;
+    __asm__ volatile (
+        "syscall"
+        : "=a" (ret)
+        : "a" ((int64_t)num), "D" (arg1), "S" (arg2), "d" (arg3), "r" (r10), "r" (r8)
+        : "rcx", "r11", "memory"
+    );
+    return ret;
+}
+
+/**
+ * Make a syscall with 6 arguments
+ */
+static inline int64_t syscall6(int num, int64_t arg1, int64_t arg2, int64_t arg3,
+                               int64_t arg4, int64_t arg5, int64_t arg6) {
+    int64_t ret;
+    register int64_t r10 __asm__("r10") = arg4;
+    register int64_t r8 __asm__("r8") = arg5;
+    register int64_t r9 __asm__("r9") = arg6;
+    __asm__ volatile (
+        "syscall"
+        : "=a" (ret)
+        : "a" ((int64_t)num), "D" (arg1), "S" (arg2), "d" (arg3), "r" (r10), "r" (r8),
+          "r" (r9)
+        : "rcx", "r11", "memory"
     );
     return ret;
 }
@@ -131,6 +304,9 @@ static inline int64_t sys_read(int fd, void *buf, int64_t len) {
 
 /**
  * Open a file
+ *
+ * Paths under /tmp are writable tmpfs files (O_CREAT creates them); other
+ * paths are read-only ramdisk files.
  */
 static inline int64_t sys_open(const char *path, int flags) {
     return syscall2(SYS_OPEN, (int64_t)path, (int64_t)flags);
@@ -150,6 +326,143 @@ static inline int64_t sys_lseek(int fd, int64_t offset, int whence) {
     return syscall3(SYS_LSEEK, (int64_t)fd, offset, (int64_t)whence);
 }
 
+/**
+ * Map a ramdisk or tmpfs file read-only into the address space
+ *
+ * Returns the file contents (zero-padded to a page boundary), or NULL on
+ * error. The file size is stored in *size if size is non-NULL. The
+ * mapping stays valid for the life of the process.
+ */
+static inline const void *sys_map_file(const char *path, uint64_t *size) {
+    int64_t ret = syscall2(SYS_MAP_FILE, (int64_t)path, (int64_t)size);
+    return ret < 0 ? (const void *)0 : (const void *)ret;
+}
+
+// ============================================================================
+// Vectored I/O
+// ============================================================================
+
+// Maximum iovecs per sys_writev/sys_readv call
+#define RX_IOV_MAX 64
+
+struct rx_iovec {
+    const void *base;
+    uint64_t len;
+};
+
+/**
+ * Gather-write iovcnt buffers with one syscall
+ */
+static inline int64_t sys_writev(int fd, const struct rx_iovec *iov, int iovcnt) {
+    return syscall3(SYS_WRITEV, (int64_t)fd, (int64_t)iov, (int64_t)iovcnt);
+}
+
+/**
+ * Scatter-read into iovcnt buffers with one syscall (stops at a short read)
+ */
+static inline int64_t sys_readv(int fd, const struct rx_iovec *iov, int iovcnt) {
+    return syscall3(SYS_READV, (int64_t)fd, (int64_t)iov, (int64_t)iovcnt);
+}
+
+// ============================================================================
+// Batched submission ring
+// ============================================================================
+//
+// sys_ring_setup() maps a shared ring into the process. Queue operations
+// with rx_ring_sqe()/rx_ring_push(), submit them all with one
+// sys_ring_enter(), then drain results with rx_ring_cqe()/rx_ring_pop().
+// Layout and protocol: src/syscall/ring.rs.
+
+#define RX_RING_MAX_ENTRIES 256
+
+// Ring operations
+#define RX_RING_NOP     0
+#define RX_RING_WRITE   1   // addr = buffer, len = bytes
+#define RX_RING_READ    2   // addr = buffer, len = bytes
+#define RX_RING_WRITEV  3   // addr = struct rx_iovec *, len = iovcnt
+#define RX_RING_READV   4   // addr = struct rx_iovec *, len = iovcnt
+
+struct rx_ring {
+    uint32_t sq_head;       // Written by the kernel
+    uint32_t sq_tail;       // Written by userspace
+    uint32_t cq_head;       // Written by userspace
+    uint32_t cq_tail;       // Written by the kernel
+    uint32_t entries;
+    uint32_t sqe_offset;
+    uint32_t cqe_offset;
+    uint32_t _reserved[9];
+};
+
+struct rx_sqe {
+    uint8_t opcode;
+    uint8_t flags;          // Must be zero
+    uint16_t _pad;
+    int32_t fd;
+    uint64_t addr;
+    uint64_t len;
+    uint64_t user_data;     // Copied to the completion
+};
+
+struct rx_cqe {
+    uint64_t user_data;
+    int64_t result;         // Bytes transferred or negative error
+};
+
+/**
+ * Map the submission ring (entries rounded up to a power of two)
+ *
+ * Returns the ring, or NULL on error (including a second setup).
+ */
+static inline struct rx_ring *sys_ring_setup(uint32_t entries) {
+    int64_t ret = syscall1(SYS_RING_SETUP, (int64_t)entries);
+    return ret < 0 ? (struct rx_ring *)0 : (struct rx_ring *)ret;
+}
+
+/**
+ * Submit up to to_submit queued operations; returns how many were consumed
+ */
+static inline int64_t sys_ring_enter(uint32_t to_submit) {
+    return syscall1(SYS_RING_ENTER, (int64_t)to_submit);
+}
+
+/**
+ * Get the next free submission slot, or NULL if the queue is full
+ */
+static inline struct rx_sqe *rx_ring_sqe(struct rx_ring *r) {
+    uint32_t head = __atomic_load_n(&r->sq_head, __ATOMIC_ACQUIRE);
+    if (r->sq_tail - head >= r->entries) {
+        return (struct rx_sqe *)0;
+    }
+    struct rx_sqe *sqes = (struct rx_sqe *)((char *)r + r->sqe_offset);
+    return &sqes[r->sq_tail & (r->entries - 1)];
+}
+
+/**
+ * Publish the slot returned by rx_ring_sqe()
+ */
+static inline void rx_ring_push(struct rx_ring *r) {
+    __atomic_store_n(&r->sq_tail, r->sq_tail + 1, __ATOMIC_RELEASE);
+}
+
+/**
+ * Get the oldest unconsumed completion, or NULL if there is none
+ */
+static inline struct rx_cqe *rx_ring_cqe(struct rx_ring *r) {
+    uint32_t tail = __atomic_load_n(&r->cq_tail, __ATOMIC_ACQUIRE);
+    if (r->cq_head == tail) {
+        return (struct rx_cqe *)0;
+    }
+    struct rx_cqe *cqes = (struct rx_cqe *)((char *)r + r->cqe_offset);
+    return &cqes[r->cq_head & (r->entries - 1)];
+}
+
+/**
+ * Release the completion returned by rx_ring_cqe()
+ */
+static inline void rx_ring_pop(struct rx_ring *r) {
+    __atomic_store_n(&r->cq_head, r->cq_head + 1, __ATOMIC_RELEASE);
+}
+
 /**
  * Get current process ID
  */
@@ -172,14 +485,244 @@ static inline int64_t sys_yield(void) {
 }
 
 /**
- * Exit the current process
+ * Set the scheduling priority of a process (pid 0 = self)
+ *
+ * Returns the previous priority, or a negative error code
+ */
+static inline int64_t sys_set_priority(int64_t pid, int64_t priority) {
+    return syscall2(SYS_SET_PRIORITY, pid, priority);
+}
+
+/**
+ * Restrict a process (pid 0 = self) to the CPUs in a mask (bit N = CPU N)
+ *
+ * A mask of 0 only queries. Returns the previous mask, or a negative
+ * error code
+ */
+static inline int64_t sys_set_affinity(int64_t pid, uint64_t mask) {
+    return syscall2(SYS_SET_AFFINITY, pid, (int64_t)mask);
+}
+
+/**
+ * Create a channel; its two endpoint descriptors are stored in fds[0]
+ * and fds[1]
+ *
+ * Close the endpoints with sys_close(). Returns 0, or a negative error code
+ */
+static inline int64_t sys_channel_create(int32_t fds[2]) {
+    return syscall2(SYS_CHANNEL_CREATE, 0, (int64_t)fds);
+}
+
+/**
+ * Send a message to the other endpoint of a channel
+ *
+ * A message larger than RX_CHANNEL_LARGE_MSG from a page-aligned buffer
+ * is not copied: the reader gets the buffer's pages mapped. Leave those
+ * pages unmodified until the reader is done with them. Returns the bytes
+ * written, -RX_ERR_SHOULD_WAIT if the reader's queue is full, or
+ * -RX_ERR_PEER_CLOSED
+ */
+static inline int64_t sys_channel_write(int fd, const void *buf, int64_t len) {
+    return syscall5(SYS_CHANNEL_WRITE, fd, (int64_t)buf, len, 0, 0);
+}
+
+/**
+ * Receive the next message from a channel
+ *
+ * If mapped is non-null and the message was sent as pages, the payload
+ * is mapped read-only and *mapped is set to its address (nothing is
+ * copied); otherwise *mapped is set to 0 and up to len bytes are copied
+ * to buf. Returns the message size, -RX_ERR_SHOULD_WAIT if no message is
+ * queued, or -RX_ERR_PEER_CLOSED
+ */
+static inline int64_t sys_channel_read(int fd, void *buf, int64_t len,
+                                       const void **mapped) {
+    return syscall6(SYS_CHANNEL_READ, fd, (int64_t)buf, len, 0, 0,
+                    (int64_t)mapped);
+}
+
+/**
+ * Create a port; returns its descriptor, or a negative error code
+ *
+ * A port collects packets from the objects registered with it, so one
+ * loop can wait on many channels. Close it with sys_close()
+ */
+static inline int64_t sys_port_create(void) {
+    return syscall1(SYS_PORT_CREATE, 0);
+}
+
+/**
+ * Watch a channel endpoint or a timer through a port
+ *
+ * A packet with the given key is queued on the port when one of the
+ * RX_SIGNAL_* bits in signals is asserted (at once if it already is).
+ * Without RX_PORT_PERSISTENT the registration ends with its first packet.
+ * Returns 0, or a negative error code
+ */
+static inline int64_t sys_port_wait_async(int fd, int port, uint64_t key,
+                                          uint32_t signals, uint32_t options) {
+    return syscall5(SYS_PORT_WAIT_ASYNC, fd, port, (int64_t)key, signals, options);
+}
+
+/**
+ * Dequeue up to max ready packets, blocking until there is one
+ *
+ * Returns the number of packets, -RX_ERR_SHOULD_WAIT if none is pending
+ * and options has RX_PORT_NONBLOCK, or -RX_ERR_PEER_CLOSED if the port
+ * was closed
+ */
+static inline int64_t sys_port_wait(int port, struct rx_port_packet *packets,
+                                    int64_t max, uint32_t options) {
+    return syscall4(SYS_PORT_WAIT, port, (int64_t)packets, max, options);
+}
+
+/**
+ * Queue a user packet on a port, e.g. to wake its event loop
+ *
+ * Returns 0, or a negative error code
+ */
+static inline int64_t sys_port_queue(int port, uint64_t key, uint32_t signals) {
+    return syscall3(SYS_PORT_QUEUE, port, (int64_t)key, signals);
+}
+
+// Most descriptors per sys_handle_duplicate()/sys_handle_transfer() call
+#define RX_FD_BATCH_MAX 64
+
+/**
+ * Duplicate count descriptors; the copies are stored in out
+ *
+ * A copy names the same object, which stays open until both are closed.
+ * All are duplicated or none. Returns count, or a negative error code
+ */
+static inline int64_t sys_handle_duplicate(const int32_t *fds, int64_t count, int32_t *out) {
+    return syscall3(SYS_HANDLE_DUPLICATE, (int64_t)fds, count, (int64_t)out);
+}
+
+/**
+ * Move count descriptors to a child process; their numbers in the
+ * child are stored in out
+ *
+ * The descriptors are closed here. All are moved or none; stdin, stdout
+ * and stderr cannot be. Returns count, -RX_ERR_ACCESS_DENIED if pid is
+ * not a live child, or another negative error code
+ */
+static inline int64_t sys_handle_transfer(int64_t pid, const int32_t *fds, int64_t count,
+                                          int32_t *out) {
+    return syscall4(SYS_HANDLE_TRANSFER, pid, (int64_t)fds, count, (int64_t)out);
+}
+
+/**
+ * Spawn a process from a ramdisk path (e.g. "/bin/counter")
+ */
+static inline int64_t sys_spawn(const char *path) {
+    return syscall1(SYS_SPAWN, (int64_t)path);
+}
+
+// Flushes librx buffered output; weak so it is only linked in (and only
+// called) when the program uses the buffered stdio API
+extern void rx_stdio_exit(void) __attribute__((weak));
+
+/**
+ * Exit the current process (flushing buffered output first)
  */
 static inline void sys_exit(int code) __attribute__((noreturn));
 static inline void sys_exit(int code) {
+    if (rx_stdio_exit) {
+        rx_stdio_exit();
+    }
     (void)syscall1(SYS_PROCESS_EXIT, (int64_t)code);
     for (;;) { __asm__ volatile("hlt"); }
 }
 
+/**
+ * Start a thread in this process at entry(arg) on the given stack
+ *
+ * stack_top is the thread's initial RSP (16-byte aligned minus 8, as
+ * after a call). entry must not return; end the thread with
+ * sys_thread_exit(). Returns the thread ID, or a negative error code
+ */
+static inline int64_t sys_thread_start(void (*entry)(void *), void *stack_top, void *arg) {
+    return syscall3(SYS_THREAD_START, (int64_t)entry, (int64_t)stack_top, (int64_t)arg);
+}
+
+/**
+ * End the calling thread (the process goes on while it has others)
+ *
+ * If clear is non-NULL, *clear is set to 0 and its futex waiters are
+ * woken once the thread is off its stack
+ */
+static inline void sys_thread_exit(uint32_t *clear) __attribute__((noreturn));
+static inline void sys_thread_exit(uint32_t *clear) {
+    (void)syscall1(SYS_THREAD_EXIT, (int64_t)clear);
+    for (;;) { __asm__ volatile("hlt"); }
+}
+
+/**
+ * Sleep until woken if *addr still holds expected
+ *
+ * Returns 0 once woken, -RX_ERR_SHOULD_WAIT at once if *addr differs,
+ * or another negative error code. Wakeups may be spurious
+ */
+static inline int64_t sys_futex_wait(uint32_t *addr, uint32_t expected) {
+    return syscall2(SYS_FUTEX_WAIT, (int64_t)addr, expected);
+}
+
+/**
+ * Wake up to count threads sleeping on addr, oldest first
+ *
+ * Returns the number woken, or a negative error code
+ */
+static inline int64_t sys_futex_wake(uint32_t *addr, int64_t count) {
+    return syscall2(SYS_FUTEX_WAKE, (int64_t)addr, count);
+}
+
+/**
+ * Monotonic clock in nanoseconds (counted from CPU reset)
+ */
+static inline int64_t sys_clock_get(void) {
+    return syscall1(SYS_CLOCK_GET, 0);
+}
+
+/**
+ * Create a timer; returns its descriptor, or a negative error code
+ *
+ * The timer asserts RX_SIGNAL_SIGNALED when it fires; watch it with
+ * sys_port_wait_async(). Close it with sys_close()
+ */
+static inline int64_t sys_timer_create(void) {
+    return syscall1(SYS_TIMER_CREATE, 0);
+}
+
+/**
+ * Arm a timer for an absolute sys_clock_get() deadline
+ *
+ * It may fire up to slack ns late. A non-zero period re-arms it every
+ * period ns after the first deadline. Re-arming clears the signal.
+ * Returns 0, or a negative error code
+ */
+static inline int64_t sys_timer_set(int fd, uint64_t deadline, uint64_t slack,
+                                    uint64_t period) {
+    return syscall4(SYS_TIMER_SET, fd, (int64_t)deadline, (int64_t)slack, (int64_t)period);
+}
+
+/**
+ * Cancel an armed timer
+ *
+ * Returns 0, or -RX_ERR_BAD_STATE if it is not armed
+ */
+static inline int64_t sys_timer_cancel(int fd) {
+    return syscall1(SYS_TIMER_CANCEL, fd);
+}
+
+/**
+ * Snapshot kernel accounting (RX_STATS_*) into an array of `max` records
+ *
+ * Returns the number of records written, or a negative error code.
+ */
+static inline int64_t sys_stats(int kind, void *records, int64_t max) {
+    return syscall3(SYS_STATS, kind, (int64_t)records, max);
+}
+
 /**
  * Debug write (to port 0xE9)
  */